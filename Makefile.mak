@@ -186,6 +186,9 @@ libsrc = \
   vl\mathop_sse2.c \
   vl\mser.c \
   vl\pgm.c \
+  vl\pooling.c \
+  vl\pq.c \
+  vl\pq_avx.c \
   vl\quickshift.c \
   vl\random.c \
   vl\rodrigues.c \
@@ -195,53 +198,68 @@ libsrc = \
   vl\stringop.c \
   vl\svm.c \
   vl\svmdataset.c \
+  vl\svmmulticlass.c \
   vl\vlad.c
 
 cmdsrc = \
   src\aib.c \
   src\mser.c \
   src\sift.c \
+  src\test_fisher.c \
   src\test_gauss_elimination.c \
   src\test_getopt_long.c \
   src\test_gmm.c \
   src\test_heap-def.c \
+  src\test_hikmeans.c \
+  src\test_ikmeans.c \
   src\test_host.c \
   src\test_imopv.c \
+  src\test_kdtree.c \
   src\test_kmeans.c \
   src\test_liop.c \
   src\test_mathop.c \
   src\test_mathop_abs.c \
   src\test_nan.c \
+  src\test_pq.c \
   src\test_qsort-def.c \
   src\test_rand.c \
   src\test_sqrti.c \
   src\test_stringop.c \
   src\test_svd2.c \
+  src\test_svm.c \
   src\test_threads.c \
-  src\test_vec_comp.c
+  src\test_vec_comp.c \
+  src\test_vlad.c
 
 cmdsrc = \
   src\aib.c \
   src\mser.c \
   src\sift.c \
+  src\test_fisher.c \
   src\test_gauss_elimination.c \
   src\test_getopt_long.c \
   src\test_gmm.c \
   src\test_heap-def.c \
+  src\test_hikmeans.c \
+  src\test_ikmeans.c \
   src\test_host.c \
   src\test_imopv.c \
+  src\test_kdtree.c \
   src\test_kmeans.c \
   src\test_liop.c \
   src\test_mathop.c \
   src\test_mathop_abs.c \
   src\test_nan.c \
+  src\test_pq.c \
   src\test_qsort-def.c \
   src\test_rand.c \
   src\test_sqrti.c \
   src\test_stringop.c \
   src\test_svd2.c \
+  src\test_svm.c \
   src\test_threads.c \
-  src\test_vec_comp.c
+  src\test_vec_comp.c \
+  src\test_vlad.c
 
 mexsrc = \
   toolbox\aib\vl_aib.c \
@@ -0,0 +1,260 @@
+/** @file test_fisher.c
+ ** @brief Fisher vector encoding test
+ ** @author agent
+ **/
+
+#include <vl/fisher.h>
+#include <vl/gmm.h>
+#include <vl/host.h>
+#include <vl/random.h>
+#include <vl/mathop.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+
+/* regions of a three-level spatial pyramid followed by random boxes
+   on a coarse lattice; return the number of regions */
+static vl_size
+make_regions (double * regions, VlRand * rand, vl_size numBoxes)
+{
+  vl_size numRegions = 0 ;
+  vl_uindex level, i, j ;
+  for (level = 1 ; level <= 4 ; level *= 2) {
+    for (i = 0 ; i < level ; ++i) {
+      for (j = 0 ; j < level ; ++j) {
+        double * box = regions + 4 * numRegions++ ;
+        box[0] = (double)i / level ;
+        box[1] = (double)j / level ;
+        box[2] = (double)(i + 1) / level ;
+        box[3] = (double)(j + 1) / level ;
+      }
+    }
+  }
+  for (i = 0 ; i < numBoxes ; ++i) {
+    double * box = regions + 4 * numRegions++ ;
+    box[0] = vl_rand_uindex(rand, 8) / 8.0 ;
+    box[1] = vl_rand_uindex(rand, 8) / 8.0 ;
+    box[2] = box[0] + (1 + vl_rand_uindex(rand, 8)) / 8.0 ;
+    box[3] = box[1] + (1 + vl_rand_uindex(rand, 8)) / 8.0 ;
+  }
+  return numRegions ;
+}
+
+/* copy the vectors inside a box; return their number */
+static vl_size
+select_region (float * selection, float const * data, double const * positions,
+               vl_size numData, vl_size dimension, double const * box)
+{
+  vl_size count = 0 ;
+  vl_uindex i ;
+  for (i = 0 ; i < numData ; ++i) {
+    double const * x = positions + 2 * i ;
+    if (box[0] <= x[0] && x[0] < box[2] && box[1] <= x[1] && x[1] < box[3]) {
+      memcpy(selection + count++ * dimension, data + i * dimension, sizeof(float) * dimension) ;
+    }
+  }
+  return count ;
+}
+
+static float
+max_difference (float const * a, float const * b, vl_size n)
+{
+  vl_uindex i ;
+  float err = 0 ;
+  for (i = 0 ; i < n ; ++i) {
+    err = VL_MAX(err, vl_abs_f(a[i] - b[i])) ;
+  }
+  return err ;
+}
+
+int
+main (int argc VL_UNUSED, char ** argv VL_UNUSED)
+{
+  VlRand rand ;
+  VlGMM * gmm ;
+  vl_size numData = 10000 ;
+  vl_size dimension = 80 ;
+  vl_size numClusters = 256 ;
+  vl_size encSize = 2 * dimension * numClusters ;
+  vl_size denseTerms, sparseTerms ;
+  vl_uindex i, d ;
+  double denseTime, sparseTime ;
+  float err ;
+
+  float * data = vl_malloc(sizeof(float) * dimension * numData) ;
+  float * centers = vl_malloc(sizeof(float) * dimension * 32) ;
+  float * denseEnc = vl_malloc(sizeof(float) * encSize) ;
+  float * sparseEnc = vl_malloc(sizeof(float) * encSize) ;
+  float const * means ;
+  float const * covariances ;
+  float const * priors ;
+
+  vl_rand_init (&rand) ;
+  vl_rand_seed (&rand, 1000) ;
+
+  /* clustered data */
+  for (i = 0 ; i < dimension * 32 ; ++i) {
+    centers[i] = (float) vl_rand_real1(&rand) * 4 ;
+  }
+  for (i = 0 ; i < numData ; ++i) {
+    float const * c = centers + vl_rand_uindex(&rand, 32) * dimension ;
+    for (d = 0 ; d < dimension ; ++d) {
+      data[i * dimension + d] = c[d] + (float) vl_rand_real1(&rand) ;
+    }
+  }
+
+  gmm = vl_gmm_new (VL_TYPE_FLOAT, dimension, numClusters) ;
+  vl_gmm_set_max_num_iterations (gmm, 5) ;
+  vl_gmm_cluster (gmm, data, numData) ;
+  means = vl_gmm_get_means(gmm) ;
+  covariances = vl_gmm_get_covariances(gmm) ;
+  priors = vl_gmm_get_priors(gmm) ;
+
+  /* keeping all the posteriors matches the dense encoder */
+  vl_tic() ;
+  denseTerms = vl_fisher_encode (denseEnc, VL_TYPE_FLOAT, means, dimension, numClusters,
+                                 covariances, priors, data, numData, 0) ;
+  denseTime = vl_toc() ;
+  sparseTerms = vl_fisher_encode_sparse (sparseEnc, VL_TYPE_FLOAT, means, dimension, numClusters,
+                                         covariances, priors, data, numData, numClusters, 0) ;
+  err = max_difference(denseEnc, sparseEnc, encSize) ;
+  /* posteriors at the pruning threshold may fall either side of it
+     depending on the summation order, hence on the number of threads */
+  check (VL_MAX(sparseTerms, denseTerms) - VL_MIN(sparseTerms, denseTerms) <= denseTerms / 10000,
+         "number of terms differ (%d vs %d)", (int)sparseTerms, (int)denseTerms) ;
+  check (err <= 1e-5f, "sparse and dense Fisher vectors differ by %g", err) ;
+
+  /* a few posteriors are a good approximation */
+  vl_tic() ;
+  vl_fisher_encode_sparse (sparseEnc, VL_TYPE_FLOAT, means, dimension, numClusters,
+                           covariances, priors, data, numData, 5, 0) ;
+  sparseTime = vl_toc() ;
+  err = max_difference(denseEnc, sparseEnc, encSize) ;
+  VL_PRINTF("test_fisher: dense %.3f s, top-5 sparse %.3f s, max error %g\n",
+            denseTime, sparseTime, err) ;
+  check (err <= 1e-3f, "top-5 Fisher vector differs by %g", err) ;
+
+  /* dropping only the smallest posterior selects the others exactly */
+  vl_fisher_encode_sparse (sparseEnc, VL_TYPE_FLOAT, means, dimension, numClusters,
+                           covariances, priors, data, numData, numClusters - 1, 0) ;
+  err = max_difference(denseEnc, sparseEnc, encSize) ;
+  check (err <= 1e-5f, "top-%d Fisher vector differs by %g", (int)numClusters - 1, err) ;
+
+  /* the fast option keeps the best posterior only */
+  vl_fisher_encode (denseEnc, VL_TYPE_FLOAT, means, dimension, numClusters,
+                    covariances, priors, data, numData,
+                    VL_FISHER_FLAG_FAST | VL_FISHER_FLAG_IMPROVED) ;
+  vl_fisher_encode_sparse (sparseEnc, VL_TYPE_FLOAT, means, dimension, numClusters,
+                           covariances, priors, data, numData, 5,
+                           VL_FISHER_FLAG_FAST | VL_FISHER_FLAG_IMPROVED) ;
+  err = max_difference(denseEnc, sparseEnc, encSize) ;
+  check (err <= 1e-5f, "fast sparse and dense Fisher vectors differ by %g", err) ;
+
+  /* encoding a batch of images equals encoding them one by one */
+  {
+    vl_size numImages = 4 ;
+    vl_size numImageData [4] = {1000, 0, 2500, 130} ;
+    float * batchEnc = vl_malloc(sizeof(float) * encSize * numImages) ;
+    VlFisherEncoder * encoder = vl_fisher_encoder_new (VL_TYPE_FLOAT, means, dimension, numClusters,
+                                                       covariances, priors) ;
+    float const * x = data ;
+    vl_fisher_encoder_set_num_posteriors (encoder, 5) ;
+    vl_fisher_encoder_encode_batch (encoder, batchEnc, data, numImageData, numImages,
+                                    VL_FISHER_FLAG_IMPROVED) ;
+    for (i = 0 ; i < numImages ; ++i) {
+      vl_fisher_encode_sparse (sparseEnc, VL_TYPE_FLOAT, means, dimension, numClusters,
+                               covariances, priors, x, numImageData[i], 5,
+                               VL_FISHER_FLAG_IMPROVED) ;
+      err = max_difference(batchEnc + i * encSize, sparseEnc, encSize) ;
+      check (err <= 1e-6f, "batch Fisher vector %d differs by %g", (int)i, err) ;
+      x += numImageData[i] * dimension ;
+    }
+    vl_fisher_encoder_delete (encoder) ;
+    vl_free(batchEnc) ;
+  }
+
+  /* pooling into a spatial pyramid (directly) and into many boxes
+     (through an integral image) equals encoding each region */
+  {
+    vl_size numBoxes [2] = {0, 200} ;
+    vl_uindex trial ;
+    double * positions = vl_malloc(sizeof(double) * 2 * numData) ;
+    double * regions = vl_malloc(sizeof(double) * 4 * (21 + 200)) ;
+    float * selection = vl_malloc(sizeof(float) * dimension * numData) ;
+    float * regionEnc = vl_malloc(sizeof(float) * encSize * (21 + 200)) ;
+    VlFisherEncoder * encoder = vl_fisher_encoder_new (VL_TYPE_FLOAT, means, dimension, numClusters,
+                                                       covariances, priors) ;
+    vl_fisher_encoder_set_num_posteriors (encoder, 5) ;
+    for (i = 0 ; i < 2 * numData ; ++i) {
+      positions[i] = vl_rand_real2(&rand) ;
+    }
+    for (trial = 0 ; trial < 2 ; ++trial) {
+      vl_size numRegions = make_regions (regions, &rand, numBoxes[trial]) ;
+      vl_size regionTerms = 0, numTerms ;
+      vl_uindex r ;
+      vl_tic() ;
+      numTerms = vl_fisher_encoder_encode_regions (encoder, regionEnc, data, numData,
+                                                   positions, regions, numRegions,
+                                                   VL_FISHER_FLAG_IMPROVED) ;
+      VL_PRINTF("test_fisher: %d regions pooled in %.3f s\n", (int)numRegions, vl_toc()) ;
+      err = 0 ;
+      for (r = 0 ; r < numRegions ; ++r) {
+        vl_size count = select_region (selection, data, positions, numData, dimension, regions + 4 * r) ;
+        regionTerms += vl_fisher_encoder_encode (encoder, sparseEnc, selection, count,
+                                                 VL_FISHER_FLAG_IMPROVED) ;
+        err = VL_MAX(err, max_difference(regionEnc + r * encSize, sparseEnc, encSize)) ;
+      }
+      check (err <= 1e-4f, "region Fisher vectors differ by %g", err) ;
+      check (numTerms == regionTerms, "number of region terms differ (%d vs %d)",
+             (int)numTerms, (int)regionTerms) ;
+    }
+    vl_fisher_encoder_delete (encoder) ;
+    vl_free(positions) ;
+    vl_free(regions) ;
+    vl_free(selection) ;
+    vl_free(regionEnc) ;
+  }
+
+  /* an encoder must not be used by concurrent callers, but one
+     encoder per thread can be; encoding from within a parallel
+     region, where the encoder runs with fewer threads than it has
+     scratch blocks for, is unaffected */
+  {
+    vl_size numThreads = vl_get_max_threads() ;
+    float * nestedEnc = vl_malloc(sizeof(float) * encSize * 2) ;
+    VlFisherEncoder * encoders [2] ;
+    vl_index k ;
+    vl_set_num_threads (4) ;
+    for (k = 0 ; k < 2 ; ++k) {
+      encoders[k] = vl_fisher_encoder_new (VL_TYPE_FLOAT, means, dimension, numClusters,
+                                           covariances, priors) ;
+      vl_fisher_encoder_set_num_posteriors (encoders[k], 5) ;
+      vl_fisher_encoder_encode (encoders[k], sparseEnc, data, numData,
+                                VL_FISHER_FLAG_IMPROVED) ;
+    }
+#if defined(_OPENMP)
+#pragma omp parallel for num_threads(2)
+#endif
+    for (k = 0 ; k < 2 ; ++k) {
+      vl_fisher_encoder_encode (encoders[k], nestedEnc + k * encSize,
+                                data, numData / 2, VL_FISHER_FLAG_IMPROVED) ;
+    }
+    vl_fisher_encoder_encode (encoders[0], sparseEnc, data, numData / 2,
+                              VL_FISHER_FLAG_IMPROVED) ;
+    for (k = 0 ; k < 2 ; ++k) {
+      err = max_difference(nestedEnc + k * encSize, sparseEnc, encSize) ;
+      check (err <= 1e-5f, "Fisher vector encoded in a parallel region differs by %g", err) ;
+      vl_fisher_encoder_delete (encoders[k]) ;
+    }
+    vl_set_num_threads (numThreads) ;
+    vl_free(nestedEnc) ;
+  }
+
+  vl_gmm_delete (gmm) ;
+  vl_free(data) ;
+  vl_free(centers) ;
+  vl_free(denseEnc) ;
+  vl_free(sparseEnc) ;
+  return 0 ;
+}
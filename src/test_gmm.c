@@ -8,9 +8,13 @@
 #include <vl/kmeans.h>
 #include <vl/fisher.h>
 #include <vl/vlad.h>
+#include <vl/mathop.h>
 #include <stdio.h>
+#include <math.h>
 //#include <sys/time.h>
 
+#include "check.h"
+
 //#define TYPE double
 //#define VL_F_TYPE VL_TYPE_DOUBLE
 
@@ -19,6 +23,173 @@
 
 void saveResults(const char * dataFileData, const char * dataFileResults, VlGMM * gmm, void * data, vl_size numData);
 
+/* sample a standard normal variable (Box-Muller) */
+static double
+rand_normal (VlRand * rand)
+{
+  double u = vl_rand_real3 (rand) ;
+  double v = vl_rand_real3 (rand) ;
+  return sqrt (-2 * log (u)) * cos (2 * VL_PI * v) ;
+}
+
+/* check that tied and spherical fits recover the covariances of
+   well separated modes */
+static void
+check_covariance_types (void)
+{
+  double const means [3*2] = {-10, 0, 0, 10, 10, -5} ;
+  double const tied [2*2] = {2, 0.8, 0.8, 1} ;
+  double const L [2*2] = {sqrt(2.0), 0, 0.8 / sqrt(2.0), sqrt(1 - 0.32)} ;
+  double const variances [3] = {0.5, 1, 2} ;
+  vl_size numData = 30000 ;
+  double * data = vl_malloc (sizeof(double) * 2 * numData) ;
+  VlRand rand ;
+  VlGMM * gmm ;
+  vl_uindex i, k, j ;
+
+  vl_rand_init (&rand) ;
+  vl_rand_seed (&rand, 0) ;
+
+  /* tied: data = mean + L z */
+  for (i = 0 ; i < numData ; ++i) {
+    double z0 = rand_normal (&rand), z1 = rand_normal (&rand) ;
+    k = i % 3 ;
+    data[2*i+0] = means[2*k+0] + L[0] * z0 ;
+    data[2*i+1] = means[2*k+1] + L[2] * z0 + L[3] * z1 ;
+  }
+  gmm = vl_gmm_new (VL_TYPE_DOUBLE, 2, 3) ;
+  vl_gmm_set_covariance_type (gmm, VlGMMTied) ;
+  vl_gmm_set_initialization (gmm, VlGMMKMeans) ;
+  vl_gmm_set_num_repetitions (gmm, 5) ;
+  vl_gmm_cluster (gmm, data, numData) ;
+  for (j = 0 ; j < 4 ; ++j) {
+    check (vl_abs_d (((double const*)vl_gmm_get_tied_covariance(gmm))[j] - tied[j]) < 0.1,
+           "tied covariance entry %d is %f instead of %f", (int)j,
+           ((double const*)vl_gmm_get_tied_covariance(gmm))[j], tied[j]) ;
+  }
+  for (k = 0 ; k < 3 ; ++k) {
+    check (((double const*)vl_gmm_get_covariances(gmm))[2*k+0] == ((double const*)vl_gmm_get_tied_covariance(gmm))[0] &&
+           ((double const*)vl_gmm_get_covariances(gmm))[2*k+1] == ((double const*)vl_gmm_get_tied_covariance(gmm))[3],
+           "the diagonal covariances differ from the tied covariance") ;
+  }
+  vl_gmm_delete (gmm) ;
+
+  /* spherical: data = mean + sigma z */
+  for (i = 0 ; i < numData ; ++i) {
+    k = i % 3 ;
+    for (j = 0 ; j < 2 ; ++j) {
+      data[2*i+j] = means[2*k+j] + sqrt(variances[k]) * rand_normal (&rand) ;
+    }
+  }
+  gmm = vl_gmm_new (VL_TYPE_DOUBLE, 2, 3) ;
+  vl_gmm_set_covariance_type (gmm, VlGMMSpherical) ;
+  vl_gmm_set_initialization (gmm, VlGMMKMeans) ;
+  vl_gmm_set_num_repetitions (gmm, 5) ;
+  vl_gmm_cluster (gmm, data, numData) ;
+  for (k = 0 ; k < 3 ; ++k) {
+    /* match the modes by their means */
+    double const * fitted = vl_gmm_get_means(gmm) ;
+    vl_uindex best = 0 ;
+    for (j = 1 ; j < 3 ; ++j) {
+      if (vl_abs_d (fitted[2*j] - means[2*k]) < vl_abs_d (fitted[2*best] - means[2*k])) best = j ;
+    }
+    check (vl_abs_d (((double const*)vl_gmm_get_covariances(gmm))[2*best+0] - variances[k]) < 0.1 * variances[k] &&
+           ((double const*)vl_gmm_get_covariances(gmm))[2*best+0] == ((double const*)vl_gmm_get_covariances(gmm))[2*best+1],
+           "spherical variance of mode %d is %f instead of %f", (int)k,
+           ((double const*)vl_gmm_get_covariances(gmm))[2*best], variances[k]) ;
+  }
+  vl_gmm_delete (gmm) ;
+
+  /* a tied covariance that is not positive definite is an error */
+  {
+    double const priors [3] = {1.0/3, 1.0/3, 1.0/3} ;
+    double const bad [2*2] = {1, 2, 2, 1} ;
+    gmm = vl_gmm_new (VL_TYPE_DOUBLE, 2, 3) ;
+    vl_gmm_set_covariance_type (gmm, VlGMMTied) ;
+    vl_gmm_set_initialization (gmm, VlGMMCustom) ;
+    vl_gmm_set_priors (gmm, priors) ;
+    vl_gmm_set_means (gmm, means) ;
+    vl_gmm_set_tied_covariance (gmm, bad) ;
+    check (vl_is_nan_d (vl_gmm_em (gmm, data, numData)) &&
+           vl_get_last_error() == VL_ERR_BAD_ARG,
+           "EM did not fail with a tied covariance that is not positive definite") ;
+    vl_gmm_delete (gmm) ;
+  }
+
+  vl_free (data) ;
+}
+
+/* check that online EM reaches a likelihood comparable to batch EM */
+static void
+check_push_batch (void)
+{
+  double const means [3*2] = {-10, 0, 0, 10, 10, -5} ;
+  double const sigmas [3*2] = {1, 2, 0.5, 1, 2, 0.5} ;
+  vl_size numData = 30000 ;
+  vl_size batchSize = 1000 ;
+  vl_size numClusters = 3 ;
+  double * data = vl_malloc (sizeof(double) * 2 * numData) ;
+  double * posteriors = vl_malloc (sizeof(double) * numClusters * numData) ;
+  double initPriors [3], initMeans [3*2], initCovariances [3*2] ;
+  double batchLL, onlineLL ;
+  VlRand rand ;
+  VlGMM * gmm ;
+  vl_uindex i, k, j, epoch ;
+
+  vl_rand_init (&rand) ;
+  vl_rand_seed (&rand, 1) ;
+  for (i = 0 ; i < numData ; ++i) {
+    k = i % 3 ;
+    for (j = 0 ; j < 2 ; ++j) {
+      data[2*i+j] = means[2*k+j] + sigmas[2*k+j] * rand_normal (&rand) ;
+    }
+  }
+
+  /* start both variants from the same model, with the means one unit
+     away from the true ones */
+  for (k = 0 ; k < numClusters ; ++k) {
+    initPriors[k] = 1.0 / numClusters ;
+    for (j = 0 ; j < 2 ; ++j) {
+      initMeans[2*k+j] = means[2*k+j] + 1 ;
+      initCovariances[2*k+j] = 1 ;
+    }
+  }
+
+  gmm = vl_gmm_new (VL_TYPE_DOUBLE, 2, numClusters) ;
+  vl_gmm_set_priors (gmm, initPriors) ;
+  vl_gmm_set_means (gmm, initMeans) ;
+  vl_gmm_set_covariances (gmm, initCovariances) ;
+  vl_gmm_em (gmm, data, numData) ;
+  batchLL = vl_get_gmm_data_posteriors_d
+  (posteriors, numClusters, numData,
+   vl_gmm_get_priors(gmm), vl_gmm_get_means(gmm), 2,
+   vl_gmm_get_covariances(gmm), data) ;
+  vl_gmm_delete (gmm) ;
+
+  /* stream three epochs of batches */
+  gmm = vl_gmm_new (VL_TYPE_DOUBLE, 2, numClusters) ;
+  vl_gmm_set_priors (gmm, initPriors) ;
+  vl_gmm_set_means (gmm, initMeans) ;
+  vl_gmm_set_covariances (gmm, initCovariances) ;
+  for (epoch = 0 ; epoch < 3 ; ++epoch) {
+    for (i = 0 ; i < numData ; i += batchSize) {
+      vl_gmm_push_batch (gmm, data + 2*i, batchSize) ;
+    }
+  }
+  onlineLL = vl_get_gmm_data_posteriors_d
+  (posteriors, numClusters, numData,
+   vl_gmm_get_priors(gmm), vl_gmm_get_means(gmm), 2,
+   vl_gmm_get_covariances(gmm), data) ;
+  vl_gmm_delete (gmm) ;
+
+  check (onlineLL > batchLL - 0.01 * numData,
+         "online EM loglikelihood %f is much lower than batch EM %f",
+         onlineLL, batchLL) ;
+
+  vl_free (posteriors) ;
+  vl_free (data) ;
+}
+
 int main(int argc VL_UNUSED, char ** argv VL_UNUSED)
 {
   VlKMeans * kmeans = 0;
@@ -58,6 +229,9 @@ int main(int argc VL_UNUSED, char ** argv VL_UNUSED)
 
   vl_set_num_threads(0) ; /* use the default number of threads */
 
+  check_covariance_types () ;
+  check_push_batch () ;
+
   vl_rand_init (&rand) ;
   vl_rand_seed (&rand, 49000) ;
 
@@ -0,0 +1,133 @@
+/** @file test_hikmeans.c
+ ** @brief HIKM flat layout, save and load test
+ ** @author agent
+ **/
+
+#include <vl/hikmeans.h>
+#include <vl/random.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+
+/* corrupt the first center offset of the second level of a file */
+static void
+corrupt_center_offsets (char const * fileName, vl_uint32 value)
+{
+  /* the header takes 48 bytes and is followed by the level records
+     (numNodes, numCenters, centerOffsetsOffset, centersOffset) */
+  FILE * file = fopen (fileName, "r+b") ;
+  vl_uint64 offset ;
+  check (file != NULL, "cannot open %s", fileName) ;
+  check (fseek (file, 48 + 32 + 16, SEEK_SET) == 0 &&
+         fread (&offset, sizeof(offset), 1, file) == 1 &&
+         fseek (file, (long) offset + sizeof(vl_uint32), SEEK_SET) == 0 &&
+         fwrite (&value, sizeof(value), 1, file) == 1,
+         "cannot modify %s", fileName) ;
+  fclose (file) ;
+}
+
+/* train a tree with a given number of threads */
+static VlHIKMTree *
+train (vl_uint8 const * data, vl_size numData, vl_size dimension,
+       vl_size K, vl_size depth, vl_size numThreads)
+{
+  VlHIKMTree * tree = vl_hikm_new (VL_IKM_LLOYD) ;
+  vl_set_num_threads (numThreads) ;
+  vl_rand_seed (vl_get_rand(), 0) ;
+  vl_hikm_set_max_niters (tree, 10) ;
+  vl_hikm_init (tree, dimension, K, depth) ;
+  vl_hikm_train (tree, data, numData) ;
+  vl_hikm_flatten (tree) ;
+  vl_set_num_threads (0) ;
+  return tree ;
+}
+
+/* check that two flat trees are identical */
+static void
+check_same_tree (VlHIKMTree const * a, VlHIKMTree const * b)
+{
+  vl_uindex d ;
+  for (d = 0 ; d < a->depth ; ++d) {
+    VlHIKMFlatLevel const * la = a->levels + d ;
+    VlHIKMFlatLevel const * lb = b->levels + d ;
+    check (la->numNodes == lb->numNodes && la->numCenters == lb->numCenters &&
+           memcmp (la->centerOffsets, lb->centerOffsets,
+                   sizeof(*la->centerOffsets) * (la->numNodes + 1)) == 0 &&
+           memcmp (la->centers, lb->centers, a->M * la->numCenters) == 0,
+           "level %d of the tree depends on the number of threads", (int)d) ;
+  }
+}
+
+int
+main (int argc VL_UNUSED, char ** argv VL_UNUSED)
+{
+  VlRand rand ;
+  vl_size numData = 20000 ;
+  vl_size dimension = 32 ;
+  vl_size K = 8 ;
+  vl_size depth = 3 ;
+  char const * fileName = "test_hikmeans.vlhikm" ;
+  vl_uindex i ;
+
+  vl_uint8 * data = vl_malloc(dimension * numData) ;
+  vl_uint32 * asgn = vl_malloc(sizeof(vl_uint32) * depth * numData) ;
+  vl_uint32 * asgn_ = vl_malloc(sizeof(vl_uint32) * depth * numData) ;
+  VlHIKMTree * tree ;
+  VlHIKMTree * loaded ;
+
+  /* clustered data */
+  vl_rand_init (&rand) ;
+  vl_rand_seed (&rand, 1000) ;
+  for (i = 0 ; i < dimension * numData ; ++i) {
+    data[i] = (vl_uint8) ((i / dimension % 13) * 16 + vl_rand_uindex(&rand, 64)) ;
+  }
+
+  tree = vl_hikm_new (VL_IKM_LLOYD) ;
+  vl_hikm_set_max_niters (tree, 10) ;
+  vl_hikm_init (tree, dimension, K, depth) ;
+  vl_hikm_train (tree, data, numData) ;
+  vl_hikm_push (tree, asgn, data, numData) ;
+
+  vl_hikm_flatten (tree) ;
+  check (vl_hikm_is_flat(tree), "the tree is not flat") ;
+  vl_hikm_push (tree, asgn_, data, numData) ;
+  check (memcmp (asgn, asgn_, sizeof(vl_uint32) * depth * numData) == 0,
+         "the flat tree assigns the data differently") ;
+
+  check (vl_hikm_save (tree, fileName) == VL_ERR_OK,
+         "cannot save %s: %s", fileName, vl_get_last_error_message()) ;
+  loaded = vl_hikm_load (fileName) ;
+  check (loaded != NULL, "cannot load %s: %s", fileName, vl_get_last_error_message()) ;
+  check (vl_hikm_get_ndims(loaded) == dimension &&
+         vl_hikm_get_K(loaded) == K &&
+         vl_hikm_get_depth(loaded) == depth, "wrong parameters after loading") ;
+  memset (asgn_, 0, sizeof(vl_uint32) * depth * numData) ;
+  vl_hikm_push (loaded, asgn_, data, numData) ;
+  check (memcmp (asgn, asgn_, sizeof(vl_uint32) * depth * numData) == 0,
+         "the loaded tree assigns the data differently") ;
+  vl_hikm_delete (loaded) ;
+
+  /* center offsets that are out of order or give a node more than K
+     centers are rejected */
+  corrupt_center_offsets (fileName, (vl_uint32) K + 1) ;
+  check (vl_hikm_load (fileName) == NULL, "loading bad center offsets should fail") ;
+  corrupt_center_offsets (fileName, (vl_uint32) -1) ;
+  check (vl_hikm_load (fileName) == NULL, "loading bad center offsets should fail") ;
+
+  remove (fileName) ;
+  check (vl_hikm_load (fileName) == NULL, "loading a missing file should fail") ;
+
+  /* the subtrees are trained by tasks, which must not change them */
+  vl_hikm_delete (tree) ;
+  tree = train (data, numData, dimension, K, depth, 1) ;
+  loaded = train (data, numData, dimension, K, depth, 4) ;
+  check_same_tree (tree, loaded) ;
+  vl_hikm_delete (loaded) ;
+
+  vl_hikm_delete (tree) ;
+  vl_free(data) ;
+  vl_free(asgn) ;
+  vl_free(asgn_) ;
+  return 0 ;
+}
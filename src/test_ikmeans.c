@@ -0,0 +1,102 @@
+/** @file test_ikmeans.c
+ ** @brief IKM SIMD distances test
+ ** @author agent
+ **/
+
+#include <vl/ikmeans.h>
+#include <vl/random.h>
+#ifndef VL_DISABLE_SSE2
+#include <vl/mathop_sse2.h>
+#endif
+#include <string.h>
+
+#include "check.h"
+
+/* train and push with and without SIMD instructions */
+static void
+check_filter (int method, vl_uint8 const * data,
+              vl_size M, vl_size N, vl_size K)
+{
+  VlIKMFilt * filters [2] ;
+  vl_uint32 * asgn [2] ;
+  vl_uindex i ;
+
+  for (i = 0 ; i < 2 ; ++i) {
+    vl_set_simd_enabled (i == 0) ;
+    vl_rand_seed (vl_get_rand(), 0) ;
+    filters[i] = vl_ikm_new (method) ;
+    asgn[i] = vl_malloc (sizeof(vl_uint32) * N) ;
+    vl_ikm_set_max_niters (filters[i], 20) ;
+
+    /* initialize twice, the second time with more centers */
+    vl_ikm_init_rand_data (filters[i], data, M, N, 2) ;
+    vl_ikm_train (filters[i], data, N) ;
+    vl_ikm_init_rand_data (filters[i], data, M, N, K) ;
+    vl_ikm_train (filters[i], data, N) ;
+    vl_ikm_push (filters[i], asgn[i], data, N) ;
+  }
+  vl_set_simd_enabled (VL_TRUE) ;
+
+  check (memcmp (vl_ikm_get_centers(filters[0]), vl_ikm_get_centers(filters[1]),
+                 sizeof(vl_ikmacc_t) * M * K) == 0,
+         "M=%d: the centers differ with SIMD instructions", (int)M) ;
+  check (memcmp (asgn[0], asgn[1], sizeof(vl_uint32) * N) == 0,
+         "M=%d: the assignments differ with SIMD instructions", (int)M) ;
+  for (i = 0 ; i < N ; ++i) {
+    check (asgn[0][i] == vl_ikm_push_one (vl_ikm_get_centers(filters[0]), data + i * M, M, K),
+           "M=%d: point %d: vl_ikm_push and vl_ikm_push_one differ", (int)M, (int)i) ;
+  }
+
+  for (i = 0 ; i < 2 ; ++i) {
+    vl_ikm_delete (filters[i]) ;
+    vl_free (asgn[i]) ;
+  }
+}
+
+int
+main (int argc VL_UNUSED, char ** argv VL_UNUSED)
+{
+  VlRand rand ;
+  vl_size N = 2000 ;
+  vl_size M ;
+  vl_uindex i ;
+  vl_uint8 * data = vl_malloc (N * 130) ;
+
+  vl_rand_init (&rand) ;
+  vl_rand_seed (&rand, 1000) ;
+
+#ifndef VL_DISABLE_SSE2
+  /* the SSE2 kernel is exact, including at the extremes of the range */
+  if (vl_cpu_has_sse2()) {
+    for (M = 1 ; M <= 130 ; ++M) {
+      vl_uint8 * x = data ;
+      vl_uint8 * y = data + M ;
+      vl_uint32 dist = 0 ;
+      for (i = 0 ; i < M ; ++i) {
+        vl_int32 delta ;
+        switch (vl_rand_uindex (&rand, 3)) {
+          case 0 : x[i] = 0 ; y[i] = 255 ; break ;
+          case 1 : x[i] = 255 ; y[i] = 0 ; break ;
+          default: x[i] = (vl_uint8) vl_rand_uindex (&rand, 256) ;
+            y[i] = (vl_uint8) vl_rand_uindex (&rand, 256) ;
+        }
+        delta = (vl_int32) x[i] - (vl_int32) y[i] ;
+        dist += (vl_uint32) (delta * delta) ;
+      }
+      check (_vl_distance_l2_sse2_u8 (M, x, y) == dist,
+             "M=%d: the SSE2 distance differs from the scalar one", (int)M) ;
+    }
+  }
+#endif
+
+  for (M = 1 ; M <= 130 ; M += 43) {
+    for (i = 0 ; i < N * M ; ++i) {
+      data[i] = (vl_uint8) ((i / M % 7) * 32 + vl_rand_uindex (&rand, 64)) ;
+    }
+    check_filter (VL_IKM_LLOYD, data, M, N, 16) ;
+    check_filter (VL_IKM_ELKAN, data, M, N, 16) ;
+  }
+
+  vl_free (data) ;
+  return 0 ;
+}
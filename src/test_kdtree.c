@@ -0,0 +1,373 @@
+/** @file test_kdtree.c
+ ** @brief KD-forest radius search, updates, save and load test
+ ** @author agent
+ **/
+
+#include <vl/kdtree.h>
+#include <vl/random.h>
+#include <stdio.h>
+
+#include "check.h"
+
+/* query a forest and compare with reference results */
+static void
+check_queries (VlKDForest * forest, char const * name,
+               vl_uint32 const * indexes, float const * distances,
+               vl_size numNeighbors, vl_size numQueries, float const * queries)
+{
+  vl_uint32 * indexes_ = vl_malloc(sizeof(vl_uint32) * numNeighbors * numQueries) ;
+  float * distances_ = vl_malloc(sizeof(float) * numNeighbors * numQueries) ;
+  vl_uindex i ;
+  vl_kdforest_query_with_array (forest, indexes_, numNeighbors, numQueries, distances_, queries) ;
+  for (i = 0 ; i < numNeighbors * numQueries ; ++i) {
+    check (indexes[i] == indexes_[i] && distances[i] == distances_[i],
+           "%s: query results differ from the original forest", name) ;
+  }
+  vl_free(indexes_) ;
+  vl_free(distances_) ;
+}
+
+/* check batched queries against one query at a time */
+static void
+check_query_with_array (VlKDForest * forest, char const * name,
+                        vl_size numNeighbors, vl_size numQueries, float const * queries)
+{
+  vl_size dimension = vl_kdforest_get_data_dimension(forest) ;
+  vl_uint32 * indexes = vl_malloc(sizeof(vl_uint32) * numNeighbors * numQueries) ;
+  float * distances = vl_malloc(sizeof(float) * numNeighbors * numQueries) ;
+  VlKDForestNeighbor * neighbors = vl_malloc(sizeof(VlKDForestNeighbor) * numNeighbors) ;
+  vl_size numComparisons = 0 ;
+  vl_uindex q, ni ;
+
+  vl_size numBatchComparisons =
+    vl_kdforest_query_with_array (forest, indexes, numNeighbors, numQueries, distances, queries) ;
+  for (q = 0 ; q < numQueries ; ++q) {
+    numComparisons += vl_kdforest_query (forest, neighbors, numNeighbors, queries + q * dimension) ;
+    for (ni = 0 ; ni < numNeighbors ; ++ni) {
+      check (indexes[q * numNeighbors + ni] == neighbors[ni].index &&
+             distances[q * numNeighbors + ni] == (float) neighbors[ni].distance,
+             "%s: query %d: batched results differ from vl_kdforest_query", name, (int)q) ;
+    }
+  }
+  check (numBatchComparisons == numComparisons,
+         "%s: batched queries made %d comparisons instead of %d", name,
+         (int)numBatchComparisons, (int)numComparisons) ;
+  vl_free(indexes) ;
+  vl_free(distances) ;
+  vl_free(neighbors) ;
+}
+
+/* check that compacting a forest does not change the query results */
+static void
+check_compact (VlKDTreeThresholdingMethod method, vl_size maxNumComparisons,
+               float const * data, vl_size numData, vl_size dimension,
+               vl_size numNeighbors, vl_size numQueries, float const * queries)
+{
+  VlKDForest * forest = vl_kdforest_new (VL_TYPE_FLOAT, dimension, 4, VlDistanceL2) ;
+  vl_uint32 * indexes = vl_malloc(sizeof(vl_uint32) * numNeighbors * numQueries) ;
+  float * distances = vl_malloc(sizeof(float) * numNeighbors * numQueries) ;
+
+  vl_kdforest_set_thresholding_method (forest, method) ;
+  vl_kdforest_set_max_num_comparisons (forest, maxNumComparisons) ;
+  vl_kdforest_build (forest, numData, data) ;
+  vl_kdforest_query_with_array (forest, indexes, numNeighbors, numQueries, distances, queries) ;
+  vl_kdforest_compact (forest) ;
+  check_queries (forest, method == VL_KDTREE_MEAN ? "compact (mean)" : "compact (median)",
+                 indexes, distances, numNeighbors, numQueries, queries) ;
+
+  vl_kdforest_delete (forest) ;
+  vl_free(indexes) ;
+  vl_free(distances) ;
+}
+
+/* check radius search against brute force */
+static void
+check_radius_queries (VlKDForest * forest, float const * data, vl_size numData,
+                      double radius, vl_size numQueries, float const * queries)
+{
+  vl_size dimension = vl_kdforest_get_data_dimension(forest) ;
+  vl_size * offsets = vl_malloc(sizeof(vl_size) * (numQueries + 1)) ;
+  vl_uint32 * indexes ;
+  float * distances ;
+  vl_uindex q, i, d ;
+
+  vl_kdforest_query_radius_with_array (forest, offsets, &indexes, (void**)&distances,
+                                       radius, numQueries, queries) ;
+  for (q = 0 ; q < numQueries ; ++q) {
+    vl_size numFound = 0 ;
+    for (i = 0 ; i < numData ; ++i) {
+      float dist = 0 ;
+      for (d = 0 ; d < dimension ; ++d) {
+        float delta = queries[q * dimension + d] - data[i * dimension + d] ;
+        dist += delta * delta ;
+      }
+      if (dist <= radius) numFound ++ ;
+    }
+    check (offsets[q+1] - offsets[q] == numFound,
+           "query %d: radius search found %d points instead of %d", (int)q,
+           (int)(offsets[q+1] - offsets[q]), (int)numFound) ;
+    for (i = offsets[q] ; i < offsets[q+1] ; ++i) {
+      check (distances[i] <= radius, "radius search returned a point too far") ;
+      check (i == offsets[q] || distances[i-1] <= distances[i],
+             "radius search results are not sorted") ;
+    }
+  }
+  vl_free(offsets) ;
+  vl_free(indexes) ;
+  vl_free(distances) ;
+}
+
+/* check a forest updated incrementally against brute force */
+static void
+check_updates (float const * data, vl_size numData, vl_size dimension,
+               vl_size numQueries, float const * queries)
+{
+  VlKDForest * forest = vl_kdforest_new (VL_TYPE_FLOAT, dimension, 2, VlDistanceL2) ;
+  vl_size numBuilt = numData / 2 ;
+  vl_size numNeighbors = 3 ;
+  vl_uint32 * indexes = vl_malloc(sizeof(vl_uint32) * numNeighbors * numQueries) ;
+  float * distances = vl_malloc(sizeof(float) * numNeighbors * numQueries) ;
+  vl_uindex i, q, d, ni ;
+
+  vl_kdforest_build (forest, numBuilt, data) ;
+  vl_kdforest_set_max_num_delta_data (forest, numData / 8) ;
+  for (i = numBuilt ; i < numData ; i += 100) {
+    vl_size n = VL_MIN(100, numData - i) ;
+    check (vl_kdforest_add (forest, n, data + i * dimension) == i, "wrong index of added points") ;
+    check (vl_kdforest_needs_merge(forest) == (vl_kdforest_get_num_delta_data(forest) > numData / 8),
+           "wrong merge status") ;
+    if (vl_kdforest_needs_merge (forest)) vl_kdforest_merge (forest) ;
+    check (vl_kdforest_get_num_delta_data(forest) <= numData / 8, "delta buffer not merged") ;
+  }
+  check (vl_kdforest_get_num_data(forest) == numData, "wrong number of points") ;
+  for (i = 0 ; i < numData ; i += 3) vl_kdforest_remove (forest, i) ;
+
+  for (ni = 0 ; ni < 2 ; ++ni) {
+    vl_kdforest_query_with_array (forest, indexes, numNeighbors, numQueries, distances, queries) ;
+    for (q = 0 ; q < numQueries ; ++q) {
+      float best = VL_INFINITY_F ;
+      for (i = 0 ; i < numData ; ++i) {
+        float dist = 0 ;
+        if (i % 3 == 0) continue ;
+        for (d = 0 ; d < dimension ; ++d) {
+          float delta = queries[q * dimension + d] - data[i * dimension + d] ;
+          dist += delta * delta ;
+        }
+        best = VL_MIN(best, dist) ;
+      }
+      check (vl_abs_f(distances[q * numNeighbors] - best) <= 1e-5f * best &&
+             indexes[q * numNeighbors] % 3 != 0,
+             "query %d: updated forest returned a wrong neighbor", (int)q) ;
+    }
+    /* again after merging everything */
+    vl_kdforest_merge (forest) ;
+    check (vl_kdforest_get_num_delta_data(forest) == 0, "merge did not empty the delta") ;
+    check (vl_kdforest_get_num_removed_data(forest) == 0, "merge did not purge the removed points") ;
+  }
+  vl_kdforest_remove (forest, 0) ;
+  check (vl_kdforest_get_num_removed_data(forest) == 0, "removing a purged point again had an effect") ;
+
+  vl_kdforest_delete (forest) ;
+  vl_free(indexes) ;
+  vl_free(distances) ;
+}
+
+/* check saving a forest after updates */
+static void
+check_save_updates (char const * fileName, float const * data, vl_size numData,
+                    vl_size dimension, vl_size numQueries, float const * queries)
+{
+  VlKDForest * forest = vl_kdforest_new (VL_TYPE_FLOAT, dimension, 2, VlDistanceL2) ;
+  VlKDForest * loaded ;
+  vl_size numNeighbors = 3 ;
+  vl_uint32 * indexes = vl_malloc(sizeof(vl_uint32) * numNeighbors * numQueries) ;
+  float * distances = vl_malloc(sizeof(float) * numNeighbors * numQueries) ;
+
+  vl_kdforest_build (forest, numData / 2, data) ;
+  vl_kdforest_set_max_num_delta_data (forest, numData) ;
+  vl_kdforest_add (forest, numData - numData / 2, data + numData / 2 * dimension) ;
+  check (vl_kdforest_save (forest, fileName, VL_TRUE) == VL_ERR_BAD_ARG,
+         "saving a forest with a non-empty delta should fail") ;
+
+  /* the added points are not in the data passed to build */
+  vl_kdforest_merge (forest) ;
+  check (vl_kdforest_save (forest, fileName, VL_FALSE) == VL_ERR_BAD_ARG,
+         "saving a forest with added points without the data should fail") ;
+  check (vl_kdforest_save (forest, fileName, VL_TRUE) == VL_ERR_OK,
+         "cannot save %s: %s", fileName, vl_get_last_error_message()) ;
+  loaded = vl_kdforest_load (fileName, NULL) ;
+  check (loaded != NULL, "cannot load %s: %s", fileName, vl_get_last_error_message()) ;
+  check (vl_kdforest_get_num_data(loaded) == numData, "wrong number of loaded points") ;
+  vl_kdforest_query_with_array (forest, indexes, numNeighbors, numQueries, distances, queries) ;
+  check_queries (loaded, "loaded after updates", indexes, distances, numNeighbors, numQueries, queries) ;
+  vl_kdforest_delete (loaded) ;
+
+  vl_kdforest_remove (forest, 0) ;
+  check (vl_kdforest_save (forest, fileName, VL_TRUE) == VL_ERR_BAD_ARG,
+         "saving a forest with removed points should fail") ;
+
+  /* merging purges the removed point, which keeps its index */
+  vl_kdforest_merge (forest) ;
+  check (vl_kdforest_get_num_data(forest) == numData, "wrong number of points after purging") ;
+  check (vl_kdforest_save (forest, fileName, VL_TRUE) == VL_ERR_OK,
+         "cannot save %s after purging: %s", fileName, vl_get_last_error_message()) ;
+  loaded = vl_kdforest_load (fileName, NULL) ;
+  check (loaded != NULL, "cannot load %s: %s", fileName, vl_get_last_error_message()) ;
+  vl_kdforest_query_with_array (forest, indexes, numNeighbors, numQueries, distances, data) ;
+  check (indexes[0] != 0, "a purged point was returned") ;
+  check_queries (loaded, "loaded after purging", indexes, distances, numNeighbors, numQueries, data) ;
+  vl_kdforest_delete (loaded) ;
+
+  remove (fileName) ;
+  vl_kdforest_delete (forest) ;
+  vl_free(indexes) ;
+  vl_free(distances) ;
+}
+
+/* check that loading fails after overwriting a 32-bit field of the
+   header of a saved forest, then restore the field */
+static void
+check_corrupt_header (char const * fileName, long offset, vl_uint32 value, char const * field)
+{
+  vl_uint32 original ;
+  FILE * file = fopen (fileName, "r+b") ;
+  check (file != NULL, "cannot open %s", fileName) ;
+  fseek (file, offset, SEEK_SET) ;
+  check (fread (&original, sizeof(original), 1, file) == 1, "cannot read %s", fileName) ;
+  fseek (file, offset, SEEK_SET) ;
+  fwrite (&value, sizeof(value), 1, file) ;
+  fclose (file) ;
+
+  check (vl_kdforest_load (fileName, NULL) == NULL,
+         "loading a forest with %s %d should fail", field, (int)value) ;
+  check (vl_get_last_error() == VL_ERR_BAD_ARG, "wrong error for %s %d", field, (int)value) ;
+
+  file = fopen (fileName, "r+b") ;
+  fseek (file, offset, SEEK_SET) ;
+  fwrite (&original, sizeof(original), 1, file) ;
+  fclose (file) ;
+}
+
+int
+main (int argc VL_UNUSED, char ** argv VL_UNUSED)
+{
+  VlRand rand ;
+  vl_size numData = 10000 ;
+  vl_size numQueries = 100 ;
+  vl_size dimension = 16 ;
+  vl_size numNeighbors = 5 ;
+  char const * fileName = "test_kdtree.vlkd" ;
+  vl_uindex i ;
+
+  float * data = vl_malloc(sizeof(float) * dimension * numData) ;
+  float * queries = vl_malloc(sizeof(float) * dimension * numQueries) ;
+  vl_uint32 * indexes = vl_malloc(sizeof(vl_uint32) * numNeighbors * numQueries) ;
+  float * distances = vl_malloc(sizeof(float) * numNeighbors * numQueries) ;
+  VlKDForest * forest ;
+  VlKDForest * loaded ;
+
+  vl_rand_init (&rand) ;
+  vl_rand_seed (&rand, 1000) ;
+  for (i = 0 ; i < dimension * numData ; ++i) data[i] = (float) vl_rand_real1(&rand) ;
+  for (i = 0 ; i < dimension * numQueries ; ++i) queries[i] = (float) vl_rand_real1(&rand) ;
+
+  check_compact (VL_KDTREE_MEDIAN, 200, data, numData, dimension, numNeighbors, numQueries, queries) ;
+  check_compact (VL_KDTREE_MEAN, 200, data, numData, dimension, numNeighbors, numQueries, queries) ;
+  check_compact (VL_KDTREE_MEAN, 0, data, numData, dimension, numNeighbors, numQueries, queries) ;
+  {
+    /* the mean 4/3 of these points rounds up to the query when
+       converted to float, which must still go to the upper child */
+    float const points [3] = {0, 1, 3} ;
+    float const query = (float) (4.0 / 3.0) ;
+    check_compact (VL_KDTREE_MEAN, 1, points, 3, 1, 1, 1, &query) ;
+  }
+
+  forest = vl_kdforest_new (VL_TYPE_FLOAT, dimension, 4, VlDistanceL2) ;
+  check_updates (data, numData, dimension, numQueries, queries) ;
+
+  vl_kdforest_build (forest, numData, data) ;
+  check_radius_queries (forest, data, numData, 0.5, numQueries, queries) ;
+  check_query_with_array (forest, "batched exact", numNeighbors, numQueries, queries) ;
+  vl_kdforest_compact (forest) ;
+  check_radius_queries (forest, data, numData, 0.5, numQueries, queries) ;
+  check_query_with_array (forest, "batched exact compact", numNeighbors, numQueries, queries) ;
+  vl_kdforest_delete (forest) ;
+
+  /* leaves of 16 points; querying with the data puts several queries
+     in each leaf, which are scored against it as a block */
+  forest = vl_kdforest_new (VL_TYPE_FLOAT, dimension, 4, VlDistanceL2) ;
+  vl_kdforest_set_leaf_size (forest, 16) ;
+  vl_kdforest_build (forest, numData, data) ;
+  check (vl_kdforest_get_depth_of_tree(forest, 0) < 14, "leaves of 16 points: tree too deep") ;
+  check_query_with_array (forest, "leaf size 16", numNeighbors, numQueries, queries) ;
+  vl_kdforest_compact (forest) ;
+  check_query_with_array (forest, "leaf size 16 compact", numNeighbors, numQueries, queries) ;
+  check_query_with_array (forest, "leaf size 16 compact, data", numNeighbors, 1000, data) ;
+  vl_kdforest_set_max_num_comparisons (forest, 200) ;
+  check_query_with_array (forest, "leaf size 16 compact, data, approximate", numNeighbors, 1000, data) ;
+  check (vl_kdforest_save (forest, fileName, VL_FALSE) == VL_ERR_OK,
+         "cannot save %s: %s", fileName, vl_get_last_error_message()) ;
+  loaded = vl_kdforest_load (fileName, data) ;
+  check (loaded != NULL && vl_kdforest_get_leaf_size(loaded) == 16,
+         "leaf size lost after loading") ;
+  vl_kdforest_delete (loaded) ;
+  vl_kdforest_delete (forest) ;
+
+  forest = vl_kdforest_new (VL_TYPE_FLOAT, dimension, 4, VlDistanceL2) ;
+  vl_kdforest_set_max_num_comparisons (forest, 200) ;
+  vl_kdforest_build (forest, numData, data) ;
+  check_query_with_array (forest, "batched", numNeighbors, numQueries, queries) ;
+  vl_kdforest_query_with_array (forest, indexes, numNeighbors, numQueries, distances, queries) ;
+
+  /* without embedded data */
+  check (vl_kdforest_save (forest, fileName, VL_FALSE) == VL_ERR_OK,
+         "cannot save %s: %s", fileName, vl_get_last_error_message()) ;
+  check (vl_kdforest_load (fileName, NULL) == NULL,
+         "loading a forest without data should fail") ;
+  loaded = vl_kdforest_load (fileName, data) ;
+  check (loaded != NULL, "cannot load %s: %s", fileName, vl_get_last_error_message()) ;
+  check (vl_kdforest_get_num_trees(loaded) == 4, "wrong number of trees") ;
+  for (i = 0 ; i < 4 ; ++i) {
+    check (vl_kdforest_get_num_nodes_of_tree(loaded, i) == vl_kdforest_get_num_nodes_of_tree(forest, i) &&
+           vl_kdforest_get_depth_of_tree(loaded, i) == vl_kdforest_get_depth_of_tree(forest, i),
+           "tree %d differs after loading", (int)i) ;
+  }
+  vl_kdforest_set_max_num_comparisons (loaded, 200) ;
+  check_queries (loaded, "loaded", indexes, distances, numNeighbors, numQueries, queries) ;
+
+  /* a loaded forest can still be compacted */
+  vl_kdforest_compact (loaded) ;
+  check_queries (loaded, "loaded and compacted", indexes, distances, numNeighbors, numQueries, queries) ;
+  vl_kdforest_delete (loaded) ;
+
+  /* compact layout with embedded data */
+  vl_kdforest_compact (forest) ;
+  check (vl_kdforest_save (forest, fileName, VL_TRUE) == VL_ERR_OK,
+         "cannot save %s: %s", fileName, vl_get_last_error_message()) ;
+  loaded = vl_kdforest_load (fileName, NULL) ;
+  check (loaded != NULL, "cannot load %s: %s", fileName, vl_get_last_error_message()) ;
+  check (vl_kdforest_is_compact(loaded), "compact layout lost") ;
+  vl_kdforest_set_max_num_comparisons (loaded, 200) ;
+  check_queries (loaded, "compact", indexes, distances, numNeighbors, numQueries, queries) ;
+  vl_kdforest_delete (loaded) ;
+
+  /* the distance and the thresholding method follow the magic, the
+     version, the byte order and the data type in the header */
+  check_corrupt_header (fileName, 20, VlDistanceChi2, "distance") ;
+  check_corrupt_header (fileName, 20, 1000, "distance") ;
+  check_corrupt_header (fileName, 24, 1000, "thresholding method") ;
+  loaded = vl_kdforest_load (fileName, NULL) ;
+  check (loaded != NULL, "cannot load %s after restoring it: %s", fileName, vl_get_last_error_message()) ;
+  vl_kdforest_delete (loaded) ;
+
+  remove (fileName) ;
+  check_save_updates (fileName, data, 2000, dimension, numQueries, queries) ;
+  check (vl_kdforest_load (fileName, data) == NULL, "loading a missing file should fail") ;
+
+  vl_kdforest_delete (forest) ;
+  vl_free(data) ;
+  vl_free(queries) ;
+  vl_free(indexes) ;
+  vl_free(distances) ;
+  return 0 ;
+}
@@ -7,8 +7,112 @@
 #include <vl/kmeans.h>
 #include <vl/host.h>
 #include <vl/kdtree.h>
+#include <vl/mathop.h>
+#include <vl/random.h>
 //#include <sys/time.h>
 
+#include <string.h>
+
+#include "check.h"
+
+/* Compare the l2 assignments of the blocked quantizer with the ones of
+   the per-pair quantizer, used when SIMD is disabled. The two evaluate
+   the distances differently, so near ties may be broken differently,
+   but then the two centers must be equally close. */
+
+static void
+check_quantize (vl_type dataType, vl_size dimension, vl_size numData, vl_size numCenters)
+{
+  VlRand rand ;
+  VlKMeans * kmeans = vl_kmeans_new (dataType, VlDistanceL2) ;
+  vl_size typeSize = vl_get_type_size(dataType) ;
+  void * data = vl_malloc(typeSize * dimension * numData) ;
+  vl_uint32 * assignments = vl_malloc(sizeof(vl_uint32) * numData) ;
+  vl_uint32 * referenceAssignments = vl_malloc(sizeof(vl_uint32) * numData) ;
+  void * distances = vl_malloc(typeSize * numData) ;
+  void * referenceDistances = vl_malloc(typeSize * numData) ;
+  vl_uindex i ;
+  vl_size numDifferent = 0 ;
+  vl_bool simdEnabled = vl_get_simd_enabled() ;
+
+  vl_rand_init (&rand) ;
+  vl_rand_seed (&rand, 1000) ;
+  for (i = 0 ; i < dimension * numData ; ++i) {
+    if (dataType == VL_TYPE_FLOAT) {
+      ((float*)data)[i] = (float) vl_rand_real1(&rand) ;
+    } else {
+      ((double*)data)[i] = vl_rand_real1(&rand) ;
+    }
+  }
+  vl_kmeans_init_centers_with_rand_data (kmeans, data, dimension, numData, numCenters) ;
+
+  vl_kmeans_quantize (kmeans, assignments, distances, data, numData) ;
+  vl_set_simd_enabled (VL_FALSE) ;
+  vl_kmeans_quantize (kmeans, referenceAssignments, referenceDistances, data, numData) ;
+  vl_set_simd_enabled (simdEnabled) ;
+
+  for (i = 0 ; i < numData ; ++i) {
+    double distance, referenceDistance ;
+    if (dataType == VL_TYPE_FLOAT) {
+      distance = ((float*)distances)[i] ;
+      referenceDistance = ((float*)referenceDistances)[i] ;
+    } else {
+      distance = ((double*)distances)[i] ;
+      referenceDistance = ((double*)referenceDistances)[i] ;
+    }
+    if (assignments[i] != referenceAssignments[i]) {
+      numDifferent ++ ;
+      check (distance <= referenceDistance * (1 + 1e-5),
+             "point %d assigned to center %d at distance %g instead of %d at distance %g",
+             (int)i, (int)assignments[i], distance, (int)referenceAssignments[i],
+             referenceDistance) ;
+    } else {
+      /* the SIMD distance functions sum in a different order */
+      check (vl_abs_d(distance - referenceDistance) <= 1e-5 * referenceDistance,
+             "point %d has distance %g instead of %g", (int)i, distance, referenceDistance) ;
+    }
+  }
+  check (numDifferent <= numData / 1000,
+         "%d assignments differ from the reference", (int)numDifferent) ;
+
+  vl_kmeans_delete (kmeans) ;
+  vl_free(data) ;
+  vl_free(assignments) ;
+  vl_free(referenceAssignments) ;
+  vl_free(distances) ;
+  vl_free(referenceDistances) ;
+}
+
+/* The mini-batch updates are defined only for the l2 distance. */
+
+static void
+check_mini_batch_distance (void)
+{
+  float data [2 * 8] ;
+  float centers [2 * 2] ;
+  vl_uindex i ;
+  double energy ;
+  VlKMeans * kmeans = vl_kmeans_new (VL_TYPE_FLOAT, VlDistanceL1) ;
+
+  for (i = 0 ; i < 2 * 8 ; ++i) data[i] = (float) i ;
+  vl_kmeans_set_centers (kmeans, data, 2, 2) ;
+
+  energy = vl_kmeans_push_batch (kmeans, data, 8) ;
+  check (vl_is_nan_d(energy), "push_batch returned %g with the L1 distance", energy) ;
+  check (vl_get_last_error() == VL_ERR_BAD_ARG, "push_batch did not fail with the L1 distance") ;
+
+  vl_kmeans_set_algorithm (kmeans, VlKMeansMiniBatch) ;
+  vl_set_last_error (VL_ERR_OK, NULL) ;
+  energy = vl_kmeans_refine_centers (kmeans, data, 8) ;
+  check (vl_is_nan_d(energy), "refine_centers returned %g with the L1 distance", energy) ;
+  check (vl_get_last_error() == VL_ERR_BAD_ARG, "refine_centers did not fail with the L1 distance") ;
+
+  memcpy (centers, vl_kmeans_get_centers (kmeans), sizeof(centers)) ;
+  for (i = 0 ; i < 2 * 2 ; ++i) {
+    check (centers[i] == data[i], "center component %d changed to %g", (int)i, centers[i]) ;
+  }
+  vl_kmeans_delete (kmeans) ;
+}
 
 int main(int argc VL_UNUSED, char ** argv VL_UNUSED)
 {
@@ -29,9 +133,16 @@ int main(int argc VL_UNUSED, char ** argv VL_UNUSED)
   //VlKMeansAlgorithm algorithm = VlKMeansANN ;
   VlKMeansAlgorithm algorithm = VlKMeansLloyd ;
   //VlKMeansAlgorithm algorithm = VlKMeansElkan ;
+  //VlKMeansAlgorithm algorithm = VlKMeansHamerly ;
   VlVectorComparisonType distance = VlDistanceL2 ;
   VlKMeans * kmeans = vl_kmeans_new (VL_TYPE_DOUBLE,distance) ;
 
+  /* the sizes are not multiples of the blocks and span several tiles */
+  check_quantize (VL_TYPE_FLOAT, 128, 5003, 1003) ;
+  check_quantize (VL_TYPE_DOUBLE, 128, 5003, 1003) ;
+  check_quantize (VL_TYPE_FLOAT, 3, 10, 5) ;
+  check_mini_batch_distance () ;
+
   vl_rand_init (&rand) ;
   vl_rand_seed (&rand,  1000) ;
 
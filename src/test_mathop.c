@@ -1,5 +1,6 @@
 #include <vl/generic.h>
 #include <vl/mathop.h>
+#include <vl/mathop_sse2.h>
 #include <math.h>
 #include <float.h>
 
@@ -74,5 +75,32 @@ main (int argc VL_UNUSED, char** argv VL_UNUSED)
 #define STEP 0
 #include "test_mathop_fast_sqrt_ui.tc"
 
+  /* -----------------------------------------------------------------
+   *                                            _vl_log_sum_exp_sse2_f
+   * -------------------------------------------------------------- */
+
+#ifndef VL_DISABLE_SSE2
+  if (vl_cpu_has_sse2()) {
+    float X [37], Y [37] ;
+    double z, zExact = 0, maxRelError = 0 ;
+    int i ;
+    for (i = 0 ; i < 37 ; ++i) { X[i] = - (float) (i * i) / 16.0F ; }
+    X[5] = (float) - VL_INFINITY_D ;
+    z = _vl_log_sum_exp_sse2_f (37, Y, X) ;
+    for (i = 0 ; i < 37 ; ++i) { zExact += exp(X[i]) ; }
+    zExact = log(zExact) ;
+    for (i = 0 ; i < 37 ; ++i) {
+      double y = exp(X[i] - zExact) ;
+      if (y > 0) { maxRelError = VL_MAX(maxRelError, fabs(Y[i] - y) / y) ; }
+    }
+    VL_PRINTF("\n%20s %10s %10s\n", "func", "log error", "rel error") ;
+    VL_PRINTF("%20s %10.3g %10.3g\n", "log_sum_exp_sse2_f", fabs(z - zExact), maxRelError) ;
+    if (fabs(z - zExact) > 1e-6 || maxRelError > 1e-6 || Y[5] != 0) {
+      VL_PRINTF("log_sum_exp_sse2_f: error too large\n") ;
+      error = 1 ;
+    }
+  }
+#endif
+
   return error ;
 }
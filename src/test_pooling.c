@@ -0,0 +1,110 @@
+/** @file test_pooling.c
+ ** @brief Region pooling test
+ ** @author agent
+ **/
+
+#include <vl/pooling.h>
+#include <vl/random.h>
+#include <vl/mathop.h>
+#include <stdio.h>
+
+#include "check.h"
+
+/* check that visiting the cells of each region enumerates exactly the
+   vectors inside its box */
+static void
+check_regions (VlPoolingGrid const * grid, double const * positions, vl_size numData,
+               double const * regions, vl_size numRegions)
+{
+  vl_uindex * marks = vl_calloc(numData, sizeof(vl_uindex)) ;
+  vl_uindex r, i ;
+  for (r = 0 ; r < numRegions ; ++r) {
+    vl_uindex const * block = grid->regionCells + 4 * r ;
+    double const * box = regions + 4 * r ;
+    vl_size count = 0, numInside = 0 ;
+    vl_uindex cx, cy, o ;
+    for (cy = block[1] ; cy < block[3] ; ++cy) {
+      for (cx = block[0] ; cx < block[2] ; ++cx) {
+        for (o = vl_pooling_grid_get_cell_begin(grid, cx, cy) ;
+             o < vl_pooling_grid_get_cell_end(grid, cx, cy) ; ++o) {
+          marks[grid->order[o]] = r + 1 ;
+          count ++ ;
+        }
+      }
+    }
+    for (i = 0 ; i < numData ; ++i) {
+      double const * x = positions + 2 * i ;
+      vl_bool inside = box[0] <= x[0] && x[0] < box[2] && box[1] <= x[1] && x[1] < box[3] ;
+      check (inside == (marks[i] == r + 1), "vector %d %s region %d", (int)i,
+             inside ? "missing from" : "wrongly in", (int)r) ;
+      numInside += inside ;
+    }
+    check (count == numInside, "region %d lists %d vectors instead of %d",
+           (int)r, (int)count, (int)numInside) ;
+  }
+  vl_free(marks) ;
+}
+
+static void
+make_boxes (double * regions, VlRand * rand, vl_size numRegions)
+{
+  vl_uindex r ;
+  for (r = 0 ; r < numRegions ; ++r) {
+    double * box = regions + 4 * r ;
+    box[0] = vl_rand_real1(rand) ;
+    box[1] = vl_rand_real1(rand) ;
+    box[2] = box[0] + vl_rand_real1(rand) * (1 - box[0]) ;
+    box[3] = box[1] + vl_rand_real1(rand) * (1 - box[1]) ;
+  }
+}
+
+int
+main (int argc VL_UNUSED, char ** argv VL_UNUSED)
+{
+  VlRand rand ;
+  vl_size width = 20, height = 15 ;
+  vl_size numData = width * height ;
+  vl_size numRegions = 2000 ;
+  double * positions = vl_malloc(sizeof(double) * 2 * numData) ;
+  double * regions = vl_malloc(sizeof(double) * 4 * numRegions) ;
+  VlPoolingGrid * grid ;
+  vl_uindex i ;
+
+  vl_rand_init (&rand) ;
+  vl_rand_seed (&rand, 1000) ;
+
+  /* arbitrary boxes on descriptors extracted on a lattice: the cells
+     are bounded by the lattice, not by the boxes */
+  for (i = 0 ; i < numData ; ++i) {
+    positions[2*i] = (i % width + 0.5) / width ;
+    positions[2*i+1] = (i / width + 0.5) / height ;
+  }
+  make_boxes (regions, &rand, numRegions) ;
+  grid = vl_pooling_grid_new (positions, numData, regions, numRegions) ;
+  check (grid->numCellsX <= width + 1 && grid->numCellsY <= height + 1,
+         "%d x %d cells for a %d x %d lattice", (int)grid->numCellsX, (int)grid->numCellsY,
+         (int)width, (int)height) ;
+  check_regions (grid, positions, numData, regions, numRegions) ;
+  vl_pooling_grid_delete (grid) ;
+
+  /* random positions, some outside all the boxes, and empty boxes */
+  for (i = 0 ; i < 2 * numData ; ++i) {
+    positions[i] = vl_rand_real1(&rand) * 1.2 - 0.1 ;
+  }
+  make_boxes (regions, &rand, 300) ;
+  regions[2] = regions[0] ;
+  regions[7] = regions[5] - 0.1 ;
+  grid = vl_pooling_grid_new (positions, numData, regions, 300) ;
+  check_regions (grid, positions, numData, regions, 300) ;
+  vl_pooling_grid_delete (grid) ;
+
+  /* no vectors */
+  grid = vl_pooling_grid_new (positions, 0, regions, 300) ;
+  check (vl_pooling_grid_get_num_cells(grid) == 0, "cells without vectors") ;
+  check_regions (grid, positions, 0, regions, 300) ;
+  vl_pooling_grid_delete (grid) ;
+
+  vl_free(positions) ;
+  vl_free(regions) ;
+  return 0 ;
+}
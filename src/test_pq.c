@@ -0,0 +1,236 @@
+/** @file test_pq.c
+ ** @brief Product quantization test and benchmark
+ ** @author agent
+ **/
+
+#include <vl/pq.h>
+#include <vl/kdtree.h>
+#include <vl/host.h>
+#include <vl/random.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+
+/* fraction of queries whose exact nearest neighbor is among the
+   returned ones */
+static double
+recall (vl_uint32 const * exact, vl_uint32 const * indexes,
+        vl_size numNeighbors, vl_size numQueries)
+{
+  vl_uindex qi, ni ;
+  vl_size numFound = 0 ;
+  for (qi = 0 ; qi < numQueries ; ++qi) {
+    for (ni = 0 ; ni < numNeighbors ; ++ni) {
+      if (indexes[qi * numNeighbors + ni] == exact[qi]) {
+        numFound ++ ;
+        break ;
+      }
+    }
+  }
+  return (double)numFound / numQueries ;
+}
+
+int
+main (int argc VL_UNUSED, char ** argv VL_UNUSED)
+{
+  VlRand rand ;
+  vl_size numData = 50000 ;
+  vl_size numQueries = 200 ;
+  vl_size dimension = 64 ;
+  vl_size numSubquantizers = 8 ;
+  vl_size numCenters = 256 ;
+  vl_size numClusters = 100 ;
+  vl_size numNeighbors = 10 ;
+  vl_uindex i, d ;
+  double time, pqRecall, ivfRecall ;
+
+  float * data = vl_malloc(sizeof(float) * dimension * numData) ;
+  float * queries = vl_malloc(sizeof(float) * dimension * numQueries) ;
+  float * modes = vl_malloc(sizeof(float) * dimension * numClusters) ;
+  float * decoded = vl_malloc(sizeof(float) * dimension) ;
+  vl_uint8 * codes = vl_malloc(numSubquantizers * numData) ;
+  vl_uint32 * exact = vl_malloc(sizeof(vl_uint32) * numQueries) ;
+  vl_uint32 * indexes = vl_malloc(sizeof(vl_uint32) * numNeighbors * numQueries) ;
+  float * distances = vl_malloc(sizeof(float) * numNeighbors * numQueries) ;
+  VlProductQuantizer * pq ;
+  VlIVFPQ * ivf ;
+  VlKDForest * forest ;
+
+  vl_rand_init (&rand) ;
+  vl_rand_seed (&rand, 1000) ;
+
+  /* clustered data; queries are perturbed data points */
+  for (i = 0 ; i < dimension * numClusters ; ++i) {
+    modes[i] = (float) vl_rand_real1(&rand) * 10 ;
+  }
+  for (i = 0 ; i < numData ; ++i) {
+    float const * mode = modes + vl_rand_uindex(&rand, numClusters) * dimension ;
+    for (d = 0 ; d < dimension ; ++d) {
+      data[i * dimension + d] = mode[d] + (float) vl_rand_real1(&rand) ;
+    }
+  }
+  for (i = 0 ; i < numQueries ; ++i) {
+    float const * x = data + vl_rand_uindex(&rand, numData) * dimension ;
+    for (d = 0 ; d < dimension ; ++d) {
+      queries[i * dimension + d] = x[d] + (float) vl_rand_real1(&rand) * 0.1f ;
+    }
+  }
+
+  /* exact search */
+  forest = vl_kdforest_new (VL_TYPE_FLOAT, dimension, 1, VlDistanceL2) ;
+  vl_kdforest_build (forest, numData, data) ;
+  vl_tic() ;
+  vl_kdforest_query_with_array (forest, exact, 1, numQueries, NULL, queries) ;
+  time = vl_toc() ;
+  VL_PRINTF("test_pq: kd-tree exact search: %.3f s\n", time) ;
+
+  /* product quantization */
+  pq = vl_pq_new (VL_TYPE_FLOAT, dimension, numSubquantizers, numCenters) ;
+  vl_pq_set_max_num_iterations (pq, 10) ;
+  vl_tic() ;
+  vl_pq_train (pq, data, 10000) ;
+  vl_pq_encode (pq, codes, data, numData) ;
+  VL_PRINTF("test_pq: pq training and encoding: %.3f s\n", vl_toc()) ;
+
+  vl_pq_decode (pq, decoded, codes, 1) ;
+  {
+    float const * table ;
+    float * tableBuffer = vl_malloc(sizeof(float) * numSubquantizers * numCenters) ;
+    float adc = 0, err = 0 ;
+    vl_pq_compute_distance_table (pq, tableBuffer, data) ;
+    table = tableBuffer ;
+    for (i = 0 ; i < numSubquantizers ; ++i) {
+      adc += table[i * numCenters + codes[i]] ;
+    }
+    for (d = 0 ; d < dimension ; ++d) {
+      err += (data[d] - decoded[d]) * (data[d] - decoded[d]) ;
+    }
+    check (vl_abs_f(adc - err) <= 1e-3f * VL_MAX(err, 1.0f),
+           "asymmetric distance %g differs from decoding error %g", adc, err) ;
+    vl_free(tableBuffer) ;
+  }
+
+  vl_tic() ;
+  vl_pq_search (pq, indexes, numNeighbors, numQueries, distances, queries, codes, numData) ;
+  time = vl_toc() ;
+  pqRecall = recall(exact, indexes, numNeighbors, numQueries) ;
+  VL_PRINTF("test_pq: pq search: %.3f s, recall@%d %.3f\n",
+            time, (int)numNeighbors, pqRecall) ;
+  for (i = 1 ; i < numNeighbors ; ++i) {
+    check (distances[i-1] <= distances[i], "search results are not sorted") ;
+  }
+
+  /* inverted file */
+  ivf = vl_ivfpq_new (VL_TYPE_FLOAT, dimension, 64, numSubquantizers, numCenters) ;
+  vl_kmeans_set_max_num_iterations (vl_ivfpq_get_coarse_quantizer(ivf), 10) ;
+  vl_pq_set_max_num_iterations (vl_ivfpq_get_pq(ivf), 10) ;
+  vl_ivfpq_set_num_probes (ivf, 8) ;
+  vl_tic() ;
+  vl_ivfpq_train (ivf, data, 10000) ;
+  vl_ivfpq_add (ivf, data, numData) ;
+  VL_PRINTF("test_pq: ivf training and indexing: %.3f s\n", vl_toc()) ;
+  check (vl_ivfpq_get_num_entries(ivf) == numData, "wrong number of entries") ;
+
+  vl_tic() ;
+  vl_ivfpq_search (ivf, indexes, numNeighbors, numQueries, distances, queries) ;
+  time = vl_toc() ;
+  ivfRecall = recall(exact, indexes, numNeighbors, numQueries) ;
+  VL_PRINTF("test_pq: ivf search: %.3f s, recall@%d %.3f\n",
+            time, (int)numNeighbors, ivfRecall) ;
+
+  check (pqRecall >= 0.5, "pq recall too low (%g)", pqRecall) ;
+  check (ivfRecall >= 0.5, "ivf recall too low (%g)", ivfRecall) ;
+
+  vl_ivfpq_delete (ivf) ;
+  vl_pq_delete (pq) ;
+
+  /* with 16 centers the fast scan (if supported) returns the same
+     neighbors as the generic scan */
+  {
+    vl_size numFastSubquantizers = 16 ;
+    vl_uint32 * genericIndexes = vl_malloc(sizeof(vl_uint32) * numNeighbors * numQueries) ;
+    float * genericDistances = vl_malloc(sizeof(float) * numNeighbors * numQueries) ;
+    vl_uint8 * fastCodes = vl_malloc(numFastSubquantizers * numData) ;
+    vl_uint8 * blockedCodes ;
+    vl_bool simdEnabled = vl_get_simd_enabled() ;
+    double genericTime ;
+
+    pq = vl_pq_new (VL_TYPE_FLOAT, dimension, numFastSubquantizers, 16) ;
+    vl_pq_set_max_num_iterations (pq, 10) ;
+    vl_pq_train (pq, data, 10000) ;
+    vl_pq_encode (pq, fastCodes, data, numData) ;
+    blockedCodes = vl_malloc(vl_pq_get_blocked_codes_size(pq, numData)) ;
+    vl_pq_block_codes (pq, blockedCodes, fastCodes, numData) ;
+    vl_tic() ;
+    vl_pq_search_blocked (pq, indexes, numNeighbors, numQueries, distances, queries,
+                          blockedCodes, numData) ;
+    time = vl_toc() ;
+    vl_tic() ;
+    vl_pq_search (pq, genericIndexes, numNeighbors, numQueries, genericDistances,
+                  queries, fastCodes, numData) ;
+    genericTime = vl_toc() ;
+    VL_PRINTF("test_pq: 16-center pq search: %.3f s, generic scan %.3f s, recall@%d %.3f\n",
+              time, genericTime, (int)numNeighbors, recall(exact, indexes, numNeighbors, numQueries)) ;
+    check (memcmp(indexes, genericIndexes, sizeof(vl_uint32) * numNeighbors * numQueries) == 0 &&
+           memcmp(distances, genericDistances, sizeof(float) * numNeighbors * numQueries) == 0,
+           "fast scan results differ from the generic scan") ;
+
+    /* the blocked layout is also searched without the fast scan */
+    vl_set_simd_enabled (VL_FALSE) ;
+    vl_pq_search_blocked (pq, indexes, numNeighbors, numQueries, distances, queries,
+                          blockedCodes, numData) ;
+    vl_set_simd_enabled (simdEnabled) ;
+    check (memcmp(indexes, genericIndexes, sizeof(vl_uint32) * numNeighbors * numQueries) == 0 &&
+           memcmp(distances, genericDistances, sizeof(float) * numNeighbors * numQueries) == 0,
+           "blocked generic scan results differ from the generic scan") ;
+
+    /* no neighbors: nothing is written */
+    indexes[0] = 0 ;
+    vl_pq_search_blocked (pq, indexes, 0, numQueries, NULL, queries, blockedCodes, numData) ;
+    vl_pq_search (pq, indexes, 0, numQueries, NULL, queries, fastCodes, numData) ;
+    check (indexes[0] == 0, "search for no neighbors wrote an index") ;
+    vl_free(blockedCodes) ;
+    vl_pq_delete (pq) ;
+
+    ivf = vl_ivfpq_new (VL_TYPE_FLOAT, dimension, 16, numFastSubquantizers, 16) ;
+    vl_kmeans_set_max_num_iterations (vl_ivfpq_get_coarse_quantizer(ivf), 10) ;
+    vl_pq_set_max_num_iterations (vl_ivfpq_get_pq(ivf), 10) ;
+    vl_ivfpq_set_num_probes (ivf, 4) ;
+    vl_ivfpq_train (ivf, data, 10000) ;
+    vl_ivfpq_add (ivf, data, numData / 3) ;
+    vl_ivfpq_add (ivf, data + numData / 3 * dimension, numData - numData / 3) ;
+    vl_tic() ;
+    vl_ivfpq_search (ivf, indexes, numNeighbors, numQueries, distances, queries) ;
+    time = vl_toc() ;
+    vl_set_simd_enabled (VL_FALSE) ;
+    vl_tic() ;
+    vl_ivfpq_search (ivf, genericIndexes, numNeighbors, numQueries, genericDistances, queries) ;
+    genericTime = vl_toc() ;
+    vl_set_simd_enabled (simdEnabled) ;
+    VL_PRINTF("test_pq: 16-center ivf search: %.3f s, generic scan %.3f s\n",
+              time, genericTime) ;
+    check (memcmp(indexes, genericIndexes, sizeof(vl_uint32) * numNeighbors * numQueries) == 0 &&
+           memcmp(distances, genericDistances, sizeof(float) * numNeighbors * numQueries) == 0,
+           "ivf fast scan results differ from the generic scan") ;
+    indexes[0] = 0 ;
+    vl_ivfpq_search (ivf, indexes, 0, numQueries, NULL, queries) ;
+    check (indexes[0] == 0, "ivf search for no neighbors wrote an index") ;
+    vl_ivfpq_delete (ivf) ;
+
+    vl_free(genericIndexes) ;
+    vl_free(genericDistances) ;
+    vl_free(fastCodes) ;
+  }
+
+  vl_kdforest_delete (forest) ;
+  vl_free(data) ;
+  vl_free(queries) ;
+  vl_free(modes) ;
+  vl_free(decoded) ;
+  vl_free(codes) ;
+  vl_free(exact) ;
+  vl_free(indexes) ;
+  vl_free(distances) ;
+  return 0 ;
+}
@@ -0,0 +1,297 @@
+/** @file test_svm.c
+ ** @brief SVM solvers test
+ ** @author agent
+ **/
+
+#include <vl/svm.h>
+#include <vl/svmmulticlass.h>
+#include <vl/pq.h>
+#include <vl/host.h>
+#include <vl/random.h>
+#include <vl/mathop.h>
+#include <stdio.h>
+
+#include "check.h"
+
+/* train and return the objective and duality gap */
+static double
+train (double * gap, VlSvmSolverType solver, VlSvmDataset * dataset,
+       double const * labels, double lambda, vl_size numEpochs)
+{
+  VlSvm * svm = vl_svm_new_with_dataset (solver, dataset, labels, lambda) ;
+  VlSvmStatistics const * stats ;
+  double objective ;
+  vl_svm_set_max_num_iterations (svm, numEpochs * vl_svmdataset_get_num_data(dataset)) ;
+  vl_svm_set_epsilon (svm, 1e-5) ;
+  vl_tic() ;
+  vl_svm_train (svm) ;
+  stats = vl_svm_get_statistics(svm) ;
+  VL_PRINTF("test_svm: solver %d: objective %g (gap %g) after %d epochs, %.3f s\n",
+            (int)solver, stats->objective, stats->dualityGap,
+            (int)stats->epoch + 1, vl_toc()) ;
+  if (solver == VlSvmSolverSdca || solver == VlSvmSolverSdcaParallel) {
+    check (stats->dualityGap >= -1e-10, "negative duality gap %g", stats->dualityGap) ;
+  }
+  objective = stats->objective ;
+  *gap = stats->dualityGap ;
+  vl_svm_delete (svm) ;
+  return objective ;
+}
+
+/* train SDCA from a fixed random sequence and return the objective */
+static double
+train_seeded (VlSvmDataset * dataset, double const * labels, double lambda, vl_size numEpochs)
+{
+  double gap ;
+  vl_rand_seed (vl_get_rand(), 1) ;
+  return train (&gap, VlSvmSolverSdca, dataset, labels, lambda, numEpochs) ;
+}
+
+/* learn the classes together and one by one from the same random
+   sequence; return the largest model difference */
+static double
+compare_multiclass (VlSvmSolverType solver, VlSvmDataset * dataset,
+                    vl_uint32 const * classes, vl_size numClasses,
+                    VlSvmLossType loss, double lambda, vl_size numEpochs,
+                    vl_size batchSize)
+{
+  vl_size numData = vl_svmdataset_get_num_data(dataset) ;
+  vl_size dimension = vl_svmdataset_get_dimension(dataset) ;
+  double * labels = vl_malloc(sizeof(double) * numData) ;
+  double const * models ;
+  double const * biases ;
+  double err = 0 ;
+  vl_uindex c, i, d ;
+
+  VlSvmMulticlass * svm = vl_svmmulticlass_new (solver, dataset, classes, numClasses, lambda) ;
+  vl_svmmulticlass_set_max_num_iterations (svm, numEpochs * numData) ;
+  vl_svmmulticlass_set_epsilon (svm, 0) ;
+  vl_svmmulticlass_set_batch_size (svm, batchSize) ;
+  vl_svmmulticlass_set_loss (svm, loss) ;
+  vl_rand_seed (vl_get_rand(), 1) ;
+  vl_tic() ;
+  vl_svmmulticlass_train (svm) ;
+  VL_PRINTF("test_svm: multi-class solver %d: %d classes in %.3f s\n",
+            (int)solver, (int)numClasses, vl_toc()) ;
+  check (vl_svmmulticlass_get_status(svm) == VlSvmStatusMaxNumIterationsReached,
+         "unexpected multi-class solver status") ;
+  models = vl_svmmulticlass_get_models(svm) ;
+  biases = vl_svmmulticlass_get_biases(svm) ;
+
+  for (c = 0 ; c < numClasses ; ++c) {
+    VlSvm * binary = vl_svm_new_with_dataset (solver, dataset, labels, lambda) ;
+    double const * model ;
+    for (i = 0 ; i < numData ; ++i) {
+      labels[i] = (classes[i] == c) ? 1 : -1 ;
+    }
+    vl_svm_set_loss (binary, loss) ;
+    vl_svm_set_max_num_iterations (binary, numEpochs * numData) ;
+    vl_svm_set_epsilon (binary, 0) ;
+    vl_rand_seed (vl_get_rand(), 1) ;
+    vl_svm_train (binary) ;
+    model = vl_svm_get_model(binary) ;
+    for (d = 0 ; d < dimension ; ++d) {
+      err = VL_MAX(err, vl_abs_d(model[d] - models[c * dimension + d])) ;
+    }
+    err = VL_MAX(err, vl_abs_d(vl_svm_get_bias(binary) - biases[c])) ;
+    vl_svm_delete (binary) ;
+  }
+  vl_svmmulticlass_delete (svm) ;
+  vl_free(labels) ;
+  return err ;
+}
+
+int
+main (int argc VL_UNUSED, char ** argv VL_UNUSED)
+{
+  VlRand rand ;
+  vl_size numData = 10000 ;
+  vl_size dimension = 100 ;
+  double lambda = 1e-3 ;
+  vl_uindex i, d ;
+  double reference, objective, referenceGap, gap, err ;
+
+  double * data = vl_malloc(sizeof(double) * dimension * numData) ;
+  double * labels = vl_malloc(sizeof(double) * numData) ;
+  double * direction = vl_malloc(sizeof(double) * dimension) ;
+  vl_uint32 * classes = vl_malloc(sizeof(vl_uint32) * numData) ;
+  VlSvmDataset * dataset ;
+  VlHomogeneousKernelMap * hom ;
+
+  vl_rand_init (&rand) ;
+  vl_rand_seed (&rand, 1000) ;
+
+  /* non-negative data, labels given by a noisy linear classifier */
+  for (d = 0 ; d < dimension ; ++d) {
+    direction[d] = vl_rand_real1(&rand) - 0.5 ;
+  }
+  for (i = 0 ; i < numData ; ++i) {
+    double score = 0.1 * (vl_rand_real1(&rand) - 0.5) ;
+    for (d = 0 ; d < dimension ; ++d) {
+      data[i * dimension + d] = vl_rand_real1(&rand) ;
+      score += direction[d] * (data[i * dimension + d] - 0.5) ;
+    }
+    labels[i] = (score > 0) ? 1 : -1 ;
+    classes[i] = (vl_uint32) ((score > 0) + 2 * (data[i * dimension] > 0.5)) ;
+  }
+  dataset = vl_svmdataset_new (VL_TYPE_DOUBLE, data, dimension, numData) ;
+
+  /* the multi-threaded solvers do as well as the reference ones; the
+     duality gaps bound how far the SDCA objectives are from the optimum */
+  reference = train (&referenceGap, VlSvmSolverSdca, dataset, labels, lambda, 30) ;
+  objective = train (&gap, VlSvmSolverSdcaParallel, dataset, labels, lambda, 30) ;
+  check (vl_abs_d(objective - reference) <= gap + referenceGap,
+         "parallel SDCA objective %g differs from %g", objective, reference) ;
+
+  reference = train (&referenceGap, VlSvmSolverSgd, dataset, labels, lambda, 30) ;
+  objective = train (&gap, VlSvmSolverSgdParallel, dataset, labels, lambda, 30) ;
+  check (objective <= 1.1 * reference,
+         "parallel SGD objective %g much larger than %g", objective, reference) ;
+
+  /* learning several classes together is the same as learning them
+     one by one */
+  err = compare_multiclass (VlSvmSolverSdca, dataset, classes, 4, VlSvmLossHinge, lambda, 3, 100) ;
+  check (err <= 1e-10, "multi-class SDCA models differ by %g", err) ;
+  err = compare_multiclass (VlSvmSolverSgd, dataset, classes, 4, VlSvmLossHinge, lambda, 3, 100) ;
+  check (err <= 1e-10, "multi-class SGD models differ by %g", err) ;
+
+  /* with eight classes or more, dense data is processed by matrix
+     products in blocks of four points, which changes only the
+     rounding; batches of 13 points end with an incomplete block, some
+     of the ten classes have no positive data, and the logistic loss
+     depends on all the scores, so that SGD amplifies the rounding
+     differences over the epochs */
+  err = compare_multiclass (VlSvmSolverSdca, dataset, classes, 10, VlSvmLossHinge, lambda, 3, 16) ;
+  check (err <= 1e-8, "batched multi-class SDCA models differ by %g", err) ;
+  err = compare_multiclass (VlSvmSolverSgd, dataset, classes, 10, VlSvmLossLogistic, lambda, 3, 13) ;
+  check (err <= 1e-6, "batched multi-class SGD models differ by %g", err) ;
+
+  /* the homogeneous kernel map can be used by several threads */
+  hom = vl_homogeneouskernelmap_new (VlHomogeneousKernelChi2, 1, 1, -1,
+                                     VlHomogeneousKernelMapWindowRectangular) ;
+  vl_svmdataset_set_homogeneous_kernel_map (dataset, hom) ;
+  reference = train (&referenceGap, VlSvmSolverSdca, dataset, labels, lambda, 10) ;
+  objective = train (&gap, VlSvmSolverSdcaParallel, dataset, labels, lambda, 10) ;
+  check (vl_abs_d(objective - reference) <= gap + referenceGap,
+         "parallel SDCA objective %g differs from %g with a kernel map", objective, reference) ;
+
+  /* more threads than when the kernel map was set */
+  {
+    vl_size numThreads = vl_get_max_threads() ;
+    vl_set_num_threads (1) ;
+    vl_svmdataset_set_homogeneous_kernel_map (dataset, hom) ;
+    vl_set_num_threads (4) ;
+    objective = train (&gap, VlSvmSolverSdcaParallel, dataset, labels, lambda, 10) ;
+    check (vl_abs_d(objective - reference) <= gap + referenceGap,
+           "parallel SDCA objective %g differs from %g after adding threads", objective, reference) ;
+    vl_set_num_threads (1) ;
+    vl_svmdataset_set_homogeneous_kernel_map (dataset, hom) ;
+    vl_set_num_threads (4) ;
+    err = compare_multiclass (VlSvmSolverSdca, dataset, classes, 4, VlSvmLossHinge, lambda, 1, 100) ;
+    check (err <= 1e-10, "multi-class SDCA models differ by %g after adding threads", err) ;
+    vl_set_num_threads (numThreads) ;
+  }
+
+  vl_svmdataset_delete (dataset) ;
+
+  /* sparse data gives the same solution as the equivalent dense data,
+     also with a kernel map */
+  {
+    double * values = vl_malloc(sizeof(double) * dimension * numData) ;
+    vl_uint32 * indexes = vl_malloc(sizeof(vl_uint32) * dimension * numData) ;
+    vl_uindex * offsets = vl_malloc(sizeof(vl_uindex) * (numData + 1)) ;
+    double * dense = vl_malloc(sizeof(double) * dimension * numData) ;
+    VlSvmDataset * sparseDataset ;
+    vl_uindex k = 0 ;
+    for (i = 0 ; i < numData ; ++i) {
+      offsets[i] = k ;
+      for (d = 0 ; d < dimension ; ++d) {
+        double x = data[i * dimension + d] ;
+        dense[i * dimension + d] = (x > 0.8) ? x : 0 ;
+        if (x > 0.8) {
+          values[k] = x ;
+          indexes[k++] = (vl_uint32) d ;
+        }
+      }
+    }
+    offsets[numData] = k ;
+    dataset = vl_svmdataset_new (VL_TYPE_DOUBLE, dense, dimension, numData) ;
+    sparseDataset = vl_svmdataset_new_sparse (VL_TYPE_DOUBLE, values, indexes, offsets,
+                                              dimension, numData) ;
+    reference = train_seeded (dataset, labels, lambda, 5) ;
+    objective = train_seeded (sparseDataset, labels, lambda, 5) ;
+    check (vl_abs_d(objective - reference) <= 1e-10 * reference,
+           "sparse SDCA objective %g differs from %g", objective, reference) ;
+
+    vl_svmdataset_set_homogeneous_kernel_map (dataset, hom) ;
+    vl_svmdataset_set_homogeneous_kernel_map (sparseDataset, hom) ;
+    check (vl_svmdataset_get_dimension(sparseDataset) == 3 * dimension,
+           "unexpected sparse dataset dimension") ;
+    reference = train_seeded (dataset, labels, lambda, 5) ;
+    objective = train_seeded (sparseDataset, labels, lambda, 5) ;
+    check (vl_abs_d(objective - reference) <= 1e-10 * reference,
+           "sparse SDCA objective %g differs from %g with a kernel map", objective, reference) ;
+
+    vl_svmdataset_delete (dataset) ;
+    vl_svmdataset_delete (sparseDataset) ;
+    vl_free(values) ;
+    vl_free(indexes) ;
+    vl_free(offsets) ;
+    vl_free(dense) ;
+  }
+
+  /* product quantized data gives the same solution as the decoded
+     data; 8-bit data is close to the original data */
+  {
+    vl_size numSubquantizers = 25 ;
+    VlProductQuantizer * pq = vl_pq_new (VL_TYPE_DOUBLE, dimension, numSubquantizers, 16) ;
+    vl_uint8 * pqCodes = vl_malloc(sizeof(vl_uint8) * numSubquantizers * numData) ;
+    vl_int8 * codes = vl_malloc(sizeof(vl_int8) * dimension * numData) ;
+    float * scales = vl_malloc(sizeof(float) * numData) ;
+    double * decoded = vl_malloc(sizeof(double) * dimension * numData) ;
+    VlSvmDataset * compressedDataset ;
+
+    vl_pq_train (pq, data, numData) ;
+    vl_pq_encode (pq, pqCodes, data, numData) ;
+    vl_pq_decode (pq, decoded, pqCodes, numData) ;
+    dataset = vl_svmdataset_new (VL_TYPE_DOUBLE, decoded, dimension, numData) ;
+    compressedDataset = vl_svmdataset_new_pq (pq, pqCodes, numData) ;
+    reference = train_seeded (dataset, labels, lambda, 5) ;
+    objective = train_seeded (compressedDataset, labels, lambda, 5) ;
+    check (vl_abs_d(objective - reference) <= 1e-10 * reference,
+           "PQ SDCA objective %g differs from %g", objective, reference) ;
+    vl_svmdataset_delete (dataset) ;
+    vl_svmdataset_delete (compressedDataset) ;
+
+    vl_svmdataset_quantize_int8 (codes, scales, VL_TYPE_DOUBLE, data, dimension, numData) ;
+    err = 0 ;
+    for (i = 0 ; i < numData ; ++i) {
+      for (d = 0 ; d < dimension ; ++d) {
+        double x = ((signed char)codes[i * dimension + d]) * (double)scales[i] ;
+        err = VL_MAX(err, vl_abs_d(x - data[i * dimension + d]) / scales[i]) ;
+      }
+    }
+    check (err <= 0.5 + 1e-5, "8-bit quantization error %g too large", err) ;
+    dataset = vl_svmdataset_new (VL_TYPE_DOUBLE, data, dimension, numData) ;
+    compressedDataset = vl_svmdataset_new_int8 (codes, scales, dimension, numData) ;
+    reference = train_seeded (dataset, labels, lambda, 5) ;
+    objective = train_seeded (compressedDataset, labels, lambda, 5) ;
+    check (vl_abs_d(objective - reference) <= 0.01 * reference,
+           "8-bit SDCA objective %g differs from %g", objective, reference) ;
+    vl_svmdataset_delete (dataset) ;
+    vl_svmdataset_delete (compressedDataset) ;
+
+    vl_pq_delete (pq) ;
+    vl_free(pqCodes) ;
+    vl_free(codes) ;
+    vl_free(scales) ;
+    vl_free(decoded) ;
+  }
+
+  vl_homogeneouskernelmap_delete (hom) ;
+  vl_free(data) ;
+  vl_free(labels) ;
+  vl_free(direction) ;
+  vl_free(classes) ;
+  return 0 ;
+}
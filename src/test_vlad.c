@@ -0,0 +1,214 @@
+/** @file test_vlad.c
+ ** @brief VLAD encoding test
+ ** @author agent
+ **/
+
+#include <vl/vlad.h>
+#include <vl/host.h>
+#include <vl/random.h>
+#include <vl/mathop.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+
+int
+main (int argc VL_UNUSED, char ** argv VL_UNUSED)
+{
+  VlRand rand ;
+  vl_size numData = 5000 ;
+  vl_size dimension = 64 ;
+  vl_size numClusters = 256 ;
+  vl_size numAssignments = 2 ;
+  vl_uindex i, k, trial ;
+  double denseTime, sparseTime ;
+  int flags = VL_VLAD_FLAG_SQUARE_ROOT | VL_VLAD_FLAG_NORMALIZE_MASS ;
+
+  float * data = vl_malloc(sizeof(float) * dimension * numData) ;
+  float * means = vl_malloc(sizeof(float) * dimension * numClusters) ;
+  float * assignments = vl_calloc(numClusters * numData, sizeof(float)) ;
+  vl_uint32 * indexes = vl_malloc(sizeof(vl_uint32) * numAssignments * numData) ;
+  float * weights = vl_malloc(sizeof(float) * numAssignments * numData) ;
+  float * denseEnc = vl_malloc(sizeof(float) * dimension * numClusters) ;
+  float * sparseEnc = vl_malloc(sizeof(float) * dimension * numClusters) ;
+
+  vl_rand_init (&rand) ;
+  vl_rand_seed (&rand, 1000) ;
+
+  for (i = 0 ; i < dimension * numData ; ++i) {
+    data[i] = (float) vl_rand_real1(&rand) ;
+  }
+  for (i = 0 ; i < dimension * numClusters ; ++i) {
+    means[i] = (float) vl_rand_real1(&rand) ;
+  }
+
+  /* hard assignments */
+  for (i = 0 ; i < numData ; ++i) {
+    indexes[i] = (vl_uint32) vl_rand_uindex(&rand, numClusters) ;
+    assignments[i * numClusters + indexes[i]] = 1 ;
+  }
+
+  vl_tic() ;
+  vl_vlad_encode (denseEnc, VL_TYPE_FLOAT, means, dimension, numClusters,
+                  data, numData, assignments, flags) ;
+  denseTime = vl_toc() ;
+  vl_tic() ;
+  vl_vlad_encode_sparse (sparseEnc, VL_TYPE_FLOAT, means, dimension, numClusters,
+                         data, numData, indexes, NULL, 1, flags) ;
+  sparseTime = vl_toc() ;
+  VL_PRINTF("test_vlad: hard assignments: dense %.4f s, sparse %.4f s\n",
+            denseTime, sparseTime) ;
+  check (memcmp(denseEnc, sparseEnc, sizeof(float) * dimension * numClusters) == 0,
+         "sparse and dense hard VLAD encodings differ") ;
+
+  /* weighted top-k assignments */
+  memset(assignments, 0, sizeof(float) * numClusters * numData) ;
+  for (i = 0 ; i < numData ; ++i) {
+    float w = (float) vl_rand_real1(&rand) ;
+    vl_uint32 k1 = (vl_uint32) vl_rand_uindex(&rand, numClusters) ;
+    vl_uint32 k2 = (vl_uint32) ((k1 + 1 + vl_rand_uindex(&rand, numClusters - 1)) % numClusters) ;
+    indexes[2*i] = k1 ;
+    indexes[2*i+1] = k2 ;
+    weights[2*i] = w ;
+    weights[2*i+1] = 1 - w ;
+    assignments[i * numClusters + k1] = w ;
+    assignments[i * numClusters + k2] = 1 - w ;
+  }
+
+  vl_vlad_encode (denseEnc, VL_TYPE_FLOAT, means, dimension, numClusters,
+                  data, numData, assignments, flags) ;
+  vl_vlad_encode_sparse (sparseEnc, VL_TYPE_FLOAT, means, dimension, numClusters,
+                         data, numData, indexes, weights, numAssignments, flags) ;
+  for (k = 0 ; k < dimension * numClusters ; ++k) {
+    float err = vl_abs_f(denseEnc[k] - sparseEnc[k]) ;
+    check (err <= 1e-5f, "sparse and dense top-k VLAD encodings differ by %g", err) ;
+  }
+
+  /* encoding a batch of images equals encoding them one by one */
+  {
+    vl_size numImages = 3 ;
+    vl_size numImageData [3] = {2000, 0, 1500} ;
+    vl_size encSize = dimension * numClusters ;
+    float * batchEnc = vl_malloc(sizeof(float) * encSize * numImages) ;
+    VlVladEncoder * encoder = vl_vlad_encoder_new (VL_TYPE_FLOAT, means, dimension, numClusters) ;
+    vl_uindex offset = 0 ;
+    vl_vlad_encoder_encode_batch (encoder, batchEnc, data, numImageData, numImages,
+                                  indexes, weights, numAssignments, flags) ;
+    for (i = 0 ; i < numImages ; ++i) {
+      vl_vlad_encode_sparse (sparseEnc, VL_TYPE_FLOAT, means, dimension, numClusters,
+                             data + offset * dimension, numImageData[i],
+                             indexes + offset * numAssignments,
+                             weights + offset * numAssignments,
+                             numAssignments, flags) ;
+      check (memcmp(batchEnc + i * encSize, sparseEnc, sizeof(float) * encSize) == 0,
+             "batch VLAD encoding %d differs", (int)i) ;
+      offset += numImageData[i] ;
+    }
+    vl_vlad_encoder_delete (encoder) ;
+    vl_free(batchEnc) ;
+  }
+
+  /* an encoder must not be used by concurrent callers, but one
+     encoder per thread can be */
+  {
+    vl_size encSize = dimension * numClusters ;
+    vl_size numImageData [2] = {2000, 1500} ;
+    vl_uindex offsets [2] = {0, 2000} ;
+    float * threadEnc = vl_malloc(sizeof(float) * encSize * 2) ;
+    VlVladEncoder * encoders [2] ;
+    vl_index k ;
+    for (k = 0 ; k < 2 ; ++k) {
+      encoders[k] = vl_vlad_encoder_new (VL_TYPE_FLOAT, means, dimension, numClusters) ;
+    }
+#if defined(_OPENMP)
+#pragma omp parallel for num_threads(2)
+#endif
+    for (k = 0 ; k < 2 ; ++k) {
+      vl_vlad_encoder_encode_batch (encoders[k], threadEnc + k * encSize,
+                                    data + offsets[k] * dimension, numImageData + k, 1,
+                                    indexes + offsets[k] * numAssignments,
+                                    weights + offsets[k] * numAssignments,
+                                    numAssignments, flags) ;
+    }
+    for (k = 0 ; k < 2 ; ++k) {
+      vl_vlad_encode_sparse (sparseEnc, VL_TYPE_FLOAT, means, dimension, numClusters,
+                             data + offsets[k] * dimension, numImageData[k],
+                             indexes + offsets[k] * numAssignments,
+                             weights + offsets[k] * numAssignments,
+                             numAssignments, flags) ;
+      check (memcmp(threadEnc + k * encSize, sparseEnc, sizeof(float) * encSize) == 0,
+             "VLAD encoding %d of a concurrent encoder differs", (int)k) ;
+      vl_vlad_encoder_delete (encoders[k]) ;
+    }
+    vl_free(threadEnc) ;
+  }
+
+  /* pooling into a few boxes (directly) and into many boxes (through
+     an integral image) equals encoding each region */
+  for (trial = 0 ; trial < 2 ; ++trial) {
+    vl_size numRegions = (trial == 0) ? 4 : 100 ;
+    vl_size encSize = dimension * numClusters ;
+    double * positions = vl_malloc(sizeof(double) * 2 * numData) ;
+    double * regions = vl_malloc(sizeof(double) * 4 * numRegions) ;
+    float * selection = vl_malloc(sizeof(float) * dimension * numData) ;
+    vl_uint32 * selectionIndexes = vl_malloc(sizeof(vl_uint32) * numAssignments * numData) ;
+    float * selectionWeights = vl_malloc(sizeof(float) * numAssignments * numData) ;
+    float * regionEnc = vl_malloc(sizeof(float) * encSize * numRegions) ;
+    VlVladEncoder * encoder = vl_vlad_encoder_new (VL_TYPE_FLOAT, means, dimension, numClusters) ;
+    vl_uindex r ;
+    float err = 0 ;
+
+    for (i = 0 ; i < 2 * numData ; ++i) {
+      positions[i] = vl_rand_real2(&rand) ;
+    }
+    for (r = 0 ; r < numRegions ; ++r) {
+      double * box = regions + 4 * r ;
+      box[0] = vl_rand_uindex(&rand, 4) / 4.0 ;
+      box[1] = vl_rand_uindex(&rand, 4) / 4.0 ;
+      box[2] = box[0] + (1 + vl_rand_uindex(&rand, 4)) / 4.0 ;
+      box[3] = box[1] + (1 + vl_rand_uindex(&rand, 4)) / 4.0 ;
+    }
+    vl_vlad_encoder_encode_regions (encoder, regionEnc, data, numData, positions,
+                                    regions, numRegions, indexes, weights,
+                                    numAssignments, flags) ;
+    for (r = 0 ; r < numRegions ; ++r) {
+      double const * box = regions + 4 * r ;
+      vl_size count = 0 ;
+      for (i = 0 ; i < numData ; ++i) {
+        double const * x = positions + 2 * i ;
+        if (box[0] <= x[0] && x[0] < box[2] && box[1] <= x[1] && x[1] < box[3]) {
+          memcpy(selection + count * dimension, data + i * dimension, sizeof(float) * dimension) ;
+          memcpy(selectionIndexes + count * numAssignments, indexes + i * numAssignments,
+                 sizeof(vl_uint32) * numAssignments) ;
+          memcpy(selectionWeights + count * numAssignments, weights + i * numAssignments,
+                 sizeof(float) * numAssignments) ;
+          count ++ ;
+        }
+      }
+      vl_vlad_encode_sparse (sparseEnc, VL_TYPE_FLOAT, means, dimension, numClusters,
+                             selection, count, selectionIndexes, selectionWeights,
+                             numAssignments, flags) ;
+      for (k = 0 ; k < encSize ; ++k) {
+        err = VL_MAX(err, vl_abs_f(regionEnc[r * encSize + k] - sparseEnc[k])) ;
+      }
+    }
+    check (err <= 1e-5f, "region VLAD encodings differ by %g", err) ;
+
+    vl_vlad_encoder_delete (encoder) ;
+    vl_free(positions) ;
+    vl_free(regions) ;
+    vl_free(selection) ;
+    vl_free(selectionIndexes) ;
+    vl_free(selectionWeights) ;
+    vl_free(regionEnc) ;
+  }
+
+  vl_free(data) ;
+  vl_free(means) ;
+  vl_free(assignments) ;
+  vl_free(indexes) ;
+  vl_free(weights) ;
+  vl_free(denseEnc) ;
+  vl_free(sparseEnc) ;
+  return 0 ;
+}
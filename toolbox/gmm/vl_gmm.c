@@ -26,7 +26,8 @@ enum
   opt_means,
   opt_covariances,
   opt_priors,
-  opt_covariance_bound
+  opt_covariance_bound,
+  opt_covariance_type
 } ;
 
 vlmxOption  options [] =
@@ -40,6 +41,7 @@ vlmxOption  options [] =
   {"InitCovariances",   1,   opt_covariances         },
   {"InitPriors",        1,   opt_priors              },
   {"CovarianceBound",   1,   opt_covariance_bound    },
+  {"CovarianceType",    1,   opt_covariance_type     },
   {0,                   0,   0                       }
 } ;
 
@@ -48,7 +50,7 @@ void
 mexFunction (int nout, mxArray * out[], int nin, const mxArray * in[])
 {
   enum {IN_DATA = 0, IN_NUMCLUSTERS, IN_END} ;
-  enum {OUT_MEANS, OUT_COVARIANCES, OUT_PRIORS, OUT_LL, OUT_POSTERIORS} ;
+  enum {OUT_MEANS, OUT_COVARIANCES, OUT_PRIORS, OUT_LL, OUT_POSTERIORS, OUT_TIEDCOVARIANCE} ;
 
   int opt ;
   int next = IN_END ;
@@ -61,6 +63,7 @@ mexFunction (int nout, mxArray * out[], int nin, const mxArray * in[])
   vl_size numData ;
 
   void * initCovariances = 0 ;
+  mxArray const * initCovariancesArray = NULL ;
   void * initMeans = 0 ;
   void * initPriors = 0 ;
 
@@ -74,6 +77,7 @@ mexFunction (int nout, mxArray * out[], int nin, const mxArray * in[])
   int verbosity = 0 ;
   VlGMMInitialization initialization = VlGMMRand ;
   vl_bool initializationSet = VL_FALSE ;
+  VlGMMCovarianceType covarianceType = VlGMMDiagonal ;
 
   vl_type dataType ;
   mxClassID classID ;
@@ -91,7 +95,7 @@ mexFunction (int nout, mxArray * out[], int nin, const mxArray * in[])
     vlmxError (vlmxErrInvalidArgument,
                "At least two arguments required.");
   }
-  else if (nout > 5)
+  else if (nout > 6)
   {
     vlmxError (vlmxErrInvalidArgument,
                "Too many output arguments.");
@@ -179,13 +183,39 @@ mexFunction (int nout, mxArray * out[], int nin, const mxArray * in[])
         if (mxGetClassID (optarg) != mxGetClassID(IN(DATA))) {
           vlmxError (vlmxErrInvalidArgument, "INITCOVARIANCES is not of the same class as the data X.") ;
         }
-        if (! vlmxIsMatrix (optarg, dimension, numClusters) || ! vlmxIsReal (optarg)) {
-          vlmxError(vlmxErrInvalidArgument, "INITCOVARIANCES is not a real matrix or does not have the correct size.") ;
+        /* the size depends on the covariance type, checked below */
+        if (! vlmxIsMatrix (optarg, -1, -1) || ! vlmxIsReal (optarg)) {
+          vlmxError(vlmxErrInvalidArgument, "INITCOVARIANCES is not a real matrix.") ;
         }
+        initCovariancesArray = optarg ;
         initCovariances = mxGetPr(optarg) ;
         break;
       }
 
+      case opt_covariance_type :
+        if (!vlmxIsString (optarg, -1)) {
+          vlmxError (vlmxErrInvalidArgument,
+                     "COVARIANCETYPE must be a string.") ;
+        }
+        if (mxGetString (optarg, buf, sizeof(buf))) {
+          vlmxError (vlmxErrInvalidArgument,
+                     "COVARIANCETYPE argument too long.") ;
+        }
+        if (vlmxCompareStringsI("diagonal", buf) == 0) {
+          covarianceType = VlGMMDiagonal ;
+        }
+        else if (vlmxCompareStringsI("spherical", buf) == 0) {
+          covarianceType = VlGMMSpherical ;
+        }
+        else if (vlmxCompareStringsI("tied", buf) == 0) {
+          covarianceType = VlGMMTied ;
+        }
+        else {
+          vlmxError (vlmxErrInvalidArgument,
+                     "Invalid value '%s' for COVARIANCETYPE.", buf) ;
+        }
+        break ;
+
       case opt_initialization :
         if (!vlmxIsString (optarg, -1))
         {
@@ -273,6 +303,16 @@ mexFunction (int nout, mxArray * out[], int nin, const mxArray * in[])
                  "INITCOVARIANCES requires 'custom' INITALIZATION.") ;
     }
     initialization = VlGMMCustom ;
+    if (covarianceType == VlGMMTied) {
+      if (! vlmxIsMatrix (initCovariancesArray, dimension, dimension)) {
+        vlmxError (vlmxErrInvalidArgument,
+                   "INITCOVARIANCES must be a SIZE(X,1) x SIZE(X,1) matrix "
+                   "with tied covariances.") ;
+      }
+    } else if (! vlmxIsMatrix (initCovariancesArray, dimension, numClusters)) {
+      vlmxError (vlmxErrInvalidArgument,
+                 "INITCOVARIANCES does not have the correct size.") ;
+    }
   }
 
   gmm = vl_gmm_new (dataType, dimension, numClusters) ;
@@ -280,6 +320,7 @@ mexFunction (int nout, mxArray * out[], int nin, const mxArray * in[])
   vl_gmm_set_num_repetitions (gmm, numRepetitions) ;
   vl_gmm_set_max_num_iterations (gmm, maxNumIterations) ;
   vl_gmm_set_initialization (gmm, initialization) ;
+  vl_gmm_set_covariance_type (gmm, covarianceType) ;
 
   if (!vl_is_nan_d(covarianceScalarBound)) {
     vl_gmm_set_covariance_lower_bound (gmm, covarianceScalarBound) ;
@@ -294,11 +335,16 @@ mexFunction (int nout, mxArray * out[], int nin, const mxArray * in[])
     vl_gmm_set_means(gmm, initMeans) ;
   }
   if (initCovariances) {
-    vl_gmm_set_covariances(gmm, initCovariances) ;
+    if (covarianceType == VlGMMTied) {
+      vl_gmm_set_tied_covariance(gmm, initCovariances) ;
+    } else {
+      vl_gmm_set_covariances(gmm, initCovariances) ;
+    }
   }
 
   if (verbosity) {
     char const * initializationName = 0 ;
+    char const * covarianceTypeName = 0 ;
 
     switch (vl_gmm_get_initialization(gmm)) {
       case VlGMMRand : initializationName = "rand" ; break ;
@@ -307,7 +353,15 @@ mexFunction (int nout, mxArray * out[], int nin, const mxArray * in[])
       default: abort() ;
     }
 
+    switch (vl_gmm_get_covariance_type(gmm)) {
+      case VlGMMDiagonal : covarianceTypeName = "diagonal" ; break ;
+      case VlGMMSpherical : covarianceTypeName = "spherical" ; break ;
+      case VlGMMTied : covarianceTypeName = "tied" ; break ;
+      default: abort() ;
+    }
+
     mexPrintf("vl_gmm: initialization = %s\n", initializationName) ;
+    mexPrintf("vl_gmm: covarianceType = %s\n", covarianceTypeName) ;
     mexPrintf("vl_gmm: maxNumIterations = %d\n", vl_gmm_get_max_num_iterations(gmm)) ;
     mexPrintf("vl_gmm: numRepetitions = %d\n", vl_gmm_get_num_repetitions(gmm)) ;
     mexPrintf("vl_gmm: data type = %s\n", vl_get_type_name(vl_gmm_get_data_type(gmm))) ;
@@ -333,6 +387,10 @@ mexFunction (int nout, mxArray * out[], int nin, const mxArray * in[])
   /* -------------------------------------------------------------- */
 
   LL = vl_gmm_cluster(gmm, data, numData) ;
+  if (covarianceType == VlGMMTied && vl_is_nan_d(LL)) {
+    vl_gmm_delete (gmm) ;
+    vlmxError (vlmxErrInvalidArgument, "%s", vl_get_last_error_message()) ;
+  }
 
   /* copy centers */
   OUT(MEANS) = mxCreateNumericMatrix (dimension, numClusters, classID, mxREAL) ;
@@ -364,5 +422,15 @@ mexFunction (int nout, mxArray * out[], int nin, const mxArray * in[])
             vl_get_type_size (dataType) * numData * vl_gmm_get_num_clusters(gmm)) ;
   }
 
+  /* optionally return the shared covariance matrix */
+  if (nout > 5) {
+    OUT(TIEDCOVARIANCE) = mxCreateNumericMatrix (dimension, dimension, classID, mxREAL) ;
+    if (covarianceType == VlGMMTied) {
+      memcpy (mxGetData(OUT(TIEDCOVARIANCE)),
+              vl_gmm_get_tied_covariance (gmm),
+              vl_get_type_size (dataType) * dimension * dimension) ;
+    }
+  }
+
   vl_gmm_delete (gmm) ;
 }
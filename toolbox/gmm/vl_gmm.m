@@ -16,6 +16,12 @@
 %   each data point. The POSTERIORS matrix has NUMCLUSTERS rows and
 %   NUMDATA columns.
 %
+%   [MEANS, COVARIANCES, PRIORS, LL, POSTERIORS, TIEDCOVARIANCE] =
+%   VL_GMM(...) returns the full covariance matrix shared by all the
+%   modes when the CovarianceType option is TIED (a
+%   size(X,1)-by-size(X,1) matrix). For other covariance types
+%   TIEDCOVARIANCE is zero.
+%
 %   VL_GMM() supports different initialization and optimization
 %   methods. Specifically, the following options are supported:
 %
@@ -36,6 +42,16 @@
 %
 %   InitCovariances:: none
 %     Specify the initial diagonal covariance matrices
+%     (size(X,1)-by-NUMCLUSTERS matrix). With a TIED covariance type,
+%     specify instead the initial shared covariance matrix
+%     (size(X,1)-by-size(X,1) matrix).
+%
+%   CovarianceType:: DIAGONAL
+%     DIAGONAL fits one diagonal covariance per mode. SPHERICAL fits
+%     one isotropic covariance per mode. TIED fits one full covariance
+%     shared by all the modes; COVARIANCES then contains its diagonal
+%     replicated for each mode. An error is raised if the shared
+%     covariance is not positive definite.
 %
 %   NumRepetitions:: 1
 %     Number of times to restart EM. The solution with maximum
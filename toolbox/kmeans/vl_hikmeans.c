@@ -203,7 +203,15 @@ void mexFunction (int nout, mxArray * out[], int nin, const mxArray * in[])
 
   vl_hikm_set_verbosity (tree, verb) ;
   vl_hikm_init (tree, M, K, depth) ;
-  vl_hikm_train (tree, data, N) ;
+
+  /* subtrees are trained by concurrent tasks that allocate memory and
+     print, but the MATLAB functions doing so are not thread safe */
+  {
+    vl_size numThreads = vl_get_max_threads () ;
+    vl_set_num_threads (1) ;
+    vl_hikm_train (tree, data, N) ;
+    vl_set_num_threads (numThreads) ;
+  }
 
   out[OUT_TREE] = hikm_to_matlab (tree) ;
 
@@ -26,6 +26,7 @@ enum {
   opt_num_comparisons,
   opt_min_energy_variation,
   opt_num_trees,
+  opt_mini_batch_size,
   opt_multithreading
 } ;
 
@@ -45,6 +46,7 @@ vlmxOption  options [] = {
   {"NumTrees",          1,   opt_num_trees           },
   {"MaxNumComparisons", 1,   opt_num_comparisons     },
   {"MinEnergyVariation",1,   opt_min_energy_variation},
+  {"MiniBatchSize",     1,   opt_mini_batch_size     },
   {0,                   0,   0                       }
 } ;
 
@@ -76,6 +78,7 @@ mexFunction (int nout, mxArray * out[], int nin, const mxArray * in[])
   int initialization = INIT_PLUSPLUS ;
   vl_size maxNumComparisons = 100 ;
   vl_size numTrees = 3;
+  vl_size miniBatchSize = 1024 ;
 
   vl_type dataType ;
   mxClassID classID ;
@@ -162,6 +165,10 @@ mexFunction (int nout, mxArray * out[], int nin, const mxArray * in[])
           algorithm = VlKMeansElkan ;
         } else if (vlmxCompareStringsI("ann", buf) == 0) {
           algorithm = VlKMeansANN ;
+        } else if (vlmxCompareStringsI("hamerly", buf) == 0) {
+          algorithm = VlKMeansHamerly ;
+        } else if (vlmxCompareStringsI("minibatch", buf) == 0) {
+          algorithm = VlKMeansMiniBatch ;
         } else {
           vlmxError (vlmxErrInvalidArgument,
                     "Invalid value %s for ALGORITHM", buf) ;
@@ -182,6 +189,9 @@ mexFunction (int nout, mxArray * out[], int nin, const mxArray * in[])
           initialization = VlKMeansPlusPlus ;
         } else if (vlmxCompareStringsI("randsel", buf) == 0) {
           initialization = VlKMeansRandomSelection ;
+        } else if (vlmxCompareStringsI("scalableplusplus", buf) == 0 ||
+                   vlmxCompareStringsI("||", buf) == 0) {
+          initialization = VlKMeansScalablePlusPlus ;
         } else {
           vlmxError (vlmxErrInvalidArgument,
                     "Invalid value %s for INITIALISATION.", buf) ;
@@ -246,6 +256,18 @@ mexFunction (int nout, mxArray * out[], int nin, const mxArray * in[])
             maxNumComparisons = (vl_size) mxGetScalar (optarg) ;
          break;
 
+      case opt_mini_batch_size :
+        if (!vlmxIsPlainScalar (optarg)) {
+          vlmxError (vlmxErrInvalidArgument,
+                     "MINIBATCHSIZE must be a scalar.") ;
+        }
+        if (mxGetScalar (optarg) < 1) {
+          vlmxError (vlmxErrInvalidArgument,
+                     "MINIBATCHSIZE must be larger than or equal to 1.") ;
+        }
+        miniBatchSize = (vl_size) mxGetScalar (optarg) ;
+        break ;
+
       default :
         abort() ;
         break ;
@@ -256,6 +278,11 @@ mexFunction (int nout, mxArray * out[], int nin, const mxArray * in[])
    *                                                        Do the job
    * -------------------------------------------------------------- */
 
+  if (algorithm == VlKMeansMiniBatch && distance != VlDistanceL2) {
+    vlmxError (vlmxErrInvalidArgument,
+               "The MINIBATCH algorithm supports only the L2 distance.") ;
+  }
+
   data = mxGetPr(IN(DATA)) ;
 
   kmeans = vl_kmeans_new (dataType, distance) ;
@@ -267,6 +294,7 @@ mexFunction (int nout, mxArray * out[], int nin, const mxArray * in[])
   vl_kmeans_set_max_num_iterations (kmeans, maxNumIterations) ;
   vl_kmeans_set_max_num_comparisons (kmeans, maxNumComparisons) ;
   vl_kmeans_set_num_trees (kmeans, numTrees);
+  vl_kmeans_set_mini_batch_size (kmeans, miniBatchSize) ;
   
   if (minEnergyVariation >= 0) {
     vl_kmeans_set_min_energy_variation (kmeans, minEnergyVariation) ;
@@ -280,11 +308,14 @@ mexFunction (int nout, mxArray * out[], int nin, const mxArray * in[])
       case VlKMeansLloyd: algorithmName = "Lloyd" ; break ;
       case VlKMeansElkan: algorithmName = "Elkan" ; break ;
       case VlKMeansANN:   algorithmName = "ANN" ; break ;
+      case VlKMeansHamerly: algorithmName = "Hamerly" ; break ;
+      case VlKMeansMiniBatch: algorithmName = "MiniBatch" ; break ;
       default : abort() ;
     }
     switch (vl_kmeans_get_initialization(kmeans)) {
       case VlKMeansPlusPlus : initializationName = "plusplus" ; break ;
       case VlKMeansRandomSelection : initializationName = "randsel" ; break ;
+      case VlKMeansScalablePlusPlus : initializationName = "scalableplusplus" ; break ;
       default: abort() ;
     }
     mexPrintf("kmeans: Initialization = %s\n", initializationName) ;
@@ -299,6 +330,7 @@ mexFunction (int nout, mxArray * out[], int nin, const mxArray * in[])
     mexPrintf("kmeans: num. centers = %d\n", numCenters) ;
     mexPrintf("kmeans: max num. comparisons = %d\n", maxNumComparisons) ;
     mexPrintf("kmeans: num. trees = %d\n", numTrees) ;
+    mexPrintf("kmeans: mini-batch size = %d\n", miniBatchSize) ;
     mexPrintf("\n") ;
   }
 
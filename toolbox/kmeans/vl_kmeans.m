@@ -20,18 +20,26 @@
 %     Use either L1 or L2 distance.
 %
 %   Initialization::
-%     Use either random data points (RANDSEL) or k-means++ (PLUSPLUS)
-%     to initialize the centers.
+%     Use either random data points (RANDSEL), k-means++ (PLUSPLUS),
+%     or scalable k-means++ (SCALABLEPLUSPLUS) to initialize the
+%     centers. SCALABLEPLUSPLUS (also known as k-means||) samples
+%     candidate centers in a few parallel rounds and is much faster
+%     than PLUSPLUS for a large number of centers.
 %
 %   Algorithm:: [LLOYD]
-%     One of LLOYD, ELKAN, or ANN. LLOYD is the standard Lloyd
-%     algorithm (similar to expectation maximisation). ELKAN is a
-%     faster version of LLOYD using triangular inequalities to cut
+%     One of LLOYD, ELKAN, HAMERLY, ANN, or MINIBATCH. LLOYD is the standard
+%     Lloyd algorithm (similar to expectation maximisation). ELKAN is
+%     a faster version of LLOYD using triangular inequalities to cut
 %     down significantly the number of sample-to-center
-%     comparisons. ANN is the same as Lloyd, but uses an approximated
+%     comparisons. HAMERLY is similar to ELKAN, but keeps only two
+%     bounds per data point instead of one per center, so that it
+%     can be used with many data points and centers. ANN is the
+%     same as Lloyd, but uses an approximated
 %     nearest neighbours (ANN) algorithm to accelerate the
 %     sample-to-center comparisons. The latter is particularly
-%     suitable for very large problems.
+%     suitable for very large problems. MINIBATCH updates the
+%     centers from small random batches of data, using one batch
+%     per iteration; it supports only the L2 distance.
 %
 %   NumRepetitions:: [1]
 %     Number of time to restart k-means. The solution with minimal
@@ -52,6 +60,9 @@
 %     Maximum number of iterations allowed for the kmeans algorithm
 %     to converge.
 %
+%   MiniBatchSize:: [1024]
+%     Number of data points in each batch of the MINIBATCH algorithm.
+%
 %   Example::
 %     VL_KMEANS(X, 10, 'verbose', 'distance', 'l1', 'algorithm',
 %     'elkan') clusters the data point X using 10 centers, l1
@@ -117,7 +117,7 @@ new_array_from_kdforest (VlKDForest const * forest)
   for (ti = 0 ; ti < forest->numTrees ; ++ ti) {
     VlKDTree * tree = forest->trees[ti] ;
     mxArray * nodes_array = mxCreateStructArray (2, dims, sizeof(nodesFieldNames) / sizeof(nodesFieldNames[0]), nodesFieldNames) ;
-    mxArray * dataIndex_array = mxCreateNumericMatrix (1, forest->numData, mxUINT32_CLASS, mxREAL) ;
+    mxArray * dataIndex_array = mxCreateNumericMatrix (1, forest->numIndexedData, mxUINT32_CLASS, mxREAL) ;
 
     mxSetField (trees_array, ti, "nodes", nodes_array) ;
     mxSetField (trees_array, ti, "dataIndex", dataIndex_array) ;
@@ -167,7 +167,7 @@ new_array_from_kdforest (VlKDForest const * forest)
     {
       vl_uint32 * dataIndex = mxGetData (dataIndex_array) ;
       vl_uindex di ;
-      for (di = 0 ; di < forest->numData ; ++ di) {
+      for (di = 0 ; di < forest->numIndexedData ; ++ di) {
         dataIndex [di] = forest->trees[ti]->dataIndex[di].index + 1 ;
       }
     }
@@ -294,6 +294,8 @@ new_kdforest_from_array (mxArray const * forest_array, mxArray const * data_arra
 
   forest = vl_kdforest_new (dataType, dimension, numTrees, distance) ;
   forest->numData = numData ;
+  forest->numIndexedData = numData ;
+  forest->numBaseData = numData ;
   forest->trees = vl_malloc (sizeof(VlKDTree*) * numTrees) ;
   forest->data = mxGetData (data_array) ;
 
@@ -383,6 +385,8 @@ new_kdforest_from_array (mxArray const * forest_array, mxArray const * data_arra
     tree->numUsedNodes = numUsedNodes ;
     tree->nodes = vl_malloc (sizeof(VlKDTreeNode) * numUsedNodes) ;
     tree->dataIndex = vl_malloc (sizeof(VlKDTreeDataIndexEntry) * numData) ;
+    tree->compactNodes = NULL ;
+    tree->compactData = NULL ;
 
     {
       vl_uindex ni ;
@@ -55,6 +55,8 @@ mexFunction (int nout VL_UNUSED, mxArray * out[], int nin, const mxArray * in[])
 
   void const * means = NULL;
   void const * assignments = NULL;
+  vl_uint32 * indexes = NULL ;
+  vl_size numAssignments = 0 ;
   void const * data = NULL ;
   int verbosity = 0 ;
 
@@ -93,9 +95,9 @@ mexFunction (int nout VL_UNUSED, mxArray * out[], int nin, const mxArray * in[])
   if (mxGetClassID (IN(MEANS)) != classID) {
     vlmxError(vlmxErrInvalidArgument, "MEANS is not of the same class as DATA.") ;
   }
-  if (mxGetClassID (IN(ASSIGNMENTS)) != classID) {
-    vlmxError(vlmxErrInvalidArgument, "ASSIGNMENTS is not of the same class as DATA.") ;
-
+  if (mxGetClassID (IN(ASSIGNMENTS)) != classID &&
+      mxGetClassID (IN(ASSIGNMENTS)) != mxUINT32_CLASS) {
+    vlmxError(vlmxErrInvalidArgument, "ASSIGNMENTS is neither of the same class as DATA nor UINT32.") ;
   }
 
   dimension = mxGetM (IN(DATA)) ;
@@ -110,7 +112,12 @@ mexFunction (int nout VL_UNUSED, mxArray * out[], int nin, const mxArray * in[])
     vlmxError (vlmxErrInvalidArgument, "MEANS is not a matrix or does not have the right size.") ;
   }
 
-  if (!vlmxIsMatrix(IN(ASSIGNMENTS), numClusters, -1)) {
+  if (mxGetClassID (IN(ASSIGNMENTS)) == mxUINT32_CLASS) {
+    if (!vlmxIsMatrix(IN(ASSIGNMENTS), -1, numData)) {
+      vlmxError (vlmxErrInvalidArgument, "ASSIGNMENTS is not a matrix or does not have the right size.") ;
+    }
+    numAssignments = mxGetM (IN(ASSIGNMENTS)) ;
+  } else if (!vlmxIsMatrix(IN(ASSIGNMENTS), numClusters, -1)) {
     vlmxError (vlmxErrInvalidArgument, "ASSIGNMENTS is not a matrix or does not have the right size.") ;
   }
 
@@ -148,9 +155,29 @@ mexFunction (int nout VL_UNUSED, mxArray * out[], int nin, const mxArray * in[])
 
   OUT(ENC) = mxCreateNumericMatrix (dimension * numClusters, 1, classID, mxREAL) ;
 
-  vl_vlad_encode (mxGetPr(OUT(ENC)), dataType,
-                  means, dimension, numClusters,
-                  data, numData,
-                  assignments,
-                  flags) ;
+  if (numAssignments > 0) {
+    /* convert the MATLAB 1-based indexes */
+    vl_uint32 const * matlabIndexes = assignments ;
+    vl_uindex i ;
+    indexes = vl_malloc(sizeof(vl_uint32) * numAssignments * numData) ;
+    for (i = 0 ; i < numAssignments * numData ; ++i) {
+      if (matlabIndexes[i] < 1 || matlabIndexes[i] > numClusters) {
+        vl_free(indexes) ;
+        vlmxError (vlmxErrInvalidArgument, "ASSIGNMENTS contains an index out of range.") ;
+      }
+      indexes[i] = matlabIndexes[i] - 1 ;
+    }
+    vl_vlad_encode_sparse (mxGetPr(OUT(ENC)), dataType,
+                           means, dimension, numClusters,
+                           data, numData,
+                           indexes, NULL, numAssignments,
+                           flags) ;
+    vl_free(indexes) ;
+  } else {
+    vl_vlad_encode (mxGetPr(OUT(ENC)), dataType,
+                    means, dimension, numClusters,
+                    data, numData,
+                    assignments,
+                    flags) ;
+  }
 }
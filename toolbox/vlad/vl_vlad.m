@@ -14,6 +14,13 @@
 %   representing the soft assignment of the corresponding vector in X
 %   to each of the clusters. It is of the same class as X.
 %
+%   Alternatively, ASSIGNMENTS can be a UINT32 matrix with as many
+%   columns as X, each containing the (1-based) indexes of the
+%   clusters to which the corresponding vector is assigned with unit
+%   weight, for example the output of VL_KMEANS(). This is equivalent
+%   to, but much faster than, passing the corresponding dense
+%   assignment matrix.
+%
 %   ENC is a vector of the same class of X of size equal to the
 %   product of the data dimension and the number of clusters.
 %
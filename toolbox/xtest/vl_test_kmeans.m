@@ -49,6 +49,13 @@ for dataType = dataTypes
                                               'NumTrees', 3, ...
                                               'MaxNumComparisons',0) ;
 
+    vl_twister('state',0) ;
+    [centers___, assignments___, en___] = vl_kmeans(X, 10, ...
+                                              'NumRepetitions', 1, ...
+                                              'MaxNumIterations', 10, ...
+                                              'Algorithm', 'Hamerly', ...
+                                              'Distance', distance) ;
+
     vl_assert_almost_equal(centers, centers_, 1e-5) ;
     vl_assert_almost_equal(assignments, assignments_, 1e-5) ;
     vl_assert_almost_equal(en, en_, 1e-4) ;
@@ -60,9 +67,39 @@ for dataType = dataTypes
     vl_assert_almost_equal(centers_, centers__, 1e-5) ;
     vl_assert_almost_equal(assignments_, assignments__, 1e-5) ;
     vl_assert_almost_equal(en_, en__, 1e-4) ;
+
+    vl_assert_almost_equal(centers, centers___, 1e-5) ;
+    vl_assert_almost_equal(assignments, assignments___, 1e-5) ;
+    vl_assert_almost_equal(en, en___, 1e-4) ;
   end
 end
 
+function test_initializations(s)
+for initialization = {'randsel', 'plusplus', 'scalableplusplus'}
+  [centers, assignments, en] = vl_kmeans(s.X, 10, ...
+                                         'NumRepetitions', 10, ...
+                                         'Initialization', char(initialization)) ;
+  [centers_, assignments_, en_] = simpleKMeans(s.X, 10) ;
+  assert(en_ <= 1.1 * en, 'vl_kmeans did not optimize enough') ;
+end
+
+function test_mini_batch(s)
+dataTypes = {'single','double'} ;
+for dataType = dataTypes
+  conversion = str2func(char(dataType)) ;
+  X = conversion(s.X) ;
+  vl_twister('state',0) ;
+  [centers, assignments, en] = vl_kmeans(X, 10, ...
+                                         'MaxNumIterations', 10, ...
+                                         'Algorithm', 'Lloyd') ;
+  vl_twister('state',0) ;
+  [centers_, assignments_, en_] = vl_kmeans(X, 10, ...
+                                            'MaxNumIterations', 50, ...
+                                            'MiniBatchSize', 20, ...
+                                            'Algorithm', 'MiniBatch') ;
+  assert(en_ <= 1.2 * en, 'mini-batch vl_kmeans did not optimize enough') ;
+end
+
 function test_patterns(s)
 distances = {'l1', 'l2'} ;
 dataTypes = {'single','double'} ;
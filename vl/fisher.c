@@ -154,6 +154,38 @@ In practice, several data to cluster assignments $q_{ik}$ are likely
 to be very small or even negligible. The *fast* version of the FV sets
 to zero all but the largest assignment for each input feature $\bx_i$.
 
+::vl_fisher_encode_sparse generalizes this idea by retaining the
+largest few assignments of each feature. Furthermore, it computes
+the assignments of a small block of features at a time and
+accumulates their contribution to the FV immediately, without storing
+the $K \times N$ matrix of all assignments. For a GMM with 256
+components, retaining the top five assignments is usually
+indistinguishable from the exact FV.
+
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+@section fisher-encoder Encoding many images
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+
+When many images are encoded with the same GMM, it is more efficient
+to create a ::VlFisherEncoder object once by ::vl_fisher_encoder_new.
+The object precomputes the quantities that depend only on the GMM
+(such as the inverse covariances and the log-determinants) and keeps
+its scratch buffers across calls. ::vl_fisher_encoder_encode_batch
+then encodes the descriptors of several images, stored one after the
+other, into the columns of a matrix, processing the images in
+parallel.
+
+Since the scratch buffers are shared by all the calls, an encoder must
+not be used by several threads at the same time. Rather than calling
+::vl_fisher_encoder_encode on the same encoder from concurrent
+threads (e.g. one per image), either pass all the images to
+::vl_fisher_encoder_encode_batch, or create one encoder per thread.
+
+Similarly, ::vl_fisher_encoder_encode_regions encodes the descriptors
+of several regions of the same image, such as the cells of a spatial
+pyramid, computing the posteriors of each descriptor only once
+(@ref pooling).
+
 <!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
 @page fisher-derivation Fisher vector derivation
 <!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
@@ -166,7 +198,10 @@ construction, an image is modeled as a collection of $D$-dimensional
 feature vectors $I=(\bx_1,\dots,\bx_n)$ generated by a GMM with $K$
 components $\Theta=(\mu_k,\Sigma_k,\pi_k:k=1,\dots,K)$. The covariance
 matrices are assumed to be diagonal, i.e. $\Sigma_k = \diag
-\bsigma_k^2$, $\bsigma_k \in \real^D_+$.
+\bsigma_k^2$, $\bsigma_k \in \real^D_+$. For a GMM with a full
+covariance shared by the modes (::VlGMMTied), the data and the means
+must be whitened first (see @ref gmm); the diagonals returned by
+::vl_gmm_get_covariances only approximate such a model.
 
 The generative model of *one* feature vector $\bx$ is given by the GMM
 density function:
@@ -353,13 +388,100 @@ kernel*:
 #include "fisher.h"
 #include "gmm.h"
 #include "mathop.h"
+#include "pooling.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef VL_DISABLE_SSE2
+#include "mathop_sse2.h"
+#endif
+
+#ifndef VL_FISHER_INSTANTIATING
+/* number of data vectors whose posteriors are computed at once */
+#define VL_FISHER_TILE_SIZE 64
+
+/* maximum number of elements of the integral image used for region
+   pooling (128 MB) */
+#define VL_FISHER_MAX_INTEGRAL_SIZE (1 << 24)
+
+struct _VlFisherEncoder
+{
+  vl_type dataType ;                 /**< Data type. */
+  vl_size dimension ;                /**< Data dimensionality. */
+  vl_size numClusters ;              /**< Number of GMM modes. */
+  vl_size numPosteriors ;            /**< Number of posteriors retained per vector. */
+  void * means ;                     /**< GMM means. */
+  void * priors ;                    /**< GMM priors. */
+  void * invSigma ;                  /**< Inverse GMM covariances. */
+  void * sqrtInvSigma ;              /**< Square root of the inverse covariances. */
+  void * logWeights ;                /**< Log-prior minus half the log-determinant of each mode. */
+  vl_size scratchSize ;              /**< Size of a per-thread scratch block (elements). */
+  vl_size numScratches ;             /**< Number of allocated scratch blocks. */
+  void * scratch ;                   /**< Per-thread statistics and posteriors. */
+  vl_uint32 * topIndexes ;           /**< Per-thread indexes of the largest posteriors of a tile. */
+} ;
+
+/* Make sure that there is a scratch block for each thread and return
+   the number of threads. */
+static vl_size
+_vl_fisher_encoder_reserve (VlFisherEncoder * self)
+{
+  vl_size numThreads = 1 ;
+#if defined(_OPENMP)
+  numThreads = vl_get_max_threads() ;
+#endif
+  if (self->numScratches < numThreads) {
+    vl_free(self->scratch) ;
+    vl_free(self->topIndexes) ;
+    self->scratch = vl_malloc(vl_get_type_size(self->dataType) *
+                              self->scratchSize * numThreads) ;
+    self->topIndexes = vl_malloc(sizeof(vl_uint32) * self->numClusters *
+                                 VL_FISHER_TILE_SIZE * numThreads) ;
+    self->numScratches = numThreads ;
+  }
+  return numThreads ;
+}
+#endif
+
 #ifdef VL_FISHER_INSTANTIATING
 
+static void
+VL_XCAT(_vl_fisher_normalize_, SFX)
+(TYPE * enc, vl_size size, int flags)
+{
+  vl_uindex dim ;
+
+  if (flags & VL_FISHER_FLAG_SQUARE_ROOT) {
+    for(dim = 0; dim < size ; dim++) {
+      TYPE z = enc [dim] ;
+      if (z >= 0) {
+        enc[dim] = VL_XCAT(vl_sqrt_, SFX)(z) ;
+      } else {
+        enc[dim] = - VL_XCAT(vl_sqrt_, SFX)(- z) ;
+      }
+    }
+  }
+
+  if (flags & VL_FISHER_FLAG_NORMALIZED) {
+    TYPE n = 0 ;
+    for(dim = 0 ; dim < size ; dim++) {
+      TYPE z = enc [dim] ;
+      n += z * z ;
+    }
+    n = VL_XCAT(vl_sqrt_, SFX)(n) ;
+    n = VL_MAX(n, 1e-12) ;
+    for(dim = 0 ; dim < size ; dim++) {
+      enc[dim] /= n ;
+    }
+  }
+}
+
 static vl_size
 VL_XCAT(_vl_fisher_encode_, SFX)
 (TYPE * enc,
@@ -460,30 +582,524 @@ VL_XCAT(_vl_fisher_encode_, SFX)
   vl_free(posteriors);
   vl_free(sqrtInvSigma) ;
 
-  if (flags & VL_FISHER_FLAG_SQUARE_ROOT) {
-    for(dim = 0; dim < 2 * dimension * numClusters ; dim++) {
-      TYPE z = enc [dim] ;
-      if (z >= 0) {
-        enc[dim] = VL_XCAT(vl_sqrt_, SFX)(z) ;
-      } else {
-        enc[dim] = - VL_XCAT(vl_sqrt_, SFX)(- z) ;
+  VL_XCAT(_vl_fisher_normalize_, SFX)(enc, 2 * dimension * numClusters, flags) ;
+
+  return numTerms ;
+}
+
+static void
+VL_XCAT(_vl_fisher_encoder_init_, SFX)
+(VlFisherEncoder * self, TYPE const * covariances)
+{
+  vl_uindex i_cl, dim ;
+  vl_size dimension = self->dimension ;
+  TYPE const * priors = self->priors ;
+  TYPE * invSigma = self->invSigma ;
+  TYPE * sqrtInvSigma = self->sqrtInvSigma ;
+  TYPE * logWeights = self->logWeights ;
+
+  for (i_cl = 0 ; i_cl < self->numClusters ; ++i_cl) {
+    double logSigma = 0 ;
+    for(dim = 0; dim < dimension; dim++) {
+      TYPE sigma = covariances[i_cl*dimension + dim] ;
+      invSigma[i_cl*dimension + dim] = (TYPE) 1.0 / sigma ;
+      sqrtInvSigma[i_cl*dimension + dim] = sqrt(1.0 / sigma) ;
+      logSigma += log(sigma) ;
+    }
+    /* see the dense encoder for why modes with a tiny prior are skipped */
+    if (priors[i_cl] < 1e-6) {
+      logWeights[i_cl] = - (TYPE) VL_INFINITY_D ;
+    } else {
+      logWeights[i_cl] = log(priors[i_cl]) - 0.5 * logSigma ;
+    }
+  }
+}
+
+/* Compute the largest posteriors of a tile of at most
+   VL_FISHER_TILE_SIZE vectors. For each vector, topIndex and topValue
+   receive the modes and posteriors, in no particular order. logDensity
+   is a scratch buffer. */
+static void
+VL_XCAT(_vl_fisher_get_posteriors_, SFX)
+(VlFisherEncoder const * self,
+ vl_uint32 * topIndex,
+ TYPE * topValue,
+ TYPE * logDensity,
+ TYPE const * data, vl_size numData,
+ int flags)
+{
+  vl_size dimension = self->dimension ;
+  vl_size numClusters = self->numClusters ;
+  vl_size numPosteriors = (flags & VL_FISHER_FLAG_FAST) ? 1 : self->numPosteriors ;
+  vl_uindex i_d, i_cl, k ;
+  TYPE const * means = self->means ;
+  TYPE const * invSigma = self->invSigma ;
+  TYPE const * logWeights = self->logWeights ;
+
+#if (FLT == VL_TYPE_FLOAT)
+  VlFloatVector3ComparisonFunction distFn = vl_get_vector_3_comparison_function_f(VlDistanceMahalanobis) ;
+#else
+  VlDoubleVector3ComparisonFunction distFn = vl_get_vector_3_comparison_function_d(VlDistanceMahalanobis) ;
+#endif
+
+  /* log-densities of the tile, up to a common constant, visiting
+     each mode once */
+  for (i_cl = 0 ; i_cl < numClusters ; ++i_cl) {
+    for (i_d = 0 ; i_d < numData ; ++i_d) {
+      logDensity[i_d * numClusters + i_cl] = logWeights[i_cl] - 0.5 *
+      distFn (dimension,
+              data + i_d * dimension,
+              means + i_cl * dimension,
+              invSigma + i_cl * dimension) ;
+    }
+  }
+
+  for (i_d = 0 ; i_d < numData ; ++i_d) {
+    TYPE const * logp = logDensity + i_d * numClusters ;
+    vl_uint32 * index = topIndex + i_d * numPosteriors ;
+    TYPE * value = topValue + i_d * numPosteriors ;
+    TYPE maxLogp ;
+    TYPE sum = 0 ;
+    vl_size numTop = 0 ;
+
+    if (numPosteriors == numClusters) {
+      /* all the modes are retained (the default) */
+      for (i_cl = 0 ; i_cl < numClusters ; ++i_cl) {
+        value[i_cl] = logp[i_cl] ;
+        index[i_cl] = (vl_uint32)i_cl ;
+      }
+      numTop = numClusters ;
+    } else {
+      /* keep the largest posteriors in a heap with the smallest on top */
+      for (i_cl = 0 ; i_cl < numClusters ; ++i_cl) {
+        TYPE v = logp[i_cl] ;
+        if (numTop < numPosteriors) {
+          k = numTop ++ ;
+          while (k > 0 && value[(k - 1) / 2] > v) {
+            value[k] = value[(k - 1) / 2] ;
+            index[k] = index[(k - 1) / 2] ;
+            k = (k - 1) / 2 ;
+          }
+        } else if (v > value[0]) {
+          k = 0 ;
+          while (2 * k + 1 < numTop) {
+            vl_uindex child = 2 * k + 1 ;
+            if (child + 1 < numTop && value[child + 1] < value[child]) child ++ ;
+            if (value[child] >= v) break ;
+            value[k] = value[child] ;
+            index[k] = index[child] ;
+            k = child ;
+          }
+        } else {
+          continue ;
+        }
+        value[k] = v ;
+        index[k] = (vl_uint32)i_cl ;
+      }
+    }
+    maxLogp = value[0] ;
+    for (k = 1 ; k < numTop ; ++k) {
+      maxLogp = VL_MAX(maxLogp, value[k]) ;
+    }
+    if (maxLogp == (TYPE)(- VL_INFINITY_D)) {
+      memset(value, 0, sizeof(TYPE) * numPosteriors) ;
+      continue ;
+    }
+
+    /* the normalization uses all the modes, not just the top ones */
+    if (flags & VL_FISHER_FLAG_FAST) {
+      value[0] = 1 ;
+    } else {
+      vl_bool calculated = VL_FALSE ;
+#if (FLT == VL_TYPE_FLOAT) && ! defined(VL_DISABLE_SSE2)
+      if (vl_get_simd_enabled() && vl_cpu_has_sse2()) {
+        sum = exp(_vl_log_sum_exp_sse2_f (numClusters, NULL, logp) - maxLogp) ;
+        calculated = VL_TRUE ;
+      }
+#endif
+      if (!calculated) {
+        for (i_cl = 0 ; i_cl < numClusters ; ++i_cl) {
+          sum += exp(logp[i_cl] - maxLogp) ;
+        }
+      }
+      for (k = 0 ; k < numTop ; ++k) {
+        value[k] = exp(value[k] - maxLogp) / sum ;
       }
     }
   }
+}
 
-  if (flags & VL_FISHER_FLAG_NORMALIZED) {
-    TYPE n = 0 ;
-    for(dim = 0 ; dim < 2 * dimension * numClusters ; dim++) {
-      TYPE z = enc [dim] ;
-      n += z * z ;
+/* Add the first and second order statistics and the mass of the
+   modes of a vector to acc, given its largest posteriors. */
+static vl_size
+VL_XCAT(_vl_fisher_add_, SFX)
+(VlFisherEncoder const * self,
+ TYPE * acc,
+ TYPE const * x,
+ vl_uint32 const * topIndex,
+ TYPE const * topValue,
+ vl_size numTop)
+{
+  vl_size dimension = self->dimension ;
+  vl_size numClusters = self->numClusters ;
+  vl_size numTerms = 0 ;
+  vl_uindex k, dim ;
+
+  for (k = 0 ; k < numTop ; ++k) {
+    TYPE p = topValue[k] ;
+    vl_uindex cl = topIndex[k] ;
+    TYPE * uk = acc + cl * dimension ;
+    TYPE * vk = acc + (numClusters + cl) * dimension ;
+    TYPE const * mu = (TYPE const *)self->means + cl * dimension ;
+    TYPE const * s = (TYPE const *)self->sqrtInvSigma + cl * dimension ;
+    vl_bool calculated = VL_FALSE ;
+
+    if (p < 1e-6) continue ;
+    numTerms += 1 ;
+    acc[2 * numClusters * dimension + cl] += p ;
+
+#ifndef VL_DISABLE_SSE2
+    if (vl_get_simd_enabled() && vl_cpu_has_sse2()) {
+      VL_XCAT(_vl_weighted_whitened_moments_sse2_, SFX)
+      (dimension, uk, vk, x, mu, s, p) ;
+      calculated = VL_TRUE ;
     }
-    n = VL_XCAT(vl_sqrt_, SFX)(n) ;
-    n = VL_MAX(n, 1e-12) ;
-    for(dim = 0 ; dim < 2 * dimension * numClusters ; dim++) {
-      enc[dim] /= n ;
+#endif
+    if (!calculated) {
+      for (dim = 0 ; dim < dimension ; ++dim) {
+        TYPE diff = (x[dim] - mu[dim]) * s[dim] ;
+        uk[dim] += p * diff ;
+        vk[dim] += p * diff * diff ;
+      }
+    }
+  }
+  return numTerms ;
+}
+
+/* Accumulate the first and second order statistics and the mass of
+   the modes for a set of vectors into a scratch block. */
+static vl_size
+VL_XCAT(_vl_fisher_accumulate_, SFX)
+(VlFisherEncoder const * self,
+ TYPE * scratch,
+ vl_uint32 * topIndex,
+ TYPE const * data, vl_size numData,
+ int flags)
+{
+  vl_size dimension = self->dimension ;
+  vl_size numClusters = self->numClusters ;
+  vl_size numPosteriors = (flags & VL_FISHER_FLAG_FAST) ? 1 : self->numPosteriors ;
+  vl_size numTerms = 0 ;
+  vl_uindex begin, i_d ;
+  TYPE * acc = scratch ;
+  TYPE * logDensity = acc + (2 * dimension + 1) * numClusters ;
+  TYPE * topValue = logDensity + numClusters * VL_FISHER_TILE_SIZE ;
+
+  for (begin = 0 ; begin < numData ; begin += VL_FISHER_TILE_SIZE) {
+    vl_size tileSize = VL_MIN(VL_FISHER_TILE_SIZE, numData - begin) ;
+    VL_XCAT(_vl_fisher_get_posteriors_, SFX)
+    (self, topIndex, topValue, logDensity,
+     data + begin * dimension, tileSize, flags) ;
+    for (i_d = 0 ; i_d < tileSize ; ++i_d) {
+      numTerms += VL_XCAT(_vl_fisher_add_, SFX)
+      (self, acc, data + (begin + i_d) * dimension,
+       topIndex + i_d * numPosteriors,
+       topValue + i_d * numPosteriors,
+       numPosteriors) ;
+    }
+  }
+  return numTerms ;
+}
+
+/* Compute the Fisher vector from the accumulated statistics. */
+static void
+VL_XCAT(_vl_fisher_finalize_, SFX)
+(VlFisherEncoder const * self,
+ TYPE * enc,
+ TYPE const * acc,
+ vl_size numData,
+ int flags)
+{
+  vl_size dimension = self->dimension ;
+  vl_size numClusters = self->numClusters ;
+  TYPE const * priors = self->priors ;
+  vl_uindex i_cl, dim ;
+
+  for (i_cl = 0 ; i_cl < numClusters ; ++i_cl) {
+    TYPE * uk = enc + i_cl*dimension ;
+    TYPE * vk = enc + i_cl*dimension + numClusters * dimension ;
+    TYPE const * ua = acc + i_cl*dimension ;
+    TYPE const * va = acc + i_cl*dimension + numClusters * dimension ;
+    TYPE mass = acc[2 * dimension * numClusters + i_cl] ;
+    if (priors[i_cl] < 1e-6 || numData == 0) {
+      memset(uk, 0, sizeof(TYPE) * dimension) ;
+      memset(vk, 0, sizeof(TYPE) * dimension) ;
+    } else {
+      TYPE uprefix = 1/(numData*sqrt(priors[i_cl]));
+      TYPE vprefix = 1/(numData*sqrt(2*priors[i_cl]));
+      for(dim = 0; dim < dimension; dim++) {
+        uk[dim] = ua[dim] * uprefix ;
+        vk[dim] = (va[dim] - mass) * vprefix ;
+      }
     }
   }
 
+  VL_XCAT(_vl_fisher_normalize_, SFX)(enc, 2 * dimension * numClusters, flags) ;
+}
+
+static vl_size
+VL_XCAT(_vl_fisher_encoder_encode_, SFX)
+(VlFisherEncoder * self,
+ TYPE * enc,
+ TYPE const * data, vl_size numData,
+ int flags)
+{
+  vl_size numTerms = 0 ;
+  vl_size numTiles = (numData + VL_FISHER_TILE_SIZE - 1) / VL_FISHER_TILE_SIZE ;
+  vl_size accSize = (2 * self->dimension + 1) * self->numClusters ;
+  vl_size numThreads = _vl_fisher_encoder_reserve (self) ;
+  vl_size teamSize = 1 ;
+  TYPE * scratch = self->scratch ;
+  vl_index t ;
+  vl_uindex e ;
+
+#if defined(_OPENMP)
+#pragma omp parallel default(shared) private(t) num_threads(numThreads) reduction(+:numTerms)
+#endif
+  {
+    vl_uindex thread = 0 ;
+#if defined(_OPENMP)
+    thread = omp_get_thread_num() ;
+    /* the team may be smaller than requested, e.g. when nested */
+    if (thread == 0) teamSize = omp_get_num_threads() ;
+#endif
+    memset(scratch + thread * self->scratchSize, 0, sizeof(TYPE) * accSize) ;
+
+#if defined(_OPENMP)
+#pragma omp for schedule(static)
+#endif
+    for (t = 0 ; t < (signed)numTiles ; ++t) {
+      vl_uindex begin = t * VL_FISHER_TILE_SIZE ;
+      numTerms += VL_XCAT(_vl_fisher_accumulate_, SFX)
+      (self,
+       scratch + thread * self->scratchSize,
+       self->topIndexes + thread * self->numClusters * VL_FISHER_TILE_SIZE,
+       data + begin * self->dimension,
+       VL_MIN(VL_FISHER_TILE_SIZE, numData - begin),
+       flags) ;
+    }
+  }
+
+  /* sum the per-thread statistics in a fixed order; only the blocks
+     of the threads that actually ran were cleared */
+  for (t = 1 ; t < (signed)teamSize ; ++t) {
+    TYPE const * acc = scratch + t * self->scratchSize ;
+    for (e = 0 ; e < accSize ; ++e) {
+      scratch[e] += acc[e] ;
+    }
+  }
+
+  VL_XCAT(_vl_fisher_finalize_, SFX)(self, enc, scratch, numData, flags) ;
+  return numTerms ;
+}
+
+static vl_size
+VL_XCAT(_vl_fisher_encoder_encode_batch_, SFX)
+(VlFisherEncoder * self,
+ TYPE * enc,
+ TYPE const * data, vl_size const * numData, vl_size numImages,
+ int flags)
+{
+  vl_size numTerms = 0 ;
+  vl_size accSize = (2 * self->dimension + 1) * self->numClusters ;
+  vl_size numThreads = _vl_fisher_encoder_reserve (self) ;
+  vl_uindex * offsets = vl_malloc(sizeof(vl_uindex) * (numImages + 1)) ;
+  vl_index i ;
+
+  offsets[0] = 0 ;
+  for (i = 0 ; i < (signed)numImages ; ++i) {
+    offsets[i + 1] = offsets[i] + numData[i] ;
+  }
+
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(i) num_threads(numThreads) \
+  schedule(dynamic) reduction(+:numTerms)
+#endif
+  for (i = 0 ; i < (signed)numImages ; ++i) {
+    vl_uindex thread = 0 ;
+    TYPE * scratch ;
+#if defined(_OPENMP)
+    thread = omp_get_thread_num() ;
+#endif
+    scratch = (TYPE*)self->scratch + thread * self->scratchSize ;
+    memset(scratch, 0, sizeof(TYPE) * accSize) ;
+    numTerms += VL_XCAT(_vl_fisher_accumulate_, SFX)
+    (self, scratch, self->topIndexes + thread * self->numClusters * VL_FISHER_TILE_SIZE,
+     data + offsets[i] * self->dimension, numData[i], flags) ;
+    VL_XCAT(_vl_fisher_finalize_, SFX)
+    (self, enc + i * 2 * self->dimension * self->numClusters,
+     scratch, numData[i], flags) ;
+  }
+
+  vl_free(offsets) ;
+  return numTerms ;
+}
+
+static vl_size
+VL_XCAT(_vl_fisher_encoder_encode_regions_, SFX)
+(VlFisherEncoder * self,
+ TYPE * enc,
+ TYPE const * data, vl_size numData,
+ VlPoolingGrid const * grid,
+ int flags)
+{
+  vl_size dimension = self->dimension ;
+  vl_size numClusters = self->numClusters ;
+  vl_size numPosteriors = (flags & VL_FISHER_FLAG_FAST) ? 1 : self->numPosteriors ;
+  vl_size numRegions = grid->numRegions ;
+  vl_size accSize = (2 * dimension + 1) * numClusters ;
+  vl_size encSize = 2 * dimension * numClusters ;
+  vl_size numTiles = (numData + VL_FISHER_TILE_SIZE - 1) / VL_FISHER_TILE_SIZE ;
+  vl_size numThreads = _vl_fisher_encoder_reserve (self) ;
+  vl_size tableWidth = grid->numCellsX + 1 ;
+  vl_size tableSize = tableWidth * (grid->numCellsY + 1) ;
+  vl_size entrySize = accSize + 2 ;
+  vl_size numTerms = 0 ;
+  vl_uint32 * allIndexes = vl_malloc(sizeof(vl_uint32) * VL_MAX(numData * numPosteriors, 1)) ;
+  TYPE * allValues = vl_malloc(sizeof(TYPE) * VL_MAX(numData * numPosteriors, 1)) ;
+  vl_index t, r ;
+
+  /* compute the posteriors once */
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(t) num_threads(numThreads)
+#endif
+  for (t = 0 ; t < (signed)numTiles ; ++t) {
+    vl_uindex thread = 0 ;
+    vl_uindex begin = t * VL_FISHER_TILE_SIZE ;
+#if defined(_OPENMP)
+    thread = omp_get_thread_num() ;
+#endif
+    VL_XCAT(_vl_fisher_get_posteriors_, SFX)
+    (self, allIndexes + begin * numPosteriors, allValues + begin * numPosteriors,
+     (TYPE*)self->scratch + thread * self->scratchSize + accSize,
+     data + begin * dimension, VL_MIN(VL_FISHER_TILE_SIZE, numData - begin), flags) ;
+  }
+
+  if (tableSize > numRegions || tableSize * entrySize > VL_FISHER_MAX_INTEGRAL_SIZE) {
+    /* pool the vectors of each region directly */
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(r) num_threads(numThreads) \
+  schedule(dynamic) reduction(+:numTerms)
+#endif
+    for (r = 0 ; r < (signed)numRegions ; ++r) {
+      vl_uindex thread = 0 ;
+      vl_uindex const * block = grid->regionCells + 4 * r ;
+      vl_size count = 0 ;
+      vl_uindex cx, cy, o ;
+      TYPE * acc ;
+#if defined(_OPENMP)
+      thread = omp_get_thread_num() ;
+#endif
+      acc = (TYPE*)self->scratch + thread * self->scratchSize ;
+      memset(acc, 0, sizeof(TYPE) * accSize) ;
+      for (cy = block[1] ; cy < block[3] ; ++cy) {
+        for (cx = block[0] ; cx < block[2] ; ++cx) {
+          for (o = vl_pooling_grid_get_cell_begin(grid, cx, cy) ;
+               o < vl_pooling_grid_get_cell_end(grid, cx, cy) ; ++o) {
+            vl_uindex i = grid->order[o] ;
+            numTerms += VL_XCAT(_vl_fisher_add_, SFX)
+            (self, acc, data + i * dimension,
+             allIndexes + i * numPosteriors, allValues + i * numPosteriors,
+             numPosteriors) ;
+            count ++ ;
+          }
+        }
+      }
+      VL_XCAT(_vl_fisher_finalize_, SFX)(self, enc + r * encSize, acc, count, flags) ;
+    }
+  } else {
+    /* integral image of the cell statistics; the last two entries
+       count the vectors and the averaging operations */
+    double * table = vl_calloc(tableSize * entrySize, sizeof(double)) ;
+    vl_index c ;
+    vl_uindex e ;
+
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(c,e) num_threads(numThreads) schedule(dynamic)
+#endif
+    for (c = 0 ; c < (signed)vl_pooling_grid_get_num_cells(grid) ; ++c) {
+      vl_uindex thread = 0 ;
+      vl_uindex cx = c % grid->numCellsX ;
+      vl_uindex cy = c / grid->numCellsX ;
+      double * entry = table + ((cy + 1) * tableWidth + cx + 1) * entrySize ;
+      vl_uindex o ;
+      TYPE * acc ;
+#if defined(_OPENMP)
+      thread = omp_get_thread_num() ;
+#endif
+      acc = (TYPE*)self->scratch + thread * self->scratchSize ;
+      memset(acc, 0, sizeof(TYPE) * accSize) ;
+      for (o = vl_pooling_grid_get_cell_begin(grid, cx, cy) ;
+           o < vl_pooling_grid_get_cell_end(grid, cx, cy) ; ++o) {
+        vl_uindex i = grid->order[o] ;
+        entry[accSize + 1] += VL_XCAT(_vl_fisher_add_, SFX)
+        (self, acc, data + i * dimension,
+         allIndexes + i * numPosteriors, allValues + i * numPosteriors,
+         numPosteriors) ;
+        entry[accSize] += 1 ;
+      }
+      for (e = 0 ; e < accSize ; ++e) entry[e] = acc[e] ;
+    }
+
+    /* cumulate along the rows and then along the columns */
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(c,e) num_threads(numThreads)
+#endif
+    for (c = 1 ; c < (signed)(grid->numCellsY + 1) ; ++c) {
+      vl_uindex cx ;
+      for (cx = 1 ; cx < tableWidth ; ++cx) {
+        double * entry = table + (c * tableWidth + cx) * entrySize ;
+        for (e = 0 ; e < entrySize ; ++e) entry[e] += entry[e - entrySize] ;
+      }
+    }
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(c,e) num_threads(numThreads)
+#endif
+    for (c = 1 ; c < (signed)tableWidth ; ++c) {
+      vl_uindex cy ;
+      for (cy = 1 ; cy < grid->numCellsY + 1 ; ++cy) {
+        double * entry = table + (cy * tableWidth + c) * entrySize ;
+        for (e = 0 ; e < entrySize ; ++e) entry[e] += entry[e - tableWidth * entrySize] ;
+      }
+    }
+
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(r,e) num_threads(numThreads) \
+  reduction(+:numTerms)
+#endif
+    for (r = 0 ; r < (signed)numRegions ; ++r) {
+      vl_uindex thread = 0 ;
+      vl_uindex const * block = grid->regionCells + 4 * r ;
+      double const * a = table + (block[1] * tableWidth + block[0]) * entrySize ;
+      double const * b = table + (block[1] * tableWidth + block[2]) * entrySize ;
+      double const * d = table + (block[3] * tableWidth + block[0]) * entrySize ;
+      double const * f = table + (block[3] * tableWidth + block[2]) * entrySize ;
+      TYPE * acc ;
+#if defined(_OPENMP)
+      thread = omp_get_thread_num() ;
+#endif
+      acc = (TYPE*)self->scratch + thread * self->scratchSize ;
+      for (e = 0 ; e < accSize ; ++e) acc[e] = (TYPE) ((f[e] - b[e]) - (d[e] - a[e])) ;
+      numTerms += (vl_size) ((f[accSize + 1] - b[accSize + 1]) - (d[accSize + 1] - a[accSize + 1]) + 0.5) ;
+      VL_XCAT(_vl_fisher_finalize_, SFX)
+      (self, enc + r * encSize, acc,
+       (vl_size) ((f[accSize] - b[accSize]) - (d[accSize] - a[accSize]) + 0.5), flags) ;
+    }
+    vl_free(table) ;
+  }
+
+  vl_free(allIndexes) ;
+  vl_free(allValues) ;
   return numTerms ;
 }
 
@@ -524,7 +1140,9 @@ VL_XCAT(_vl_fisher_encode_, SFX)
  ** @return number of averaging operations.
  **
  ** @a means and @a covariances have @a dimension rows and @a
- ** numCluster columns.  @a priors is a vector of size @a
+ ** numCluster columns. The covariances are diagonal; a GMM with
+ ** tied covariances must be whitened first (@ref fisher-derivation).
+ ** @a priors is a vector of size @a
  ** numCluster. @a data has @a dimension rows and @a numData
  ** columns. @a enc is a vecotr of size equal to twice the product of
  ** @a dimension and @a numClusters. All these vectors and matrices
@@ -542,6 +1160,12 @@ VL_XCAT(_vl_fisher_encode_, SFX)
  ** the ::VL_FISHER_FLAG_FAST, is equal to the number of input
  ** features. This information can be used for diagnostic purposes.
  **
+ ** The posteriors are computed by ::vl_get_gmm_data_posteriors_f or
+ ** ::vl_get_gmm_data_posteriors_d. For single precision data they
+ ** therefore use the approximated exponential of @ref gmm-fast-exp
+ ** (relative error below 2e-7) unless SIMD is disabled with
+ ** ::vl_set_simd_enabled.
+ **
  ** @sa @ref fisher
  **/
 
@@ -577,6 +1201,289 @@ vl_fisher_encode
       abort();
   }
 }
+/** @brief Fisher vector encoding with sparse posteriors.
+ ** @param dataType the type of the input data (::VL_TYPE_DOUBLE or ::VL_TYPE_FLOAT).
+ ** @param enc Fisher vector (output).
+ ** @param means Gaussian mixture means.
+ ** @param dimension dimension of the data.
+ ** @param numClusters number of Gaussians mixture components.
+ ** @param covariances Gaussian mixture diagonal covariances.
+ ** @param priors Gaussian mixture prior probabilities.
+ ** @param data vectors to encode.
+ ** @param numData number of vectors to encode.
+ ** @param numPosteriors number of posteriors retained for each vector.
+ ** @param flags options.
+ ** @return number of averaging operations.
+ **
+ ** The function is similar to ::vl_fisher_encode, but only the @a
+ ** numPosteriors largest posteriors of each vector are used to
+ ** accumulate the Fisher vector statistics (@ref fisher-fast). The
+ ** posteriors are computed for blocks of data vectors and used
+ ** immediately, so that the matrix of all the posteriors is never
+ ** stored, and the statistics are accumulated using SIMD
+ ** instructions if available. The retained posteriors are
+ ** normalized with respect to all the modes, so that the result
+ ** matches ::vl_fisher_encode up to the dropped terms.
+ ** ::VL_FISHER_FLAG_FAST is equivalent to setting @a numPosteriors
+ ** to one. The normalization of the posteriors uses the same
+ ** approximated exponential as ::vl_fisher_encode.
+ **
+ ** Arguments and the return value are otherwise the same as for
+ ** ::vl_fisher_encode.
+ **
+ ** @sa @ref fisher
+ **/
+
+VL_EXPORT vl_size
+vl_fisher_encode_sparse
+(void * enc, vl_type dataType,
+ void const * means, vl_size dimension, vl_size numClusters,
+ void const * covariances,
+ void const * priors,
+ void const * data,  vl_size numData,
+ vl_size numPosteriors,
+ int flags
+)
+{
+  vl_size numTerms ;
+  VlFisherEncoder * encoder = vl_fisher_encoder_new (dataType, means, dimension, numClusters,
+                                                      covariances, priors) ;
+  vl_fisher_encoder_set_num_posteriors (encoder, numPosteriors) ;
+  numTerms = vl_fisher_encoder_encode (encoder, enc, data, numData, flags) ;
+  vl_fisher_encoder_delete (encoder) ;
+  return numTerms ;
+}
+
+/* ---------------------------------------------------------------- */
+/*                                                   Encoder object */
+/* ---------------------------------------------------------------- */
+
+/** @brief Create a new Fisher vector encoder
+ ** @param dataType the type of the data (::VL_TYPE_DOUBLE or ::VL_TYPE_FLOAT).
+ ** @param means Gaussian mixture means.
+ ** @param dimension dimension of the data.
+ ** @param numClusters number of Gaussians mixture components.
+ ** @param covariances Gaussian mixture diagonal covariances.
+ ** @param priors Gaussian mixture prior probabilities.
+ ** @return new encoder.
+ **
+ ** The encoder copies the GMM parameters and precomputes the
+ ** quantities that depend only on them (@ref fisher-encoder). The
+ ** parameters have the same format as for ::vl_fisher_encode. By
+ ** default, the encoder retains all the posteriors, which can be
+ ** changed by ::vl_fisher_encoder_set_num_posteriors.
+ **
+ ** The encoder keeps its scratch buffers across calls, so it must
+ ** not be used by concurrent callers: use one encoder per thread, or
+ ** ::vl_fisher_encoder_encode_batch.
+ **/
+
+VL_EXPORT VlFisherEncoder *
+vl_fisher_encoder_new (vl_type dataType,
+                       void const * means, vl_size dimension, vl_size numClusters,
+                       void const * covariances,
+                       void const * priors)
+{
+  vl_size size = vl_get_type_size(dataType) ;
+  VlFisherEncoder * self = vl_calloc(1, sizeof(VlFisherEncoder)) ;
+
+  assert(numClusters >= 1) ;
+  assert(dimension >= 1) ;
+
+  self->dataType = dataType ;
+  self->dimension = dimension ;
+  self->numClusters = numClusters ;
+  self->numPosteriors = numClusters ;
+  self->means = vl_malloc(size * dimension * numClusters) ;
+  self->priors = vl_malloc(size * numClusters) ;
+  self->invSigma = vl_malloc(size * dimension * numClusters) ;
+  self->sqrtInvSigma = vl_malloc(size * dimension * numClusters) ;
+  self->logWeights = vl_malloc(size * numClusters) ;
+  self->scratchSize = (2 * dimension + 1) * numClusters +
+    2 * numClusters * VL_FISHER_TILE_SIZE ;
+  self->numScratches = 0 ;
+  self->scratch = NULL ;
+  self->topIndexes = NULL ;
+
+  memcpy(self->means, means, size * dimension * numClusters) ;
+  memcpy(self->priors, priors, size * numClusters) ;
+
+  switch (dataType) {
+    case VL_TYPE_FLOAT:
+      _vl_fisher_encoder_init_f (self, (float const *) covariances) ;
+      break ;
+    case VL_TYPE_DOUBLE:
+      _vl_fisher_encoder_init_d (self, (double const *) covariances) ;
+      break ;
+    default:
+      abort() ;
+  }
+  return self ;
+}
+
+/** @brief Delete a Fisher vector encoder
+ ** @param self encoder.
+ **/
+
+VL_EXPORT void
+vl_fisher_encoder_delete (VlFisherEncoder * self)
+{
+  vl_free(self->means) ;
+  vl_free(self->priors) ;
+  vl_free(self->invSigma) ;
+  vl_free(self->sqrtInvSigma) ;
+  vl_free(self->logWeights) ;
+  if (self->scratch) vl_free(self->scratch) ;
+  if (self->topIndexes) vl_free(self->topIndexes) ;
+  vl_free(self) ;
+}
+
+/** @brief Get the number of posteriors retained for each vector
+ ** @param self encoder.
+ ** @return number of posteriors.
+ **/
+
+VL_EXPORT vl_size
+vl_fisher_encoder_get_num_posteriors (VlFisherEncoder const * self)
+{
+  return self->numPosteriors ;
+}
+
+/** @brief Set the number of posteriors retained for each vector
+ ** @param self encoder.
+ ** @param numPosteriors number of posteriors.
+ **
+ ** @a numPosteriors is clamped to the range from one to the number of
+ ** modes. See ::vl_fisher_encode_sparse.
+ **/
+
+VL_EXPORT void
+vl_fisher_encoder_set_num_posteriors (VlFisherEncoder * self, vl_size numPosteriors)
+{
+  self->numPosteriors = VL_MAX(VL_MIN(numPosteriors, self->numClusters), 1) ;
+}
+
+/** @brief Encode a set of vectors
+ ** @param self encoder.
+ ** @param enc Fisher vector (output).
+ ** @param data vectors to encode.
+ ** @param numData number of vectors to encode.
+ ** @param flags options.
+ ** @return number of averaging operations.
+ **
+ ** The function is equivalent to ::vl_fisher_encode_sparse with the
+ ** GMM and the number of posteriors of the encoder. The vectors are
+ ** processed in parallel.
+ **/
+
+VL_EXPORT vl_size
+vl_fisher_encoder_encode (VlFisherEncoder * self,
+                          void * enc,
+                          void const * data, vl_size numData,
+                          int flags)
+{
+  switch (self->dataType) {
+    case VL_TYPE_FLOAT:
+      return _vl_fisher_encoder_encode_f
+      (self, (float *) enc, (float const *) data, numData, flags) ;
+    case VL_TYPE_DOUBLE:
+      return _vl_fisher_encoder_encode_d
+      (self, (double *) enc, (double const *) data, numData, flags) ;
+    default:
+      abort() ;
+  }
+}
+
+/** @brief Encode several sets of vectors
+ ** @param self encoder.
+ ** @param enc Fisher vectors (output).
+ ** @param data vectors to encode.
+ ** @param numData number of vectors in each set.
+ ** @param numImages number of sets.
+ ** @param flags options.
+ ** @return total number of averaging operations.
+ **
+ ** @a data contains the vectors of the @a numImages sets one after
+ ** the other, and @a numData[i] is the number of vectors of the
+ ** @a i-th set (which can be zero). @a enc is a matrix with
+ ** @a numImages columns of size twice the product of the data
+ ** dimension and the number of modes, each receiving the Fisher
+ ** vector of one set. The sets are encoded in parallel.
+ **/
+
+VL_EXPORT vl_size
+vl_fisher_encoder_encode_batch (VlFisherEncoder * self,
+                                void * enc,
+                                void const * data,
+                                vl_size const * numData,
+                                vl_size numImages,
+                                int flags)
+{
+  switch (self->dataType) {
+    case VL_TYPE_FLOAT:
+      return _vl_fisher_encoder_encode_batch_f
+      (self, (float *) enc, (float const *) data, numData, numImages, flags) ;
+    case VL_TYPE_DOUBLE:
+      return _vl_fisher_encoder_encode_batch_d
+      (self, (double *) enc, (double const *) data, numData, numImages, flags) ;
+    default:
+      abort() ;
+  }
+}
+
+/** @brief Encode the vectors of several image regions
+ ** @param self encoder.
+ ** @param enc Fisher vectors (output).
+ ** @param data vectors to encode.
+ ** @param numData number of vectors.
+ ** @param positions vector positions.
+ ** @param regions pooling regions.
+ ** @param numRegions number of regions.
+ ** @param flags options.
+ ** @return total number of averaging operations.
+ **
+ ** The function computes the Fisher vector of the vectors of each of
+ ** @a numRegions regions, for example the cells of a spatial pyramid
+ ** or a set of object proposals. @a positions is a 2 x @a numData
+ ** matrix with the (x,y) coordinates of the vectors and @a regions a
+ ** 4 x @a numRegions matrix of boxes $(x_0,y_0,x_1,y_1)$ (@ref
+ ** pooling). @a enc is a matrix with @a numRegions columns, each
+ ** receiving the Fisher vector of the vectors inside one region, as
+ ** computed by ::vl_fisher_encoder_encode.
+ **
+ ** The posteriors of each vector are computed only once, however
+ ** many regions contain it. If the regions are more than the cells
+ ** of their @ref pooling-grid "pooling grid", the statistics of the
+ ** regions are obtained from an integral image of the cells.
+ **/
+
+VL_EXPORT vl_size
+vl_fisher_encoder_encode_regions (VlFisherEncoder * self,
+                                  void * enc,
+                                  void const * data, vl_size numData,
+                                  double const * positions,
+                                  double const * regions,
+                                  vl_size numRegions,
+                                  int flags)
+{
+  vl_size numTerms ;
+  VlPoolingGrid * grid = vl_pooling_grid_new (positions, numData, regions, numRegions) ;
+  switch (self->dataType) {
+    case VL_TYPE_FLOAT:
+      numTerms = _vl_fisher_encoder_encode_regions_f
+      (self, (float *) enc, (float const *) data, numData, grid, flags) ;
+      break ;
+    case VL_TYPE_DOUBLE:
+      numTerms = _vl_fisher_encoder_encode_regions_d
+      (self, (double *) enc, (double const *) data, numData, grid, flags) ;
+      break ;
+    default:
+      abort() ;
+  }
+  vl_pooling_grid_delete (grid) ;
+  return numTerms ;
+}
+
 /* not VL_FISHER_INSTANTIATING */
 #endif
 
@@ -53,5 +53,63 @@ VL_EXPORT vl_size vl_fisher_encode
  void const * data, vl_size numData,
  int flags) ;
 
+#ifndef __DOXYGEN__
+struct _VlFisherEncoder ;
+typedef struct _VlFisherEncoder VlFisherEncoder ;
+#else
+/** @brief Fisher vector encoder
+ **
+ ** An encoder reuses its scratch buffers across calls and must not
+ ** be used by concurrent callers (@ref fisher-encoder).
+ **/
+typedef OPAQUE VlFisherEncoder ;
+#endif
+
+VL_EXPORT vl_size vl_fisher_encode_sparse
+(void * enc, vl_type dataType,
+ void const * means, vl_size dimension, vl_size numClusters,
+ void const * covariances,
+ void const * priors,
+ void const * data, vl_size numData,
+ vl_size numPosteriors,
+ int flags) ;
+
+/** @name Encoder object
+ ** @{ */
+VL_EXPORT VlFisherEncoder * vl_fisher_encoder_new
+(vl_type dataType,
+ void const * means, vl_size dimension, vl_size numClusters,
+ void const * covariances,
+ void const * priors) ;
+
+VL_EXPORT void vl_fisher_encoder_delete (VlFisherEncoder * self) ;
+
+VL_EXPORT vl_size vl_fisher_encoder_get_num_posteriors (VlFisherEncoder const * self) ;
+VL_EXPORT void vl_fisher_encoder_set_num_posteriors (VlFisherEncoder * self, vl_size numPosteriors) ;
+
+VL_EXPORT vl_size vl_fisher_encoder_encode
+(VlFisherEncoder * self,
+ void * enc,
+ void const * data, vl_size numData,
+ int flags) ;
+
+VL_EXPORT vl_size vl_fisher_encoder_encode_batch
+(VlFisherEncoder * self,
+ void * enc,
+ void const * data,
+ vl_size const * numData,
+ vl_size numImages,
+ int flags) ;
+
+VL_EXPORT vl_size vl_fisher_encoder_encode_regions
+(VlFisherEncoder * self,
+ void * enc,
+ void const * data, vl_size numData,
+ double const * positions,
+ double const * regions,
+ vl_size numRegions,
+ int flags) ;
+/** @} */
+
 /* VL_FISHER_H */
 #endif
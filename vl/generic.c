@@ -41,6 +41,7 @@ VLFeat strives to be clutter-free, simple, portable, and well documented.
   - @subpage hog
   - @subpage fisher
   - @subpage vlad
+  - @subpage pooling
   - @subpage liop
   - @subpage lbp
 
@@ -51,6 +52,7 @@ VLFeat strives to be clutter-free, simple, portable, and well documented.
   - @subpage gmm
   - @subpage aib
   - @subpage kdtree
+  - @subpage pq
 
 - **Segmentation**
   - @subpage slic
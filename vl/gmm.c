@@ -76,11 +76,40 @@ loglikelihood = vl_gmm_get_loglikelihood(gmm) ;
 posteriors = vl_gmm_get_posteriors(gmm) ;
 @endcode
 
-@note ::VlGMM assumes that the covariance matrices of the GMM are
-diagonal. This reduces significantly the number of parameters to learn
-and is usually an acceptable compromise in vision applications. If the
-data is significantly correlated, it can be beneficial to de-correlate
-it by PCA rotation or projection in pre-processing.
+@note By default ::VlGMM assumes that the covariance matrices of the
+GMM are diagonal. This reduces significantly the number of parameters
+to learn and is usually an acceptable compromise in vision
+applications. If the data is significantly correlated, it can be
+beneficial to de-correlate it by PCA rotation or projection in
+pre-processing, or to use a tied covariance (see below).
+
+The shape of the covariance matrices can be changed by
+::vl_gmm_set_covariance_type as follows:
+
+Covariance   | ::VlGMMCovarianceType enumeration | Description
+-------------|-----------------------------------|-----------------------------------------------
+Diagonal     | ::VlGMMDiagonal                   | A diagonal covariance matrix per mode (default)
+Spherical    | ::VlGMMSpherical                  | A multiple of the identity per mode
+Tied         | ::VlGMMTied                       | A full covariance matrix shared by all the modes
+
+In the tied case the E step computes the Cholesky factor of the
+shared covariance once, whitens the data with it, and then uses
+Euclidean distances to the whitened means. This costs about as much as
+the diagonal case, so more modes can be afforded for low dimensional
+data. The shared matrix is returned by ::vl_gmm_get_tied_covariance,
+while ::vl_gmm_get_covariances returns its diagonal for each mode.
+If the shared matrix is not positive definite (for example because of
+a custom initialization), ::vl_gmm_em stops, returns NaN and sets the
+last error (::vl_get_last_error). Spherical covariances are also
+stored as diagonals, with identical entries.
+
+The Fisher vector encoder (@ref fisher) assumes diagonal
+covariances. Passing it the diagonals of a tied model ignores the
+correlations, so that its posteriors differ from the ones of the
+model. To use the model exactly, whiten the data and the means by the
+Cholesky factor @f$ L @f$ of the shared matrix @f$ \Sigma = L L^\top
+@f$, i.e. replace @f$ x @f$ by @f$ L^{-1} x @f$, and use unit
+covariances.
 
 ::vl_gmm_get_loglikelihood is used to get the final loglikelihood of
 the estimated mixture, ::vl_gmm_get_means and ::vl_gmm_get_covariances
@@ -232,6 +261,15 @@ $\Sigma_k$ reduces to computing the trace of the matrix and the
 inversion of $\Sigma_k$ could be obtained by inverting the elements on
 the diagonal of the covariance matrix.
 
+@anchor gmm-fast-exp
+The underflow is avoided by computing the posteriors in the log
+domain and normalizing them by subtracting the maximum before
+exponentiating (log-sum-exp). For single precision data, this step
+is vectorized and the exponential is evaluated by a polynomial
+approximation with relative error below 2e-7, comparable to the
+rounding error of the log-densities. ::vl_gmm_set_fast_exp switches
+back to the C library exponential.
+
 @subsection gmm-maximization-step  Maximization step
 
 The M step estimates the parameters of the Gaussian mixture components
@@ -251,6 +289,36 @@ manner, yielding to:
  \pi_k &= { \sum_{i=1}^n { q_{ik} } \over { \sum_{i=1}^n \sum_{l=1}^K q_{il} } }.
 @f}
 
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+@section gmm-online Online EM
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+
+Batch EM requires all the data (and all the posteriors $q_{ik}$) to be
+in memory at once. ::vl_gmm_push_batch implements instead the
+*stepwise* (online) variant of EM, which processes the data in
+batches. For each batch, the function runs one E step and one M step
+on that batch only, obtaining the statistics $\hat\pi_k$,
+$\hat\mu_k$, $\hat\Sigma_k$. These are then blended with the current
+parameters using a step size $\eta_t = (t+1)^{-\alpha}$, where $t$ is
+the number of batches seen so far and $\alpha \in (0.5,1]$ is set by
+::vl_gmm_set_step_decay. The blending is carried out on the
+sufficient statistics of the model. For example, the priors and
+means are updated as
+
+@f{align*}
+ \pi_k &\leftarrow (1-\eta_t) \pi_k + \eta_t \hat\pi_k,
+\\
+ \mu_k &\leftarrow { (1-\eta_t) \pi_k \mu_k + \eta_t \hat\pi_k \hat\mu_k \over
+ (1-\eta_t) \pi_k + \eta_t \hat\pi_k },
+@f}
+
+where on the right hand side $\pi_k$ and $\mu_k$ are the old values.
+The memory used is proportional to the batch size rather than to the
+size of the dataset. The model must be initialized beforehand, for
+example by calling ::vl_gmm_init_with_rand_data or
+::vl_gmm_init_with_kmeans on the first batch. Smaller values of
+$\alpha$ forget old batches faster.
+
 <!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
 @section gmm-fundamentals-init Initialization algorithms
 <!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
@@ -309,6 +377,9 @@ Alternatively, one can manually specify a starting point
 #define VL_GMM_MIN_POSTERIOR 1e-2
 #define VL_GMM_MIN_PRIOR 1e-6
 
+/* the E step processes the data in tiles of this many points */
+#define VL_GMM_TILE_SIZE 64
+
 struct _VlGMM
 {
   vl_type dataType ;                  /**< Data type. */
@@ -320,12 +391,17 @@ struct _VlGMM
   int     verbosity ;                 /**< Verbosity level. */
   void *  means;                      /**< Means of Gaussian modes. */
   void *  covariances;                /**< Diagonals of covariance matrices of Gaussian modes. */
+  void *  tiedCovariance;             /**< Shared covariance matrix (tied covariance type). */
+  VlGMMCovarianceType covarianceType; /**< Covariance type. */
   void *  priors;                     /**< Weights of Gaussian modes. */
   void *  posteriors;                 /**< Probabilities of correspondences of points to clusters. */
   double * sigmaLowBound ;            /**< Lower bound on the diagonal covariance values. */
   VlGMMInitialization initialization; /**< Initialization option */
   VlKMeans * kmeansInit;              /**< Kmeans object for initialization of gaussians */
   double LL ;                         /**< Current solution loglikelihood */
+  vl_size numBatches ;                /**< Number of batches processed by online EM. */
+  double stepDecay ;                  /**< Step size exponent of online EM. */
+  vl_bool fastExp ;                   /**< Use the approximated exponential in the E-step. */
   vl_bool kmeansInitIsOwner; /**< Indicates whether a user provided the kmeans initialization object */
 } ;
 
@@ -364,6 +440,9 @@ vl_gmm_new (vl_type dataType, vl_size dimension, vl_size numComponents)
   self->verbosity = 0 ;
   self->maxNumIterations = 50;
   self->numRepetitions = 1;
+  self->numBatches = 0 ;
+  self->stepDecay = 0.6 ;
+  self->fastExp = VL_TRUE ;
   self->sigmaLowBound =  NULL ;
   self->priors = NULL ;
   self->covariances = NULL ;
@@ -375,6 +454,8 @@ vl_gmm_new (vl_type dataType, vl_size dimension, vl_size numComponents)
   self->priors = vl_calloc (numComponents, size) ;
   self->means = vl_calloc (numComponents * dimension, size) ;
   self->covariances = vl_calloc (numComponents * dimension, size) ;
+  self->tiedCovariance = vl_calloc (dimension * dimension, size) ;
+  self->covarianceType = VlGMMDiagonal ;
   self->sigmaLowBound = vl_calloc (dimension, sizeof(double)) ;
 
   for (i = 0 ; i < (unsigned)self->dimension ; ++i)  { self->sigmaLowBound[i] = 1e-4 ; }
@@ -391,6 +472,7 @@ vl_gmm_new (vl_type dataType, vl_size dimension, vl_size numComponents)
 void
 vl_gmm_reset (VlGMM * self)
 {
+  self->numBatches = 0 ;
   if (self->posteriors) {
     vl_free(self->posteriors) ;
     self->posteriors = NULL ;
@@ -415,6 +497,7 @@ vl_gmm_delete (VlGMM * self)
 {
   if(self->means) vl_free(self->means);
   if(self->covariances) vl_free(self->covariances);
+  if(self->tiedCovariance) vl_free(self->tiedCovariance);
   if(self->priors) vl_free(self->priors);
   if(self->posteriors) vl_free(self->posteriors);
   if(self->kmeansInit && self->kmeansInitIsOwner) {
@@ -515,6 +598,117 @@ vl_gmm_get_covariances (VlGMM const * self)
   return self->covariances ;
 }
 
+/** @brief Get the shared covariance matrix
+ ** @param self object
+ ** @return covariance matrix (@c dimension x @c dimension).
+ **
+ ** The matrix is meaningful only for the ::VlGMMTied covariance
+ ** type.
+ **/
+
+void const *
+vl_gmm_get_tied_covariance (VlGMM const * self)
+{
+  return self->tiedCovariance ;
+}
+
+/** @brief Get the covariance type
+ ** @param self object
+ ** @return covariance type.
+ **/
+
+VlGMMCovarianceType
+vl_gmm_get_covariance_type (VlGMM const * self)
+{
+  return self->covarianceType ;
+}
+
+/** @brief Set the covariance type
+ ** @param self object
+ ** @param type covariance type.
+ **
+ ** The type takes effect at the next initialization. With the
+ ** ::VlGMMCustom initialization and the ::VlGMMTied type, set the
+ ** initial covariance by ::vl_gmm_set_tied_covariance.
+ **/
+
+void
+vl_gmm_set_covariance_type (VlGMM * self, VlGMMCovarianceType type)
+{
+  self->covarianceType = type ;
+}
+
+/** @brief Get the step size exponent of online EM
+ ** @param self object
+ ** @return exponent $\alpha$.
+ **
+ ** See ::vl_gmm_set_step_decay.
+ **/
+
+double
+vl_gmm_get_step_decay (VlGMM const * self)
+{
+  return self->stepDecay ;
+}
+
+/** @brief Set the step size exponent of online EM
+ ** @param self object
+ ** @param decay exponent $\alpha$.
+ **
+ ** ::vl_gmm_push_batch blends the @a t-th batch with step
+ ** size $(t+1)^{-\alpha}$ (@ref gmm-online). Convergence is
+ ** guaranteed for $\alpha \in (0.5, 1]$; the default is 0.6.
+ **/
+
+void
+vl_gmm_set_step_decay (VlGMM * self, double decay)
+{
+  assert (decay > 0 && decay <= 1) ;
+  self->stepDecay = decay ;
+}
+
+/** @brief Get whether the E-step approximates the exponential
+ ** @param self object
+ ** @return @c true if the approximation is used.
+ **
+ ** See ::vl_gmm_set_fast_exp.
+ **/
+
+vl_bool
+vl_gmm_get_fast_exp (VlGMM const * self)
+{
+  return self->fastExp ;
+}
+
+/** @brief Set whether the E-step approximates the exponential
+ ** @param self object
+ ** @param fastExp @c true to use the approximation.
+ **
+ ** For single precision data, the posteriors are normalized by a
+ ** vectorized log-sum-exp that evaluates the exponential by a
+ ** polynomial with relative error below 2e-7 (@ref gmm-fast-exp).
+ ** Setting @a fastExp to @c false uses the C library @c exp
+ ** instead. The option has no effect on double precision data or
+ ** if SIMD instructions are disabled. The default is @c true.
+ **/
+
+void
+vl_gmm_set_fast_exp (VlGMM * self, vl_bool fastExp)
+{
+  self->fastExp = fastExp ;
+}
+
+/** @brief Get the number of batches processed by online EM
+ ** @param self object
+ ** @return number of batches.
+ **/
+
+vl_size
+vl_gmm_get_num_batches (VlGMM const * self)
+{
+  return self->numBatches ;
+}
+
 /** @brief Get priors
  ** @param self object
  ** @return priors of cluster gaussians.
@@ -692,24 +886,94 @@ void vl_gmm_set_covariance_lower_bound (VlGMM * self, double bound)
 /*                                            Posterior assignments */
 /* ---------------------------------------------------------------- */
 
-/** @fn vl_get_gmm_data_posterior_f(float*,vl_size,vl_size,float const*,float const*,vl_size,float const*,float const*)
- ** @brief Get Gaussian modes posterior probabilities
- ** @param posteriors posterior probabilities (output)/
+/** @internal
+ ** @brief Cholesky decomposition
+ ** @param L lower triangular factor (output).
+ ** @param A symmetric positive definite matrix.
+ ** @param dimension size of the matrices.
+ ** @return @c false if @a A is not numerically positive definite.
+ **
+ ** The function computes @f$ A = L L^\top @f$. Matrices are stored
+ ** by rows; the upper triangle of @a L is set to zero.
+ **/
+
+static vl_bool
+VL_XCAT(_vl_gmm_cholesky_, SFX)
+(TYPE * L, TYPE const * A, vl_size dimension)
+{
+  vl_uindex r, c, k ;
+  memset(L, 0, sizeof(TYPE) * dimension * dimension) ;
+  for (r = 0 ; r < dimension ; ++r) {
+    for (c = 0 ; c <= r ; ++c) {
+      double acc = A[r * dimension + c] ;
+      for (k = 0 ; k < c ; ++k) {
+        acc -= (double) L[r * dimension + k] * L[c * dimension + k] ;
+      }
+      if (r == c) {
+        if (acc <= 0) return VL_FALSE ;
+        L[r * dimension + r] = (TYPE) sqrt(acc) ;
+      } else {
+        L[r * dimension + c] = (TYPE) (acc / L[c * dimension + c]) ;
+      }
+    }
+  }
+  return VL_TRUE ;
+}
+
+/** @internal
+ ** @brief Solve a lower triangular system
+ ** @param y solution (output).
+ ** @param L lower triangular matrix.
+ ** @param x right hand side.
+ ** @param dimension size of the system.
+ ** @param dotFn inner product function.
+ **
+ ** The function computes @f$ y = L^{-1} x @f$ by forward
+ ** substitution.
+ **/
+
+static void
+VL_XCAT(_vl_gmm_whiten_, SFX)
+(TYPE * y, TYPE const * L, TYPE const * x, vl_size dimension,
+ TYPE (*dotFn)(vl_size, TYPE const *, TYPE const *))
+{
+  vl_uindex r ;
+  for (r = 0 ; r < dimension ; ++r) {
+    TYPE acc = (r > 0) ? dotFn(r, L + r * dimension, y) : 0 ;
+    y[r] = (x[r] - acc) / L[r * dimension + r] ;
+  }
+}
+
+/** @internal
+ ** @brief Compute the data posteriors for any covariance type
+ ** @param posteriors posterior probabilities (output).
  ** @param numClusters number of modes in the GMM model.
  ** @param numData number of data elements.
  ** @param priors prior mode probabilities of the GMM model.
  ** @param means means of the GMM model.
  ** @param dimension data dimension.
  ** @param covariances diagonal covariances of the GMM model.
+ ** @param tiedCovariance shared covariance of the GMM model.
+ ** @param covarianceType covariance type.
  ** @param data data.
+ ** @param fastExp whether to approximate the exponential.
  ** @return data log-likelihood.
  **
- ** This is a helper function that does not require a ::VlGMM object
- ** instance to operate.
+ ** The data is processed in tiles of ::VL_GMM_TILE_SIZE points. For
+ ** each tile, the posteriors of all the modes are computed one mode
+ ** at a time, so that both the tile and the parameters of the mode
+ ** stay in cache. With tied covariances, the tile is whitened first
+ ** and compared to the whitened means by the Euclidean distance,
+ ** which is also used for spherical covariances.
+ **
+ ** @a tiedCovariance is used only with the ::VlGMMTied type and @a
+ ** covariances only with the other types. If @a tiedCovariance is
+ ** not positive definite, the function sets the last error and
+ ** returns NaN without computing the posteriors.
  **/
 
-double
-VL_XCAT(vl_get_gmm_data_posteriors_, SFX)
+static double
+VL_XCAT(_vl_gmm_get_posteriors_, SFX)
 (TYPE * posteriors,
  vl_size numClusters,
  vl_size numData,
@@ -717,27 +981,61 @@ VL_XCAT(vl_get_gmm_data_posteriors_, SFX)
  TYPE const * means,
  vl_size dimension,
  TYPE const * covariances,
- TYPE const * data)
+ TYPE const * tiedCovariance,
+ VlGMMCovarianceType covarianceType,
+ TYPE const * data,
+ vl_bool fastExp VL_UNUSED)
 {
-  vl_index i_d, i_cl;
+  vl_index i_d, i_cl, t ;
   vl_size dim;
+  vl_size numTiles = (numData + VL_GMM_TILE_SIZE - 1) / VL_GMM_TILE_SIZE ;
   double LL = 0;
 
   TYPE halfDimLog2Pi = (dimension / 2.0) * log(2.0*VL_PI);
   TYPE * logCovariances ;
   TYPE * logWeights ;
   TYPE * invCovariances ;
+  TYPE * cholesky = NULL ;
+  TYPE * whiteMeans = NULL ;
 
 #if (FLT == VL_TYPE_FLOAT)
   VlFloatVector3ComparisonFunction distFn = vl_get_vector_3_comparison_function_f(VlDistanceMahalanobis) ;
+  VlFloatVectorComparisonFunction l2Fn = vl_get_vector_comparison_function_f(VlDistanceL2) ;
+  VlFloatVectorComparisonFunction dotFn = vl_get_vector_comparison_function_f(VlKernelL2) ;
 #else
   VlDoubleVector3ComparisonFunction distFn = vl_get_vector_3_comparison_function_d(VlDistanceMahalanobis) ;
+  VlDoubleVectorComparisonFunction l2Fn = vl_get_vector_comparison_function_d(VlDistanceL2) ;
+  VlDoubleVectorComparisonFunction dotFn = vl_get_vector_comparison_function_d(VlKernelL2) ;
 #endif
 
   logCovariances = vl_malloc(sizeof(TYPE) * numClusters) ;
   invCovariances = vl_malloc(sizeof(TYPE) * numClusters * dimension) ;
   logWeights = vl_malloc(sizeof(TYPE) * numClusters) ;
 
+  if (covarianceType == VlGMMTied) {
+    /* whiten the means once; all the modes share the determinant */
+    TYPE logDet = 0 ;
+    cholesky = vl_malloc(sizeof(TYPE) * dimension * dimension) ;
+    whiteMeans = vl_malloc(sizeof(TYPE) * dimension * numClusters) ;
+    if (! VL_XCAT(_vl_gmm_cholesky_, SFX)(cholesky, tiedCovariance, dimension)) {
+      vl_free(logCovariances) ;
+      vl_free(invCovariances) ;
+      vl_free(logWeights) ;
+      vl_free(cholesky) ;
+      vl_free(whiteMeans) ;
+      vl_set_last_error(VL_ERR_BAD_ARG, "The tied covariance of the GMM is not positive definite") ;
+      return VL_NAN_D ;
+    }
+    for (dim = 0 ; dim < dimension ; ++dim) {
+      logDet += 2 * log(cholesky[dim * dimension + dim]) ;
+    }
+    for (i_cl = 0 ; i_cl < (signed)numClusters ; ++ i_cl) {
+      VL_XCAT(_vl_gmm_whiten_, SFX)(whiteMeans + i_cl * dimension, cholesky,
+                                    means + i_cl * dimension, dimension, dotFn) ;
+      logCovariances[i_cl] = logDet ;
+    }
+  }
+
 #if defined(_OPENMP)
 #pragma omp parallel for private(i_cl,dim) num_threads(vl_get_max_threads())
 #endif
@@ -748,55 +1046,162 @@ VL_XCAT(vl_get_gmm_data_posteriors_, SFX)
     } else {
       logWeights[i_cl] = log(priors[i_cl]);
     }
-    for(dim = 0 ; dim < dimension ; ++ dim) {
-      logSigma += log(covariances[i_cl*dimension + dim]);
-      invCovariances [i_cl*dimension + dim] = (TYPE) 1.0 / covariances[i_cl*dimension + dim];
+    switch (covarianceType) {
+      case VlGMMDiagonal:
+        for(dim = 0 ; dim < dimension ; ++ dim) {
+          logSigma += log(covariances[i_cl*dimension + dim]);
+          invCovariances [i_cl*dimension + dim] = (TYPE) 1.0 / covariances[i_cl*dimension + dim];
+        }
+        logCovariances[i_cl] = logSigma;
+        break ;
+      case VlGMMSpherical:
+        logCovariances[i_cl] = dimension * log(covariances[i_cl*dimension]) ;
+        invCovariances[i_cl] = (TYPE) 1.0 / covariances[i_cl*dimension] ;
+        break ;
+      case VlGMMTied:
+        break ;
     }
-    logCovariances[i_cl] = logSigma;
   } /* end of parallel region */
 
 #if defined(_OPENMP)
-#pragma omp parallel for private(i_cl,i_d) reduction(+:LL) \
+#pragma omp parallel default(shared) private(t,i_cl,i_d) reduction(+:LL) \
 num_threads(vl_get_max_threads())
 #endif
-  for (i_d = 0 ; i_d < (signed)numData ; ++ i_d) {
-    TYPE clusterPosteriorsSum = 0;
-    TYPE maxPosterior = (TYPE)(-VL_INFINITY_D) ;
+  {
+    TYPE * whiteTile = NULL ;
+    if (covarianceType == VlGMMTied) {
+      /* vl_malloc cannot be used here if mapped to MATLAB malloc */
+      whiteTile = malloc(sizeof(TYPE) * dimension * VL_GMM_TILE_SIZE) ;
+    }
 
-    for (i_cl = 0 ; i_cl < (signed)numClusters ; ++ i_cl) {
-      TYPE p =
-      logWeights[i_cl]
-      - halfDimLog2Pi
-      - 0.5 * logCovariances[i_cl]
-      - 0.5 * distFn (dimension,
-                      data + i_d * dimension,
+#if defined(_OPENMP)
+#pragma omp for
+#endif
+    for (t = 0 ; t < (signed)numTiles ; ++t) {
+      vl_index begin = t * VL_GMM_TILE_SIZE ;
+      vl_index end = VL_MIN(begin + VL_GMM_TILE_SIZE, (signed)numData) ;
+      TYPE const * tile = data + begin * dimension ;
+
+      if (covarianceType == VlGMMTied) {
+        for (i_d = begin ; i_d < end ; ++i_d) {
+          VL_XCAT(_vl_gmm_whiten_, SFX)(whiteTile + (i_d - begin) * dimension, cholesky,
+                                        data + i_d * dimension, dimension, dotFn) ;
+        }
+        tile = whiteTile ;
+      }
+
+      /* log-densities of all the modes for the tile */
+      for (i_cl = 0 ; i_cl < (signed)numClusters ; ++ i_cl) {
+        double offset = logWeights[i_cl] - halfDimLog2Pi - 0.5 * logCovariances[i_cl] ;
+        TYPE * post = posteriors + i_cl ;
+        switch (covarianceType) {
+          case VlGMMDiagonal:
+            for (i_d = begin ; i_d < end ; ++i_d) {
+              post[i_d * numClusters] = offset - 0.5 *
+              distFn (dimension,
+                      tile + (i_d - begin) * dimension,
                       means + i_cl * dimension,
                       invCovariances + i_cl * dimension) ;
-      posteriors[i_cl + i_d * numClusters] = p ;
-      if (p > maxPosterior) { maxPosterior = p ; }
-    }
+            }
+            break ;
+          case VlGMMSpherical:
+            for (i_d = begin ; i_d < end ; ++i_d) {
+              post[i_d * numClusters] = offset - 0.5 * invCovariances[i_cl] *
+              l2Fn (dimension,
+                    tile + (i_d - begin) * dimension,
+                    means + i_cl * dimension) ;
+            }
+            break ;
+          case VlGMMTied:
+            for (i_d = begin ; i_d < end ; ++i_d) {
+              post[i_d * numClusters] = offset - 0.5 *
+              l2Fn (dimension,
+                    tile + (i_d - begin) * dimension,
+                    whiteMeans + i_cl * dimension) ;
+            }
+            break ;
+        }
+      }
 
-    for (i_cl = 0 ; i_cl < (signed)numClusters ; ++i_cl) {
-      TYPE p = posteriors[i_cl + i_d * numClusters] ;
-      p =  exp(p - maxPosterior) ;
-      posteriors[i_cl + i_d * numClusters] = p ;
-      clusterPosteriorsSum += p ;
-    }
+      /* normalize */
+#if (FLT == VL_TYPE_FLOAT) && ! defined(VL_DISABLE_SSE2)
+      if (fastExp && vl_get_simd_enabled() && vl_cpu_has_sse2()) {
+        for (i_d = begin ; i_d < end ; ++i_d) {
+          TYPE * post = posteriors + i_d * numClusters ;
+          LL += _vl_log_sum_exp_sse2_f (numClusters, post, post) ;
+        }
+        continue ;
+      }
+#endif
+      for (i_d = begin ; i_d < end ; ++i_d) {
+        TYPE clusterPosteriorsSum = 0;
+        TYPE maxPosterior = (TYPE)(-VL_INFINITY_D) ;
+        TYPE * post = posteriors + i_d * numClusters ;
 
-    LL +=  log(clusterPosteriorsSum) + (double) maxPosterior ;
+        for (i_cl = 0 ; i_cl < (signed)numClusters ; ++i_cl) {
+          if (post[i_cl] > maxPosterior) { maxPosterior = post[i_cl] ; }
+        }
 
-    for (i_cl = 0 ; i_cl < (signed)numClusters ; ++i_cl) {
-      posteriors[i_cl + i_d * numClusters] /= clusterPosteriorsSum ;
+        for (i_cl = 0 ; i_cl < (signed)numClusters ; ++i_cl) {
+          TYPE p = exp(post[i_cl] - maxPosterior) ;
+          post[i_cl] = p ;
+          clusterPosteriorsSum += p ;
+        }
+
+        LL +=  log(clusterPosteriorsSum) + (double) maxPosterior ;
+
+        for (i_cl = 0 ; i_cl < (signed)numClusters ; ++i_cl) {
+          post[i_cl] /= clusterPosteriorsSum ;
+        }
+      }
     }
+    free(whiteTile) ;
   } /* end of parallel region */
 
   vl_free(logCovariances);
   vl_free(logWeights);
   vl_free(invCovariances);
+  if (cholesky) vl_free(cholesky) ;
+  if (whiteMeans) vl_free(whiteMeans) ;
 
   return LL;
 }
 
+/** @fn vl_get_gmm_data_posteriors_f(float*,vl_size,vl_size,float const*,float const*,vl_size,float const*,float const*)
+ ** @brief Get Gaussian modes posterior probabilities
+ ** @param posteriors posterior probabilities (output)/
+ ** @param numClusters number of modes in the GMM model.
+ ** @param numData number of data elements.
+ ** @param priors prior mode probabilities of the GMM model.
+ ** @param means means of the GMM model.
+ ** @param dimension data dimension.
+ ** @param covariances diagonal covariances of the GMM model.
+ ** @param data data.
+ ** @return data log-likelihood.
+ **
+ ** This is a helper function that does not require a ::VlGMM object
+ ** instance to operate. With single precision data, it always uses
+ ** the approximated exponential of @ref gmm-fast-exp, as there is no
+ ** ::vl_gmm_set_fast_exp switch; disabling SIMD with
+ ** ::vl_set_simd_enabled reverts to the C library @c exp.
+ **/
+
+double
+VL_XCAT(vl_get_gmm_data_posteriors_, SFX)
+(TYPE * posteriors,
+ vl_size numClusters,
+ vl_size numData,
+ TYPE const * priors,
+ TYPE const * means,
+ vl_size dimension,
+ TYPE const * covariances,
+ TYPE const * data)
+{
+  return VL_XCAT(_vl_gmm_get_posteriors_, SFX)
+  (posteriors, numClusters, numData, priors, means, dimension,
+   covariances, NULL, VlGMMDiagonal, data, VL_TRUE) ;
+}
+
 /* ---------------------------------------------------------------- */
 /*                                 Restarts zero-weighted Gaussians */
 /* ---------------------------------------------------------------- */
@@ -1009,17 +1414,54 @@ VL_XCAT(_vl_gmm_apply_bounds_, SFX)(VlGMM * self)
   vl_uindex k ;
   vl_size numAdjusted = 0 ;
   TYPE * cov = (TYPE*)self->covariances ;
+  TYPE * tied = (TYPE*)self->tiedCovariance ;
   double const * lbs = self->sigmaLowBound ;
+  double lb = 0 ;
 
-  for (k = 0 ; k < self->numClusters ; ++k) {
-    vl_bool adjusted = VL_FALSE ;
-    for (dim = 0 ; dim < self->dimension ; ++dim) {
-      if (cov[k * self->dimension + dim] < lbs[dim] ) {
-        cov[k * self->dimension + dim] = lbs[dim] ;
-        adjusted = VL_TRUE ;
+  switch (self->covarianceType) {
+    case VlGMMDiagonal:
+      for (k = 0 ; k < self->numClusters ; ++k) {
+        vl_bool adjusted = VL_FALSE ;
+        for (dim = 0 ; dim < self->dimension ; ++dim) {
+          if (cov[k * self->dimension + dim] < lbs[dim] ) {
+            cov[k * self->dimension + dim] = lbs[dim] ;
+            adjusted = VL_TRUE ;
+          }
+        }
+        if (adjusted) { numAdjusted ++ ; }
       }
-    }
-    if (adjusted) { numAdjusted ++ ; }
+      break ;
+
+    case VlGMMSpherical:
+      /* the variance must satisfy all the bounds */
+      for (dim = 0 ; dim < self->dimension ; ++dim) {
+        lb = VL_MAX(lb, lbs[dim]) ;
+      }
+      for (k = 0 ; k < self->numClusters ; ++k) {
+        if (cov[k * self->dimension] < lb) {
+          for (dim = 0 ; dim < self->dimension ; ++dim) {
+            cov[k * self->dimension + dim] = (TYPE) lb ;
+          }
+          numAdjusted ++ ;
+        }
+      }
+      break ;
+
+    case VlGMMTied:
+      /* bound the diagonal of the shared matrix, then copy it to
+         the diagonal covariances of all modes */
+      for (dim = 0 ; dim < self->dimension ; ++dim) {
+        if (tied[dim * self->dimension + dim] < lbs[dim]) {
+          tied[dim * self->dimension + dim] = lbs[dim] ;
+          numAdjusted = self->numClusters ;
+        }
+      }
+      for (k = 0 ; k < self->numClusters ; ++k) {
+        for (dim = 0 ; dim < self->dimension ; ++dim) {
+          cov[k * self->dimension + dim] = tied[dim * self->dimension + dim] ;
+        }
+      }
+      break ;
   }
 
   if (numAdjusted > 0 && self->verbosity > 0) {
@@ -1044,9 +1486,15 @@ VL_XCAT(_vl_gmm_maximization_, SFX)
  vl_size numData)
 {
   vl_size numClusters = self->numClusters;
-  vl_index i_d, i_cl;
-  vl_size dim ;
+  vl_index i_d, i_cl, e ;
+  vl_size dim, dim2 ;
   TYPE * oldMeans ;
+  TYPE * shift = NULL ;
+  TYPE * tied = (TYPE*)self->tiedCovariance ;
+  vl_bool isTied = (self->covarianceType == VlGMMTied) ;
+  vl_size numThreads = 1 ;
+  vl_size accSize ;
+  TYPE * accumulators ;
   double time = 0 ;
 
   if (self->verbosity > 1) {
@@ -1057,24 +1505,52 @@ VL_XCAT(_vl_gmm_maximization_, SFX)
   oldMeans = vl_malloc(sizeof(TYPE) * self->dimension * numClusters) ;
   memcpy(oldMeans, means, sizeof(TYPE) * self->dimension * numClusters) ;
 
-  memset(priors, 0, sizeof(TYPE) * numClusters) ;
-  memset(means, 0, sizeof(TYPE) * self->dimension * numClusters) ;
-  memset(covariances, 0, sizeof(TYPE) * self->dimension * numClusters) ;
+  if (isTied) {
+    /* the scatter matrix of the data is accumulated w.r.t. the average
+       of the old means, which is close to the data mean */
+    shift = vl_calloc(sizeof(TYPE), self->dimension) ;
+    for (i_cl = 0 ; i_cl < (signed)numClusters ; ++i_cl) {
+      for (dim = 0 ; dim < self->dimension ; ++dim) {
+        shift[dim] += oldMeans[i_cl * self->dimension + dim] / numClusters ;
+      }
+    }
+  }
 
+  /*
+    Each thread accumulates the statistics in its own block of
+    accumulators: the mass of the clusters, the weighted sums of the
+    data, the weighted sums of square differences and, for tied
+    covariances, the scatter matrix followed by a scratch vector.
+  */
 #if defined(_OPENMP)
-#pragma omp parallel default(shared) private(i_d, i_cl, dim) \
-                     num_threads(vl_get_max_threads())
+  numThreads = vl_get_max_threads() ;
+#endif
+  accSize = numClusters * (1 + 2 * self->dimension) ;
+  if (isTied) {
+    accSize += self->dimension * (self->dimension + 1) ;
+  }
+  accumulators = vl_calloc(sizeof(TYPE), numThreads * accSize) ;
+
+#if defined(_OPENMP)
+#pragma omp parallel default(shared) private(i_d, i_cl, dim, e) \
+                     num_threads(numThreads)
 #endif
   {
+    vl_uindex thread = 0 ;
+    vl_size teamSize = 1 ;
     TYPE * clusterPosteriorSum_, * means_, * covariances_ ;
+    TYPE * scatter_ = NULL, * centered_ = NULL ;
 
 #if defined(_OPENMP)
-#pragma omp critical
+    thread = omp_get_thread_num() ;
+    teamSize = omp_get_num_threads() ;
 #endif
-    {
-      clusterPosteriorSum_ = vl_calloc(sizeof(TYPE), numClusters) ;
-      means_ = vl_calloc(sizeof(TYPE), self->dimension * numClusters) ;
-      covariances_ = vl_calloc(sizeof(TYPE), self->dimension * numClusters) ;
+    clusterPosteriorSum_ = accumulators + thread * accSize ;
+    means_ = clusterPosteriorSum_ + numClusters ;
+    covariances_ = means_ + self->dimension * numClusters ;
+    if (isTied) {
+      scatter_ = covariances_ + self->dimension * numClusters ;
+      centered_ = scatter_ + self->dimension * self->dimension ;
     }
 
     /*
@@ -1091,6 +1567,7 @@ VL_XCAT(_vl_gmm_maximization_, SFX)
 #pragma omp for
 #endif
     for (i_d = 0 ; i_d < (signed)numData ; ++i_d) {
+      TYPE weight = 0 ;
       for (i_cl = 0 ; i_cl < (signed)numClusters ; ++i_cl) {
         TYPE p = posteriors[i_cl + i_d * self->numClusters] ;
         vl_bool calculated = VL_FALSE ;
@@ -1099,16 +1576,17 @@ VL_XCAT(_vl_gmm_maximization_, SFX)
         if (p < VL_GMM_MIN_POSTERIOR / numClusters) { continue ; }
 
         clusterPosteriorSum_ [i_cl] += p ;
+        weight += p ;
 
         #ifndef VL_DISABLE_AVX
         if (vl_get_simd_enabled() && vl_cpu_has_avx()) {
-          VL_XCAT(_vl_weighted_mean_sse2_, SFX)
+          VL_XCAT(_vl_weighted_mean_avx_, SFX)
           (self->dimension,
            means_+ i_cl * self->dimension,
            data + i_d * self->dimension,
            p) ;
 
-          VL_XCAT(_vl_weighted_sigma_sse2_, SFX)
+          VL_XCAT(_vl_weighted_sigma_avx_, SFX)
           (self->dimension,
            covariances_ + i_cl * self->dimension,
            data + i_d * self->dimension,
@@ -1146,26 +1624,53 @@ VL_XCAT(_vl_gmm_maximization_, SFX)
           }
         }
       }
+
+      /* the shared covariance needs the full scatter matrix of the
+         data (lower triangle) weighted by the retained mass */
+      if (isTied && weight > 0) {
+        for (dim = 0 ; dim < self->dimension ; ++dim) {
+          centered_[dim] = data[i_d * self->dimension + dim] - shift[dim] ;
+        }
+        for (dim = 0 ; dim < self->dimension ; ++dim) {
+          TYPE wx = weight * centered_[dim] ;
+          TYPE * row = scatter_ + dim * self->dimension ;
+          for (dim2 = 0 ; dim2 <= dim ; ++dim2) {
+            row[dim2] += wx * centered_[dim2] ;
+          }
+        }
+      }
     }
 
-    /* accumulate */
+    /*
+      Sum the blocks of the different threads into the first one. The
+      reduction is split over the accumulators rather than the threads,
+      so that all the threads take part in it and the order of the
+      sums does not depend on the scheduling.
+    */
 #if defined(_OPENMP)
-#pragma omp critical
+#pragma omp for
 #endif
-    {
-      for (i_cl = 0 ; i_cl < (signed)numClusters ; ++i_cl) {
-        priors [i_cl] += clusterPosteriorSum_ [i_cl];
-        for (dim = 0 ; dim < self->dimension ; ++dim) {
-          means [i_cl * self->dimension + dim] += means_ [i_cl * self->dimension + dim] ;
-          covariances [i_cl * self->dimension + dim] += covariances_ [i_cl * self->dimension + dim] ;
-        }
+    for (e = 0 ; e < (signed)accSize ; ++e) {
+      vl_uindex t ;
+      TYPE acc = accumulators [e] ;
+      for (t = 1 ; t < teamSize ; ++t) {
+        acc += accumulators [t * accSize + e] ;
       }
-      vl_free(means_);
-      vl_free(covariances_);
-      vl_free(clusterPosteriorSum_);
+      accumulators [e] = acc ;
     }
   } /* parallel section */
 
+  memcpy(priors, accumulators, sizeof(TYPE) * numClusters) ;
+  memcpy(means, accumulators + numClusters,
+         sizeof(TYPE) * self->dimension * numClusters) ;
+  memcpy(covariances, accumulators + numClusters * (1 + self->dimension),
+         sizeof(TYPE) * self->dimension * numClusters) ;
+  if (isTied) {
+    memcpy(tied, accumulators + numClusters * (1 + 2 * self->dimension),
+           sizeof(TYPE) * self->dimension * self->dimension) ;
+  }
+  vl_free(accumulators) ;
+
   /* at this stage priors[] contains the total mass of each cluster */
   for (i_cl = 0 ; i_cl < (signed)numClusters ; ++ i_cl) {
     TYPE mass = priors[i_cl] ;
@@ -1191,6 +1696,54 @@ VL_XCAT(_vl_gmm_maximization_, SFX)
     }
   }
 
+  switch (self->covarianceType) {
+    case VlGMMDiagonal:
+      break ;
+
+    case VlGMMSpherical:
+      /* the ML isotropic variance is the average of the diagonal */
+      for (i_cl = 0 ; i_cl < (signed)numClusters ; ++ i_cl) {
+        TYPE sigma2 = 0 ;
+        for (dim = 0 ; dim < self->dimension ; ++dim) {
+          sigma2 += covariances[i_cl * self->dimension + dim] ;
+        }
+        sigma2 /= self->dimension ;
+        for (dim = 0 ; dim < self->dimension ; ++dim) {
+          covariances[i_cl * self->dimension + dim] = sigma2 ;
+        }
+      }
+      break ;
+
+    case VlGMMTied:
+    {
+      /* sum_ik q_ik (x_i - mu_k)(x_i - mu_k)' =
+         sum_i w_i (x_i - c)(x_i - c)' - sum_k n_k (mu_k - c)(mu_k - c)' */
+      TYPE totalMass = 0 ;
+      for (i_cl = 0 ; i_cl < (signed)numClusters ; ++ i_cl) {
+        TYPE mass = priors[i_cl] ;
+        if (mass < 1e-6 / numClusters) continue ;
+        totalMass += mass ;
+        for (dim = 0 ; dim < self->dimension ; ++dim) {
+          TYPE delta = means[i_cl * self->dimension + dim] - shift[dim] ;
+          for (dim2 = 0 ; dim2 <= dim ; ++dim2) {
+            TYPE delta2 = means[i_cl * self->dimension + dim2] - shift[dim2] ;
+            tied[dim * self->dimension + dim2] -= mass * delta * delta2 ;
+          }
+        }
+      }
+      totalMass = VL_MAX(totalMass, 1e-12) ;
+      for (dim = 0 ; dim < self->dimension ; ++dim) {
+        for (dim2 = 0 ; dim2 <= dim ; ++dim2) {
+          TYPE value = tied[dim * self->dimension + dim2] / totalMass ;
+          tied[dim * self->dimension + dim2] = value ;
+          tied[dim2 * self->dimension + dim] = value ;
+        }
+      }
+      vl_free(shift) ;
+      break ;
+    }
+  }
+
   VL_XCAT(_vl_gmm_apply_bounds_,SFX)(self) ;
 
   {
@@ -1245,7 +1798,7 @@ VL_XCAT(_vl_gmm_em_, SFX)
       time = vl_get_cpu_time() ;
     }
 
-    LL = VL_XCAT(vl_get_gmm_data_posteriors_,SFX)
+    LL = VL_XCAT(_vl_gmm_get_posteriors_,SFX)
     (self->posteriors,
      self->numClusters,
      numData,
@@ -1253,12 +1806,22 @@ VL_XCAT(_vl_gmm_em_, SFX)
      self->means,
      self->dimension,
      self->covariances,
-     data) ;
+     self->tiedCovariance,
+     self->covarianceType,
+     data,
+     self->fastExp) ;
 
     if (self->verbosity > 1) {
       VL_PRINTF("gmm: em: expectation step completed in %.2f s\n",
                 vl_get_cpu_time() - time) ;
     }
+    if (vl_is_nan_d(LL)) {
+      if (self->verbosity) {
+        VL_PRINTF("gmm: em: terminating because the expectation step "
+                  "failed: %s\n", vl_get_last_error_message()) ;
+      }
+      break ;
+    }
 
     /*
      Check the termination conditions.
@@ -1308,6 +1871,157 @@ VL_XCAT(_vl_gmm_em_, SFX)
 }
 
 
+/* ---------------------------------------------------------------- */
+/*                                                        Online EM */
+/* ---------------------------------------------------------------- */
+
+static double
+VL_XCAT(_vl_gmm_push_batch_, SFX)
+(VlGMM * self,
+ TYPE const * data,
+ vl_size numData)
+{
+  vl_size dimension = self->dimension ;
+  vl_size numClusters = self->numClusters ;
+  vl_index i_cl ;
+  vl_uindex dim, dim2 ;
+  double eta, LL ;
+  TYPE * priors = (TYPE*)self->priors ;
+  TYPE * means = (TYPE*)self->means ;
+  TYPE * covariances = (TYPE*)self->covariances ;
+  TYPE * tied = (TYPE*)self->tiedCovariance ;
+  TYPE * oldPriors, * oldMeans, * oldCovariances, * oldTied = NULL ;
+  TYPE * blendedMean ;
+
+  _vl_gmm_prepare_for_data (self, numData) ;
+
+  VL_XCAT(_vl_gmm_apply_bounds_,SFX)(self) ;
+
+  LL = VL_XCAT(_vl_gmm_get_posteriors_,SFX)
+  (self->posteriors,
+   numClusters,
+   numData,
+   self->priors,
+   self->means,
+   dimension,
+   self->covariances,
+   self->tiedCovariance,
+   self->covarianceType,
+   data,
+   self->fastExp) ;
+  if (vl_is_nan_d(LL)) return LL ;
+
+  /* the first batch replaces the initial parameters */
+  eta = (self->numBatches == 0) ? 1.0 : pow(self->numBatches + 1, - self->stepDecay) ;
+
+  oldPriors = vl_malloc(sizeof(TYPE) * numClusters) ;
+  oldMeans = vl_malloc(sizeof(TYPE) * numClusters * dimension) ;
+  oldCovariances = vl_malloc(sizeof(TYPE) * numClusters * dimension) ;
+  blendedMean = vl_malloc(sizeof(TYPE) * dimension) ;
+  memcpy(oldPriors, priors, sizeof(TYPE) * numClusters) ;
+  memcpy(oldMeans, means, sizeof(TYPE) * numClusters * dimension) ;
+  memcpy(oldCovariances, covariances, sizeof(TYPE) * numClusters * dimension) ;
+  if (self->covarianceType == VlGMMTied) {
+    oldTied = vl_malloc(sizeof(TYPE) * dimension * dimension) ;
+    memcpy(oldTied, tied, sizeof(TYPE) * dimension * dimension) ;
+  }
+
+  /* estimate the parameters from the batch alone */
+  VL_XCAT(_vl_gmm_maximization_, SFX)
+    (self,self->posteriors,priors,covariances,means,data,numData) ;
+
+  /*
+    Blend the batch estimates with the old ones. The covariances are
+    blended as second order moments, which amounts to adding the
+    spread of the old and batch means around the new mean.
+  */
+  if (self->covarianceType == VlGMMTied) {
+    for (dim = 0 ; dim < dimension * dimension ; ++dim) {
+      tied[dim] = (1 - eta) * oldTied[dim] + eta * tied[dim] ;
+    }
+  }
+
+  for (i_cl = 0 ; i_cl < (signed)numClusters ; ++i_cl) {
+    TYPE oldMass = (1 - eta) * oldPriors[i_cl] ;
+    TYPE newMass = eta * priors[i_cl] ;
+    TYPE mass = oldMass + newMass ;
+    TYPE * mu = means + i_cl * dimension ;
+    TYPE * sigma = covariances + i_cl * dimension ;
+    TYPE const * oldMu = oldMeans + i_cl * dimension ;
+    TYPE const * oldSigma = oldCovariances + i_cl * dimension ;
+    TYPE spread = 0 ;
+
+    priors[i_cl] = mass ;
+    if (mass <= 0) {
+      memcpy(mu, oldMu, sizeof(TYPE) * dimension) ;
+      memcpy(sigma, oldSigma, sizeof(TYPE) * dimension) ;
+      continue ;
+    }
+
+    for (dim = 0 ; dim < dimension ; ++dim) {
+      blendedMean[dim] = (oldMass * oldMu[dim] + newMass * mu[dim]) / mass ;
+    }
+
+    switch (self->covarianceType) {
+      case VlGMMDiagonal:
+        for (dim = 0 ; dim < dimension ; ++dim) {
+          TYPE oldDelta = oldMu[dim] - blendedMean[dim] ;
+          TYPE newDelta = mu[dim] - blendedMean[dim] ;
+          sigma[dim] = (oldMass * (oldSigma[dim] + oldDelta * oldDelta) +
+                        newMass * (sigma[dim] + newDelta * newDelta)) / mass ;
+        }
+        break ;
+
+      case VlGMMSpherical:
+        for (dim = 0 ; dim < dimension ; ++dim) {
+          TYPE oldDelta = oldMu[dim] - blendedMean[dim] ;
+          TYPE newDelta = mu[dim] - blendedMean[dim] ;
+          spread += oldMass * oldDelta * oldDelta + newMass * newDelta * newDelta ;
+        }
+        spread /= mass * dimension ;
+        for (dim = 0 ; dim < dimension ; ++dim) {
+          sigma[dim] = (oldMass * oldSigma[dim] + newMass * sigma[dim]) / mass + spread ;
+        }
+        break ;
+
+      case VlGMMTied:
+        /* add the spread of the means to the lower triangle */
+        for (dim = 0 ; dim < dimension ; ++dim) {
+          TYPE oldDelta = oldMu[dim] - blendedMean[dim] ;
+          TYPE newDelta = mu[dim] - blendedMean[dim] ;
+          for (dim2 = 0 ; dim2 <= dim ; ++dim2) {
+            tied[dim * dimension + dim2] +=
+              oldMass * oldDelta * (oldMu[dim2] - blendedMean[dim2]) +
+              newMass * newDelta * (mu[dim2] - blendedMean[dim2]) ;
+          }
+        }
+        break ;
+    }
+
+    memcpy(mu, blendedMean, sizeof(TYPE) * dimension) ;
+  }
+
+  if (self->covarianceType == VlGMMTied) {
+    for (dim = 0 ; dim < dimension ; ++dim) {
+      for (dim2 = 0 ; dim2 < dim ; ++dim2) {
+        tied[dim2 * dimension + dim] = tied[dim * dimension + dim2] ;
+      }
+    }
+    vl_free(oldTied) ;
+  }
+
+  VL_XCAT(_vl_gmm_apply_bounds_,SFX)(self) ;
+
+  vl_free(oldPriors) ;
+  vl_free(oldMeans) ;
+  vl_free(oldCovariances) ;
+  vl_free(blendedMean) ;
+
+  self->numBatches ++ ;
+  self->LL = LL ;
+  return LL ;
+}
+
 /* ---------------------------------------------------------------- */
 /*                                Kmeans initialization of mixtures */
 /* ---------------------------------------------------------------- */
@@ -1428,6 +2142,22 @@ VL_XCAT(_vl_gmm_init_with_rand_data_, SFX)
 
   /* initialize diagonals of covariance matrices to data covariance */
   VL_XCAT(_vl_gmm_compute_init_sigma_, SFX) (self, data, self->covariances, self->dimension, numData);
+  if (self->covarianceType == VlGMMSpherical) {
+    TYPE sigma2 = 0 ;
+    for(dim = 0; dim < self->dimension; dim++) {
+      sigma2 += *((TYPE*)self->covariances + dim) / self->dimension ;
+    }
+    for(dim = 0; dim < self->dimension; dim++) {
+      *((TYPE*)self->covariances + dim) = sigma2 ;
+    }
+  }
+  if (self->covarianceType == VlGMMTied) {
+    memset(self->tiedCovariance, 0, sizeof(TYPE) * self->dimension * self->dimension) ;
+    for(dim = 0; dim < self->dimension; dim++) {
+      *((TYPE*)self->tiedCovariance + dim * (self->dimension + 1)) =
+      *((TYPE*)self->covariances + dim) ;
+    }
+  }
   for (k = 1 ; k < self->numClusters ; ++ k) {
     for(dim = 0; dim < self->dimension; dim++) {
       *((TYPE*)self->covariances + k * self->dimension + dim) =
@@ -1486,10 +2216,15 @@ vl_gmm_new_copy (VlGMM const * self)
   gmm->maxNumIterations = self->maxNumIterations;
   gmm->numRepetitions = self->numRepetitions;
   gmm->verbosity = self->verbosity;
+  gmm->covarianceType = self->covarianceType;
   gmm->LL = self->LL;
+  gmm->numBatches = self->numBatches;
+  gmm->stepDecay = self->stepDecay;
+  gmm->fastExp = self->fastExp;
 
   memcpy(gmm->means, self->means, size*self->numClusters*self->dimension);
   memcpy(gmm->covariances, self->covariances, size*self->numClusters*self->dimension);
+  memcpy(gmm->tiedCovariance, self->tiedCovariance, size*self->dimension*self->dimension);
   memcpy(gmm->priors, self->priors, size*self->numClusters);
   return gmm ;
 }
@@ -1561,6 +2296,7 @@ double vl_gmm_cluster (VlGMM * self,
   void * bestPriors = NULL ;
   void * bestMeans = NULL;
   void * bestCovariances = NULL;
+  void * bestTiedCovariance = NULL;
   void * bestPosteriors = NULL;
   vl_size size = vl_get_type_size(self->dataType) ;
   double bestLL = -VL_INFINITY_D;
@@ -1571,6 +2307,7 @@ double vl_gmm_cluster (VlGMM * self,
   bestPriors = vl_malloc(size * self->numClusters) ;
   bestMeans = vl_malloc(size * self->dimension * self->numClusters) ;
   bestCovariances = vl_malloc(size * self->dimension * self->numClusters) ;
+  bestTiedCovariance = vl_malloc(size * self->dimension * self->dimension) ;
   bestPosteriors = vl_malloc(size * self->numClusters * numData) ;
 
 #if 0
@@ -1621,6 +2358,10 @@ double vl_gmm_cluster (VlGMM * self,
       bestCovariances = self->covariances ;
       self->covariances = temp ;
 
+      temp = bestTiedCovariance ;
+      bestTiedCovariance = self->tiedCovariance ;
+      self->tiedCovariance = temp ;
+
       temp = bestPosteriors ;
       bestPosteriors = self->posteriors ;
       self->posteriors = temp ;
@@ -1632,11 +2373,13 @@ double vl_gmm_cluster (VlGMM * self,
   vl_free (self->priors) ;
   vl_free (self->means) ;
   vl_free (self->covariances) ;
+  vl_free (self->tiedCovariance) ;
   vl_free (self->posteriors) ;
 
   self->priors = bestPriors ;
   self->means = bestMeans ;
   self->covariances = bestCovariances ;
+  self->tiedCovariance = bestTiedCovariance ;
   self->posteriors = bestPosteriors ;
   self->LL = bestLL;
 
@@ -1651,6 +2394,11 @@ double vl_gmm_cluster (VlGMM * self,
  ** @param self GMM object instance.
  ** @param data data points which should be clustered.
  ** @param numData number of data points.
+ ** @return log-likelihood of the data.
+ **
+ ** With the ::VlGMMTied type, if the shared covariance is not
+ ** positive definite, the function stops, sets the last error and
+ ** returns NaN.
  **/
 
 double vl_gmm_em (VlGMM * self, void const * data, vl_size numData)
@@ -1666,6 +2414,39 @@ double vl_gmm_em (VlGMM * self, void const * data, vl_size numData)
   return 0 ;
 }
 
+/** @brief Update the GMM with a batch of data (online EM).
+ ** @param self GMM object instance.
+ ** @param data batch of data points.
+ ** @param numData number of data points in the batch.
+ ** @return log-likelihood of the batch before the update.
+ **
+ ** The function runs one step of online EM (@ref gmm-online) on the
+ ** batch. The GMM must have been initialized before, for example by
+ ** calling ::vl_gmm_init_with_rand_data on the first batch. The
+ ** function can then be called repeatedly as new data becomes
+ ** available; the data does not need to be retained after the call
+ ** returns. The posteriors of the last batch can be retrieved by
+ ** ::vl_gmm_get_posteriors. ::vl_gmm_reset restarts the step size
+ ** schedule.
+ **
+ ** As for ::vl_gmm_em, if the shared covariance of a ::VlGMMTied
+ ** model is not positive definite, the model is not updated and the
+ ** function returns NaN.
+ **/
+
+double vl_gmm_push_batch (VlGMM * self, void const * data, vl_size numData)
+{
+  switch (self->dataType) {
+    case VL_TYPE_FLOAT:
+      return _vl_gmm_push_batch_f (self, (float const *)data, numData) ; break ;
+    case VL_TYPE_DOUBLE:
+      return _vl_gmm_push_batch_d (self, (double const *)data, numData) ; break ;
+    default:
+      abort() ;
+  }
+  return 0 ;
+}
+
 /** @brief Explicitly set the initial means for EM.
  ** @param self GMM object instance.
  ** @param means initial values of means.
@@ -1689,6 +2470,20 @@ void vl_gmm_set_covariances (VlGMM * self, void const * covariances)
          self->dimension * self->numClusters * vl_get_type_size(self->dataType));
 }
 
+/** @brief Explicitly set the initial shared covariance for EM.
+ ** @param self GMM object instance.
+ ** @param covariance initial value of the shared covariance matrix.
+ **
+ ** The matrix is used with the ::VlGMMTied covariance type and has
+ ** size @c dimension x @c dimension.
+ **/
+
+void vl_gmm_set_tied_covariance (VlGMM * self, void const * covariance)
+{
+  memcpy(self->tiedCovariance,covariance,
+         self->dimension * self->dimension * vl_get_type_size(self->dataType));
+}
+
 /** @brief Explicitly set the initial priors of the gaussians.
  ** @param self GMM object instance.
  ** @param priors initial values of the gaussian priors.
@@ -25,6 +25,14 @@ typedef enum _VlGMMInitialization
   VlGMMCustom  /**< User specifies the initial GMM parameters. */
 } VlGMMInitialization ;
 
+/** @brief GMM covariance types */
+typedef enum _VlGMMCovarianceType
+{
+  VlGMMDiagonal,  /**< A diagonal covariance per mode (default). */
+  VlGMMSpherical, /**< An isotropic covariance per mode. */
+  VlGMMTied       /**< A full covariance shared by all the modes. */
+} VlGMMCovarianceType ;
+
 
 #ifndef __DOXYGEN__
 struct _VlGMM ;
@@ -71,6 +79,12 @@ vl_gmm_init_with_kmeans
 
 VL_EXPORT double
 vl_gmm_em
+(VlGMM * self,
+ void const * data,
+ vl_size numData);
+
+VL_EXPORT double
+vl_gmm_push_batch
 (VlGMM * self,
  void const * data,
  vl_size numData);
@@ -91,6 +105,11 @@ vl_gmm_set_priors
 (VlGMM * self,
  void const * priors);
 
+VL_EXPORT void
+vl_gmm_set_tied_covariance
+(VlGMM * self,
+ void const * covariance);
+
 VL_EXPORT double
 vl_get_gmm_data_posteriors_f(float * posteriors,
                              vl_size numClusters,
@@ -122,6 +141,9 @@ VL_EXPORT void vl_gmm_set_initialization (VlGMM * self, VlGMMInitialization init
 VL_EXPORT void vl_gmm_set_kmeans_init_object (VlGMM * self, VlKMeans * kmeans);
 VL_EXPORT void vl_gmm_set_covariance_lower_bounds (VlGMM * self, double const * bounds);
 VL_EXPORT void vl_gmm_set_covariance_lower_bound (VlGMM * self, double bound) ;
+VL_EXPORT void vl_gmm_set_covariance_type (VlGMM * self, VlGMMCovarianceType type) ;
+VL_EXPORT void vl_gmm_set_step_decay (VlGMM * self, double decay) ;
+VL_EXPORT void vl_gmm_set_fast_exp (VlGMM * self, vl_bool fastExp) ;
 /** @} */
 
 /** @name Get parameters
@@ -129,6 +151,7 @@ VL_EXPORT void vl_gmm_set_covariance_lower_bound (VlGMM * self, double bound) ;
  **/
 VL_EXPORT void const * vl_gmm_get_means (VlGMM const * self);
 VL_EXPORT void const * vl_gmm_get_covariances (VlGMM const * self);
+VL_EXPORT void const * vl_gmm_get_tied_covariance (VlGMM const * self);
 VL_EXPORT void const * vl_gmm_get_priors (VlGMM const * self);
 VL_EXPORT void const * vl_gmm_get_posteriors (VlGMM const * self);
 VL_EXPORT vl_type vl_gmm_get_data_type (VlGMM const * self);
@@ -143,6 +166,10 @@ VL_EXPORT vl_size vl_gmm_get_num_repetitions (VlGMM const * self);
 VL_EXPORT VlGMMInitialization vl_gmm_get_initialization (VlGMM const * self);
 VL_EXPORT VlKMeans * vl_gmm_get_kmeans_init_object (VlGMM const * self);
 VL_EXPORT double const * vl_gmm_get_covariance_lower_bounds (VlGMM const * self);
+VL_EXPORT VlGMMCovarianceType vl_gmm_get_covariance_type (VlGMM const * self);
+VL_EXPORT double vl_gmm_get_step_decay (VlGMM const * self);
+VL_EXPORT vl_size vl_gmm_get_num_batches (VlGMM const * self);
+VL_EXPORT vl_bool vl_gmm_get_fast_exp (VlGMM const * self);
 /** @} */
 
 /* VL_GMM_H */
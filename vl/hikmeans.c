@@ -31,6 +31,35 @@ the terms of the BSD license (see the COPYING file).
  ** contains a tree composed of ::VlHIKMNode. Each node is an
  ** integer K-means filter which partitions the data into @c K
  ** clusters.
+ **
+ ** @section hikm-parallel Parallel training
+ **
+ ** The root node is trained first, using all threads to assign the
+ ** data to its centers. The subtrees are then independent and
+ ** ::vl_hikm_train() clusters them as concurrent OpenMP tasks. Rather
+ ** than copying the data of each subtree, nodes pass down lists of
+ ** indexes into the training data. Each subtree is initialized from
+ ** its own seed, so the result does not depend on the number of
+ ** threads. Since the tasks allocate the tree nodes, the memory
+ ** allocation functions (see ::vl_set_alloc_func) must be thread
+ ** safe.
+ **
+ ** @section hikm-flat Flat layout
+ **
+ ** After training, ::vl_hikm_flatten() freezes the tree in a flat
+ ** layout (::VlHIKMFlatLevel). All the centers of a level are
+ ** stored as bytes in a single array and the children are
+ ** addressed by index instead of by pointer. ::vl_hikm_push() then
+ ** processes the data one level at a time. At each level the data
+ ** are sorted by node, so that the centers of a node are read once
+ ** for all the data that reach it, and the distances are computed
+ ** with SIMD instructions. The assignments are the same as with the
+ ** linked tree.
+ **
+ ** ::vl_hikm_save() writes the flat layout to a file and
+ ** ::vl_hikm_load() maps it back in memory with no per-node
+ ** allocation. A loaded tree can only be used to push data: it has
+ ** no root (::vl_hikm_get_root() returns @c NULL).
  **/
 
 #include <stdio.h>
@@ -40,110 +69,216 @@ the terms of the BSD license (see the COPYING file).
 
 #include "hikmeans.h"
 
+#include "random.h"
+#include "mathop.h"
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+/* subsets not larger than this are clustered by the parent task */
+#define VL_HIKM_PARALLEL_TRAIN_SIZE 1024
+
 /** ------------------------------------------------------------------
  ** @internal
  ** @brief Copy a subset of the data to a buffer
  ** @param data Data
- ** @param ids Data labels
- ** @param N Number of indices
+ ** @param indexes Indexes of the data to copy
+ ** @param N Number of indexes
  ** @param M Data dimensionality
- ** @param id Label of data to copy
- ** @param N2 Number of data copied (out)
  ** @return a new buffer with a copy of the selected data.
  **/
 
-vl_uint8*
+static vl_uint8*
 vl_hikm_copy_subset (vl_uint8 const * data,
-                     vl_uint32 *ids,
-                     vl_size N, vl_size M,
-                     vl_uint32 id, vl_size *N2)
+                     vl_uint32 const * indexes,
+                     vl_size N, vl_size M)
 {
   vl_uindex i ;
-  vl_size count = 0;
-
-  /* count how many data points with this label there are */
-  for (i = 0 ; i < N ; i++) {
-    if (ids[i] == id) {
-      count ++ ;
-    }
-  }
-  *N2 = count ;
-
-  /* copy each datum to the buffer */
-  {
-    vl_uint8 *new_data = vl_malloc (sizeof(*new_data) * M * count);
-    count = 0;
-    for (i = 0 ; i < N ; i ++) {
-      if (ids[i] == id) {
-        memcpy(new_data + count * M,
-               data + i * M,
-               sizeof(*new_data) * M);
-        count ++ ;
-      }
-    }
-    *N2 = count ;
-    return new_data ;
+  vl_uint8 *new_data = vl_malloc (sizeof(*new_data) * M * N) ;
+  for (i = 0 ; i < N ; i ++) {
+    memcpy(new_data + i * M,
+           data + (vl_uindex)indexes[i] * M,
+           sizeof(*new_data) * M);
   }
+  return new_data ;
 }
 
 /** ------------------------------------------------------------------
- ** @brief Compute HIKM clustering.
- **
- ** @param tree   HIKM tree to initialize.
- ** @param data   Data to cluster.
- ** @param N      Number of data points.
- ** @param K      Number of clusters for this node.
- ** @param height Tree height.
+ ** @internal
+ ** @brief Train a HIKM node
  **
- ** @remark height cannot be smaller than 1.
+ ** @param tree    HIKM tree.
+ ** @param data    Training data.
+ ** @param indexes Indexes of the data of this node (or @c NULL for all).
+ ** @param N       Number of data points.
+ ** @param K       Number of clusters for this node.
+ ** @param ids     Assignments of the data to the clusters (out, or @c NULL).
  **
- ** @return a new HIKM node representing a sub-clustering.
+ ** @return a new HIKM node without children.
  **/
 
 static VlHIKMNode *
-xmeans (VlHIKMTree *tree,
-        vl_uint8 const *data,
-        vl_size N, vl_size K, vl_size height)
+xmeans_node (VlHIKMTree *tree,
+             vl_uint8 const *data,
+             vl_uint32 const *indexes,
+             vl_size N, vl_size K,
+             vl_uint32 *ids)
 {
   VlHIKMNode *node = vl_malloc (sizeof(*node)) ;
-  vl_uint32 *ids = vl_malloc (sizeof(*ids) * N) ;
+  vl_uint8 *subset = NULL ;
+
+  if (indexes) {
+    subset = vl_hikm_copy_subset (data, indexes, N, tree->M) ;
+    data = subset ;
+  }
 
   node->filter = vl_ikm_new (tree -> method) ;
-  node->children = (height == 1) ? 0 : vl_malloc (sizeof(*node->children) * K) ;
+  node->children = NULL ;
 
   vl_ikm_set_max_niters (node->filter, tree->max_niters) ;
   vl_ikm_set_verbosity  (node->filter, tree->verb - 1  ) ;
   vl_ikm_init_rand_data (node->filter, data, tree->M, N, K) ;
   vl_ikm_train (node->filter, data, N) ;
-  vl_ikm_push (node->filter, ids, data, N) ;
+  if (ids) {
+    vl_ikm_push (node->filter, ids, data, N) ;
+  }
 
-  /* recursively process each child */
-  if (height > 1) {
-    vl_uindex k ;
-    for (k = 0 ; k < K ; ++k) {
-      vl_size partition_N ;
-      vl_size partition_K ;
-      vl_uint8 *partition ;
+  vl_free (subset) ;
+  return node ;
+}
 
-      partition = vl_hikm_copy_subset
-        (data, ids, N, tree->M, (vl_uint32)k, &partition_N) ;
+static VlHIKMNode *
+xmeans (VlHIKMTree *tree,
+        vl_uint8 const *data,
+        vl_uint32 *indexes,
+        vl_size N, vl_size K, vl_size height) ;
 
-      partition_K = VL_MIN (K, partition_N) ;
+/** ------------------------------------------------------------------
+ ** @internal
+ ** @brief Compute the children of a HIKM node
+ **
+ ** @param tree    HIKM tree.
+ ** @param node    HIKM node.
+ ** @param data    Training data.
+ ** @param indexes Indexes of the data of the node (in/out).
+ ** @param ids     Assignments of the data to the node clusters.
+ ** @param seeds   Seeds of the random generator for each child.
+ ** @param N       Number of data points.
+ ** @param K       Number of clusters of the node.
+ ** @param height  Height of the node.
+ **
+ ** The function sorts @a indexes by cluster and clusters each
+ ** subset recursively. Large subsets are processed by separate
+ ** tasks.
+ **/
 
-      node->children [k] = xmeans
-        (tree, partition, partition_N, partition_K, height - 1) ;
+static void
+xmeans_split (VlHIKMTree *tree,
+              VlHIKMNode *node,
+              vl_uint8 const *data,
+              vl_uint32 *indexes,
+              vl_uint32 const *ids,
+              vl_uint32 const *seeds,
+              vl_size N, vl_size K, vl_size height)
+{
+  vl_uindex i, k ;
+  vl_size numCompleted = 0 ;
+  vl_size *begins = vl_malloc (sizeof(*begins) * (K + 1)) ;
+  vl_uint32 *sorted = vl_malloc (sizeof(*sorted) * N) ;
+
+  /* sort the indexes by cluster (counting sort) */
+  memset (begins, 0, sizeof(*begins) * (K + 1)) ;
+  for (i = 0 ; i < N ; ++i) {
+    begins [ids[i] + 1] ++ ;
+  }
+  for (k = 0 ; k < K ; ++k) {
+    begins [k + 1] += begins [k] ;
+  }
+  for (i = 0 ; i < N ; ++i) {
+    sorted [begins [ids[i]] ++] = indexes [i] ;
+  }
+  memcpy (indexes, sorted, sizeof(*indexes) * N) ;
+  vl_free (sorted) ;
+  for (k = K ; k > 0 ; --k) {
+    begins [k] = begins [k - 1] ;
+  }
+  begins [0] = 0 ;
 
-      vl_free (partition) ;
+  /* recursively process each child */
+  node->children = vl_malloc (sizeof(*node->children) * K) ;
+  for (k = 0 ; k < K ; ++k) {
+    vl_size partition_N = begins [k + 1] - begins [k] ;
+    vl_size partition_K = VL_MIN (K, partition_N) ;
+#if defined(_OPENMP)
+#pragma omp task default(shared) firstprivate(k, partition_N, partition_K) \
+    if(partition_N > VL_HIKM_PARALLEL_TRAIN_SIZE)
+#endif
+    {
+      vl_rand_seed (vl_get_rand(), seeds [k]) ;
+      node->children [k] = xmeans
+        (tree, data, indexes + begins [k], partition_N, partition_K, height - 1) ;
 
       if (tree->verb > (signed)tree->depth - (signed)height) {
-        VL_PRINTF("hikmeans: branch at depth %d: %6.1f %% completed\n",
-                  tree->depth - height,
-                  (double) (k+1) / K * 100) ;
+#if defined(_OPENMP)
+#pragma omp critical(vl_hikm_verbose)
+#endif
+        {
+          numCompleted ++ ;
+          VL_PRINTF("hikmeans: branch at depth %d: %6.1f %% completed\n",
+                    tree->depth - height,
+                    (double) numCompleted / K * 100) ;
+        }
       }
     }
   }
+#if defined(_OPENMP)
+#pragma omp taskwait
+#endif
+  vl_free (begins) ;
+}
 
-  vl_free (ids) ;
+/** ------------------------------------------------------------------
+ ** @brief Compute HIKM clustering.
+ **
+ ** @param tree    HIKM tree to initialize.
+ ** @param data    Data to cluster.
+ ** @param indexes Indexes of the data of this node.
+ ** @param N       Number of data points.
+ ** @param K       Number of clusters for this node.
+ ** @param height  Tree height.
+ **
+ ** @remark height cannot be smaller than 1.
+ **
+ ** @return a new HIKM node representing a sub-clustering.
+ **/
+
+static VlHIKMNode *
+xmeans (VlHIKMTree *tree,
+        vl_uint8 const *data,
+        vl_uint32 *indexes,
+        vl_size N, vl_size K, vl_size height)
+{
+  VlHIKMNode *node ;
+  vl_uint32 *ids = NULL ;
+  vl_uint32 *seeds = NULL ;
+  vl_uindex k ;
+
+  if (height > 1) {
+    ids = vl_malloc (sizeof(*ids) * N) ;
+  }
+  node = xmeans_node (tree, data, indexes, N, K, ids) ;
+
+  if (height > 1) {
+    /* draw the seeds before spawning tasks that reuse this thread */
+    seeds = vl_malloc (sizeof(*seeds) * K) ;
+    for (k = 0 ; k < K ; ++k) {
+      seeds [k] = vl_rand_uint32 (vl_get_rand()) ;
+    }
+    xmeans_split (tree, node, data, indexes, ids, seeds, N, K, height) ;
+    vl_free (seeds) ;
+    vl_free (ids) ;
+  }
   return node ;
 }
 
@@ -173,6 +308,33 @@ xdelete (VlHIKMNode *node)
   }
 }
 
+/** ------------------------------------------------------------------
+ ** @internal
+ ** @brief Delete the flat layout of a tree
+ ** @param f HIKM tree.
+ **/
+
+static void
+vl_hikm_free_levels (VlHIKMTree *f)
+{
+  vl_uindex d ;
+  if (f->mappedFile) {
+    /* the levels point into the file */
+    _vl_unmap_file (f->mappedFile, f->mappedFileSize) ;
+    f->mappedFile = NULL ;
+    f->mappedFileSize = 0 ;
+  } else if (f->levels) {
+    for (d = 0 ; d < f->depth ; ++d) {
+      vl_free (f->levels[d].centerOffsets) ;
+      vl_free (f->levels[d].centers) ;
+    }
+  }
+  if (f->levels) {
+    vl_free (f->levels) ;
+    f->levels = NULL ;
+  }
+}
+
 /** ------------------------------------------------------------------
  ** @brief New HIKM tree
  ** @param method clustering method.
@@ -198,6 +360,7 @@ vl_hikm_delete (VlHIKMTree *f)
 {
   if (f) {
     xdelete (f->root) ;
+    vl_hikm_free_levels (f) ;
     vl_free (f) ;
   }
 }
@@ -221,6 +384,7 @@ vl_hikm_init (VlHIKMTree *f, vl_size M, vl_size K, vl_size depth)
   assert(K > 0) ;
 
   xdelete (f -> root) ;
+  vl_hikm_free_levels (f) ;
   f->root = 0;
   f->M = M ;
   f->K = K ;
@@ -237,7 +401,130 @@ vl_hikm_init (VlHIKMTree *f, vl_size M, vl_size K, vl_size depth)
 void
 vl_hikm_train (VlHIKMTree *f, vl_uint8 const *data, vl_size N)
 {
-  f->root= xmeans (f, data, N, VL_MIN(f->K, N), f->depth) ;
+  vl_size K = VL_MIN(f->K, N) ;
+  vl_uint32 *ids = NULL ;
+  vl_uint32 *seeds ;
+  vl_uint32 *indexes ;
+  vl_uindex i ;
+
+  assert (N <= 0xffffffff) ;
+
+  /* a previous flat layout would be stale */
+  vl_hikm_free_levels (f) ;
+
+  /* the root is trained using all the threads for each step */
+  if (f->depth == 1) {
+    f->root = xmeans_node (f, data, NULL, N, K, NULL) ;
+    return ;
+  }
+  ids = vl_malloc (sizeof(*ids) * N) ;
+  f->root = xmeans_node (f, data, NULL, N, K, ids) ;
+
+  seeds = vl_malloc (sizeof(*seeds) * K) ;
+  indexes = vl_malloc (sizeof(*indexes) * N) ;
+  for (i = 0 ; i < K ; ++i) {
+    seeds [i] = vl_rand_uint32 (vl_get_rand()) ;
+  }
+  for (i = 0 ; i < N ; ++i) {
+    indexes [i] = (vl_uint32) i ;
+  }
+
+  /* the subtrees are trained by concurrent tasks */
+#if defined(_OPENMP)
+#pragma omp parallel default(shared) num_threads(vl_get_max_threads())
+#pragma omp single
+#endif
+  xmeans_split (f, f->root, data, indexes, ids, seeds, N, K, f->depth) ;
+
+  vl_free (indexes) ;
+  vl_free (seeds) ;
+  vl_free (ids) ;
+}
+
+/** ------------------------------------------------------------------
+ ** @internal
+ ** @brief Project data down the flat layout of a HIKM tree
+ ** @param f HIKM tree.
+ ** @param asgn Path down the tree (out).
+ ** @param data Data to project.
+ ** @param N Number of data.
+ **
+ ** The data are processed one level at a time. Before moving to the
+ ** next level they are sorted by node (counting sort), so that the
+ ** data reaching the same node are processed together.
+ **/
+
+static void
+vl_hikm_push_flat (VlHIKMTree *f, vl_uint32 *asgn, vl_uint8 const *data, vl_size N)
+{
+  vl_index p ;
+  vl_uindex i, d, c ;
+  vl_size M = f->M ;
+  vl_size depth = f->depth ;
+  vl_uint32 const none = (vl_uint32) -1 ;
+  vl_uint32 *nodes = vl_malloc (sizeof(*nodes) * N) ;
+  vl_uint32 *order = vl_malloc (sizeof(*order) * N) ;
+  vl_uint32 *sorted = vl_malloc (sizeof(*sorted) * N) ;
+  VlIKMDistanceFunction distance = _vl_ikm_get_distance_function () ;
+
+  for (i = 0 ; i < N ; ++i) {
+    nodes [i] = 0 ;
+    order [i] = (vl_uint32) i ;
+  }
+
+  for (d = 0 ; d < depth ; ++d) {
+    VlHIKMFlatLevel const *level = f->levels + d ;
+
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(p,i,c) \
+    num_threads(vl_get_max_threads())
+#endif
+    for (p = 0 ; p < (signed)N ; ++p) {
+      vl_uint32 begin, end, best = 0 ;
+      vl_uint32 bestDist = 0 ;
+      vl_uint8 const *x ;
+      i = order [p] ;
+      if (nodes [i] == none) {
+        asgn [i * depth + d] = 0 ;
+        continue ;
+      }
+      x = data + i * M ;
+      begin = level->centerOffsets [nodes [i]] ;
+      end = level->centerOffsets [nodes [i] + 1] ;
+      for (c = begin ; c < end ; ++c) {
+        vl_uint32 dist = distance (M, x, level->centers + c * M) ;
+        if (c == begin || dist < bestDist) {
+          best = (vl_uint32) (c - begin) ;
+          bestDist = dist ;
+        }
+      }
+      asgn [i * depth + d] = best ;
+      /* the child of center c is node c of the next level */
+      nodes [i] = (begin < end) ? begin + best : none ;
+    }
+
+    /* sort the data by node of the next level */
+    if (d + 1 < depth) {
+      vl_size numNodes = f->levels [d + 1].numNodes ;
+      vl_size *begins = vl_calloc (numNodes + 2, sizeof(*begins)) ;
+      for (i = 0 ; i < N ; ++i) {
+        begins [(nodes[i] == none ? numNodes : nodes[i]) + 1] ++ ;
+      }
+      for (c = 0 ; c < numNodes + 1 ; ++c) {
+        begins [c + 1] += begins [c] ;
+      }
+      for (p = 0 ; p < (signed)N ; ++p) {
+        i = order [p] ;
+        sorted [begins [nodes[i] == none ? numNodes : nodes[i]] ++] = (vl_uint32) i ;
+      }
+      memcpy (order, sorted, sizeof(*order) * N) ;
+      vl_free (begins) ;
+    }
+  }
+
+  vl_free (sorted) ;
+  vl_free (order) ;
+  vl_free (nodes) ;
 }
 
 /** ------------------------------------------------------------------
@@ -251,32 +538,359 @@ vl_hikm_train (VlHIKMTree *f, vl_uint8 const *data, vl_size N)
  ** down the HIKM tree @a f. The parameter @a asgn must point to
  ** an array of @c M by @c N elements, where @c M is the depth of
  ** the HIKM tree and @c N is the number of data point to process.
+ **
+ ** If the tree has a flat layout (::vl_hikm_flatten), the function
+ ** uses it. In both layouts, the entries of the levels below a node
+ ** without centers (trained on no data) are set to zero.
  **/
 
 void
 vl_hikm_push (VlHIKMTree *f, vl_uint32 *asgn, vl_uint8 const *data, vl_size N)
 {
-  vl_uindex i, d ;
+  vl_index i ;
+  vl_uindex d ;
   vl_size M = vl_hikm_get_ndims (f) ;
   vl_size depth = vl_hikm_get_depth (f) ;
 
-  /* for each datum */
-  for(i = 0 ; i < N ; i++) {
+  if (f->levels) {
+    vl_hikm_push_flat (f, asgn, data, N) ;
+    return ;
+  }
+
+  /* for each datum; each call to vl_ikm_push() below is serial */
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(i,d) \
+    num_threads(vl_get_max_threads())
+#endif
+  for(i = 0 ; i < (signed)N ; i++) {
     VlHIKMNode *node = f->root ;
-    d = 0 ;
-    while (node) {
-      vl_uint32 best ;
-      vl_ikm_push (node->filter,
-                   &best,
-                   data + i * M, 1) ;
+    for (d = 0 ; d < depth ; ++d) {
+      vl_uint32 best = 0 ;
+      if (node && vl_ikm_get_K (node->filter) > 0) {
+        vl_ikm_push (node->filter,
+                     &best,
+                     data + i * M, 1) ;
+        node = node->children ? node->children [best] : NULL ;
+      } else {
+        node = NULL ;
+      }
       asgn[i * depth + d] = best ;
-      ++ d ;
-      if (!node->children) break ;
-      node = node->children [best] ;
     }
   }
 }
 
+/** ------------------------------------------------------------------
+ ** @brief Freeze a HIKM tree in the flat layout
+ ** @param f HIKM tree.
+ **
+ ** The function builds the flat layout of a trained tree (see @ref
+ ** hikm-flat), which ::vl_hikm_push uses from then on. The linked
+ ** tree is kept. The centers must be in the range 0-255, as it is
+ ** the case after training.
+ **/
+
+void
+vl_hikm_flatten (VlHIKMTree *f)
+{
+  VlHIKMNode **nodes ;
+  VlHIKMNode **nextNodes ;
+  vl_uindex d, j, k, i ;
+  vl_size numNodes = 1 ;
+
+  assert (f->root) ;
+  vl_hikm_free_levels (f) ;
+  f->levels = vl_calloc (f->depth, sizeof(*f->levels)) ;
+
+  nodes = vl_malloc (sizeof(*nodes)) ;
+  nodes [0] = f->root ;
+
+  for (d = 0 ; d < f->depth ; ++d) {
+    VlHIKMFlatLevel *level = f->levels + d ;
+    vl_size numCenters = 0 ;
+
+    for (j = 0 ; j < numNodes ; ++j) {
+      numCenters += vl_ikm_get_K (nodes[j]->filter) ;
+    }
+    assert (numCenters <= 0xffffffff) ;
+    level->numNodes = numNodes ;
+    level->numCenters = numCenters ;
+    level->centerOffsets = vl_malloc (sizeof(*level->centerOffsets) * (numNodes + 1)) ;
+    level->centers = vl_malloc (sizeof(*level->centers) * f->M * numCenters) ;
+    nextNodes = vl_malloc (sizeof(*nextNodes) * numCenters) ;
+
+    numCenters = 0 ;
+    for (j = 0 ; j < numNodes ; ++j) {
+      VlIKMFilt const *filter = nodes[j]->filter ;
+      vl_ikmacc_t const *centers = vl_ikm_get_centers (filter) ;
+      vl_size K = vl_ikm_get_K (filter) ;
+      level->centerOffsets [j] = (vl_uint32) numCenters ;
+      for (i = 0 ; i < f->M * K ; ++i) {
+        assert (0 <= centers [i] && centers [i] <= 255) ;
+        level->centers [f->M * numCenters + i] = (vl_uint8) centers [i] ;
+      }
+      for (k = 0 ; k < K ; ++k) {
+        nextNodes [numCenters + k] = nodes[j]->children ? nodes[j]->children [k] : NULL ;
+      }
+      numCenters += K ;
+    }
+    level->centerOffsets [numNodes] = (vl_uint32) numCenters ;
+
+    vl_free (nodes) ;
+    nodes = nextNodes ;
+    numNodes = numCenters ;
+  }
+  vl_free (nodes) ;
+}
+
+/* ---------------------------------------------------------------- */
+/*                                               Saving and loading */
+/* ---------------------------------------------------------------- */
+
+#define VL_HIKM_FILE_VERSION 1
+#define VL_HIKM_FILE_ALIGNMENT 64
+
+static char const vl_hikm_file_magic [8] = {'V','L','H','I','K','M','T','R'} ;
+
+/* All offsets are in bytes from the beginning of the file and are
+   multiple of VL_HIKM_FILE_ALIGNMENT. The header is followed by one
+   VlHIKMFileLevel record per level. */
+
+typedef struct _VlHIKMFileHeader
+{
+  char magic [8] ;
+  vl_uint32 version ;
+  vl_uint32 byteOrder ;
+  vl_int32 method ;
+  vl_uint32 reserved ;
+  vl_uint64 M ;
+  vl_uint64 K ;
+  vl_uint64 depth ;
+} VlHIKMFileHeader ;
+
+typedef struct _VlHIKMFileLevel
+{
+  vl_uint64 numNodes ;
+  vl_uint64 numCenters ;
+  vl_uint64 centerOffsetsOffset ;
+  vl_uint64 centersOffset ;
+} VlHIKMFileLevel ;
+
+/** @internal @brief Reserve an aligned section of the file */
+
+static vl_uint64
+vl_hikm_file_reserve (vl_uint64 * fileSize, vl_uint64 size)
+{
+  vl_uint64 offset = (*fileSize + VL_HIKM_FILE_ALIGNMENT - 1)
+    & ~ (vl_uint64) (VL_HIKM_FILE_ALIGNMENT - 1) ;
+  *fileSize = offset + size ;
+  return offset ;
+}
+
+/** @internal @brief Write a section, padding the file up to its offset */
+
+static vl_bool
+vl_hikm_file_write (FILE * file, vl_uint64 * position,
+                    vl_uint64 offset, void const * buffer, vl_uint64 size)
+{
+  static char const padding [VL_HIKM_FILE_ALIGNMENT] = {0} ;
+  assert (offset >= *position) ;
+  assert (offset - *position <= VL_HIKM_FILE_ALIGNMENT) ;
+  if (fwrite (padding, 1, (size_t)(offset - *position), file) != offset - *position) {
+    return VL_FALSE ;
+  }
+  if (size > 0 && fwrite (buffer, 1, (size_t)size, file) != size) {
+    return VL_FALSE ;
+  }
+  *position = offset + size ;
+  return VL_TRUE ;
+}
+
+/** @internal @brief Check that a file section is within the file */
+
+static vl_bool
+vl_hikm_file_has_section (vl_size fileSize, vl_uint64 offset, vl_uint64 size)
+{
+  return offset > 0
+    && offset % VL_HIKM_FILE_ALIGNMENT == 0
+    && offset <= fileSize
+    && size <= fileSize - offset ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Save a HIKM tree to a file
+ ** @param f HIKM tree.
+ ** @param fileName name of the file to write.
+ ** @return error code.
+ **
+ ** The function writes the flat layout of the tree (see
+ ** ::vl_hikm_flatten) to a binary file that ::vl_hikm_load can map
+ ** back in memory. Arrays are written in the native byte order of
+ ** the host, which the header records.
+ **/
+
+int
+vl_hikm_save (VlHIKMTree const *f, char const *fileName)
+{
+  VlHIKMFileHeader header ;
+  VlHIKMFileLevel *fileLevels ;
+  vl_uint64 fileSize, position = 0 ;
+  vl_bool ok ;
+  vl_uindex d ;
+  FILE *file ;
+
+  assert (f->levels) ;
+
+  memset (&header, 0, sizeof(header)) ;
+  memcpy (header.magic, vl_hikm_file_magic, sizeof(header.magic)) ;
+  header.version = VL_HIKM_FILE_VERSION ;
+  header.byteOrder = 0x01020304 ;
+  header.method = f->method ;
+  header.M = f->M ;
+  header.K = f->K ;
+  header.depth = f->depth ;
+
+  /* lay out the file */
+  fileLevels = vl_calloc (sizeof(VlHIKMFileLevel), f->depth) ;
+  fileSize = sizeof(header) + sizeof(VlHIKMFileLevel) * f->depth ;
+  for (d = 0 ; d < f->depth ; ++d) {
+    VlHIKMFlatLevel const *level = f->levels + d ;
+    fileLevels[d].numNodes = level->numNodes ;
+    fileLevels[d].numCenters = level->numCenters ;
+    fileLevels[d].centerOffsetsOffset = vl_hikm_file_reserve
+      (&fileSize, sizeof(vl_uint32) * (level->numNodes + 1)) ;
+    fileLevels[d].centersOffset = vl_hikm_file_reserve
+      (&fileSize, f->M * level->numCenters) ;
+  }
+
+  file = fopen (fileName, "wb") ;
+  if (! file) {
+    vl_free (fileLevels) ;
+    return vl_set_last_error (VL_ERR_IO, "Error opening HIKM file `%s' for writing", fileName) ;
+  }
+
+  ok = vl_hikm_file_write (file, &position, 0, &header, sizeof(header)) ;
+  ok = ok && vl_hikm_file_write (file, &position, position, fileLevels,
+                                 sizeof(VlHIKMFileLevel) * f->depth) ;
+  for (d = 0 ; ok && d < f->depth ; ++d) {
+    VlHIKMFlatLevel const *level = f->levels + d ;
+    ok = ok && vl_hikm_file_write (file, &position, fileLevels[d].centerOffsetsOffset,
+                                   level->centerOffsets,
+                                   sizeof(vl_uint32) * (level->numNodes + 1)) ;
+    ok = ok && vl_hikm_file_write (file, &position, fileLevels[d].centersOffset,
+                                   level->centers, f->M * level->numCenters) ;
+  }
+  vl_free (fileLevels) ;
+
+  if (fclose (file) != 0 || ! ok) {
+    return vl_set_last_error (VL_ERR_IO, "Error writing HIKM file `%s'", fileName) ;
+  }
+  return VL_ERR_OK ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Load a HIKM tree from a file
+ ** @param fileName name of a file written by ::vl_hikm_save.
+ ** @return new HIKM tree, or @c NULL on error.
+ **
+ ** The function maps the file read-only in memory and returns a tree
+ ** whose flat layout points directly into the mapping, so that no
+ ** node is allocated. The file must not change while the tree is in
+ ** use. The tree can be used by ::vl_hikm_push but has no root.
+ **
+ ** The header, the size of each level and the center offsets are
+ ** validated. Checking the offsets reads them, but not the centers,
+ ** which make up most of the file. In case of error the function returns
+ ** @c NULL and sets the last error (see ::vl_get_last_error). The
+ ** tree is released by ::vl_hikm_delete as usual, which also unmaps
+ ** the file.
+ **/
+
+VlHIKMTree *
+vl_hikm_load (char const *fileName)
+{
+  VlHIKMFileHeader const *header ;
+  VlHIKMFileLevel const *fileLevels = NULL ;
+  VlHIKMTree *f ;
+  char const *buffer ;
+  char const *error = NULL ;
+  vl_size fileSize = 0 ;
+  vl_uindex d ;
+
+  buffer = _vl_map_file (fileName, &fileSize) ;
+  if (! buffer) {
+    vl_set_last_error (VL_ERR_IO, "Error opening HIKM file `%s' for reading", fileName) ;
+    return NULL ;
+  }
+  header = (VlHIKMFileHeader const *) buffer ;
+
+  if (fileSize < sizeof(VlHIKMFileHeader) ||
+      memcmp (header->magic, vl_hikm_file_magic, sizeof(header->magic)) != 0) {
+    error = "`%s' is not a HIKM file" ;
+  } else if (header->version != VL_HIKM_FILE_VERSION) {
+    error = "HIKM file `%s' has an unsupported version" ;
+  } else if (header->byteOrder != 0x01020304) {
+    error = "HIKM file `%s' was written by an incompatible host" ;
+  } else if (header->M < 1 || header->M > fileSize ||
+             header->K < 1 || header->K > 0xffffffff || header->depth < 1 ||
+             header->depth > (fileSize - sizeof(VlHIKMFileHeader)) / sizeof(VlHIKMFileLevel)) {
+    error = "HIKM file `%s' is corrupted" ;
+  }
+
+  if (! error) {
+    vl_uint64 numNodes = 1 ;
+    fileLevels = (VlHIKMFileLevel const *) (header + 1) ;
+    for (d = 0 ; d < header->depth ; ++d) {
+      VlHIKMFileLevel const *fileLevel = fileLevels + d ;
+      vl_bool ok =
+        fileLevel->numNodes == numNodes &&
+        fileLevel->numCenters <= 0xffffffff &&
+        vl_hikm_file_has_section (fileSize, fileLevel->centerOffsetsOffset,
+                                  sizeof(vl_uint32) * (fileLevel->numNodes + 1)) &&
+        vl_hikm_file_has_section (fileSize, fileLevel->centersOffset,
+                                  header->M * fileLevel->numCenters) ;
+      if (ok) {
+        /* each node has at most K centers, contiguous and in order */
+        vl_uint32 const *centerOffsets =
+          (vl_uint32 const *) (buffer + fileLevel->centerOffsetsOffset) ;
+        vl_uindex j ;
+        ok = (centerOffsets [0] == 0 &&
+              centerOffsets [fileLevel->numNodes] == fileLevel->numCenters) ;
+        for (j = 0 ; ok && j < fileLevel->numNodes ; ++j) {
+          ok = (centerOffsets [j] <= centerOffsets [j + 1] &&
+                centerOffsets [j + 1] - centerOffsets [j] <= header->K) ;
+        }
+      }
+      if (! ok) {
+        error = "HIKM file `%s' is corrupted" ;
+        break ;
+      }
+      numNodes = fileLevel->numCenters ;
+    }
+  }
+
+  if (error) {
+    vl_set_last_error (VL_ERR_BAD_ARG, error, fileName) ;
+    _vl_unmap_file ((void*)buffer, fileSize) ;
+    return NULL ;
+  }
+
+  f = vl_hikm_new (header->method) ;
+  f->M = header->M ;
+  f->K = header->K ;
+  f->depth = header->depth ;
+  f->mappedFile = (void*) buffer ;
+  f->mappedFileSize = fileSize ;
+  f->levels = vl_calloc (f->depth, sizeof(*f->levels)) ;
+  for (d = 0 ; d < f->depth ; ++d) {
+    VlHIKMFileLevel const *fileLevel = fileLevels + d ;
+    f->levels[d].numNodes = fileLevel->numNodes ;
+    f->levels[d].numCenters = fileLevel->numCenters ;
+    f->levels[d].centerOffsets = (vl_uint32*) (buffer + fileLevel->centerOffsetsOffset) ;
+    f->levels[d].centers = (vl_uint8*) (buffer + fileLevel->centersOffset) ;
+  }
+  return f ;
+}
+
 /* ---------------------------------------------------------------- */
 /*                                              Setters and getters */
 /* ---------------------------------------------------------------- */
@@ -348,6 +962,18 @@ vl_hikm_get_root (VlHIKMTree const *f)
   return f->root ;
 }
 
+/** @brief Check whether the tree has a flat layout
+ ** @param f HIKM tree.
+ ** @return @c true if the tree has a flat layout.
+ ** @sa ::vl_hikm_flatten
+ **/
+
+vl_bool
+vl_hikm_is_flat (VlHIKMTree const *f)
+{
+  return f->levels != NULL ;
+}
+
 /** @brief Set verbosity level
  ** @param f HIKM tree.
  ** @param verb verbosity level.
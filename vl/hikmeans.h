@@ -31,6 +31,20 @@ typedef struct _VlHIKMNode
   struct _VlHIKMNode **children ; /**< Node children (if any) */
 } VlHIKMNode ;
 
+/** @brief HIKM tree level in the flat layout
+ **
+ ** The centers of node @c j are the ones from @c centerOffsets[j]
+ ** to @c centerOffsets[j+1]-1. The child of center @c c is node @c c
+ ** of the next level.
+ **/
+typedef struct _VlHIKMFlatLevel
+{
+  vl_size numNodes ; /**< Number of nodes */
+  vl_size numCenters ; /**< Number of centers of all nodes */
+  vl_uint32 *centerOffsets ; /**< First center of each node (numNodes+1 entries) */
+  vl_uint8 *centers ; /**< Centers (M bytes each) */
+} VlHIKMFlatLevel ;
+
 /** @brief HIKM tree */
 typedef struct _VlHIKMTree {
   vl_size M ; /**< IKM: data dimensionality */
@@ -40,6 +54,9 @@ typedef struct _VlHIKMTree {
   int method ; /**< IKM: method */
   int verb ; /**< Verbosity level */
   VlHIKMNode * root; /**< Tree root node */
+  VlHIKMFlatLevel * levels ; /**< Flat layout (one per level), or NULL */
+  void * mappedFile ; /**< File holding the flat layout, or NULL */
+  vl_size mappedFileSize ; /**< Size of the mapped file */
 } VlHIKMTree ;
 
 /** @name Create and destroy
@@ -58,6 +75,7 @@ VL_EXPORT vl_size vl_hikm_get_depth (VlHIKMTree const *f) ;
 VL_EXPORT int vl_hikm_get_verbosity (VlHIKMTree const *f) ;
 VL_EXPORT vl_size vl_hikm_get_max_niters (VlHIKMTree const *f) ;
 VL_EXPORT VlHIKMNode const * vl_hikm_get_root (VlHIKMTree const *f) ;
+VL_EXPORT vl_bool vl_hikm_is_flat (VlHIKMTree const *f) ;
 /** @} */
 
 /** @name Set parameters
@@ -73,6 +91,14 @@ VL_EXPORT void vl_hikm_set_max_niters (VlHIKMTree *f, int max_niters) ;
 VL_EXPORT void vl_hikm_init (VlHIKMTree *f, vl_size M, vl_size K, vl_size depth) ;
 VL_EXPORT void vl_hikm_train (VlHIKMTree *f, vl_uint8 const *data, vl_size N) ;
 VL_EXPORT void vl_hikm_push (VlHIKMTree *f, vl_uint32 *asgn, vl_uint8 const *data, vl_size N) ;
+VL_EXPORT void vl_hikm_flatten (VlHIKMTree *f) ;
+/** @} */
+
+/** @name Saving and loading
+ ** @{
+ **/
+VL_EXPORT int vl_hikm_save (VlHIKMTree const *f, char const *fileName) ;
+VL_EXPORT VlHIKMTree * vl_hikm_load (char const *fileName) ;
 /** @} */
 
 
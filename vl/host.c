@@ -397,6 +397,13 @@ it supports POSIX threads.
 #include "generic.h"
 #include <stdio.h>
 
+#if defined(VL_OS_LINUX) || defined(VL_OS_MACOSX)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #if defined(VL_ARCH_IX86) || defined(VL_ARCH_IA64) || defined(VL_ARCH_X64)
 #define HAS_CPUID
 #else
@@ -580,3 +587,72 @@ snprintf(compilerString, 1024,
     return string ;
   }
 }
+
+/* ---------------------------------------------------------------- */
+/*                                         Mapping files in memory */
+/* ---------------------------------------------------------------- */
+
+/** ------------------------------------------------------------------
+ ** @internal @brief Map a file in memory read-only
+ ** @param fileName name of the file.
+ ** @param size size of the file in bytes (output).
+ ** @return file contents or @c NULL on error.
+ **
+ ** On POSIX systems the file is mapped with @c mmap, so that
+ ** processes loading the same file share its pages. Elsewhere it
+ ** is read in a buffer. Release the contents by ::_vl_unmap_file.
+ **/
+
+void *
+_vl_map_file (char const * fileName, vl_size * size)
+{
+#if defined(VL_OS_LINUX) || defined(VL_OS_MACOSX)
+  struct stat info ;
+  void * buffer ;
+  int fd = open (fileName, O_RDONLY) ;
+  if (fd < 0) return NULL ;
+  if (fstat (fd, &info) != 0 || info.st_size <= 0) {
+    close (fd) ;
+    return NULL ;
+  }
+  *size = (vl_size) info.st_size ;
+  buffer = mmap (NULL, *size, PROT_READ, MAP_SHARED, fd, 0) ;
+  close (fd) ;
+  return (buffer == MAP_FAILED) ? NULL : buffer ;
+#else
+  void * buffer ;
+  long length ;
+  FILE * file = fopen (fileName, "rb") ;
+  if (! file) return NULL ;
+  if (fseek (file, 0, SEEK_END) != 0 || (length = ftell (file)) <= 0) {
+    fclose (file) ;
+    return NULL ;
+  }
+  rewind (file) ;
+  *size = (vl_size) length ;
+  buffer = vl_malloc (*size) ;
+  if (buffer && fread (buffer, 1, *size, file) != *size) {
+    vl_free (buffer) ;
+    buffer = NULL ;
+  }
+  fclose (file) ;
+  return buffer ;
+#endif
+}
+
+/** ------------------------------------------------------------------
+ ** @internal @brief Release a file mapped by ::_vl_map_file
+ ** @param buffer file contents.
+ ** @param size size of the file in bytes.
+ **/
+
+void
+_vl_unmap_file (void * buffer, vl_size size)
+{
+#if defined(VL_OS_LINUX) || defined(VL_OS_MACOSX)
+  munmap (buffer, size) ;
+#else
+  (void) size ;
+  vl_free (buffer) ;
+#endif
+}
@@ -574,6 +574,13 @@ char * _vl_x86cpu_info_to_string_copy (VlX86CpuInfo const *self) ;
 
 /** @} */
 
+/** ------------------------------------------------------------------
+ ** @name Mapping files in memory
+ ** @{ */
+void * _vl_map_file (char const * fileName, vl_size * size) ;
+void _vl_unmap_file (void * buffer, vl_size size) ;
+/** @} */
+
 /** ------------------------------------------------------------------
  ** @brief Host <-> big endian transformation for 8-bytes value
  **
@@ -74,15 +74,32 @@ the terms of the BSD license (see the COPYING file).
  ** Usually 4-5 times less comparisons than Lloyd are preformed,
  ** providing a dramatic speedup in the execution time.
  **
+ ** @subsection ikmeans-alg-impl Implementation
+ **
+ ** Data points are assigned to the centers in parallel (OpenMP), both
+ ** during training and by ::vl_ikm_push. When all the centers have
+ ** components in the range 0-255, as it is the case after training,
+ ** the filter keeps a copy of them as bytes and computes the
+ ** distances on bytes, with SSE2 integer instructions if available.
+ ** The results are the same as with the plain C code.
  **/
 
 #include "ikmeans.h"
+#include "mathop.h"
+
+#ifndef VL_DISABLE_SSE2
+#include "mathop_sse2.h"
+#endif
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h> /* memset */
 #include "assert.h"
 
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
 static void vl_ikm_init_lloyd (VlIKMFilt*) ;
 static void vl_ikm_init_elkan (VlIKMFilt*) ;
 static int vl_ikm_train_lloyd (VlIKMFilt*, vl_uint8 const*, vl_size) ;
@@ -90,6 +107,125 @@ static int vl_ikm_train_elkan (VlIKMFilt*, vl_uint8 const*, vl_size) ;
 static void vl_ikm_push_lloyd (VlIKMFilt*, vl_uint32*, vl_uint8 const*, vl_size) ;
 static void  vl_ikm_push_elkan  (VlIKMFilt*, vl_uint32*, vl_uint8 const*, vl_size) ;
 
+/* below this number of data points ::vl_ikm_push runs in a single thread */
+#define VL_IKM_PARALLEL_PUSH_SIZE 64
+
+/** @internal
+ ** @brief Squared Euclidean distance of two byte vectors
+ **/
+
+static vl_uint32
+vl_ikm_distance_l2_u8 (vl_size M, vl_uint8 const *X, vl_uint8 const *Y)
+{
+  vl_uint8 const *X_end = X + M ;
+  vl_uint32 dist = 0 ;
+  while (X < X_end) {
+    vl_int32 delta = (vl_int32) *X++ - (vl_int32) *Y++ ;
+    dist += (vl_uint32) (delta * delta) ;
+  }
+  return dist ;
+}
+
+/** @internal
+ ** @brief Get the distance function for byte vectors
+ ** @return distance function.
+ **
+ ** The function returns the SSE2 implementation if SIMD instructions
+ ** are enabled and supported, and the plain C one otherwise. Both
+ ** compute the exact distance. The function is shared by the IKM
+ ** filter and the flat layout of HIKM trees.
+ **/
+
+VlIKMDistanceFunction
+_vl_ikm_get_distance_function (void)
+{
+#ifndef VL_DISABLE_SSE2
+  if (vl_get_simd_enabled() && vl_cpu_has_sse2()) {
+    return _vl_distance_l2_sse2_u8 ;
+  }
+#endif
+  return vl_ikm_distance_l2_u8 ;
+}
+
+/** @internal
+ ** @brief Update the copy of the centers as bytes
+ ** @param f IKM quantizer.
+ **
+ ** The copy is made only if all the components of the centers are in
+ ** the range 0-255. Otherwise @c f->packed_centers is set to @c NULL
+ ** and distances are computed on the centers directly.
+ **/
+
+static void
+vl_ikm_pack_centers (VlIKMFilt * f)
+{
+  vl_uindex i ;
+  vl_size n = f->M * f->K ;
+  vl_bool pack = VL_TRUE ;
+
+  for (i = 0 ; pack && i < n ; ++i) {
+    pack = (f->centers[i] >= 0 && f->centers[i] <= 255) ;
+  }
+  if (! pack) {
+    if (f->packed_centers) vl_free (f->packed_centers) ;
+    f->packed_centers = NULL ;
+    return ;
+  }
+  if (! f->packed_centers) {
+    f->packed_centers = vl_malloc (n) ;
+  }
+  for (i = 0 ; i < n ; ++i) {
+    f->packed_centers[i] = (vl_uint8) f->centers[i] ;
+  }
+  f->packed_distance = _vl_ikm_get_distance_function () ;
+}
+
+/** @internal
+ ** @brief Compute the squared distance of a datum to a center
+ ** @param f IKM quantizer.
+ ** @param x datum.
+ ** @param k index of the center.
+ ** @return distance.
+ **/
+
+VL_INLINE vl_ikmacc_t
+vl_ikm_distance (VlIKMFilt const * f, vl_uint8 const * x, vl_uindex k)
+{
+  vl_ikmacc_t dist = 0 ;
+  vl_ikmacc_t const * center = f->centers + k * f->M ;
+  vl_uindex i ;
+  if (f->packed_centers) {
+    return (vl_ikmacc_t) f->packed_distance (f->M, x, f->packed_centers + k * f->M) ;
+  }
+  for (i = 0 ; i < f->M ; ++i) {
+    vl_ikmacc_t delta = (vl_ikmacc_t)x[i] - center[i] ;
+    dist += delta * delta ;
+  }
+  return dist ;
+}
+
+/** @internal
+ ** @brief Find the center closest to a datum
+ ** @param f IKM quantizer.
+ ** @param x datum.
+ ** @return index of the closest center.
+ **/
+
+static vl_uint32
+vl_ikm_assign_one (VlIKMFilt const * f, vl_uint8 const * x)
+{
+  vl_uindex k, best = 0 ;
+  vl_ikmacc_t best_dist = vl_ikm_distance (f, x, 0) ;
+  for (k = 1 ; k < f->K ; ++k) {
+    vl_ikmacc_t dist = vl_ikm_distance (f, x, k) ;
+    if (dist < best_dist) {
+      best = k ;
+      best_dist = dist ;
+    }
+  }
+  return (vl_uint32) best ;
+}
+
 /** @brief Create a new IKM quantizer
  ** @param method Clustering algorithm.
  ** @return new IKM quantizer.
@@ -119,6 +255,7 @@ vl_ikm_delete (VlIKMFilt* f)
   if (f) {
     if (f->centers) vl_free(f->centers) ;
     if (f->inter_dist) vl_free(f->inter_dist) ;
+    if (f->packed_centers) vl_free(f->packed_centers) ;
     vl_free(f) ;
   }
 }
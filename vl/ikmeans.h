@@ -37,6 +37,9 @@ enum VlIKMAlgorithms {
   VL_IKM_ELKAN, /**< Elkan algorithm */
 } ;
 
+/** @internal @brief Squared Euclidean distance of two byte vectors */
+typedef vl_uint32 (*VlIKMDistanceFunction) (vl_size M, vl_uint8 const *X, vl_uint8 const *Y) ;
+
 /** ------------------------------------------------------------------
  ** @brief IKM quantizer
  **/
@@ -50,6 +53,8 @@ typedef struct _VlIKMFilt
   int verb ; /**< verbosity level */
   vl_ikmacc_t *centers ; /**< centers */
   vl_ikmacc_t *inter_dist ; /**< centers inter-distances */
+  vl_uint8 *packed_centers ; /**< centers as bytes, or NULL */
+  VlIKMDistanceFunction packed_distance ; /**< distance to the centers as bytes */
 } VlIKMFilt ;
 
 /** @name Create and destroy
@@ -83,5 +88,7 @@ VL_EXPORT void vl_ikm_set_verbosity (VlIKMFilt *f, int verb) ;
 VL_EXPORT void vl_ikm_set_max_niters (VlIKMFilt *f, vl_size max_niters) ;
 /** @} */
 
+VL_EXPORT VlIKMDistanceFunction _vl_ikm_get_distance_function (void) ;
+
 /* VL_IKMEANS_H */
 #endif
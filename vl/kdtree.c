@@ -50,6 +50,26 @@ with the searcher object as an argument. To set a maximum number of
 comparisons per query and calculate approximate nearest neighbors use
 ::vl_kdforest_set_max_num_comparisons.
 
+Once built, a forest of @c float data can be converted by
+::vl_kdforest_compact to a search-optimized layout. The nodes are
+smaller, are stored in breadth-first order, and each tree keeps a copy
+of the data reordered leaf by leaf. This trades one copy of the data
+per tree for faster queries.
+
+A built forest can be saved to a file by ::vl_kdforest_save and
+loaded back by ::vl_kdforest_load. The loader maps the file in memory
+read-only instead of reading it, so that loading takes constant time
+and processes serving the same index share one copy of it. The file
+can optionally embed the indexed data as well.
+
+Points can be added to a built forest by ::vl_kdforest_add and removed
+by ::vl_kdforest_remove. Added points are kept in a flat buffer that
+queries scan exhaustively, and removed points are skipped by the
+queries. Neither update modifies the trees. ::vl_kdforest_merge
+rebuilds them over the remaining points, which keep their indexes;
+the caller runs it when ::vl_kdforest_needs_merge reports that the
+updates have grown too large, at a time when queries can wait.
+
 <!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
 @section kdtree-tech Technical details
 <!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
@@ -69,7 +89,16 @@ threshold are determined as a statistic of the data points contained
 in the partition. The splitting dimension is the one which has largest
 sample variance and the splitting threshold is either the sample mean
 or the median. Leaves are atomic partitions and they contain a list of
-zero or more data points (typically one).
+zero or more data points. By default partitions are split down to a
+single point; ::vl_kdforest_set_leaf_size stops the splitting at a
+larger bucket of points, which yields shallower trees whose leaves
+are scanned sequentially.
+
+The median is found by linear-time selection rather than by sorting
+the partition. The trees of a forest are built concurrently and large
+partitions are further split by parallel tasks (OpenMP), each with its
+own random number generator, so that the result does not depend on
+the number of threads.
 
 <b>Querying.</b> Querying amounts to finding the N data points closer
 to a given query point @f$ x_q \in \mathbb{R}^d @f$. This is done by
@@ -91,11 +120,22 @@ using the vl_kdforest_delete_searcher method.
 #include "random.h"
 #include "mathop.h"
 #include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
 
 #if defined(_OPENMP)
 #include <omp.h>
 #endif
 
+/* Subtrees with more points than this are built by parallel tasks */
+#define VL_KDTREE_PARALLEL_BUILD_SIZE 8192
+
+/* Number of consecutive (sorted) queries processed by a thread */
+#define VL_KDFOREST_QUERY_BATCH_SIZE 64
+
+/* Minimum size of the delta buffer before it is merged in the trees */
+#define VL_KDFOREST_MIN_NUM_DELTA_DATA 1024
+
 #define VL_HEAP_prefix     vl_kdforest_search_heap
 #define VL_HEAP_type       VlKDForestSearchState
 #define VL_HEAP_cmp(v,x,y) (v[x].distanceLowerBound - v[y].distanceLowerBound)
@@ -112,43 +152,129 @@ using the vl_kdforest_delete_searcher method.
 #include "heap-def.h"
 
 /** ------------------------------------------------------------------
- ** @internal
- ** @brief Allocate a new node from the tree pool
+ ** @internal @brief Get a data point
+ ** @param self KDForest object.
+ ** @param di index of the point.
+ ** @return pointer to the point.
+ **
+ ** Points added by ::vl_kdforest_add after the forest was built are
+ ** stored by the forest after the ones passed to ::vl_kdforest_build.
  **/
 
-static vl_uindex
-vl_kdtree_node_new (VlKDTree * tree, vl_uindex parentIndex)
+VL_INLINE void const *
+vl_kdforest_get_point (VlKDForest const * self, vl_index di)
 {
-  VlKDTreeNode * node = NULL ;
-  vl_uindex nodeIndex = tree->numUsedNodes ;
-  tree -> numUsedNodes += 1 ;
+  vl_size pointSize = vl_get_type_size(self->dataType) * self->dimension ;
+  if ((vl_size)di < self->numBaseData) {
+    return (char const *)self->data + di * pointSize ;
+  }
+  return (char const *)self->appendedData + (di - self->numBaseData) * pointSize ;
+}
 
-  assert (tree->numUsedNodes <= tree->numAllocatedNodes) ;
+/** ------------------------------------------------------------------
+ ** @internal
+ ** @brief Initialize a node of the tree pool
+ **
+ ** While a tree is built, the subtree of a node indexing @c n data
+ ** points occupies a range of <code>2n - 1</code> nodes starting at
+ ** the node itself, with the lower subtree immediately following the
+ ** node and the upper subtree following the range of the lower
+ ** one. Since the ranges of different subtrees do not overlap, they
+ ** can be filled concurrently. Nodes that are not used (because some
+ ** leaves contain more than one point) are removed by
+ ** ::vl_kdtree_compact_nodes once the tree is complete.
+ **/
 
-  node = tree->nodes + nodeIndex ;
+static void
+vl_kdtree_node_init (VlKDTree * tree, vl_uindex nodeIndex, vl_uindex parentIndex)
+{
+  VlKDTreeNode * node = tree->nodes + nodeIndex ;
+  assert (nodeIndex < tree->numAllocatedNodes) ;
   node -> parent = parentIndex ;
   node -> lowerChild = 0 ;
   node -> upperChild = 0 ;
   node -> splitDimension = 0 ;
   node -> splitThreshold = 0 ;
-  return nodeIndex ;
 }
 
 /** ------------------------------------------------------------------
  ** @internal
- ** @brief Compare KDTree index entries for sorting
+ ** @brief Remove the unused nodes from the tree pool
+ **
+ ** The function renumbers the nodes in the order in which they
+ ** appear in the pool, which is the depth-first order of the
+ ** tree. Unused nodes are recognized from having a null
+ ** @c lowerChild, which is never the case for a built node.
  **/
 
-VL_INLINE int
-vl_kdtree_compare_index_entries (void const * a,
-                                 void const * b)
+static void
+vl_kdtree_compact_nodes (VlKDTree * tree)
 {
-  double delta =
-    ((VlKDTreeDataIndexEntry const*)a) -> value -
-    ((VlKDTreeDataIndexEntry const*)b) -> value ;
-  if (delta < 0) return -1 ;
-  if (delta > 0) return +1 ;
-  return 0 ;
+  vl_uindex ni, numUsedNodes = 0 ;
+  vl_uindex * nodeMap = vl_malloc (sizeof(vl_uindex) * tree->numAllocatedNodes) ;
+
+  for (ni = 0 ; ni < tree->numAllocatedNodes ; ++ ni) {
+    if (tree->nodes[ni].lowerChild == 0) continue ;
+    nodeMap[ni] = numUsedNodes ;
+    tree->nodes[numUsedNodes++] = tree->nodes[ni] ;
+  }
+  for (ni = 0 ; ni < numUsedNodes ; ++ ni) {
+    VlKDTreeNode * node = tree->nodes + ni ;
+    node->parent = nodeMap[node->parent] ;
+    if (node->lowerChild > 0) {
+      node->lowerChild = nodeMap[node->lowerChild] ;
+      node->upperChild = nodeMap[node->upperChild] ;
+    }
+  }
+  tree->numUsedNodes = numUsedNodes ;
+  vl_free (nodeMap) ;
+}
+
+/** ------------------------------------------------------------------
+ ** @internal
+ ** @brief Partially sort KDTree index entries
+ ** @param entries entries to sort.
+ ** @param numEntries number of entries.
+ ** @param k index of the entry to select.
+ **
+ ** The function rearranges @a entries so that the entry of index @a
+ ** k is the one that would be there if the entries were sorted by
+ ** increasing value, no entry before it has a larger value, and no
+ ** entry after it has a smaller value (quickselect). The running
+ ** time is linear on average.
+ **/
+
+static void
+vl_kdtree_select_index_entry (VlKDTreeDataIndexEntry * entries,
+                              vl_size numEntries,
+                              vl_uindex k)
+{
+  vl_uindex begin = 0 ;
+  vl_uindex end = numEntries - 1 ;
+  while (begin < end) {
+    double pivot = entries[(begin + end) / 2].value ;
+    vl_uindex i = begin ;
+    vl_uindex j = end ;
+    while (i <= j) {
+      while (entries[i].value < pivot) ++ i ;
+      while (entries[j].value > pivot) -- j ;
+      if (i <= j) {
+        VlKDTreeDataIndexEntry tmp = entries[i] ;
+        entries[i] = entries[j] ;
+        entries[j] = tmp ;
+        ++ i ;
+        if (j == 0) break ;
+        -- j ;
+      }
+    }
+    if (k <= j) {
+      end = j ;
+    } else if (k >= i) {
+      begin = i ;
+    } else {
+      break ;
+    }
+  }
 }
 
 /** ------------------------------------------------------------------
@@ -156,33 +282,43 @@ vl_kdtree_compare_index_entries (void const * a,
  ** @brief Build KDTree recursively
  ** @param forest forest to which the tree belongs.
  ** @param tree tree being built.
+ ** @param rand random number generator for this subtree.
  ** @param nodeIndex node to process.
  ** @param dataBegin begin of data for this node.
  ** @param dataEnd end of data for this node.
  ** @param depth depth of this node.
+ ** @return depth of the subtree.
+ **
+ ** Subtrees with more than ::VL_KDTREE_PARALLEL_BUILD_SIZE points
+ ** are built by parallel tasks, each with its own random number
+ ** generator seeded from @a rand. The result does not depend on the
+ ** number of threads.
  **/
 
-static void
+static unsigned int
 vl_kdtree_build_recursively
 (VlKDForest * forest,
- VlKDTree * tree, vl_uindex nodeIndex,
+ VlKDTree * tree,
+ VlRand * rand,
+ vl_uindex nodeIndex,
  vl_uindex dataBegin, vl_uindex dataEnd,
  unsigned int depth)
 {
   vl_uindex d, i, medianIndex, splitIndex ;
   VlKDTreeNode * node = tree->nodes + nodeIndex ;
+  VlKDTreeSplitDimension splitHeapArray [VL_KDTREE_SPLIT_HEAP_SIZE] ;
+  vl_size splitHeapNumNodes = 0 ;
   VlKDTreeSplitDimension * splitDimension ;
+  unsigned int lowerDepth, upperDepth ;
 
-  /* base case: there is only one data point */
-  if (dataEnd - dataBegin <= 1) {
-    if (tree->depth < depth) tree->depth = depth ;
+  /* base case: the points fit in a leaf */
+  if (dataEnd - dataBegin <= forest->leafSize) {
     node->lowerChild = - dataBegin - 1;
     node->upperChild = - dataEnd - 1 ;
-    return ;
+    return depth ;
   }
 
   /* compute the dimension with largest variance > 0 */
-  forest->splitHeapNumNodes = 0 ;
   for (d = 0 ; d < forest->dimension ; ++ d) {
     double mean = 0 ; /* unnormalized */
     double secondMoment = 0 ;
@@ -203,18 +339,18 @@ vl_kdtree_build_recursively
       if(useAllData == VL_TRUE) {
         sampleIndex = (vl_uint32)i;
       } else {
-        sampleIndex = (vl_rand_uint32(forest->rand) % VL_KDTREE_VARIANCE_EST_NUM_SAMPLES);
+        sampleIndex = (vl_rand_uint32(rand) % VL_KDTREE_VARIANCE_EST_NUM_SAMPLES);
       }
       sampleIndex += dataBegin;
 
       di = tree->dataIndex[sampleIndex].index ;
 
       switch(forest->dataType) {
-        case VL_TYPE_FLOAT: datum = ((float const*)forest->data)
-          [di * forest->dimension + d] ;
+        case VL_TYPE_FLOAT: datum = ((float const*)
+          vl_kdforest_get_point (forest, di))[d] ;
           break ;
-        case VL_TYPE_DOUBLE: datum = ((double const*)forest->data)
-          [di * forest->dimension + d] ;
+        case VL_TYPE_DOUBLE: datum = ((double const*)
+          vl_kdforest_get_point (forest, di))[d] ;
           break ;
         default:
           abort() ;
@@ -230,76 +366,88 @@ vl_kdtree_build_recursively
     if (variance <= 0) continue ;
 
     /* keep splitHeapSize most varying dimensions */
-    if (forest->splitHeapNumNodes < forest->splitHeapSize) {
+    if (splitHeapNumNodes < forest->splitHeapSize) {
       VlKDTreeSplitDimension * splitDimension
-        = forest->splitHeapArray + forest->splitHeapNumNodes ;
+        = splitHeapArray + splitHeapNumNodes ;
       splitDimension->dimension = (unsigned int)d ;
       splitDimension->mean = mean ;
       splitDimension->variance = variance ;
-      vl_kdtree_split_heap_push (forest->splitHeapArray, &forest->splitHeapNumNodes) ;
+      vl_kdtree_split_heap_push (splitHeapArray, &splitHeapNumNodes) ;
     } else {
-      VlKDTreeSplitDimension * splitDimension = forest->splitHeapArray + 0 ;
+      VlKDTreeSplitDimension * splitDimension = splitHeapArray + 0 ;
       if (splitDimension->variance < variance) {
         splitDimension->dimension = (unsigned int)d ;
         splitDimension->mean = mean ;
         splitDimension->variance = variance ;
-        vl_kdtree_split_heap_update (forest->splitHeapArray, forest->splitHeapNumNodes, 0) ;
+        vl_kdtree_split_heap_update (splitHeapArray, splitHeapNumNodes, 0) ;
       }
     }
   }
 
   /* additional base case: the maximum variance is equal to 0 (overlapping points) */
-  if (forest->splitHeapNumNodes == 0) {
+  if (splitHeapNumNodes == 0) {
     node->lowerChild = - dataBegin - 1 ;
     node->upperChild = - dataEnd - 1 ;
-    return ;
+    return depth ;
   }
 
   /* toss a dice to decide the splitting dimension (variance > 0) */
-  splitDimension = forest->splitHeapArray
-  + (vl_rand_uint32(forest->rand) % VL_MIN(forest->splitHeapSize, forest->splitHeapNumNodes)) ;
+  splitDimension = splitHeapArray
+  + (vl_rand_uint32(rand) % VL_MIN(forest->splitHeapSize, splitHeapNumNodes)) ;
 
   node->splitDimension = splitDimension->dimension ;
 
-  /* sort data along largest variance dimension */
+  /* get the data along the splitting dimension */
   for (i = dataBegin ; i < dataEnd ; ++ i) {
     vl_index di = tree->dataIndex[i].index ;
     double datum ;
     switch (forest->dataType) {
-      case VL_TYPE_FLOAT: datum = ((float const*)forest->data)
-        [di * forest->dimension + splitDimension->dimension] ;
+      case VL_TYPE_FLOAT: datum = ((float const*)
+        vl_kdforest_get_point (forest, di))[splitDimension->dimension] ;
         break ;
-      case VL_TYPE_DOUBLE: datum = ((double const*)forest->data)
-        [di * forest->dimension + splitDimension->dimension] ;
+      case VL_TYPE_DOUBLE: datum = ((double const*)
+        vl_kdforest_get_point (forest, di))[splitDimension->dimension] ;
         break ;
       default:
         abort() ;
     }
     tree->dataIndex [i] .value = datum ;
   }
-  qsort (tree->dataIndex + dataBegin,
-         dataEnd - dataBegin,
-         sizeof (VlKDTreeDataIndexEntry),
-         vl_kdtree_compare_index_entries) ;
 
-  /* determine split threshold */
+  /* determine split threshold and partition the data */
   switch (forest->thresholdingMethod) {
     case VL_KDTREE_MEAN :
       node->splitThreshold = splitDimension->mean ;
-      for (splitIndex = dataBegin ;
-           splitIndex < dataEnd && tree->dataIndex[splitIndex].value <= node->splitThreshold ;
-           ++ splitIndex) ;
-      splitIndex -= 1 ;
+      {
+        vl_uindex j = dataEnd ;
+        splitIndex = dataBegin ;
+        while (splitIndex < j) {
+          if (tree->dataIndex[splitIndex].value <= node->splitThreshold) {
+            ++ splitIndex ;
+          } else {
+            VlKDTreeDataIndexEntry tmp = tree->dataIndex[splitIndex] ;
+            tree->dataIndex[splitIndex] = tree->dataIndex[--j] ;
+            tree->dataIndex[j] = tmp ;
+          }
+        }
+      }
       /* If the mean does not provide a proper partition, fall back to
        * median. This usually happens if all points have the same
        * value and the zero variance test fails for numerical accuracy
        * reasons. In this case, also due to numerical accuracy, the
        * mean value can be smaller, equal, or larger than all
        * points. */
-      if (dataBegin <= splitIndex && splitIndex + 1 < dataEnd) break ;
+      if (dataBegin < splitIndex && splitIndex < dataEnd) {
+        splitIndex -= 1 ;
+        break ;
+      }
+      /* fall through */
 
     case VL_KDTREE_MEDIAN :
       medianIndex = (dataBegin + dataEnd - 1) / 2 ;
+      vl_kdtree_select_index_entry (tree->dataIndex + dataBegin,
+                                    dataEnd - dataBegin,
+                                    medianIndex - dataBegin) ;
       splitIndex = medianIndex ;
       node -> splitThreshold = tree->dataIndex[medianIndex].value ;
       break ;
@@ -308,12 +456,34 @@ vl_kdtree_build_recursively
       abort() ;
   }
 
-  /* divide subparts */
-  node->lowerChild = vl_kdtree_node_new (tree, nodeIndex) ;
-  vl_kdtree_build_recursively (forest, tree, node->lowerChild, dataBegin, splitIndex + 1, depth + 1) ;
-
-  node->upperChild = vl_kdtree_node_new (tree, nodeIndex) ;
-  vl_kdtree_build_recursively (forest, tree, node->upperChild, splitIndex + 1, dataEnd, depth + 1) ;
+  /* divide subparts; the lower subtree is processed by a separate
+     task if large enough */
+  node->lowerChild = nodeIndex + 1 ;
+  node->upperChild = nodeIndex + 2 * (splitIndex + 1 - dataBegin) ;
+  vl_kdtree_node_init (tree, node->lowerChild, nodeIndex) ;
+  vl_kdtree_node_init (tree, node->upperChild, nodeIndex) ;
+
+  if (dataEnd - dataBegin > VL_KDTREE_PARALLEL_BUILD_SIZE) {
+    VlRand lowerRand ;
+    vl_rand_init (&lowerRand) ;
+    vl_rand_seed (&lowerRand, vl_rand_uint32(rand)) ;
+#if defined(_OPENMP)
+#pragma omp task default(shared)
+#endif
+    lowerDepth = vl_kdtree_build_recursively (forest, tree, &lowerRand, node->lowerChild,
+                                              dataBegin, splitIndex + 1, depth + 1) ;
+    upperDepth = vl_kdtree_build_recursively (forest, tree, rand, node->upperChild,
+                                              splitIndex + 1, dataEnd, depth + 1) ;
+#if defined(_OPENMP)
+#pragma omp taskwait
+#endif
+  } else {
+    lowerDepth = vl_kdtree_build_recursively (forest, tree, rand, node->lowerChild,
+                                              dataBegin, splitIndex + 1, depth + 1) ;
+    upperDepth = vl_kdtree_build_recursively (forest, tree, rand, node->upperChild,
+                                              splitIndex + 1, dataEnd, depth + 1) ;
+  }
+  return VL_MAX(lowerDepth, upperDepth) ;
 }
 
 /** ------------------------------------------------------------------
@@ -341,26 +511,40 @@ vl_kdforest_new (vl_type dataType,
   self -> rand = vl_get_rand () ;
   self -> dataType = dataType ;
   self -> numData = 0 ;
+  self -> numIndexedData = 0 ;
   self -> data = 0 ;
   self -> dimension = dimension ;
   self -> numTrees = numTrees ;
   self -> trees = 0 ;
   self -> thresholdingMethod = VL_KDTREE_MEDIAN ;
+  self -> leafSize = 1 ;
   self -> splitHeapSize = VL_MIN(numTrees, VL_KDTREE_SPLIT_HEAP_SIZE) ;
-  self -> splitHeapNumNodes = 0 ;
   self -> distance = distance;
   self -> maxNumNodes = 0 ;
   self -> numSearchers = 0 ;
   self -> headSearcher = 0 ;
+  self -> numBaseData = 0 ;
+  self -> appendedData = NULL ;
+  self -> numAppendedData = 0 ;
+  self -> appendedDataCapacity = 0 ;
+  self -> maxNumDeltaData = 0 ;
+  self -> removed = NULL ;
+  self -> numRemoved = 0 ;
+  self -> mappedFile = NULL ;
+  self -> mappedFileSize = 0 ;
 
   switch (self->dataType) {
     case VL_TYPE_FLOAT:
       self -> distanceFunction = (void(*)(void))
       vl_get_vector_comparison_function_f (distance) ;
+      self -> blockDistanceFunction = (void(*)(void))
+      vl_get_vector_block_comparison_function_f (distance) ;
       break;
     case VL_TYPE_DOUBLE :
       self -> distanceFunction = (void(*)(void))
       vl_get_vector_comparison_function_d (distance) ;
+      self -> blockDistanceFunction = (void(*)(void))
+      vl_get_vector_block_comparison_function_d (distance) ;
       break ;
     default :
       abort() ;
@@ -411,6 +595,10 @@ vl_kdforest_new_searcher (VlKDForest * kdforest)
   self->forest = kdforest;
   self->searchHeapArray = vl_malloc (sizeof(VlKDForestSearchState) * kdforest->maxNumNodes) ;
   self->searchIdBook = vl_calloc (sizeof(vl_uindex), kdforest->numData) ;
+  self->radiusSearch = VL_FALSE ;
+  self->radius = 0 ;
+  self->radiusNeighbors = NULL ;
+  self->radiusNeighborsCapacity = 0 ;
   return self ;
 }
 
@@ -436,6 +624,7 @@ vl_kdforestsearcher_delete (VlKDForestSearcher * self)
   self->forest->numSearchers -- ;
   vl_free(self->searchHeapArray) ;
   vl_free(self->searchIdBook) ;
+  free(self->radiusNeighbors) ;
   vl_free(self) ;
 }
 
@@ -451,6 +640,49 @@ vl_kdforest_get_searcher (VlKDForest const * self, vl_uindex pos)
   return lastSearcher ;
 }
 
+/** ------------------------------------------------------------------
+ ** @internal @brief Free a tree array unless it belongs to the mapped file
+ ** @param self KDForest object.
+ ** @param buffer array to free (may be @c NULL).
+ **
+ ** Trees loaded by ::vl_kdforest_load point into the mapped file,
+ ** but ::vl_kdforest_compact may still add arrays on the heap.
+ **/
+
+static void
+vl_kdforest_free_storage (VlKDForest * self, void * buffer)
+{
+  char const * begin = self->mappedFile ;
+  if (buffer == NULL) return ;
+  if (begin &&
+      (char const *)buffer >= begin &&
+      (char const *)buffer < begin + self->mappedFileSize) return ;
+  vl_free (buffer) ;
+}
+
+/** ------------------------------------------------------------------
+ ** @internal @brief Free the trees of the forest
+ ** @param self KDForest object.
+ **/
+
+static void
+vl_kdforest_free_trees (VlKDForest * self)
+{
+  vl_uindex ti ;
+  if (! self->trees) return ;
+  for (ti = 0 ; ti < self->numTrees ; ++ ti) {
+    if (self->trees[ti]) {
+      vl_kdforest_free_storage (self, self->trees[ti]->nodes) ;
+      vl_kdforest_free_storage (self, self->trees[ti]->dataIndex) ;
+      vl_kdforest_free_storage (self, self->trees[ti]->compactNodes) ;
+      vl_kdforest_free_storage (self, self->trees[ti]->compactData) ;
+      vl_free (self->trees[ti]) ;
+    }
+  }
+  vl_free (self->trees) ;
+  self->trees = NULL ;
+}
+
 /** ------------------------------------------------------------------
  ** @brief Delete KDForest object
  ** @param self KDForest object to delete
@@ -460,22 +692,17 @@ vl_kdforest_get_searcher (VlKDForest const * self, vl_uindex pos)
 void
 vl_kdforest_delete (VlKDForest * self)
 {
-  vl_uindex ti ;
   VlKDForestSearcher * searcher ;
 
   while ((searcher = vl_kdforest_get_searcher(self, 0))) {
     vl_kdforestsearcher_delete(searcher) ;
   }
 
-  if (self->trees) {
-    for (ti = 0 ; ti < self->numTrees ; ++ ti) {
-      if (self->trees[ti]) {
-        if (self->trees[ti]->nodes) vl_free (self->trees[ti]->nodes) ;
-        if (self->trees[ti]->dataIndex) vl_free (self->trees[ti]->dataIndex) ;
-        vl_free (self->trees[ti]) ;
-      }
-    }
-    vl_free (self->trees) ;
+  vl_kdforest_free_trees (self) ;
+  if (self->appendedData) vl_free (self->appendedData) ;
+  if (self->removed) vl_free (self->removed) ;
+  if (self->mappedFile) {
+    _vl_unmap_file (self->mappedFile, self->mappedFileSize) ;
   }
   vl_free (self) ;
 }
@@ -513,51 +740,90 @@ vl_kdtree_calc_bounds_recursively (VlKDTree * tree,
 }
 
 /** ------------------------------------------------------------------
- ** @brief Build KDTree from data
- ** @param self KDTree object
- ** @param numData number of data points.
- ** @param data pointer to the data.
+ ** @internal @brief Resize the buffers of the searchers
+ ** @param self KDForest object.
  **
- ** The function builds the KDTree by processing the data @a data. For
- ** efficiency, KDTree does not make a copy the data, but retains a
- ** pointer to it. Therefore the data buffer must be valid and
- ** unchanged for the lifespan of the object.
+ ** The function is called when the trees are rebuilt, as the number
+ ** of nodes and of indexed points may have changed.
+ **/
+
+static void
+vl_kdforest_update_searchers (VlKDForest * self)
+{
+  VlKDForestSearcher * searcher ;
+  for (searcher = self->headSearcher ; searcher ; searcher = searcher->next) {
+    searcher->searchHeapArray = vl_realloc
+      (searcher->searchHeapArray, sizeof(VlKDForestSearchState) * self->maxNumNodes) ;
+    searcher->searchIdBook = vl_realloc
+      (searcher->searchIdBook, sizeof(vl_uindex) * self->numData) ;
+    memset (searcher->searchIdBook, 0, sizeof(vl_uindex) * self->numData) ;
+    searcher->searchId = 0 ;
+  }
+}
+
+/** ------------------------------------------------------------------
+ ** @internal @brief Build the trees of the forest
+ ** @param self KDForest object.
+ ** @param indexes indexes of the points to store in the trees (may be @c NULL).
+ ** @param numIndexes number of indexes.
  **
- ** The number of data points @c numData must not be smaller than one.
+ ** If @a indexes is @c NULL, the function indexes the first @c
+ ** self->numData points of the forest.
  **/
 
-void
-vl_kdforest_build (VlKDForest * self, vl_size numData, void const * data)
+static void
+vl_kdforest_build_trees (VlKDForest * self, vl_uindex const * indexes, vl_size numIndexes)
 {
   vl_uindex di, ti ;
   vl_size maxNumNodes ;
   double * searchBounds;
+  VlRand * treeRands ;
 
-  assert(data) ;
-  assert(numData >= 1) ;
-
-  /* need to check: if alredy built, clean first */
-  self->data = data ;
-  self->numData = numData ;
+  if (! indexes) numIndexes = self->numData ;
+  assert (numIndexes >= 1) ;
+  self->numIndexedData = numIndexes ;
   self->trees = vl_malloc (sizeof(VlKDTree*) * self->numTrees) ;
+  treeRands = vl_malloc (sizeof(VlRand) * self->numTrees) ;
   maxNumNodes = 0 ;
 
   for (ti = 0 ; ti < self->numTrees ; ++ ti) {
     self->trees[ti] = vl_malloc (sizeof(VlKDTree)) ;
-    self->trees[ti]->dataIndex = vl_malloc (sizeof(VlKDTreeDataIndexEntry) * self->numData) ;
-    for (di = 0 ; di < self->numData ; ++ di) {
-      self->trees[ti]->dataIndex[di].index = di ;
+    self->trees[ti]->dataIndex = vl_malloc (sizeof(VlKDTreeDataIndexEntry) * numIndexes) ;
+    for (di = 0 ; di < numIndexes ; ++ di) {
+      self->trees[ti]->dataIndex[di].index = indexes ? indexes[di] : di ;
     }
     self->trees[ti]->numUsedNodes = 0 ;
-    /* num. nodes of a complete binary tree with numData leaves */
-    self->trees[ti]->numAllocatedNodes = 2 * self->numData - 1 ;
-    self->trees[ti]->nodes = vl_malloc (sizeof(VlKDTreeNode) * self->trees[ti]->numAllocatedNodes) ;
+    /* num. nodes of a complete binary tree with numIndexes leaves */
+    self->trees[ti]->numAllocatedNodes = 2 * numIndexes - 1 ;
+    self->trees[ti]->nodes = vl_calloc (sizeof(VlKDTreeNode), self->trees[ti]->numAllocatedNodes) ;
     self->trees[ti]->depth = 0 ;
-    vl_kdtree_build_recursively (self, self->trees[ti],
-                                 vl_kdtree_node_new(self->trees[ti], 0), 0,
-                                 self->numData, 0) ;
+    self->trees[ti]->compactNodes = NULL ;
+    self->trees[ti]->compactData = NULL ;
+    vl_kdtree_node_init (self->trees[ti], 0, 0) ;
+    vl_rand_init (treeRands + ti) ;
+    vl_rand_seed (treeRands + ti, vl_rand_uint32(self->rand)) ;
+  }
+
+  /* build the trees concurrently; large subtrees spawn more tasks */
+#if defined(_OPENMP)
+#pragma omp parallel default(shared) private(ti) num_threads(vl_get_max_threads())
+#pragma omp single
+#endif
+  {
+    for (ti = 0 ; ti < self->numTrees ; ++ ti) {
+#if defined(_OPENMP)
+#pragma omp task default(shared) firstprivate(ti)
+#endif
+      self->trees[ti]->depth = vl_kdtree_build_recursively
+      (self, self->trees[ti], treeRands + ti, 0, 0, numIndexes, 0) ;
+    }
+  }
+
+  for (ti = 0 ; ti < self->numTrees ; ++ ti) {
+    vl_kdtree_compact_nodes (self->trees[ti]) ;
     maxNumNodes += self->trees[ti]->numUsedNodes ;
   }
+  vl_free (treeRands) ;
 
   searchBounds = vl_malloc(sizeof(double) * 2 * self->dimension);
 
@@ -574,124 +840,802 @@ vl_kdforest_build (VlKDForest * self, vl_size numData, void const * data)
 
   vl_free(searchBounds);
   self -> maxNumNodes = maxNumNodes;
+  vl_kdforest_update_searchers (self) ;
 }
 
 
 /** ------------------------------------------------------------------
- ** @internal @brief
+ ** @brief Build KDTree from data
+ ** @param self KDTree object
+ ** @param numData number of data points.
+ ** @param data pointer to the data.
+ **
+ ** The function builds the KDTree by processing the data @a data. For
+ ** efficiency, KDTree does not make a copy the data, but retains a
+ ** pointer to it. Therefore the data buffer must be valid and
+ ** unchanged for the lifespan of the object.
+ **
+ ** The number of data points @c numData must not be smaller than one.
  **/
 
-vl_uindex
-vl_kdforest_query_recursively (VlKDForestSearcher * searcher,
-                               VlKDTree * tree,
-                               vl_uindex nodeIndex,
-                               VlKDForestNeighbor * neighbors,
-                               vl_size numNeighbors,
-                               vl_size * numAddedNeighbors,
-                               double dist,
-                               void const * query)
+void
+vl_kdforest_build (VlKDForest * self, vl_size numData, void const * data)
 {
+  assert(data) ;
+  assert(numData >= 1) ;
 
-  VlKDTreeNode const * node = tree->nodes + nodeIndex ;
-  vl_uindex i = node->splitDimension ;
-  vl_index nextChild, saveChild ;
-  double delta, saveDist ;
-  double x ;
-  double x1 = node->lowerBound ;
-  double x2 = node->splitThreshold ;
-  double x3 = node->upperBound ;
-  VlKDForestSearchState * searchState ;
-
-  searcher->searchNumRecursions ++ ;
-
-  switch (searcher->forest->dataType) {
-    case VL_TYPE_FLOAT :
-      x = ((float const*) query)[i] ;
-      break ;
-    case VL_TYPE_DOUBLE :
-      x = ((double const*) query)[i] ;
-      break ;
-    default :
-      abort() ;
-  }
-
-  /* base case: this is a leaf node */
-  if (node->lowerChild < 0) {
-
-    vl_index begin = - node->lowerChild - 1 ;
-    vl_index end   = - node->upperChild - 1 ;
-    vl_index iter ;
+  vl_kdforest_free_trees (self) ;
+  if (self->appendedData) vl_free (self->appendedData) ;
+  if (self->removed) vl_free (self->removed) ;
+  self->appendedData = NULL ;
+  self->numAppendedData = 0 ;
+  self->appendedDataCapacity = 0 ;
+  self->removed = NULL ;
+  self->numRemoved = 0 ;
 
-    for (iter = begin ;
-         iter < end &&
-         (searcher->forest->searchMaxNumComparisons == 0 ||
-          searcher->searchNumComparisons < searcher->forest->searchMaxNumComparisons) ;
-         ++ iter) {
+  self->data = data ;
+  self->numData = numData ;
+  self->numBaseData = numData ;
+  vl_kdforest_build_trees (self, NULL, 0) ;
+}
 
-      vl_index di = tree->dataIndex [iter].index ;
+/** ------------------------------------------------------------------
+ ** @brief Convert the forest to the search-optimized layout
+ ** @param self KDForest object.
+ **
+ ** The function converts the trees of a built forest of @c float
+ ** data to a compact layout. In this layout, nodes take 32 bytes
+ ** instead of 48. Child indexes are stored as 32-bit integers and
+ ** split dimensions as 16-bit integers. Thresholds and bounds keep
+ ** their double precision, so that queries are routed exactly as in
+ ** the original trees. Nodes are stored in breadth-first order.
+ **
+ ** Each tree also stores a copy of the data, reordered so that the
+ ** points of each leaf are contiguous. A leaf can then be scanned
+ ** with a streaming distance loop. This costs one copy of the data
+ ** per tree. Search results are unchanged.
+ **
+ ** The original nodes are kept, so the conversion can be repeated and
+ ** the forest can still be exported. The data dimension must not be
+ ** larger than 65536.
+ **/
 
-      /* multiple KDTrees share the database points and we must avoid
-       * adding the same point twice */
-      if (searcher->searchIdBook[di] == searcher->searchId) continue ;
-      searcher->searchIdBook[di] = searcher->searchId ;
+void
+vl_kdforest_compact (VlKDForest * self)
+{
+  vl_uindex ti ;
 
-      /* compare the query to this point */
-      switch (searcher->forest->dataType) {
-        case VL_TYPE_FLOAT:
-          dist = ((VlFloatVectorComparisonFunction)searcher->forest->distanceFunction)
-                 (searcher->forest->dimension,
-                  ((float const *)query),
-                  ((float const*)searcher->forest->data) + di * searcher->forest->dimension) ;
-          break ;
-        case VL_TYPE_DOUBLE:
-          dist = ((VlDoubleVectorComparisonFunction)searcher->forest->distanceFunction)
-                 (searcher->forest->dimension,
-                  ((double const *)query),
-                  ((double const*)searcher->forest->data) + di * searcher->forest->dimension) ;
-          break ;
-        default:
-          abort() ;
-      }
-      searcher->searchNumComparisons += 1 ;
+  assert (self->dataType == VL_TYPE_FLOAT) ;
+  assert (self->dimension <= 65536) ;
+  assert (self->trees) ;
 
-      /* see if it should be added to the result set */
-      if (*numAddedNeighbors < numNeighbors) {
-        VlKDForestNeighbor * newNeighbor = neighbors + *numAddedNeighbors ;
-        newNeighbor->index = di ;
-        newNeighbor->distance = dist ;
-        vl_kdforest_neighbor_heap_push (neighbors, numAddedNeighbors) ;
+  for (ti = 0 ; ti < self->numTrees ; ++ ti) {
+    VlKDTree * tree = self->trees[ti] ;
+    vl_uindex * queue ;
+    vl_uindex head = 0, tail = 0, i ;
+
+    if (tree->compactNodes) continue ;
+
+    tree->compactNodes = vl_malloc (sizeof(VlKDTreeCompactNode) * tree->numUsedNodes) ;
+    tree->compactData = vl_malloc (sizeof(float) * self->dimension * self->numIndexedData) ;
+
+    /* the queue of the visit doubles as new-to-old node map */
+    queue = vl_malloc (sizeof(vl_uindex) * tree->numUsedNodes) ;
+    queue[tail++] = 0 ;
+    while (head < tail) {
+      VlKDTreeNode const * node = tree->nodes + queue[head] ;
+      VlKDTreeCompactNode * compactNode = tree->compactNodes + head ;
+      if (node->lowerChild < 0) {
+        compactNode->lowerChild = -1 ;
+        compactNode->splitDimension = 0 ;
+        compactNode->u.leaf.begin = (vl_uint32) (- node->lowerChild - 1) ;
+        compactNode->u.leaf.end = (vl_uint32) (- node->upperChild - 1) ;
       } else {
-        VlKDForestNeighbor * largestNeighbor = neighbors + 0 ;
-        if (largestNeighbor->distance > dist) {
-          largestNeighbor->index = di ;
-          largestNeighbor->distance = dist ;
-          vl_kdforest_neighbor_heap_update (neighbors, *numAddedNeighbors, 0) ;
-        }
+        compactNode->lowerChild = (vl_int32) tail ;
+        compactNode->splitDimension = (vl_uint16) node->splitDimension ;
+        compactNode->u.split.threshold = node->splitThreshold ;
+        compactNode->u.split.lowerBound = node->lowerBound ;
+        compactNode->u.split.upperBound = node->upperBound ;
+        queue[tail++] = node->lowerChild ;
+        queue[tail++] = node->upperChild ;
       }
-    } /* next data point */
-
+      head ++ ;
+    }
+    vl_free (queue) ;
 
-    return nodeIndex ;
+    for (i = 0 ; i < self->numIndexedData ; ++ i) {
+      memcpy (tree->compactData + i * self->dimension,
+              vl_kdforest_get_point (self, tree->dataIndex[i].index),
+              sizeof(float) * self->dimension) ;
+    }
   }
+}
 
-#if 0
-  assert (x1 <= x2 && x2 <= x3) ;
-  assert (node->lowerChild >= 0) ;
-  assert (node->upperChild >= 0) ;
-#endif
+/* ---------------------------------------------------------------- */
+/*                                                         Updating */
+/* ---------------------------------------------------------------- */
 
-  /*
-   *   x1  x2 x3
-   * x (---|---]
-   *   (--x|---]
-   *   (---|x--]
-   *   (---|---] x
-   */
+/** ------------------------------------------------------------------
+ ** @brief Add points to the forest
+ ** @param self KDForest object.
+ ** @param numData number of points to add.
+ ** @param data points to add.
+ ** @return index of the first added point.
+ **
+ ** The function adds @a numData points to a built forest. Unlike the
+ ** data passed to ::vl_kdforest_build, the points are copied. They
+ ** receive consecutive indexes after the existing points and are
+ ** found by the following queries.
+ **
+ ** The added points are stored in a flat @e delta buffer, which
+ ** queries scan exhaustively in addition to the trees. The function
+ ** only copies the points and never rebuilds the trees, so its cost
+ ** does not depend on the size of the forest. The delta is moved to
+ ** the trees by ::vl_kdforest_merge, which the caller runs when
+ ** convenient, e.g. when ::vl_kdforest_needs_merge becomes true and
+ ** the load is low.
+ **
+ ** Updates must not run concurrently with queries.
+ **/
 
-  delta = x - x2 ;
-  saveDist = dist + delta*delta ;
+vl_uindex
+vl_kdforest_add (VlKDForest * self, vl_size numData, void const * data)
+{
+  vl_size pointSize = vl_get_type_size(self->dataType) * self->dimension ;
+  vl_uindex firstIndex = self->numBaseData + self->numAppendedData ;
+
+  assert (self->trees) ;
+  assert (data || numData == 0) ;
+
+  if (self->numAppendedData + numData > self->appendedDataCapacity) {
+    vl_size capacity = VL_MAX(2 * self->appendedDataCapacity,
+                              self->numAppendedData + numData) ;
+    self->appendedData = vl_realloc (self->appendedData, pointSize * capacity) ;
+    if (self->removed) {
+      self->removed = vl_realloc (self->removed, self->numBaseData + capacity) ;
+      memset (self->removed + self->numBaseData + self->appendedDataCapacity, 0,
+              capacity - self->appendedDataCapacity) ;
+    }
+    self->appendedDataCapacity = capacity ;
+  }
+  memcpy ((char*)self->appendedData + self->numAppendedData * pointSize,
+          data, numData * pointSize) ;
+  self->numAppendedData += numData ;
+  return firstIndex ;
+}
 
-  if (x <= x2) {
+/** ------------------------------------------------------------------
+ ** @brief Remove a point from the forest
+ ** @param self KDForest object.
+ ** @param index index of the point to remove.
+ **
+ ** The point is marked as removed and is skipped by the following
+ ** queries. Indexes of the other points do not change. The point is
+ ** still stored in the trees, which are not modified, until the next
+ ** ::vl_kdforest_merge. Removing a point twice has no effect.
+ **
+ ** Updates must not run concurrently with queries.
+ **/
+
+void
+vl_kdforest_remove (VlKDForest * self, vl_uindex index)
+{
+  assert (index < self->numBaseData + self->numAppendedData) ;
+  if (! self->removed) {
+    self->removed = vl_calloc (1, self->numBaseData + self->appendedDataCapacity) ;
+  }
+  if (! self->removed[index]) {
+    self->removed[index] = 1 ;
+    self->numRemoved ++ ;
+  }
+}
+
+/** ------------------------------------------------------------------
+ ** @internal @brief Get the maximum size of the delta buffer in use
+ ** @param self KDForest object.
+ ** @return maximum number of points.
+ **/
+
+static vl_size
+vl_kdforest_get_merge_threshold (VlKDForest const * self)
+{
+  if (self->maxNumDeltaData > 0) return self->maxNumDeltaData ;
+  return VL_MAX(VL_KDFOREST_MIN_NUM_DELTA_DATA, self->numIndexedData / 8) ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Merge the updates in the trees
+ ** @param self KDForest object.
+ **
+ ** The function rebuilds the trees over the points of the forest that
+ ** are not removed, emptying the delta buffer (see ::vl_kdforest_add)
+ ** and purging the removed points (see ::vl_kdforest_remove) from the
+ ** trees. The points keep their indexes. If the forest is compact, so
+ ** are the new trees. If all the points are removed, the trees are
+ ** left unchanged.
+ **
+ ** The rebuild costs as much as ::vl_kdforest_build, and the function
+ ** is never called implicitly. It should be called at a convenient
+ ** time, e.g. when the load is low, once ::vl_kdforest_needs_merge
+ ** returns true. Like the other updates, it must not run
+ ** concurrently with queries.
+ **/
+
+void
+vl_kdforest_merge (VlKDForest * self)
+{
+  vl_bool compact = vl_kdforest_is_compact (self) ;
+  vl_size numData = self->numBaseData + self->numAppendedData ;
+  vl_size numLive = 0 ;
+  vl_uindex * indexes ;
+  vl_uindex di ;
+
+  if (vl_kdforest_get_num_delta_data(self) == 0 && self->numRemoved == 0) return ;
+
+  /* the removed points stay marked in self->removed after they are
+     purged, so that removing them again has no effect */
+  indexes = vl_malloc (sizeof(vl_uindex) * numData) ;
+  for (di = 0 ; di < numData ; ++ di) {
+    if (self->removed && self->removed[di]) continue ;
+    indexes[numLive++] = di ;
+  }
+  if (numLive == 0) {
+    vl_free (indexes) ;
+    return ;
+  }
+
+  vl_kdforest_free_trees (self) ;
+  self->numData = numData ;
+  self->numRemoved = 0 ;
+  vl_kdforest_build_trees (self, indexes, numLive) ;
+  if (compact) vl_kdforest_compact (self) ;
+  vl_free (indexes) ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Check whether the forest should be merged
+ ** @param self KDForest object.
+ ** @return whether ::vl_kdforest_merge is due.
+ **
+ ** The function returns true when the points in the delta buffer, or
+ ** the removed points still stored in the trees, exceed
+ ** ::vl_kdforest_get_max_num_delta_data.
+ **/
+
+vl_bool
+vl_kdforest_needs_merge (VlKDForest const * self)
+{
+  vl_size threshold = vl_kdforest_get_merge_threshold (self) ;
+  return vl_kdforest_get_num_delta_data(self) > threshold || self->numRemoved > threshold ;
+}
+
+/* ---------------------------------------------------------------- */
+/*                                               Saving and loading */
+/* ---------------------------------------------------------------- */
+
+#define VL_KDFOREST_FILE_VERSION 2
+#define VL_KDFOREST_FILE_ALIGNMENT 64
+#define VL_KDFOREST_FILE_EMBEDDED_DATA 0x1
+#define VL_KDFOREST_FILE_COMPACT 0x2
+
+static char const vl_kdforest_file_magic [8] = {'V','L','K','D','F','R','S','T'} ;
+
+/* All offsets are in bytes from the beginning of the file and are
+   multiple of VL_KDFOREST_FILE_ALIGNMENT. An offset of zero marks a
+   missing section. Arrays are stored in the host byte order and
+   structure layout, which the header records. */
+
+typedef struct _VlKDForestFileHeader
+{
+  char magic [8] ;
+  vl_uint32 version ;
+  vl_uint32 byteOrder ;
+  vl_uint32 dataType ;
+  vl_uint32 distance ;
+  vl_uint32 thresholdingMethod ;
+  vl_uint32 flags ;
+  vl_uint32 nodeSize ;
+  vl_uint32 compactNodeSize ;
+  vl_uint32 dataIndexEntrySize ;
+  vl_uint32 leafSize ;
+  vl_uint64 dimension ;
+  vl_uint64 numData ;
+  vl_uint64 numTrees ;
+  vl_uint64 dataOffset ;
+  vl_uint64 numIndexedData ;
+} VlKDForestFileHeader ;
+
+typedef struct _VlKDForestFileTree
+{
+  vl_uint64 numNodes ;
+  vl_uint64 depth ;
+  vl_uint64 nodesOffset ;
+  vl_uint64 dataIndexOffset ;
+  vl_uint64 compactNodesOffset ;
+  vl_uint64 compactDataOffset ;
+} VlKDForestFileTree ;
+
+/** @internal @brief Reserve an aligned section of the file */
+
+static vl_uint64
+vl_kdforest_file_reserve (vl_uint64 * fileSize, vl_uint64 size)
+{
+  vl_uint64 offset = (*fileSize + VL_KDFOREST_FILE_ALIGNMENT - 1)
+    & ~ (vl_uint64) (VL_KDFOREST_FILE_ALIGNMENT - 1) ;
+  *fileSize = offset + size ;
+  return offset ;
+}
+
+/** @internal @brief Write a section, padding the file up to its offset */
+
+static vl_bool
+vl_kdforest_file_write (FILE * file, vl_uint64 * position,
+                        vl_uint64 offset, void const * buffer, vl_uint64 size)
+{
+  static char const padding [VL_KDFOREST_FILE_ALIGNMENT] = {0} ;
+  assert (offset >= *position) ;
+  assert (offset - *position <= VL_KDFOREST_FILE_ALIGNMENT) ;
+  if (fwrite (padding, 1, (size_t)(offset - *position), file) != offset - *position) {
+    return VL_FALSE ;
+  }
+  if (size > 0 && fwrite (buffer, 1, (size_t)size, file) != size) {
+    return VL_FALSE ;
+  }
+  *position = offset + size ;
+  return VL_TRUE ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Save the forest to a file
+ ** @param self KDForest object.
+ ** @param fileName name of the file to write.
+ ** @param embedData whether to store a copy of the indexed data.
+ ** @return error code.
+ **
+ ** The function writes the trees of a built forest to a binary file
+ ** that ::vl_kdforest_load can map back in memory. The file contains
+ ** the nodes and data index of each tree and, if the forest is
+ ** compact, the compact nodes and the reordered data as well. If @a
+ ** embedData is true, the file also stores a copy of the indexed
+ ** data, so that the forest can be loaded without it.
+ **
+ ** Only the trees are saved. The function fails with
+ ** ::VL_ERR_BAD_ARG if the delta buffer is not empty or if removed
+ ** points are still stored in the trees (call ::vl_kdforest_merge
+ ** first in both cases). Points
+ ** added by ::vl_kdforest_add are not part of the data passed to
+ ** ::vl_kdforest_build, so a forest containing them can only be
+ ** saved with @a embedData set.
+ **
+ ** Arrays are written in the native byte order and structure layout
+ ** of the host. The header records both, so that a file produced by
+ ** an incompatible build is rejected by the loader rather than
+ ** misread.
+ **/
+
+int
+vl_kdforest_save (VlKDForest const * self, char const * fileName, vl_bool embedData)
+{
+  VlKDForestFileHeader header ;
+  VlKDForestFileTree * fileTrees ;
+  vl_uint64 fileSize, position = 0 ;
+  vl_uint64 dataSize = vl_get_type_size(self->dataType) * self->dimension * self->numData ;
+  vl_bool compact = vl_kdforest_is_compact (self) ;
+  vl_bool ok ;
+  vl_uindex ti ;
+  FILE * file ;
+
+  assert (self->trees) ;
+
+  if (vl_kdforest_get_num_delta_data(self) > 0) {
+    return vl_set_last_error (VL_ERR_BAD_ARG, "Cannot save a KD-forest with points in the delta buffer") ;
+  }
+  if (self->numRemoved > 0) {
+    return vl_set_last_error (VL_ERR_BAD_ARG, "Cannot save a KD-forest with removed points") ;
+  }
+  if (! embedData && self->numAppendedData > 0) {
+    return vl_set_last_error (VL_ERR_BAD_ARG, "Cannot save a KD-forest with added points without embedding the data") ;
+  }
+
+  memset (&header, 0, sizeof(header)) ;
+  memcpy (header.magic, vl_kdforest_file_magic, sizeof(header.magic)) ;
+  header.version = VL_KDFOREST_FILE_VERSION ;
+  header.byteOrder = 0x01020304 ;
+  header.dataType = self->dataType ;
+  header.distance = self->distance ;
+  header.thresholdingMethod = self->thresholdingMethod ;
+  header.flags = (embedData ? VL_KDFOREST_FILE_EMBEDDED_DATA : 0)
+    | (compact ? VL_KDFOREST_FILE_COMPACT : 0) ;
+  header.nodeSize = sizeof(VlKDTreeNode) ;
+  header.compactNodeSize = sizeof(VlKDTreeCompactNode) ;
+  header.dataIndexEntrySize = sizeof(VlKDTreeDataIndexEntry) ;
+  header.leafSize = (vl_uint32) self->leafSize ;
+  header.dimension = self->dimension ;
+  header.numData = self->numData ;
+  header.numIndexedData = self->numIndexedData ;
+  header.numTrees = self->numTrees ;
+
+  /* lay out the file */
+  fileTrees = vl_calloc (sizeof(VlKDForestFileTree), self->numTrees) ;
+  fileSize = sizeof(header) + sizeof(VlKDForestFileTree) * self->numTrees ;
+  for (ti = 0 ; ti < self->numTrees ; ++ ti) {
+    VlKDTree const * tree = self->trees[ti] ;
+    fileTrees[ti].numNodes = tree->numUsedNodes ;
+    fileTrees[ti].depth = tree->depth ;
+    fileTrees[ti].nodesOffset = vl_kdforest_file_reserve
+      (&fileSize, sizeof(VlKDTreeNode) * tree->numUsedNodes) ;
+    fileTrees[ti].dataIndexOffset = vl_kdforest_file_reserve
+      (&fileSize, sizeof(VlKDTreeDataIndexEntry) * self->numIndexedData) ;
+    if (compact) {
+      fileTrees[ti].compactNodesOffset = vl_kdforest_file_reserve
+        (&fileSize, sizeof(VlKDTreeCompactNode) * tree->numUsedNodes) ;
+      fileTrees[ti].compactDataOffset = vl_kdforest_file_reserve
+        (&fileSize, sizeof(float) * self->dimension * self->numIndexedData) ;
+    }
+  }
+  if (embedData) {
+    header.dataOffset = vl_kdforest_file_reserve (&fileSize, dataSize) ;
+  }
+
+  file = fopen (fileName, "wb") ;
+  if (! file) {
+    vl_free (fileTrees) ;
+    return vl_set_last_error (VL_ERR_IO, "Error opening KD-forest file `%s' for writing", fileName) ;
+  }
+
+  ok = vl_kdforest_file_write (file, &position, 0, &header, sizeof(header)) ;
+  ok = ok && vl_kdforest_file_write (file, &position, position, fileTrees,
+                                     sizeof(VlKDForestFileTree) * self->numTrees) ;
+  for (ti = 0 ; ok && ti < self->numTrees ; ++ ti) {
+    VlKDTree const * tree = self->trees[ti] ;
+    ok = ok && vl_kdforest_file_write (file, &position, fileTrees[ti].nodesOffset, tree->nodes,
+                                       sizeof(VlKDTreeNode) * tree->numUsedNodes) ;
+    ok = ok && vl_kdforest_file_write (file, &position, fileTrees[ti].dataIndexOffset, tree->dataIndex,
+                                       sizeof(VlKDTreeDataIndexEntry) * self->numIndexedData) ;
+    if (compact) {
+      ok = ok && vl_kdforest_file_write (file, &position, fileTrees[ti].compactNodesOffset, tree->compactNodes,
+                                         sizeof(VlKDTreeCompactNode) * tree->numUsedNodes) ;
+      ok = ok && vl_kdforest_file_write (file, &position, fileTrees[ti].compactDataOffset, tree->compactData,
+                                         sizeof(float) * self->dimension * self->numIndexedData) ;
+    }
+  }
+  if (embedData) {
+    /* points added after the forest was built are stored separately */
+    vl_uint64 baseDataSize = dataSize / self->numData * self->numBaseData ;
+    ok = ok && vl_kdforest_file_write (file, &position, header.dataOffset,
+                                       self->data, baseDataSize) ;
+    ok = ok && vl_kdforest_file_write (file, &position, position,
+                                       self->appendedData, dataSize - baseDataSize) ;
+  }
+  vl_free (fileTrees) ;
+
+  if (fclose (file) != 0 || ! ok) {
+    return vl_set_last_error (VL_ERR_IO, "Error writing KD-forest file `%s'", fileName) ;
+  }
+  return VL_ERR_OK ;
+}
+
+/** @internal @brief Check that a file section is within the file */
+
+static vl_bool
+vl_kdforest_file_has_section (vl_size fileSize, vl_uint64 offset, vl_uint64 size)
+{
+  return offset > 0
+    && offset % VL_KDFOREST_FILE_ALIGNMENT == 0
+    && offset <= fileSize
+    && size <= fileSize - offset ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Load a forest from a file
+ ** @param fileName name of a file written by ::vl_kdforest_save.
+ ** @param data indexed data (may be @c NULL).
+ ** @return new KDForest object, or @c NULL on error.
+ **
+ ** The function maps the file read-only in memory and returns a
+ ** forest whose trees point directly into the mapping. Loading does
+ ** not read the trees, so it takes constant time, and processes
+ ** loading the same file share a single copy of it through the page
+ ** cache. The file must not change while the forest is in use.
+ **
+ ** @a data is the indexed data, in the same format passed to
+ ** ::vl_kdforest_build. If @a data is @c NULL, the file must embed
+ ** the data (see ::vl_kdforest_save), which is then used instead.
+ **
+ ** The file header is validated, but the trees are trusted. In case
+ ** of error the function returns @c NULL and sets the last error
+ ** (see ::vl_get_last_error).
+ **
+ ** The forest is released by ::vl_kdforest_delete as usual, which
+ ** also unmaps the file.
+ **/
+
+VlKDForest *
+vl_kdforest_load (char const * fileName, void const * data)
+{
+  VlKDForestFileHeader const * header ;
+  VlKDForestFileTree const * fileTrees = NULL ;
+  VlKDForest * self ;
+  char const * buffer ;
+  char const * error = NULL ;
+  vl_size fileSize = 0 ;
+  vl_size dataSize = 0 ;
+  vl_uindex ti ;
+
+  buffer = _vl_map_file (fileName, &fileSize) ;
+  if (! buffer) {
+    vl_set_last_error (VL_ERR_IO, "Error opening KD-forest file `%s' for reading", fileName) ;
+    return NULL ;
+  }
+  header = (VlKDForestFileHeader const *) buffer ;
+
+  if (fileSize < sizeof(VlKDForestFileHeader) ||
+      memcmp (header->magic, vl_kdforest_file_magic, sizeof(header->magic)) != 0) {
+    error = "`%s' is not a KD-forest file" ;
+  } else if (header->version != VL_KDFOREST_FILE_VERSION) {
+    error = "KD-forest file `%s' has an unsupported version" ;
+  } else if (header->byteOrder != 0x01020304 ||
+             header->nodeSize != sizeof(VlKDTreeNode) ||
+             header->compactNodeSize != sizeof(VlKDTreeCompactNode) ||
+             header->dataIndexEntrySize != sizeof(VlKDTreeDataIndexEntry)) {
+    error = "KD-forest file `%s' was written by an incompatible host" ;
+  } else if ((header->dataType != VL_TYPE_FLOAT && header->dataType != VL_TYPE_DOUBLE) ||
+             (header->distance != VlDistanceL1 && header->distance != VlDistanceL2) ||
+             (header->thresholdingMethod != VL_KDTREE_MEDIAN &&
+              header->thresholdingMethod != VL_KDTREE_MEAN) ||
+             header->dimension < 1 || header->numData < 1 || header->numTrees < 1 ||
+             header->numIndexedData < 1 || header->numIndexedData > header->numData ||
+             header->numTrees > (fileSize - sizeof(VlKDForestFileHeader)) / sizeof(VlKDForestFileTree)) {
+    error = "KD-forest file `%s' is corrupted" ;
+  }
+
+  if (! error) {
+    dataSize = vl_get_type_size(header->dataType) * header->dimension * header->numData ;
+    fileTrees = (VlKDForestFileTree const *) (header + 1) ;
+
+    for (ti = 0 ; ti < header->numTrees ; ++ ti) {
+      VlKDForestFileTree const * fileTree = fileTrees + ti ;
+      vl_bool ok =
+        fileTree->numNodes >= 1 &&
+        vl_kdforest_file_has_section (fileSize, fileTree->nodesOffset,
+                                      sizeof(VlKDTreeNode) * fileTree->numNodes) &&
+        vl_kdforest_file_has_section (fileSize, fileTree->dataIndexOffset,
+                                      sizeof(VlKDTreeDataIndexEntry) * header->numIndexedData) ;
+      if (header->flags & VL_KDFOREST_FILE_COMPACT) {
+        ok = ok &&
+          vl_kdforest_file_has_section (fileSize, fileTree->compactNodesOffset,
+                                        sizeof(VlKDTreeCompactNode) * fileTree->numNodes) &&
+          vl_kdforest_file_has_section (fileSize, fileTree->compactDataOffset,
+                                        sizeof(float) * header->dimension * header->numIndexedData) ;
+      }
+      if (! ok) error = "KD-forest file `%s' is corrupted" ;
+    }
+
+    if (header->flags & VL_KDFOREST_FILE_EMBEDDED_DATA) {
+      if (! vl_kdforest_file_has_section (fileSize, header->dataOffset, dataSize)) {
+        error = "KD-forest file `%s' is corrupted" ;
+      } else if (! data) {
+        data = buffer + header->dataOffset ;
+      }
+    } else if (! data) {
+      error = "KD-forest file `%s' does not embed the data" ;
+    }
+  }
+
+  if (error) {
+    vl_set_last_error (VL_ERR_BAD_ARG, error, fileName) ;
+    _vl_unmap_file ((void*)buffer, fileSize) ;
+    return NULL ;
+  }
+
+  self = vl_kdforest_new (header->dataType, header->dimension,
+                          header->numTrees, header->distance) ;
+  self->thresholdingMethod = header->thresholdingMethod ;
+  self->leafSize = VL_MAX(header->leafSize, 1) ;
+  self->data = data ;
+  self->numData = header->numData ;
+  self->numIndexedData = header->numIndexedData ;
+  self->numBaseData = header->numData ;
+  self->mappedFile = (void*) buffer ;
+  self->mappedFileSize = fileSize ;
+  self->trees = vl_malloc (sizeof(VlKDTree*) * self->numTrees) ;
+
+  for (ti = 0 ; ti < self->numTrees ; ++ ti) {
+    VlKDForestFileTree const * fileTree = fileTrees + ti ;
+    VlKDTree * tree = vl_calloc (sizeof(VlKDTree), 1) ;
+    tree->nodes = (VlKDTreeNode*) (buffer + fileTree->nodesOffset) ;
+    tree->numUsedNodes = fileTree->numNodes ;
+    tree->numAllocatedNodes = fileTree->numNodes ;
+    tree->dataIndex = (VlKDTreeDataIndexEntry*) (buffer + fileTree->dataIndexOffset) ;
+    tree->depth = (unsigned int) fileTree->depth ;
+    if (header->flags & VL_KDFOREST_FILE_COMPACT) {
+      tree->compactNodes = (VlKDTreeCompactNode*) (buffer + fileTree->compactNodesOffset) ;
+      tree->compactData = (float*) (buffer + fileTree->compactDataOffset) ;
+    }
+    self->trees[ti] = tree ;
+    self->maxNumNodes += tree->numUsedNodes ;
+  }
+  return self ;
+}
+
+/** ------------------------------------------------------------------
+ ** @internal @brief Add a point to the results of a search
+ ** @param searcher searcher object.
+ ** @param neighbors neighbor heap (k-NN search).
+ ** @param numNeighbors size of the heap (k-NN search).
+ ** @param numAddedNeighbors number of neighbors found so far (in/out).
+ ** @param di index of the point.
+ ** @param dist distance of the point to the query.
+ **
+ ** In a k-NN search the point replaces the farthest neighbor if
+ ** closer. In a radius search it is appended to the buffer of the
+ ** searcher if within the radius.
+ **/
+
+static void
+vl_kdforestsearcher_add_neighbor (VlKDForestSearcher * searcher,
+                                  VlKDForestNeighbor * neighbors,
+                                  vl_size numNeighbors,
+                                  vl_size * numAddedNeighbors,
+                                  vl_index di,
+                                  double dist)
+{
+  if (searcher->radiusSearch) {
+    if (dist <= searcher->radius) {
+      if (*numAddedNeighbors == searcher->radiusNeighborsCapacity) {
+        /* vl_realloc cannot be used here if mapped to MATLAB realloc,
+           as searchers may run in parallel */
+        searcher->radiusNeighborsCapacity = VL_MAX(64, 2 * searcher->radiusNeighborsCapacity) ;
+        searcher->radiusNeighbors = realloc (searcher->radiusNeighbors,
+                                             sizeof(VlKDForestNeighbor) *
+                                             searcher->radiusNeighborsCapacity) ;
+      }
+      searcher->radiusNeighbors[*numAddedNeighbors].index = di ;
+      searcher->radiusNeighbors[*numAddedNeighbors].distance = dist ;
+      (*numAddedNeighbors) ++ ;
+    }
+  } else if (*numAddedNeighbors < numNeighbors) {
+    VlKDForestNeighbor * newNeighbor = neighbors + *numAddedNeighbors ;
+    newNeighbor->index = di ;
+    newNeighbor->distance = dist ;
+    vl_kdforest_neighbor_heap_push (neighbors, numAddedNeighbors) ;
+  } else {
+    VlKDForestNeighbor * largestNeighbor = neighbors + 0 ;
+    if (largestNeighbor->distance > dist) {
+      largestNeighbor->index = di ;
+      largestNeighbor->distance = dist ;
+      vl_kdforest_neighbor_heap_update (neighbors, *numAddedNeighbors, 0) ;
+    }
+  }
+}
+
+/** ------------------------------------------------------------------
+ ** @internal @brief Check whether a partition may contain results
+ ** @param searcher searcher object.
+ ** @param neighbors neighbor heap (k-NN search).
+ ** @param numNeighbors size of the heap (k-NN search).
+ ** @param numAddedNeighbors number of neighbors found so far.
+ ** @param bound lower bound on the distance of the partition.
+ ** @return whether the partition should be searched.
+ **/
+
+VL_INLINE vl_bool
+vl_kdforestsearcher_is_bound_relevant (VlKDForestSearcher const * searcher,
+                                       VlKDForestNeighbor const * neighbors,
+                                       vl_size numNeighbors,
+                                       vl_size numAddedNeighbors,
+                                       double bound)
+{
+  if (searcher->radiusSearch) {
+    return bound <= searcher->radius ;
+  }
+  return numAddedNeighbors < numNeighbors || neighbors[0].distance > bound ;
+}
+
+/** ------------------------------------------------------------------
+ ** @internal @brief
+ **/
+
+vl_uindex
+vl_kdforest_query_recursively (VlKDForestSearcher * searcher,
+                               VlKDTree * tree,
+                               vl_uindex nodeIndex,
+                               VlKDForestNeighbor * neighbors,
+                               vl_size numNeighbors,
+                               vl_size * numAddedNeighbors,
+                               double dist,
+                               void const * query)
+{
+
+  VlKDTreeNode const * node = tree->nodes + nodeIndex ;
+  vl_uindex i = node->splitDimension ;
+  vl_index nextChild, saveChild ;
+  double delta, saveDist ;
+  double x ;
+  double x1 = node->lowerBound ;
+  double x2 = node->splitThreshold ;
+  double x3 = node->upperBound ;
+  VlKDForestSearchState * searchState ;
+
+  searcher->searchNumRecursions ++ ;
+
+  switch (searcher->forest->dataType) {
+    case VL_TYPE_FLOAT :
+      x = ((float const*) query)[i] ;
+      break ;
+    case VL_TYPE_DOUBLE :
+      x = ((double const*) query)[i] ;
+      break ;
+    default :
+      abort() ;
+  }
+
+  /* base case: this is a leaf node */
+  if (node->lowerChild < 0) {
+
+    vl_index begin = - node->lowerChild - 1 ;
+    vl_index end   = - node->upperChild - 1 ;
+    vl_index iter ;
+
+    for (iter = begin ;
+         iter < end &&
+         (searcher->forest->searchMaxNumComparisons == 0 ||
+          searcher->searchNumComparisons < searcher->forest->searchMaxNumComparisons) ;
+         ++ iter) {
+
+      vl_index di = tree->dataIndex [iter].index ;
+
+      /* multiple KDTrees share the database points and we must avoid
+       * adding the same point twice */
+      if (searcher->searchIdBook[di] == searcher->searchId) continue ;
+      searcher->searchIdBook[di] = searcher->searchId ;
+      if (searcher->forest->removed && searcher->forest->removed[di]) continue ;
+
+      /* compare the query to this point */
+      switch (searcher->forest->dataType) {
+        case VL_TYPE_FLOAT:
+          dist = ((VlFloatVectorComparisonFunction)searcher->forest->distanceFunction)
+                 (searcher->forest->dimension,
+                  ((float const *)query),
+                  (float const*) vl_kdforest_get_point (searcher->forest, di)) ;
+          break ;
+        case VL_TYPE_DOUBLE:
+          dist = ((VlDoubleVectorComparisonFunction)searcher->forest->distanceFunction)
+                 (searcher->forest->dimension,
+                  ((double const *)query),
+                  (double const*) vl_kdforest_get_point (searcher->forest, di)) ;
+          break ;
+        default:
+          abort() ;
+      }
+      searcher->searchNumComparisons += 1 ;
+
+      vl_kdforestsearcher_add_neighbor (searcher, neighbors, numNeighbors,
+                                        numAddedNeighbors, di, dist) ;
+    } /* next data point */
+
+
+    return nodeIndex ;
+  }
+
+#if 0
+  assert (x1 <= x2 && x2 <= x3) ;
+  assert (node->lowerChild >= 0) ;
+  assert (node->upperChild >= 0) ;
+#endif
+
+  /*
+   *   x1  x2 x3
+   * x (---|---]
+   *   (--x|---]
+   *   (---|x--]
+   *   (---|---] x
+   */
+
+  delta = x - x2 ;
+  saveDist = dist + delta*delta ;
+
+  if (x <= x2) {
     nextChild = node->lowerChild ;
     saveChild = node->upperChild ;
     if (x <= x1) {
@@ -707,7 +1651,8 @@ vl_kdforest_query_recursively (VlKDForestSearcher * searcher,
     }
   }
 
-  if (*numAddedNeighbors < numNeighbors || neighbors[0].distance > saveDist) {
+  if (vl_kdforestsearcher_is_bound_relevant (searcher, neighbors, numNeighbors,
+                                              *numAddedNeighbors, saveDist)) {
     searchState = searcher->searchHeapArray + searcher->searchHeapNumNodes ;
     searchState->tree = tree ;
     searchState->nodeIndex = saveChild ;
@@ -726,6 +1671,109 @@ vl_kdforest_query_recursively (VlKDForestSearcher * searcher,
                                         query) ;
 }
 
+/** ------------------------------------------------------------------
+ ** @internal @brief Search a tree in the compact layout
+ **
+ ** This is the analogous of ::vl_kdforest_query_recursively for the
+ ** layout produced by ::vl_kdforest_compact. The descent is
+ ** iterative and the points of the leaf are read sequentially from
+ ** the reordered copy of the data.
+ **/
+
+static void
+vl_kdforest_query_compact (VlKDForestSearcher * searcher,
+                           VlKDTree * tree,
+                           vl_uindex nodeIndex,
+                           VlKDForestNeighbor * neighbors,
+                           vl_size numNeighbors,
+                           vl_size * numAddedNeighbors,
+                           double dist,
+                           float const * query)
+{
+  VlKDForest const * forest = searcher->forest ;
+  VlFloatVectorComparisonFunction distanceFunction =
+    (VlFloatVectorComparisonFunction) forest->distanceFunction ;
+  vl_size dimension = forest->dimension ;
+  VlKDTreeCompactNode const * node = tree->compactNodes + nodeIndex ;
+  float const * leafDistances = NULL ;
+  float const * point ;
+  vl_uindex iter, end ;
+
+  while (node->lowerChild >= 0) {
+    double x = query[node->splitDimension] ;
+    double x2 = node->u.split.threshold ;
+    double delta = x - x2 ;
+    double saveDist = dist + delta*delta ;
+    vl_index nextChild, saveChild ;
+
+    searcher->searchNumRecursions ++ ;
+
+    if (x <= x2) {
+      nextChild = node->lowerChild ;
+      saveChild = node->lowerChild + 1 ;
+      if (x <= node->u.split.lowerBound) {
+        delta = x - node->u.split.lowerBound ;
+        saveDist -= delta*delta ;
+      }
+    } else {
+      nextChild = node->lowerChild + 1 ;
+      saveChild = node->lowerChild ;
+      if (x > node->u.split.upperBound) {
+        delta = x - node->u.split.upperBound ;
+        saveDist -= delta*delta ;
+      }
+    }
+
+    if (vl_kdforestsearcher_is_bound_relevant (searcher, neighbors, numNeighbors,
+                                                *numAddedNeighbors, saveDist)) {
+      VlKDForestSearchState * searchState = searcher->searchHeapArray + searcher->searchHeapNumNodes ;
+      searchState->tree = tree ;
+      searchState->nodeIndex = saveChild ;
+      searchState->distanceLowerBound = saveDist ;
+      vl_kdforest_search_heap_push (searcher->searchHeapArray ,
+                                    &searcher->searchHeapNumNodes) ;
+    }
+
+    node = tree->compactNodes + nextChild ;
+  }
+
+  searcher->searchNumRecursions ++ ;
+  end = node->u.leaf.end ;
+  point = tree->compactData + node->u.leaf.begin * dimension ;
+
+  /* use the distances computed in advance for this leaf, if any */
+  if (searcher->leafDistances &&
+      tree == forest->trees[0] &&
+      node->u.leaf.begin == searcher->leafBegin) {
+    leafDistances = searcher->leafDistances ;
+  }
+
+  for (iter = node->u.leaf.begin ;
+       iter < end &&
+       (forest->searchMaxNumComparisons == 0 ||
+        searcher->searchNumComparisons < forest->searchMaxNumComparisons) ;
+       ++ iter, point += dimension) {
+
+    vl_index di = tree->dataIndex [iter].index ;
+
+    /* multiple KDTrees share the database points and we must avoid
+     * adding the same point twice */
+    if (searcher->searchIdBook[di] == searcher->searchId) continue ;
+    searcher->searchIdBook[di] = searcher->searchId ;
+    if (forest->removed && forest->removed[di]) continue ;
+
+    if (leafDistances) {
+      dist = leafDistances [iter - node->u.leaf.begin] ;
+    } else {
+      dist = distanceFunction (dimension, query, point) ;
+    }
+    searcher->searchNumComparisons += 1 ;
+
+    vl_kdforestsearcher_add_neighbor (searcher, neighbors, numNeighbors,
+                                      numAddedNeighbors, di, dist) ;
+  }
+}
+
 /** ------------------------------------------------------------------
  ** @brief Query the forest
  ** @param self object.
@@ -757,36 +1805,103 @@ vl_kdforest_query (VlKDForest * self,
 }
 
 /** ------------------------------------------------------------------
- ** @brief Query the forest
- ** @param self object.
- ** @param neighbors list of nearest neighbors found (output).
- ** @param numNeighbors number of nearest neighbors to find.
+ ** @brief Find all the neighbors within a radius
+ ** @param self object.
+ ** @param neighbors neighbors found (output).
+ ** @param radius search radius.
+ ** @param query query point.
+ ** @return number of neighbors found.
+ **
+ ** This is the same as ::vl_kdforestsearcher_query_radius, using the
+ ** first searcher of the forest.
+ **/
+
+vl_size
+vl_kdforest_query_radius (VlKDForest * self,
+                          VlKDForestNeighbor const ** neighbors,
+                          double radius,
+                          void const * query)
+{
+  VlKDForestSearcher * searcher = vl_kdforest_get_searcher(self, 0) ;
+  if (searcher == NULL) {
+    searcher = vl_kdforest_new_searcher(self) ;
+  }
+  return vl_kdforestsearcher_query_radius(searcher,
+                                          neighbors,
+                                          radius,
+                                          query) ;
+}
+
+/** ------------------------------------------------------------------
+ ** @internal @brief Compare the query to the points of the delta buffer
+ ** @param self searcher object.
+ ** @param neighbors neighbor heap (k-NN search).
+ ** @param numNeighbors size of the heap (k-NN search).
+ ** @param numAddedNeighbors number of neighbors found so far (in/out).
+ ** @param query query point.
+ **
+ ** The delta points are contiguous and are compared in sequence
+ ** with the (SIMD) distance function of the forest. They are not
+ ** subject to the maximum number of comparisons.
+ **/
+
+static void
+vl_kdforestsearcher_scan_delta (VlKDForestSearcher * self,
+                                VlKDForestNeighbor * neighbors,
+                                vl_size numNeighbors,
+                                vl_size * numAddedNeighbors,
+                                void const * query)
+{
+  VlKDForest const * forest = self->forest ;
+  vl_uindex di ;
+  vl_uindex end = forest->numBaseData + forest->numAppendedData ;
+
+  for (di = forest->numData ; di < end ; ++ di) {
+    double dist ;
+    if (forest->removed && forest->removed[di]) continue ;
+    switch (forest->dataType) {
+      case VL_TYPE_FLOAT:
+        dist = ((VlFloatVectorComparisonFunction)forest->distanceFunction)
+               (forest->dimension, query, vl_kdforest_get_point (forest, di)) ;
+        break ;
+      case VL_TYPE_DOUBLE:
+        dist = ((VlDoubleVectorComparisonFunction)forest->distanceFunction)
+               (forest->dimension, query, vl_kdforest_get_point (forest, di)) ;
+        break ;
+      default:
+        abort() ;
+    }
+    self->searchNumComparisons += 1 ;
+    vl_kdforestsearcher_add_neighbor (self, neighbors, numNeighbors,
+                                      numAddedNeighbors, di, dist) ;
+  }
+}
+
+/** ------------------------------------------------------------------
+ ** @internal @brief Search the forest by branch and bound
+ ** @param self searcher object.
+ ** @param neighbors neighbor heap (k-NN search).
+ ** @param numNeighbors size of the heap (k-NN search).
  ** @param query query point.
- ** @return number of tree leaves visited.
+ ** @return number of neighbors found.
  **
- ** A neighbor is represented by an instance of the structure
- ** ::VlKDForestNeighbor. Each entry contains the index of the
- ** neighbor (this is an index into the KDTree data) and its distance
- ** to the query point. Neighbors are sorted by increasing distance.
+ ** This is the search shared by k-NN and radius queries. The latter
+ ** are selected by @c self->radiusSearch and store the neighbors in
+ ** the searcher buffer, unsorted.
  **/
 
-vl_size
-vl_kdforestsearcher_query (VlKDForestSearcher * self,
-                           VlKDForestNeighbor * neighbors,
-                           vl_size numNeighbors,
-                           void const * query)
+static vl_size
+vl_kdforestsearcher_search (VlKDForestSearcher * self,
+                            VlKDForestNeighbor * neighbors,
+                            vl_size numNeighbors,
+                            void const * query)
 {
-
-  vl_uindex i, ti ;
+  vl_uindex ti ;
   vl_bool exactSearch = self->forest->searchMaxNumComparisons == 0 ;
 
   VlKDForestSearchState * searchState  ;
   vl_size numAddedNeighbors = 0 ;
 
-  assert (neighbors) ;
-  assert (numNeighbors > 0) ;
-  assert (query) ;
-
   /* this number is used to differentiate a query from the next */
   self -> searchId += 1 ;
   self -> searchNumRecursions = 0 ;
@@ -818,21 +1933,73 @@ vl_kdforestsearcher_query (VlKDForestSearcher * self,
     searchState = self->searchHeapArray +
                   vl_kdforest_search_heap_pop (self->searchHeapArray, &self->searchHeapNumNodes) ;
     /* break if no better solution may exist */
-    if (numAddedNeighbors == numNeighbors &&
-        neighbors[0].distance < searchState->distanceLowerBound) {
+    if (self->radiusSearch) {
+      if (searchState->distanceLowerBound > self->radius) {
+        self->searchNumSimplifications ++ ;
+        break ;
+      }
+    } else if (numAddedNeighbors == numNeighbors &&
+               neighbors[0].distance < searchState->distanceLowerBound) {
       self->searchNumSimplifications ++ ;
       break ;
     }
-    vl_kdforest_query_recursively (self,
-                                   searchState->tree,
-                                   searchState->nodeIndex,
-                                   neighbors,
-                                   numNeighbors,
-                                   &numAddedNeighbors,
-                                   searchState->distanceLowerBound,
-                                   query) ;
+    if (searchState->tree->compactNodes) {
+      vl_kdforest_query_compact (self,
+                                 searchState->tree,
+                                 searchState->nodeIndex,
+                                 neighbors,
+                                 numNeighbors,
+                                 &numAddedNeighbors,
+                                 searchState->distanceLowerBound,
+                                 query) ;
+    } else {
+      vl_kdforest_query_recursively (self,
+                                     searchState->tree,
+                                     searchState->nodeIndex,
+                                     neighbors,
+                                     numNeighbors,
+                                     &numAddedNeighbors,
+                                     searchState->distanceLowerBound,
+                                     query) ;
+    }
   }
 
+  /* points added after the trees were built are scanned exhaustively */
+  vl_kdforestsearcher_scan_delta (self, neighbors, numNeighbors,
+                                  &numAddedNeighbors, query) ;
+  return numAddedNeighbors ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Query the forest
+ ** @param self object.
+ ** @param neighbors list of nearest neighbors found (output).
+ ** @param numNeighbors number of nearest neighbors to find.
+ ** @param query query point.
+ ** @return number of tree leaves visited.
+ **
+ ** A neighbor is represented by an instance of the structure
+ ** ::VlKDForestNeighbor. Each entry contains the index of the
+ ** neighbor (this is an index into the KDTree data) and its distance
+ ** to the query point. Neighbors are sorted by increasing distance.
+ **/
+
+vl_size
+vl_kdforestsearcher_query (VlKDForestSearcher * self,
+                           VlKDForestNeighbor * neighbors,
+                           vl_size numNeighbors,
+                           void const * query)
+{
+  vl_uindex i ;
+  vl_size numAddedNeighbors ;
+
+  assert (neighbors) ;
+  assert (numNeighbors > 0) ;
+  assert (query) ;
+
+  self->radiusSearch = VL_FALSE ;
+  numAddedNeighbors = vl_kdforestsearcher_search (self, neighbors, numNeighbors, query) ;
+
   /* sort neighbors by increasing distance */
   for (i = numAddedNeighbors ; i < numNeighbors ; ++ i) {
     neighbors[i].index = -1 ;
@@ -846,6 +2013,139 @@ vl_kdforestsearcher_query (VlKDForestSearcher * self,
   return self->searchNumComparisons ;
 }
 
+/** ------------------------------------------------------------------
+ ** @internal @brief Compare neighbors by increasing distance
+ **/
+
+static int
+vl_kdforest_compare_neighbors (void const * a, void const * b)
+{
+  VlKDForestNeighbor const * na = a ;
+  VlKDForestNeighbor const * nb = b ;
+  if (na->distance < nb->distance) return -1 ;
+  if (na->distance > nb->distance) return +1 ;
+  if (na->index < nb->index) return -1 ;
+  if (na->index > nb->index) return +1 ;
+  return 0 ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Find all the neighbors within a radius
+ ** @param self object.
+ ** @param neighbors neighbors found (output).
+ ** @param radius search radius.
+ ** @param query query point.
+ ** @return number of neighbors found.
+ **
+ ** The function finds the data points whose distance to @a query is
+ ** not larger than @a radius. Distances are measured as in the other
+ ** queries, so that for ::VlDistanceL2 @a radius is a squared
+ ** Euclidean distance.
+ **
+ ** On return, @a neighbors points to an array owned by the searcher
+ ** with the neighbors sorted by increasing distance. The array is
+ ** valid until the next query of the searcher.
+ **
+ ** Partitions whose distance lower bound exceeds @a radius are never
+ ** visited. The search is exact unless a maximum number of
+ ** comparisons is set (::vl_kdforest_set_max_num_comparisons). In
+ ** this case it stops early and some neighbors may be missed.
+ **
+ ** @sa ::vl_kdforest_query_radius_with_array.
+ **/
+
+vl_size
+vl_kdforestsearcher_query_radius (VlKDForestSearcher * self,
+                                  VlKDForestNeighbor const ** neighbors,
+                                  double radius,
+                                  void const * query)
+{
+  vl_size numAddedNeighbors ;
+
+  assert (neighbors) ;
+  assert (query) ;
+
+  self->radiusSearch = VL_TRUE ;
+  self->radius = radius ;
+  numAddedNeighbors = vl_kdforestsearcher_search (self, NULL, 0, query) ;
+  self->radiusSearch = VL_FALSE ;
+
+  if (numAddedNeighbors > 1) {
+    qsort (self->radiusNeighbors, numAddedNeighbors, sizeof(VlKDForestNeighbor),
+           vl_kdforest_compare_neighbors) ;
+  }
+  *neighbors = self->radiusNeighbors ;
+  return numAddedNeighbors ;
+}
+
+/** ------------------------------------------------------------------
+ ** @internal
+ ** @brief Compare KDTree index entries for sorting
+ **/
+
+VL_INLINE int
+vl_kdtree_compare_index_entries (void const * a,
+                                 void const * b)
+{
+  double delta =
+    ((VlKDTreeDataIndexEntry const*)a) -> value -
+    ((VlKDTreeDataIndexEntry const*)b) -> value ;
+  if (delta < 0) return -1 ;
+  if (delta > 0) return +1 ;
+  return 0 ;
+}
+
+/** ------------------------------------------------------------------
+ ** @internal @brief Find the leaf of a compact tree containing a point
+ ** @param tree tree in the compact layout.
+ ** @param query point.
+ ** @return leaf node.
+ **/
+
+static VlKDTreeCompactNode const *
+vl_kdtree_get_compact_leaf (VlKDTree const * tree, float const * query)
+{
+  VlKDTreeCompactNode const * node = tree->compactNodes ;
+  while (node->lowerChild >= 0) {
+    node = tree->compactNodes + node->lowerChild
+      + (query[node->splitDimension] > node->u.split.threshold) ;
+  }
+  return node ;
+}
+
+/** ------------------------------------------------------------------
+ ** @internal @brief Find the leaf of a tree containing a point
+ ** @param forest KDForest object.
+ ** @param tree tree.
+ ** @param query point.
+ ** @return index of the first data entry of the leaf.
+ **
+ ** Since the entries are in depth-first order, leaves with close
+ ** indexes are usually close in space too.
+ **/
+
+static vl_uindex
+vl_kdtree_get_leaf_begin (VlKDForest const * forest,
+                          VlKDTree const * tree,
+                          void const * query)
+{
+  if (tree->compactNodes) {
+    return vl_kdtree_get_compact_leaf (tree, query)->u.leaf.begin ;
+  } else {
+    VlKDTreeNode const * node = tree->nodes ;
+    while (node->lowerChild > 0) {
+      double x ;
+      switch (forest->dataType) {
+        case VL_TYPE_FLOAT: x = ((float const*)query)[node->splitDimension] ; break ;
+        case VL_TYPE_DOUBLE: x = ((double const*)query)[node->splitDimension] ; break ;
+        default: abort() ;
+      }
+      node = tree->nodes + ((x <= node->splitThreshold) ? node->lowerChild : node->upperChild) ;
+    }
+    return - node->lowerChild - 1 ;
+  }
+}
+
 /** ------------------------------------------------------------------
  ** @brief Run multiple queries
  ** @param self object.
@@ -863,6 +2163,28 @@ vl_kdforestsearcher_query (VlKDForestSearcher * self,
  ** difference is that the function can use multiple cores to query
  ** large amounts of data.
  **
+ ** Queries are processed in batches of nearby queries. They are sorted
+ ** by the leaf of the first tree that contains them, and each thread
+ ** handles runs of consecutive queries. These tend to follow the same
+ ** paths and compare against the same data, which improves cache
+ ** reuse. The output keeps the order of @a queries.
+ **
+ ** For a compact forest of @c float data
+ ** (::vl_kdforest_compact), the sorted queries are further grouped
+ ** by ::VL_VECTOR_COMPARISON_BLOCK_SIZE queries falling in the same
+ ** leaf of the first tree. The points of that leaf are compared to
+ ** the whole group at once by a block comparison function
+ ** (::vl_get_vector_block_comparison_function_f), which loads each
+ ** point once for all the queries. This pays off when the leaves
+ ** hold several points (::vl_kdforest_set_leaf_size).
+ **
+ ** Each query is still searched on its own by
+ ** ::vl_kdforestsearcher_query, reading the distances to that leaf
+ ** from the block. The block function computes the same values as
+ ** the distance function, so the results and the number of
+ ** comparisons are the same as calling ::vl_kdforest_query for each
+ ** query.
+ **
  ** @sa ::vl_kdforest_query.
  **/
 
@@ -877,67 +2199,312 @@ vl_kdforest_query_with_array (VlKDForest * self,
   vl_size numComparisons = 0;
   vl_type dataType = vl_kdforest_get_data_type(self) ;
   vl_size dimension = vl_kdforest_get_data_dimension(self) ;
+  vl_size numThreads = vl_get_max_threads() ;
+  VlFloatVectorBlockComparisonFunction blockDistanceFunction =
+    (VlFloatVectorBlockComparisonFunction) self->blockDistanceFunction ;
+  vl_bool useBlocks = dataType == VL_TYPE_FLOAT &&
+    vl_kdforest_is_compact(self) && blockDistanceFunction != NULL ;
+  vl_size blockSize = useBlocks ? VL_VECTOR_COMPARISON_BLOCK_SIZE : 1 ;
+  vl_size chunkSize = VL_KDFOREST_QUERY_BATCH_SIZE / blockSize ;
+  VlKDForestSearcher ** searchers ;
+  VlKDForestNeighbor * neighborBuffers ;
+  VlKDTreeDataIndexEntry * order ;
+  vl_uindex * groups ;
+  float ** leafBuffers ;
+  vl_size * leafBufferSizes ;
+  vl_size numGroups = 0 ;
+  vl_index qi, gi ;
+  vl_uindex t ;
+
+  /* the searchers are created before entering the parallel region,
+     as vl_malloc cannot be used there if mapped to MATLAB malloc */
+  searchers = vl_malloc (sizeof(VlKDForestSearcher*) * numThreads) ;
+  neighborBuffers = vl_malloc (sizeof(VlKDForestNeighbor) * numNeighbors * numThreads) ;
+  order = vl_malloc (sizeof(VlKDTreeDataIndexEntry) * numQueries) ;
+  groups = vl_malloc (sizeof(vl_uindex) * (numQueries + 1)) ;
+  leafBuffers = vl_calloc (numThreads, sizeof(float*)) ;
+  leafBufferSizes = vl_calloc (numThreads, sizeof(vl_size)) ;
+  for (t = 0 ; t < numThreads ; ++t) {
+    searchers[t] = vl_kdforest_new_searcher(self) ;
+  }
 
+  /* sort the queries by the leaf of the first tree that contains
+     them, so that consecutive queries follow similar paths and visit
+     nearby data */
 #ifdef _OPENMP
-#pragma omp parallel default(shared) num_threads(vl_get_max_threads())
+#pragma omp parallel for default(shared) private(qi) num_threads(numThreads)
 #endif
-  {
-    vl_index qi ;
-    vl_size thisNumComparisons = 0 ;
-    VlKDForestSearcher * searcher ;
-    VlKDForestNeighbor * neighbors ;
+  for (qi = 0 ; qi < (signed)numQueries ; ++ qi) {
+    void const * query = (char const *)queries + qi * dimension * vl_get_type_size(dataType) ;
+    order[qi].index = qi ;
+    order[qi].value = (double) vl_kdtree_get_leaf_begin (self, self->trees[0], query) ;
+  }
+  qsort (order, numQueries, sizeof(VlKDTreeDataIndexEntry), vl_kdtree_compare_index_entries) ;
+
+  /* group up to blockSize consecutive queries in the same leaf */
+  for (qi = 0 ; qi < (signed)numQueries ; ++ qi) {
+    if (numGroups == 0 ||
+        order[qi].value != order[groups[numGroups - 1]].value ||
+        (vl_uindex) qi - groups[numGroups - 1] == blockSize) {
+      groups[numGroups++] = qi ;
+    }
+  }
+  groups[numGroups] = numQueries ;
 
 #ifdef _OPENMP
-#pragma omp critical
+#pragma omp parallel for default(shared) private(gi) num_threads(numThreads) \
+  schedule(dynamic, chunkSize) reduction(+:numComparisons)
 #endif
-    {
-      searcher = vl_kdforest_new_searcher(self) ;
-      neighbors = vl_calloc (sizeof(VlKDForestNeighbor), numNeighbors) ;
-    }
-
+  for (gi = 0 ; gi < (signed)numGroups ; ++ gi) {
+    vl_uindex begin = groups[gi] ;
+    vl_uindex end = groups[gi + 1] ;
+    vl_uindex qj, ni ;
+    vl_size leafSize = 0 ;
+    vl_bool precomputed = VL_FALSE ;
 #ifdef _OPENMP
-#pragma omp for
+    vl_uindex thread = omp_get_thread_num() ;
+#else
+    vl_uindex thread = 0 ;
 #endif
-    for(qi = 0 ; qi < (signed)numQueries; ++ qi) {
+    VlKDForestSearcher * searcher = searchers[thread] ;
+    VlKDForestNeighbor * neighbors = neighborBuffers + thread * numNeighbors ;
+
+    /* compare the queries of the group to the points of their leaf in
+       the first tree at once; the search then reads these distances
+       instead of computing them again. A single query gains nothing
+       from this. */
+    if (useBlocks && end - begin > 1) {
+      float const * blockQueries [VL_VECTOR_COMPARISON_BLOCK_SIZE] ;
+      VlKDTreeCompactNode const * leaf ;
+      vl_uindex i ;
+      for (i = 0 ; i < VL_VECTOR_COMPARISON_BLOCK_SIZE ; ++i) {
+        /* an incomplete group repeats its last query */
+        blockQueries[i] = (float const *) queries
+          + order[VL_MIN(begin + i, end - 1)].index * dimension ;
+      }
+      leaf = vl_kdtree_get_compact_leaf (self->trees[0], blockQueries[0]) ;
+      leafSize = leaf->u.leaf.end - leaf->u.leaf.begin ;
+      if (leafBufferSizes[thread] < leafSize * VL_VECTOR_COMPARISON_BLOCK_SIZE) {
+        float * buffer = realloc (leafBuffers[thread], sizeof(float) *
+                                  leafSize * VL_VECTOR_COMPARISON_BLOCK_SIZE) ;
+        if (buffer) {
+          leafBuffers[thread] = buffer ;
+          leafBufferSizes[thread] = leafSize * VL_VECTOR_COMPARISON_BLOCK_SIZE ;
+        }
+      }
+      if (leafBufferSizes[thread] >= leafSize * VL_VECTOR_COMPARISON_BLOCK_SIZE) {
+        blockDistanceFunction (dimension, leafBuffers[thread], blockQueries,
+                               self->trees[0]->compactData + leaf->u.leaf.begin * dimension,
+                               leafSize) ;
+        searcher->leafBegin = leaf->u.leaf.begin ;
+        precomputed = VL_TRUE ;
+      }
+    }
+
+    for (qj = begin ; qj < end ; ++ qj) {
+      vl_uindex q = order[qj].index ;
+      if (precomputed) {
+        searcher->leafDistances = leafBuffers[thread] + (qj - begin) * leafSize ;
+      }
       switch (dataType) {
-        case VL_TYPE_FLOAT: {
-          vl_size ni;
-          thisNumComparisons += vl_kdforestsearcher_query (searcher, neighbors, numNeighbors,
-                                                           (float const *) (queries) + qi * dimension) ;
+        case VL_TYPE_FLOAT:
+          numComparisons += vl_kdforestsearcher_query (searcher, neighbors, numNeighbors,
+                                                       (float const *) (queries) + q * dimension) ;
           for (ni = 0 ; ni < numNeighbors ; ++ni) {
-            indexes [qi*numNeighbors + ni] = (vl_uint32) neighbors[ni].index ;
+            indexes [q*numNeighbors + ni] = (vl_uint32) neighbors[ni].index ;
             if (distances){
-              *((float*)distances + qi*numNeighbors + ni) = neighbors[ni].distance ;
+              *((float*)distances + q*numNeighbors + ni) = neighbors[ni].distance ;
             }
           }
           break ;
-        }
-        case VL_TYPE_DOUBLE: {
-          vl_size ni;
-          thisNumComparisons += vl_kdforestsearcher_query (searcher, neighbors, numNeighbors,
-                                                           (double const *) (queries) + qi * dimension) ;
+        case VL_TYPE_DOUBLE:
+          numComparisons += vl_kdforestsearcher_query (searcher, neighbors, numNeighbors,
+                                                       (double const *) (queries) + q * dimension) ;
           for (ni = 0 ; ni < numNeighbors ; ++ni) {
-            indexes [qi*numNeighbors + ni] = (vl_uint32) neighbors[ni].index ;
+            indexes [q*numNeighbors + ni] = (vl_uint32) neighbors[ni].index ;
             if (distances){
-              *((double*)distances + qi*numNeighbors + ni) = neighbors[ni].distance ;
+              *((double*)distances + q*numNeighbors + ni) = neighbors[ni].distance ;
             }
           }
           break ;
-        }
         default:
           abort() ;
       }
     }
+    searcher->leafDistances = NULL ;
+  }
+
+  for (t = 0 ; t < numThreads ; ++t) {
+    vl_kdforestsearcher_delete (searchers[t]) ;
+    free (leafBuffers[t]) ;
+  }
+  vl_free (searchers) ;
+  vl_free (neighborBuffers) ;
+  vl_free (order) ;
+  vl_free (groups) ;
+  vl_free (leafBuffers) ;
+  vl_free (leafBufferSizes) ;
+  return numComparisons ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Run multiple radius queries
+ ** @param self object.
+ ** @param offsets offsets of the results of each query (output).
+ ** @param indexes indexes of the neighbors (output).
+ ** @param distances distances of the neighbors (output, may be @c NULL).
+ ** @param radius search radius.
+ ** @param numQueries number of query points.
+ ** @param queries list of vectors to use as queries.
+ ** @return number of comparisons.
+ **
+ ** The function runs ::vl_kdforestsearcher_query_radius for each of
+ ** the @a numQueries queries @a queries and returns the results in
+ ** compressed sparse row format. @a offsets is an array of @a
+ ** numQueries + 1 elements allocated by the caller. The neighbors of
+ ** query @c q are the elements from <code>offsets[q]</code> to
+ ** <code>offsets[q+1]-1</code> of the arrays @a *indexes and @a
+ ** *distances, sorted by increasing distance. These arrays are
+ ** allocated by the function and must be disposed by the caller
+ ** with ::vl_free. The distances are of the same type as the data.
+ **
+ ** Queries run in parallel and are scheduled as in
+ ** ::vl_kdforest_query_with_array. Each thread collects its results
+ ** in a private buffer, which are then copied to the output.
+ **
+ ** @sa ::vl_kdforestsearcher_query_radius.
+ **/
+
+vl_size
+vl_kdforest_query_radius_with_array (VlKDForest * self,
+                                     vl_size * offsets,
+                                     vl_uint32 ** indexes,
+                                     void ** distances,
+                                     double radius,
+                                     vl_size numQueries,
+                                     void const * queries)
+{
+  vl_size numComparisons = 0;
+  vl_type dataType = vl_kdforest_get_data_type(self) ;
+  vl_size dimension = vl_kdforest_get_data_dimension(self) ;
+  vl_size numThreads = vl_get_max_threads() ;
+  VlKDForestSearcher ** searchers ;
+  VlKDForestNeighbor ** threadNeighbors ;
+  vl_size * threadNumNeighbors ;
+  vl_size * threadCapacities ;
+  vl_uindex * queryThreads ;
+  vl_uindex * queryStarts ;
+  VlKDTreeDataIndexEntry * order ;
+  vl_index qi ;
+  vl_uindex t ;
+
+  assert (offsets) ;
+  assert (indexes) ;
+
+  searchers = vl_malloc (sizeof(VlKDForestSearcher*) * numThreads) ;
+  threadNeighbors = vl_calloc (sizeof(VlKDForestNeighbor*), numThreads) ;
+  threadNumNeighbors = vl_calloc (sizeof(vl_size), numThreads) ;
+  threadCapacities = vl_calloc (sizeof(vl_size), numThreads) ;
+  queryThreads = vl_malloc (sizeof(vl_uindex) * numQueries) ;
+  queryStarts = vl_malloc (sizeof(vl_uindex) * numQueries) ;
+  order = vl_malloc (sizeof(VlKDTreeDataIndexEntry) * numQueries) ;
+  for (t = 0 ; t < numThreads ; ++t) {
+    searchers[t] = vl_kdforest_new_searcher(self) ;
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for default(shared) private(qi) num_threads(numThreads)
+#endif
+  for (qi = 0 ; qi < (signed)numQueries ; ++ qi) {
+    void const * query = (char const *)queries + qi * dimension * vl_get_type_size(dataType) ;
+    order[qi].index = qi ;
+    order[qi].value = (double) vl_kdtree_get_leaf_begin (self, self->trees[0], query) ;
+  }
+  qsort (order, numQueries, sizeof(VlKDTreeDataIndexEntry), vl_kdtree_compare_index_entries) ;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(shared) private(qi) num_threads(numThreads) \
+  schedule(dynamic, VL_KDFOREST_QUERY_BATCH_SIZE) reduction(+:numComparisons)
+#endif
+  for (qi = 0 ; qi < (signed)numQueries ; ++ qi) {
+    vl_uindex q = order[qi].index ;
+    VlKDForestNeighbor const * neighbors ;
+    vl_size numNeighbors ;
+#ifdef _OPENMP
+    vl_uindex thread = omp_get_thread_num() ;
+#else
+    vl_uindex thread = 0 ;
+#endif
+    VlKDForestSearcher * searcher = searchers[thread] ;
+
+    numNeighbors = vl_kdforestsearcher_query_radius
+      (searcher, &neighbors, radius,
+       (char const *)queries + q * dimension * vl_get_type_size(dataType)) ;
+    numComparisons += searcher->searchNumComparisons ;
+
+    if (threadNumNeighbors[thread] + numNeighbors > threadCapacities[thread]) {
+      /* vl_realloc cannot be used here if mapped to MATLAB realloc */
+      threadCapacities[thread] = VL_MAX(2 * threadCapacities[thread],
+                                        threadNumNeighbors[thread] + numNeighbors) ;
+      threadNeighbors[thread] = realloc (threadNeighbors[thread],
+                                         sizeof(VlKDForestNeighbor) * threadCapacities[thread]) ;
+    }
+    memcpy (threadNeighbors[thread] + threadNumNeighbors[thread], neighbors,
+            sizeof(VlKDForestNeighbor) * numNeighbors) ;
+    queryThreads[q] = thread ;
+    queryStarts[q] = threadNumNeighbors[thread] ;
+    threadNumNeighbors[thread] += numNeighbors ;
+    offsets[q + 1] = numNeighbors ;
+  }
+
+  /* convert the counts to offsets and gather the results */
+  offsets[0] = 0 ;
+  for (qi = 0 ; qi < (signed)numQueries ; ++ qi) {
+    offsets[qi + 1] += offsets[qi] ;
+  }
+  *indexes = vl_malloc (sizeof(vl_uint32) * VL_MAX(offsets[numQueries], 1)) ;
+  if (distances) {
+    *distances = vl_malloc (vl_get_type_size(dataType) * VL_MAX(offsets[numQueries], 1)) ;
+  }
 
 #ifdef _OPENMP
-#pragma omp critical
+#pragma omp parallel for default(shared) private(qi) num_threads(numThreads)
 #endif
-    {
-      numComparisons += thisNumComparisons ;
-      vl_kdforestsearcher_delete (searcher) ;
-      vl_free (neighbors) ;
+  for (qi = 0 ; qi < (signed)numQueries ; ++ qi) {
+    VlKDForestNeighbor const * neighbors = threadNeighbors[queryThreads[qi]] + queryStarts[qi] ;
+    vl_uindex ni, begin = offsets[qi], end = offsets[qi + 1] ;
+    for (ni = begin ; ni < end ; ++ ni) {
+      (*indexes)[ni] = (vl_uint32) neighbors[ni - begin].index ;
     }
+    if (distances) {
+      switch (dataType) {
+        case VL_TYPE_FLOAT:
+          for (ni = begin ; ni < end ; ++ ni) {
+            ((float*)*distances)[ni] = (float) neighbors[ni - begin].distance ;
+          }
+          break ;
+        case VL_TYPE_DOUBLE:
+          for (ni = begin ; ni < end ; ++ ni) {
+            ((double*)*distances)[ni] = neighbors[ni - begin].distance ;
+          }
+          break ;
+        default:
+          abort() ;
+      }
+    }
+  }
+
+  for (t = 0 ; t < numThreads ; ++t) {
+    vl_kdforestsearcher_delete (searchers[t]) ;
+    free (threadNeighbors[t]) ;
   }
+  vl_free (searchers) ;
+  vl_free (threadNeighbors) ;
+  vl_free (threadNumNeighbors) ;
+  vl_free (threadCapacities) ;
+  vl_free (queryThreads) ;
+  vl_free (queryStarts) ;
+  vl_free (order) ;
   return numComparisons ;
 }
 
@@ -982,6 +2549,88 @@ vl_kdforest_get_num_trees (VlKDForest const * self)
   return self->numTrees ;
 }
 
+/** ------------------------------------------------------------------
+ ** @brief Get the number of data points
+ ** @param self KDForest object.
+ ** @return number of points, including the removed ones.
+ **/
+
+vl_size
+vl_kdforest_get_num_data (VlKDForest const * self)
+{
+  return self->numBaseData + self->numAppendedData ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get the number of data points in the delta buffer
+ ** @param self KDForest object.
+ ** @return number of points added but not yet merged in the trees.
+ ** @sa ::vl_kdforest_add, ::vl_kdforest_merge.
+ **/
+
+vl_size
+vl_kdforest_get_num_delta_data (VlKDForest const * self)
+{
+  return self->numBaseData + self->numAppendedData - self->numData ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get the number of removed data points
+ ** @param self KDForest object.
+ ** @return number of removed points not yet purged from the trees.
+ ** @sa ::vl_kdforest_remove.
+ **/
+
+vl_size
+vl_kdforest_get_num_removed_data (VlKDForest const * self)
+{
+  return self->numRemoved ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Set the maximum size of the delta buffer
+ ** @param self KDForest object.
+ ** @param n maximum number of points.
+ **
+ ** When more than @a n points are waiting in the delta buffer, or
+ ** more than @a n removed points are still stored in the trees,
+ ** ::vl_kdforest_needs_merge returns true. Setting @a n to 0 (the
+ ** default) uses one eighth of the points in the trees, but no less
+ ** than 1024. In this way the cost of rebuilding the trees is
+ ** amortized over the updates.
+ **/
+
+void
+vl_kdforest_set_max_num_delta_data (VlKDForest * self, vl_size n)
+{
+  self->maxNumDeltaData = n ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get the maximum size of the delta buffer
+ ** @param self KDForest object.
+ ** @return maximum number of points (0 for automatic).
+ ** @sa ::vl_kdforest_set_max_num_delta_data.
+ **/
+
+vl_size
+vl_kdforest_get_max_num_delta_data (VlKDForest const * self)
+{
+  return self->maxNumDeltaData ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Check whether the forest uses the compact layout
+ ** @param self KDForest object.
+ ** @return @c true if ::vl_kdforest_compact has been applied.
+ **/
+
+vl_bool
+vl_kdforest_is_compact (VlKDForest const * self)
+{
+  return self->trees && self->trees[0]->compactNodes != NULL ;
+}
+
 /** ------------------------------------------------------------------
  ** @brief Set the maximum number of comparisons for a search
  **
@@ -1045,6 +2694,45 @@ vl_kdforest_get_thresholding_method (VlKDForest const * self)
   return self->thresholdingMethod ;
 }
 
+/** ------------------------------------------------------------------
+ ** @brief Set the maximum number of points in a leaf
+ ** @param self KDForest object.
+ ** @param n maximum number of points (at least one).
+ **
+ ** The partitions are not split further once they contain at most
+ ** @a n points (the @e bucket size). The setting takes effect the
+ ** next time the trees are built, by ::vl_kdforest_build or
+ ** ::vl_kdforest_merge. The default is one point per leaf.
+ **
+ ** Larger leaves make the trees shallower and let the search compare
+ ** the query with more points per leaf, which for a compact forest
+ ** (::vl_kdforest_compact) are contiguous in memory. They also let
+ ** ::vl_kdforest_query_with_array compare several queries with the
+ ** same leaf at once.
+ **
+ ** @sa ::vl_kdforest_get_leaf_size
+ **/
+
+void
+vl_kdforest_set_leaf_size (VlKDForest * self, vl_size n)
+{
+  assert (n >= 1) ;
+  self->leafSize = n ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get the maximum number of points in a leaf
+ ** @param self KDForest object.
+ ** @return maximum number of points.
+ ** @sa ::vl_kdforest_set_leaf_size
+ **/
+
+vl_size
+vl_kdforest_get_leaf_size (VlKDForest const * self)
+{
+  return self->leafSize ;
+}
+
 /** ------------------------------------------------------------------
  ** @brief Get the dimension of the data
  ** @param self KDForest object.
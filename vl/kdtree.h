@@ -21,6 +21,7 @@ the terms of the BSD license (see the COPYING file).
 #define VL_KDTREE_VARIANCE_EST_NUM_SAMPLES 1024
 
 typedef struct _VlKDTreeNode VlKDTreeNode ;
+typedef struct _VlKDTreeCompactNode VlKDTreeCompactNode ;
 typedef struct _VlKDTreeSplitDimension VlKDTreeSplitDimension ;
 typedef struct _VlKDTreeDataIndexEntry VlKDTreeDataIndexEntry ;
 typedef struct _VlKDForestSearchState VlKDForestSearchState ;
@@ -36,6 +37,29 @@ struct _VlKDTreeNode
   double upperBound ;
 } ;
 
+/* Search-optimized node (see ::vl_kdforest_compact). Nodes are
+   stored in breadth-first order, so that the upper child of a node
+   immediately follows the lower one. Leaves have a negative
+   lowerChild and store the range of their points instead of the
+   split. Thresholds and bounds stay in double precision, as mean
+   thresholds are generally not representable as data values. */
+struct _VlKDTreeCompactNode
+{
+  union {
+    struct {
+      double threshold ;
+      double lowerBound ;
+      double upperBound ;
+    } split ;
+    struct {
+      vl_uint32 begin ;
+      vl_uint32 end ;
+    } leaf ;
+  } u ;
+  vl_int32 lowerChild ;
+  vl_uint16 splitDimension ;
+} ;
+
 struct _VlKDTreeSplitDimension
 {
   unsigned int dimension ;
@@ -69,6 +93,8 @@ typedef struct _VlKDTree
   vl_size numAllocatedNodes ;
   VlKDTreeDataIndexEntry * dataIndex ;
   unsigned int depth ;
+  VlKDTreeCompactNode * compactNodes ;
+  float * compactData ;
 } VlKDTree ;
 
 struct _VlKDForestSearchState
@@ -92,8 +118,10 @@ typedef struct _VlKDForest
   vl_type dataType ;
   void const * data ;
   vl_size numData ;
+  vl_size numIndexedData ;   /* points stored in the trees (the removed ones may be left out) */
   VlVectorComparisonType distance;
   void (*distanceFunction)(void) ;
+  void (*blockDistanceFunction)(void) ;  /* may be NULL (see vl_get_vector_block_comparison_function_f) */
 
   /* tree structure */
   VlKDTree ** trees ;
@@ -101,8 +129,7 @@ typedef struct _VlKDForest
 
   /* build */
   VlKDTreeThresholdingMethod thresholdingMethod ;
-  VlKDTreeSplitDimension splitHeapArray [VL_KDTREE_SPLIT_HEAP_SIZE] ;
-  vl_size splitHeapNumNodes ;
+  vl_size leafSize ;
   vl_size splitHeapSize ;
   vl_size maxNumNodes;
 
@@ -111,6 +138,19 @@ typedef struct _VlKDForest
   vl_size numSearchers;
   struct _VlKDForestSearcher * headSearcher ;  /* head of the double linked list with searchers */
 
+  /* incremental updates (see vl_kdforest_add) */
+  vl_size numBaseData ;
+  void * appendedData ;
+  vl_size numAppendedData ;
+  vl_size appendedDataCapacity ;
+  vl_size maxNumDeltaData ;
+  vl_uint8 * removed ;
+  vl_size numRemoved ;
+
+  /* file storage (see vl_kdforest_load) */
+  void * mappedFile ;
+  vl_size mappedFileSize ;
+
 } VlKDForest ;
 
 /** @brief ::VlKDForest searcher object */
@@ -130,6 +170,17 @@ typedef struct _VlKDForestSearcher
 
   vl_size searchHeapNumNodes ;
   vl_uindex searchId ;
+
+  /* distances to the points of a leaf of the first tree computed in
+     advance (see vl_kdforest_query_with_array) */
+  float const * leafDistances ;
+  vl_uindex leafBegin ;
+
+  /* radius search */
+  vl_bool radiusSearch ;
+  double radius ;
+  VlKDForestNeighbor * radiusNeighbors ;
+  vl_size radiusNeighborsCapacity ;
 } VlKDForestSearcher ;
 
 /** @name Creating, copying and disposing
@@ -163,6 +214,45 @@ VL_EXPORT vl_size vl_kdforestsearcher_query (VlKDForestSearcher * self,
                                              VlKDForestNeighbor * neighbors,
                                              vl_size numNeighbors,
                                              void const * query) ;
+
+VL_EXPORT vl_size vl_kdforest_query_radius (VlKDForest * self,
+                                            VlKDForestNeighbor const ** neighbors,
+                                            double radius,
+                                            void const * query) ;
+
+VL_EXPORT vl_size vl_kdforest_query_radius_with_array (VlKDForest * self,
+                                                       vl_size * offsets,
+                                                       vl_uint32 ** indexes,
+                                                       void ** distances,
+                                                       double radius,
+                                                       vl_size numQueries,
+                                                       void const * queries) ;
+
+VL_EXPORT vl_size vl_kdforestsearcher_query_radius (VlKDForestSearcher * self,
+                                                    VlKDForestNeighbor const ** neighbors,
+                                                    double radius,
+                                                    void const * query) ;
+
+VL_EXPORT void vl_kdforest_compact (VlKDForest * self) ;
+/** @} */
+
+/** @name Updating
+ ** @{ */
+VL_EXPORT vl_uindex vl_kdforest_add (VlKDForest * self,
+                                     vl_size numData,
+                                     void const * data) ;
+VL_EXPORT void vl_kdforest_remove (VlKDForest * self, vl_uindex index) ;
+VL_EXPORT void vl_kdforest_merge (VlKDForest * self) ;
+VL_EXPORT vl_bool vl_kdforest_needs_merge (VlKDForest const * self) ;
+/** @} */
+
+/** @name Saving and loading
+ ** @{ */
+VL_EXPORT int vl_kdforest_save (VlKDForest const * self,
+                                char const * fileName,
+                                vl_bool embedData) ;
+VL_EXPORT VlKDForest * vl_kdforest_load (char const * fileName,
+                                         void const * data) ;
 /** @} */
 
 /** @name Retrieving and setting parameters
@@ -170,6 +260,14 @@ VL_EXPORT vl_size vl_kdforestsearcher_query (VlKDForestSearcher * self,
 VL_EXPORT vl_size vl_kdforest_get_depth_of_tree (VlKDForest const * self, vl_uindex treeIndex) ;
 VL_EXPORT vl_size vl_kdforest_get_num_nodes_of_tree (VlKDForest const * self, vl_uindex treeIndex) ;
 VL_EXPORT vl_size vl_kdforest_get_num_trees (VlKDForest const * self) ;
+VL_EXPORT vl_size vl_kdforest_get_num_data (VlKDForest const * self) ;
+VL_EXPORT vl_size vl_kdforest_get_num_delta_data (VlKDForest const * self) ;
+VL_EXPORT vl_size vl_kdforest_get_num_removed_data (VlKDForest const * self) ;
+VL_EXPORT void vl_kdforest_set_max_num_delta_data (VlKDForest * self, vl_size n) ;
+VL_EXPORT vl_size vl_kdforest_get_max_num_delta_data (VlKDForest const * self) ;
+VL_EXPORT vl_bool vl_kdforest_is_compact (VlKDForest const * self) ;
+VL_EXPORT void vl_kdforest_set_leaf_size (VlKDForest * self, vl_size n) ;
+VL_EXPORT vl_size vl_kdforest_get_leaf_size (VlKDForest const * self) ;
 VL_EXPORT vl_size vl_kdforest_get_data_dimension (VlKDForest const * self) ;
 VL_EXPORT vl_type vl_kdforest_get_data_type (VlKDForest const * self) ;
 VL_EXPORT void vl_kdforest_set_max_num_comparisons (VlKDForest * self, vl_size n) ;
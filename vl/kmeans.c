@@ -21,9 +21,9 @@ the terms of the BSD license (see the COPYING file).
 <!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
 
 @ref kmeans.h implements a number of algorithm for **K-means
-quantization**: Lloyd @cite{lloyd82least}, an accelerated version by
-Elkan @cite{elkan03using}, and a large scale algorithm based on
-Approximate Nearest Neighbors (ANN). All algorithms support @c float
+quantization**: Lloyd @cite{lloyd82least}, accelerated versions by
+Elkan @cite{elkan03using} and Hamerly @cite{hamerly10making}, and a
+large scale algorithm based on Approximate Nearest Neighbors (ANN). All algorithms support @c float
 or @c double data and can use the $l^1$ or the $l^2$ distance for
 clustering. Furthermore, all algorithms can take advantage of multiple
 CPU cores.
@@ -87,6 +87,7 @@ Method         | Function                                | Description
 ---------------|-----------------------------------------|-----------------------------------------------
 Random samples | ::vl_kmeans_init_centers_with_rand_data | Random data points
 K-means++      | ::vl_kmeans_init_centers_plus_plus      | Random selection biased towards diversity
+K-means\|\|   | ::vl_kmeans_init_centers_scalable_plus_plus | Like K-means++, but using a few parallel sampling rounds
 Custom         | ::vl_kmeans_set_centers                 | Choose centers (useful to run quantization only)
 
 See @ref kmeans-init for further details. The initialization methods
@@ -100,6 +101,8 @@ Algorithm   | Symbol           | See               | Description
 ------------|------------------|-------------------|-----------------------------------------------
 Lloyd       | ::VlKMeansLloyd  | @ref kmeans-lloyd | Alternate EM-style optimization
 Elkan       | ::VlKMeansElkan  | @ref kmeans-elkan | A speedup using triangular inequalities
+Hamerly     | ::VlKMeansHamerly| @ref kmeans-hamerly | Like Elkan, but with memory linear in the data
+Mini-batch  | ::VlKMeansMiniBatch | @ref kmeans-mini-batch | Stochastic updates from small data batches
 ANN         | ::VlKMeansANN    | @ref kmeans-ann   | A speedup using approximated nearest neighbors
 
 See the relative sections for further details. These algorithm are
@@ -107,8 +110,12 @@ iterative, and stop when either a **maximum number of iterations**
 (::vl_kmeans_set_max_num_iterations) is reached, or when the energy
 changes sufficiently slowly in one iteration (::vl_kmeans_set_min_energy_variation).
 
+If the data does not fit in memory, the centers can be learned
+incrementally from a stream of data chunks by calling
+::vl_kmeans_push_batch repeatedly (@ref kmeans-mini-batch).
 
-All the three algorithms support multithreaded computations. The number
+
+All the algorithms support multithreaded computations. The number
 of threads used is usually controlled globally by ::vl_set_num_threads.
 **/
 
@@ -157,6 +164,12 @@ uses the triangular inequality to cut down significantly the cost of
 Lloyd's algorithm. Since this algorithm is otherwise equivalent, it
 should often be preferred.
 
+Elkan's algorithm stores a lower bound for each point-center pair,
+which is impractical when both the number of points and the number of
+centers are large. Hamerly's algorithm (@ref kmeans-hamerly) keeps
+only two bounds per point and is the preferred exact algorithm in this
+case.
+
 For very large problems (millions of point to clusters and hundreds,
 thousands, or more clusters to find), even Elkan's algorithm is not
 sufficiently fast. In these cases, one can resort to a variant of
@@ -188,6 +201,24 @@ the data points with probability proportional to the distance. The
 procedure is repeated to obtain the other centers by using the minimum
 distance to the centers collected so far.
 
+The distance updates are computed in parallel. However, the $K$
+centers still have to be selected one after the other, so that the
+cost is $O(dnK)$.
+
+@par Scalable K-means++
+
+K-means|| @cite{bahmani12scalable} reduces the number of sequential
+steps. Starting from a random point, it runs a small number of rounds
+(::vl_kmeans_set_num_seeding_rounds). In each round, every point is
+sampled independently with probability $\ell\, D(\bx_i) / \sum_j
+D(\bx_j)$, where $D(\bx)$ is the distance to the closest point
+sampled so far and $\ell$ is the oversampling (the factor set by
+::vl_kmeans_set_oversampling_factor times $K$). Each round can be
+computed in parallel. The sampled candidates, about $\ell$ per round,
+are then weighted by the number of data points closest to them and
+reclustered into $K$ centers by running K-means++ on the weighted
+candidates only.
+
 <!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
 @section kmeans-lloyd Lloyd's algorithm
 <!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
@@ -318,6 +349,69 @@ Thus the K-means algorithm becomes:
           $\bc$. Update $q_i$ to the index of center $\bc$ and reset $UB_i
           = LB_i(\bc)$.
 
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+@section kmeans-hamerly Hamerly's algorithm
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+
+Hamerly's algorithm @cite{hamerly10making} is a simplification of
+Elkan's algorithm (@ref kmeans-elkan) that replaces the $K$ lower
+bounds $LB_i(\bc)$ of each point with a single lower bound $LB_i$ to
+the distance of $\bx_i$ to its *second* closest center. Hence the
+algorithm uses $O(n + K)$ memory instead of $O(nK)$, which makes it
+usable for a large number of points and centers.
+
+Let $s(\bc) = \frac{1}{2} \min_{\bc' \not= \bc} \|\bc - \bc'\|$
+be half the distance of a center to its closest other center. After
+a center update, the bounds are refreshed as
+
+@f{align*}
+  UB_i & \leftarrow UB_i + \|\bc_{q_i} - \hat{\bc}_{q_i} \|, \\
+  LB_i & \leftarrow LB_i - \max_{\bc \not= \bc_{q_i}} \|\bc -\hat \bc\|.
+@f}
+
+and a point $\bx_i$ keeps its current assignment if $UB_i \leq
+\max\{s(\bc_{q_i}), LB_i\}$. Otherwise the upper bound is made tight
+and the test is repeated; if this fails too, the distances from
+$\bx_i$ to all the centers are recomputed, updating $q_i$, $UB_i$ and
+$LB_i$. Bounds use the metric (i.e. not squared) $l^2$ distance.
+
+Both the reassignment step and the center update are computed in
+parallel. The latter first buckets the points by center so that each
+center (mean or median) is computed independently.
+
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+@section kmeans-mini-batch Mini-batch and streaming K-means
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+
+The mini-batch algorithm @cite{sculley10web-scale} replaces the full
+passes over the data of Lloyd's algorithm by stochastic updates
+computed from small batches of points. At each iteration, a batch of
+::vl_kmeans_get_mini_batch_size points is sampled at random and each
+point $\bx$ is assigned to its closest center $\bc_q$. Then the
+center is updated as
+
+\[
+ n_q \leftarrow n_q + 1,
+ \qquad
+ \bc_q \leftarrow \bc_q + \frac{1}{n_q} (\bx - \bc_q),
+\]
+
+where $n_q$ is the number of points assigned to the center so far,
+so that each center has its own, decreasing, learning rate. With the
+::VlKMeansMiniBatch algorithm, ::vl_kmeans_set_max_num_iterations
+sets the number of batches.
+
+The same update is exposed by ::vl_kmeans_push_batch, which consumes
+batches provided by the caller. This can be used to learn the centers
+from a stream of data (e.g. descriptors as they are extracted)
+without ever storing the whole dataset. Memory is proportional to
+the batch size and to the number of centers. The resulting centers
+can be used with ::vl_kmeans_quantize as usual.
+
+This algorithm supports only the $l^2$ distance; with another distance
+::vl_kmeans_push_batch and ::vl_kmeans_refine_centers fail with
+::VL_ERR_BAD_ARG.
+
 <!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
 @section kmeans-ann ANN algorithm
 <!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
@@ -369,9 +463,27 @@ Elkan's while retaining a similar solution accuracy.
 #include <omp.h>
 #endif
 
+#ifndef VL_DISABLE_SSE2
+#include "mathop_sse2.h"
+#endif
+
 /* ================================================================ */
 #ifndef VL_KMEANS_INSTANTIATING
 
+/* Number of points processed together by the seeding algorithms */
+#define VL_KMEANS_SEEDING_BLOCK_SIZE 4096
+
+/* Data points (rows) and centers (columns) in a block of the l2
+   assignment matrix product (must match _vl_inner_products_4x8_sse2) */
+#define VL_KMEANS_GEMM_NUM_ROWS 4
+#define VL_KMEANS_GEMM_NUM_COLS 8
+
+/* Data points in a chunk and bytes of packed centers in a tile of
+   the l2 assignment matrix product */
+#define VL_KMEANS_GEMM_CHUNK_NUM_ROWS 64
+#define VL_KMEANS_GEMM_TILE_SIZE (128 * 1024)
+
+static void _vl_kmeans_update_packed_centers (VlKMeans * self) ;
 
 /** ------------------------------------------------------------------
  ** @brief Reset state
@@ -390,9 +502,13 @@ vl_kmeans_reset (VlKMeans * self)
 
   if (self->centers) vl_free(self->centers) ;
   if (self->centerDistances) vl_free(self->centerDistances) ;
+  if (self->centerMasses) vl_free(self->centerMasses) ;
+  if (self->packedCenters) vl_free(self->packedCenters) ;
 
   self->centers = NULL ;
   self->centerDistances = NULL ;
+  self->centerMasses = NULL ;
+  self->packedCenters = NULL ;
 }
 
 /** ------------------------------------------------------------------
@@ -417,8 +533,13 @@ vl_kmeans_new (vl_type dataType,
   self->numRepetitions = 1 ;
   self->centers = NULL ;
   self->centerDistances = NULL ;
+  self->centerMasses = NULL ;
+  self->packedCenters = NULL ;
   self->numTrees = 3;
   self->maxNumComparisons = 100;
+  self->miniBatchSize = 1024 ;
+  self->oversamplingFactor = 0.5 ;
+  self->numSeedingRounds = 5 ;
 
   vl_kmeans_reset (self) ;
   return self ;
@@ -447,9 +568,14 @@ vl_kmeans_new_copy (VlKMeans const * kmeans)
   self->numCenters = kmeans->numCenters ;
   self->centers = NULL ;
   self->centerDistances = NULL ;
+  self->centerMasses = NULL ;
+  self->packedCenters = NULL ;
 
   self->numTrees = kmeans->numTrees;
   self->maxNumComparisons = kmeans->maxNumComparisons;
+  self->miniBatchSize = kmeans->miniBatchSize ;
+  self->oversamplingFactor = kmeans->oversamplingFactor ;
+  self->numSeedingRounds = kmeans->numSeedingRounds ;
 
   if (kmeans->centers) {
     vl_size dataSize = vl_get_type_size(self->dataType) * self->dimension * self->numCenters ;
@@ -463,6 +589,13 @@ vl_kmeans_new_copy (VlKMeans const * kmeans)
     memcpy (self->centerDistances, kmeans->centerDistances, dataSize) ;
   }
 
+  if (kmeans->centerMasses) {
+    vl_size dataSize = sizeof(vl_size) * self->numCenters ;
+    self->centerMasses = vl_malloc(dataSize) ;
+    memcpy (self->centerMasses, kmeans->centerMasses, dataSize) ;
+  }
+
+  _vl_kmeans_update_packed_centers (self) ;
   return self ;
 }
 
@@ -496,6 +629,44 @@ typedef struct _VlKMeansSortWrapper {
 #define VL_SHUFFLE_prefix _vl_kmeans
 #include "shuffle-def.h"
 
+/* ---------------------------------------------------------------- */
+/* Bucket data points by center                                      */
+
+/* The function sorts the data indexes by assigned center (counting
+ * sort). On output, the points assigned to center @c c are
+ * clusterMembers[clusterOffsets[c]], ...,
+ * clusterMembers[clusterOffsets[c+1]-1]. @a clusterOffsets has
+ * numCenters+1 elements. The function returns the largest cluster
+ * mass. */
+
+static vl_size
+_vl_kmeans_bucket_assignments (vl_uint32 const * assignments,
+                               vl_size numData,
+                               vl_size numCenters,
+                               vl_uindex * clusterOffsets,
+                               vl_uint32 * clusterMembers)
+{
+  vl_uindex x, c ;
+  vl_size maxMass = 0 ;
+
+  memset(clusterOffsets, 0, sizeof(vl_uindex) * (numCenters + 1)) ;
+  for (x = 0 ; x < numData ; ++x) {
+    clusterOffsets[assignments[x] + 1] ++ ;
+  }
+  for (c = 0 ; c < numCenters ; ++c) {
+    maxMass = VL_MAX(maxMass, clusterOffsets[c + 1]) ;
+    clusterOffsets[c + 1] += clusterOffsets[c] ;
+  }
+  for (x = 0 ; x < numData ; ++x) {
+    clusterMembers[clusterOffsets[assignments[x]] ++] = (vl_uint32)x ;
+  }
+  for (c = numCenters ; c > 0 ; --c) {
+    clusterOffsets[c] = clusterOffsets[c - 1] ;
+  }
+  clusterOffsets[0] = 0 ;
+  return maxMass ;
+}
+
 /* #ifdef VL_KMEANS_INSTANTITATING */
 #endif
 
@@ -585,17 +756,27 @@ VL_XCAT(_vl_kmeans_init_centers_with_rand_data_, SFX)
 /*                                                 kmeans++ seeding */
 /* ---------------------------------------------------------------- */
 
+/* The data is processed in blocks of VL_KMEANS_SEEDING_BLOCK_SIZE
+ * points. Blocks are processed in parallel and the energy of each
+ * block is stored, so that sampling a point with probability
+ * proportional to its distance requires scanning a single block.
+ * The result does not depend on the number of threads. */
+
 static void
-VL_XCAT(_vl_kmeans_init_centers_plus_plus_, SFX)
+VL_XCAT(_vl_kmeans_seed_plus_plus_, SFX)
 (VlKMeans * self,
+ TYPE * centers,
  TYPE const * data,
+ double const * weights,
  vl_size dimension,
  vl_size numData,
  vl_size numCenters)
 {
+  vl_index b ;
   vl_uindex x, c ;
   VlRand * rand = vl_get_rand () ;
-  TYPE * distances = vl_malloc (sizeof(TYPE) * numData) ;
+  vl_size numBlocks = (numData + VL_KMEANS_SEEDING_BLOCK_SIZE - 1) / VL_KMEANS_SEEDING_BLOCK_SIZE ;
+  double * blockEnergies = vl_malloc (sizeof(double) * numBlocks) ;
   TYPE * minDistances = vl_malloc (sizeof(TYPE) * numData) ;
 #if (FLT == VL_TYPE_FLOAT)
   VlFloatVectorComparisonFunction distFn = vl_get_vector_comparison_function_f(self->distance) ;
@@ -603,55 +784,379 @@ VL_XCAT(_vl_kmeans_init_centers_plus_plus_, SFX)
   VlDoubleVectorComparisonFunction distFn = vl_get_vector_comparison_function_d(self->distance) ;
 #endif
 
-  self->dimension = dimension ;
-  self->numCenters = numCenters ;
-  self->centers = vl_malloc (sizeof(TYPE) * dimension * numCenters) ;
-
   for (x = 0 ; x < numData ; ++x) {
     minDistances[x] = (TYPE) VL_INFINITY_D ;
   }
 
-  /* select the first point at random */
-  x = vl_rand_uindex (rand, numData) ;
+  /* select the first point at random (proportionally to its weight) */
+  if (weights) {
+    double total = 0 ;
+    double acc = 0 ;
+    double thresh ;
+    for (x = 0 ; x < numData ; ++x) total += weights[x] ;
+    thresh = vl_rand_real1 (rand) * total ;
+    for (x = 0 ; x < numData - 1 ; ++x) {
+      acc += weights[x] ;
+      if (acc >= thresh) break ;
+    }
+  } else {
+    x = vl_rand_uindex (rand, numData) ;
+  }
+
   c = 0 ;
   while (1) {
-    TYPE energy = 0 ;
-    TYPE acc = 0 ;
-    TYPE thresh = (TYPE) vl_rand_real1 (rand) ;
+    TYPE const * cpt = centers + c * dimension ;
+    double energy = 0 ;
+    double acc = 0 ;
+    double thresh ;
 
-    memcpy ((TYPE*)self->centers + c * dimension,
+    memcpy (centers + c * dimension,
             data + x * dimension,
             sizeof(TYPE) * dimension) ;
 
     c ++ ;
     if (c == numCenters) break ;
 
-    VL_XCAT(vl_eval_vector_comparison_on_all_pairs_, SFX)
-    (distances,
-     dimension,
-     (TYPE*)self->centers + (c - 1) * dimension, 1,
-     data, numData,
-     distFn) ;
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(b, x) num_threads(vl_get_max_threads())
+#endif
+    for (b = 0 ; b < (signed)numBlocks ; ++b) {
+      vl_uindex end = VL_MIN((vl_uindex)(b + 1) * VL_KMEANS_SEEDING_BLOCK_SIZE, numData) ;
+      double blockEnergy = 0 ;
+      for (x = b * VL_KMEANS_SEEDING_BLOCK_SIZE ; x < end ; ++x) {
+        TYPE distance = distFn(dimension, data + x * dimension, cpt) ;
+        minDistances[x] = VL_MIN(minDistances[x], distance) ;
+        blockEnergy += weights ? weights[x] * minDistances[x] : minDistances[x] ;
+      }
+      blockEnergies[b] = blockEnergy ;
+    }
 
-    for (x = 0 ; x < numData ; ++x) {
-      minDistances[x] = VL_MIN(minDistances[x], distances[x]) ;
-      energy += minDistances[x] ;
+    for (b = 0 ; b < (signed)numBlocks ; ++b) energy += blockEnergies[b] ;
+    thresh = vl_rand_real1 (rand) * energy ;
+
+    /* find the block, then the point within the block */
+    for (b = 0 ; b < (signed)numBlocks - 1 ; ++b) {
+      if (acc + blockEnergies[b] >= thresh) break ;
+      acc += blockEnergies[b] ;
+    }
+    {
+      vl_uindex end = VL_MIN((vl_uindex)(b + 1) * VL_KMEANS_SEEDING_BLOCK_SIZE, numData) ;
+      for (x = b * VL_KMEANS_SEEDING_BLOCK_SIZE ; x < end - 1 ; ++x) {
+        acc += weights ? weights[x] * minDistances[x] : minDistances[x] ;
+        if (acc >= thresh) break ;
+      }
     }
+  }
 
-    for (x = 0 ; x < numData - 1 ; ++x) {
-      acc += minDistances[x] ;
-      if (acc >= thresh * energy) break ;
+  vl_free(blockEnergies) ;
+  vl_free(minDistances) ;
+}
+
+static void
+VL_XCAT(_vl_kmeans_init_centers_plus_plus_, SFX)
+(VlKMeans * self,
+ TYPE const * data,
+ vl_size dimension,
+ vl_size numData,
+ vl_size numCenters)
+{
+  self->dimension = dimension ;
+  self->numCenters = numCenters ;
+  self->centers = vl_malloc (sizeof(TYPE) * dimension * numCenters) ;
+
+  VL_XCAT(_vl_kmeans_seed_plus_plus_, SFX)
+  (self, self->centers, data, NULL, dimension, numData, numCenters) ;
+}
+
+/* ---------------------------------------------------------------- */
+/*                                        Scalable kmeans++ seeding */
+/* ---------------------------------------------------------------- */
+
+static void
+VL_XCAT(_vl_kmeans_init_centers_scalable_plus_plus_, SFX)
+(VlKMeans * self,
+ TYPE const * data,
+ vl_size dimension,
+ vl_size numData,
+ vl_size numCenters)
+{
+  vl_index b ;
+  vl_uindex x, j, round ;
+  VlRand * rand = vl_get_rand () ;
+  vl_size numBlocks = (numData + VL_KMEANS_SEEDING_BLOCK_SIZE - 1) / VL_KMEANS_SEEDING_BLOCK_SIZE ;
+  double oversampling = VL_MAX(self->oversamplingFactor * numCenters, 1.0) ;
+  double * blockEnergies = vl_malloc (sizeof(double) * numBlocks) ;
+  vl_uint32 * blockSeeds = vl_malloc (sizeof(vl_uint32) * numBlocks) ;
+  TYPE * minDistances = vl_malloc (sizeof(TYPE) * numData) ;
+  vl_uint32 * closestCandidates = vl_malloc (sizeof(vl_uint32) * numData) ;
+  vl_uint8 * selected = vl_malloc (sizeof(vl_uint8) * numData) ;
+  vl_size numCandidates = 0 ;
+  vl_size candidatesCapacity = 2 * numCenters + 1 ;
+  TYPE * candidates = vl_malloc (sizeof(TYPE) * dimension * candidatesCapacity) ;
+  double * weights ;
+#if (FLT == VL_TYPE_FLOAT)
+  VlFloatVectorComparisonFunction distFn = vl_get_vector_comparison_function_f(self->distance) ;
+#else
+  VlDoubleVectorComparisonFunction distFn = vl_get_vector_comparison_function_d(self->distance) ;
+#endif
+
+  self->dimension = dimension ;
+  self->numCenters = numCenters ;
+  self->centers = vl_malloc (sizeof(TYPE) * dimension * numCenters) ;
+
+  /* the first candidate is a random point */
+  x = vl_rand_uindex (rand, numData) ;
+  memcpy (candidates, data + x * dimension, sizeof(TYPE) * dimension) ;
+  numCandidates = 1 ;
+  for (x = 0 ; x < numData ; ++x) {
+    minDistances[x] = (TYPE) VL_INFINITY_D ;
+  }
+
+  for (round = 0 ; 1 ; ++ round) {
+    vl_size firstNewCandidate = (round == 0) ? 0 : numCandidates ;
+    double energy = 0 ;
+
+    /* add the points sampled in the previous round */
+    if (round > 0) {
+      for (x = 0 ; x < numData ; ++x) {
+        if (! selected[x]) continue ;
+        if (numCandidates == candidatesCapacity) {
+          candidatesCapacity *= 2 ;
+          candidates = vl_realloc (candidates, sizeof(TYPE) * dimension * candidatesCapacity) ;
+        }
+        memcpy (candidates + numCandidates * dimension,
+                data + x * dimension,
+                sizeof(TYPE) * dimension) ;
+        numCandidates ++ ;
+      }
+    }
+
+    /* update the distances to the closest candidate */
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(b, x, j) num_threads(vl_get_max_threads())
+#endif
+    for (b = 0 ; b < (signed)numBlocks ; ++b) {
+      vl_uindex end = VL_MIN((vl_uindex)(b + 1) * VL_KMEANS_SEEDING_BLOCK_SIZE, numData) ;
+      double blockEnergy = 0 ;
+      for (x = b * VL_KMEANS_SEEDING_BLOCK_SIZE ; x < end ; ++x) {
+        for (j = firstNewCandidate ; j < numCandidates ; ++j) {
+          TYPE distance = distFn(dimension, data + x * dimension,
+                                 candidates + j * dimension) ;
+          if (distance < minDistances[x]) {
+            minDistances[x] = distance ;
+            closestCandidates[x] = (vl_uint32)j ;
+          }
+        }
+        blockEnergy += minDistances[x] ;
+      }
+      blockEnergies[b] = blockEnergy ;
+    }
+    for (b = 0 ; b < (signed)numBlocks ; ++b) energy += blockEnergies[b] ;
+
+    if (self->verbosity) {
+      VL_PRINTF("kmeans: scalable k-means++ round %d: %d candidates, energy = %g\n",
+                round, numCandidates, energy) ;
+    }
+
+    if (round >= self->numSeedingRounds || energy == 0) break ;
+
+    /*
+     Sample each point independently with probability proportional to
+     its distance to the closest candidate. Each block uses its own
+     generator, seeded from the global one.
+     */
+    for (b = 0 ; b < (signed)numBlocks ; ++b) {
+      blockSeeds[b] = vl_rand_uint32 (rand) ;
+    }
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(b, x) num_threads(vl_get_max_threads())
+#endif
+    for (b = 0 ; b < (signed)numBlocks ; ++b) {
+      VlRand blockRand ;
+      vl_uindex end = VL_MIN((vl_uindex)(b + 1) * VL_KMEANS_SEEDING_BLOCK_SIZE, numData) ;
+      vl_rand_init (&blockRand) ;
+      vl_rand_seed (&blockRand, blockSeeds[b]) ;
+      for (x = b * VL_KMEANS_SEEDING_BLOCK_SIZE ; x < end ; ++x) {
+        selected[x] = (vl_rand_real1 (&blockRand) * energy
+                       < oversampling * minDistances[x]) ;
+      }
     }
   }
 
-  vl_free(distances) ;
+  /* weight each candidate by the number of points closest to it */
+  weights = vl_calloc (numCandidates, sizeof(double)) ;
+  for (x = 0 ; x < numData ; ++x) {
+    weights[closestCandidates[x]] += 1 ;
+  }
+
+  if (numCandidates >= numCenters) {
+    /* recluster the weighted candidates by kmeans++ */
+    VL_XCAT(_vl_kmeans_seed_plus_plus_, SFX)
+    (self, self->centers, candidates, weights, dimension, numCandidates, numCenters) ;
+  } else {
+    if (self->verbosity) {
+      VL_PRINTF("kmeans: scalable k-means++: too few candidates, using k-means++\n") ;
+    }
+    VL_XCAT(_vl_kmeans_seed_plus_plus_, SFX)
+    (self, self->centers, data, NULL, dimension, numData, numCenters) ;
+  }
+
+  vl_free(weights) ;
+  vl_free(candidates) ;
+  vl_free(selected) ;
+  vl_free(closestCandidates) ;
   vl_free(minDistances) ;
+  vl_free(blockSeeds) ;
+  vl_free(blockEnergies) ;
 }
 
 /* ---------------------------------------------------------------- */
 /*                                                     Quantization */
 /* ---------------------------------------------------------------- */
 
+/*
+ For the l2 distance, the assignments are computed by expanding
+ |x - c|^2 = |x|^2 - 2 <x,c> + |c|^2 and evaluating the inner products
+ as a blocked matrix product of the data against the centers. The
+ centers are packed in blocks of VL_KMEANS_GEMM_NUM_COLS centers,
+ stored dimension-major, so that the inner loop of the product runs
+ over contiguous memory and VL_KMEANS_GEMM_NUM_ROWS data points are
+ scored against a block of centers at once. The packed centers and
+ their half norms are computed once whenever the centers change and
+ stored in the object (_vl_kmeans_pack_centers).
+
+ The data is processed in chunks of VL_KMEANS_GEMM_CHUNK_NUM_ROWS
+ points and the centers in tiles of about VL_KMEANS_GEMM_TILE_SIZE
+ bytes, so that a tile stays in cache while all the points of the
+ chunk are scored against it. The minimum is tracked while the product
+ is computed, so that the matrix of point-to-center distances is never
+ stored. Since the centers of each point are still visited in order,
+ ties are broken as in the generic path. The distance to the selected
+ center is finally recomputed exactly. The product is evaluated by an
+ SSE2 micro-kernel; without SIMD support the generic per-pair path
+ below is used instead.
+ */
+
+#ifndef VL_DISABLE_SSE2
+static void
+VL_XCAT(_vl_kmeans_pack_centers_, SFX) (VlKMeans * self)
+{
+  vl_uindex c, d ;
+  vl_size dimension = self->dimension ;
+  vl_size numBlocks = (self->numCenters + VL_KMEANS_GEMM_NUM_COLS - 1) / VL_KMEANS_GEMM_NUM_COLS ;
+  vl_size numPacked = numBlocks * VL_KMEANS_GEMM_NUM_COLS ;
+  TYPE const * centers = (TYPE const *) self->centers ;
+  TYPE * packedCenters ;
+  TYPE * halfCenterNorms ;
+
+  if (self->packedCenters) vl_free(self->packedCenters) ;
+  self->packedCenters = vl_calloc (numPacked * (dimension + 1), sizeof(TYPE)) ;
+  packedCenters = self->packedCenters ;
+  halfCenterNorms = packedCenters + numPacked * dimension ;
+
+  /* padding centers get an infinite norm so that they are never
+     selected */
+  for (c = 0 ; c < numPacked ; ++c) {
+    TYPE * pc = packedCenters + (c / VL_KMEANS_GEMM_NUM_COLS) * dimension * VL_KMEANS_GEMM_NUM_COLS
+                              + (c % VL_KMEANS_GEMM_NUM_COLS) ;
+    TYPE norm = 0 ;
+    if (c >= self->numCenters) {
+      halfCenterNorms[c] = (TYPE) VL_INFINITY_D ;
+      continue ;
+    }
+    for (d = 0 ; d < dimension ; ++d) {
+      TYPE z = centers[c * dimension + d] ;
+      pc[d * VL_KMEANS_GEMM_NUM_COLS] = z ;
+      norm += z * z ;
+    }
+    halfCenterNorms[c] = norm / 2 ;
+  }
+}
+
+static void
+VL_XCAT(_vl_kmeans_quantize_l2_, SFX)
+(VlKMeans * self,
+ vl_uint32 * assignments,
+ TYPE * distances,
+ TYPE const * data,
+ vl_size numData)
+{
+  vl_index i ;
+  vl_size dimension = self->dimension ;
+  vl_size numBlocks = (self->numCenters + VL_KMEANS_GEMM_NUM_COLS - 1) / VL_KMEANS_GEMM_NUM_COLS ;
+  vl_size blockSize = dimension * VL_KMEANS_GEMM_NUM_COLS ;
+  vl_size tileNumBlocks = VL_MAX(VL_KMEANS_GEMM_TILE_SIZE / (sizeof(TYPE) * blockSize), 1) ;
+  TYPE const * centers = (TYPE const *) self->centers ;
+  TYPE const * packedCenters = self->packedCenters ;
+  TYPE const * halfCenterNorms = packedCenters + numBlocks * blockSize ;
+  vl_size numChunks = (numData + VL_KMEANS_GEMM_CHUNK_NUM_ROWS - 1) / VL_KMEANS_GEMM_CHUNK_NUM_ROWS ;
+
+#if (FLT == VL_TYPE_FLOAT)
+  VlFloatVectorComparisonFunction distFn = vl_get_vector_comparison_function_f(self->distance) ;
+#else
+  VlDoubleVectorComparisonFunction distFn = vl_get_vector_comparison_function_d(self->distance) ;
+#endif
+
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(i) num_threads(vl_get_max_threads())
+#endif
+  for (i = 0 ; i < (signed)numChunks ; ++i) {
+    TYPE bestScore [VL_KMEANS_GEMM_CHUNK_NUM_ROWS] ;
+    vl_uint32 bestCenter [VL_KMEANS_GEMM_CHUNK_NUM_ROWS] ;
+    vl_uindex begin = i * VL_KMEANS_GEMM_CHUNK_NUM_ROWS ;
+    vl_size numRows = VL_MIN(numData - begin, VL_KMEANS_GEMM_CHUNK_NUM_ROWS) ;
+    vl_uindex r, c, b, tile ;
+
+    for (r = 0 ; r < numRows ; ++r) {
+      bestScore[r] = (TYPE) VL_INFINITY_D ;
+      bestCenter[r] = 0 ;
+    }
+
+    for (tile = 0 ; tile < numBlocks ; tile += tileNumBlocks) {
+      vl_uindex tileEnd = VL_MIN(tile + tileNumBlocks, numBlocks) ;
+      vl_uindex row ;
+      for (row = 0 ; row < numRows ; row += VL_KMEANS_GEMM_NUM_ROWS) {
+        TYPE const * xpt [VL_KMEANS_GEMM_NUM_ROWS] ;
+        vl_size n = VL_MIN(numRows - row, VL_KMEANS_GEMM_NUM_ROWS) ;
+
+        /* the last block may be incomplete: repeat its last row */
+        for (r = 0 ; r < VL_KMEANS_GEMM_NUM_ROWS ; ++r) {
+          xpt[r] = data + (begin + row + VL_MIN(r, n - 1)) * dimension ;
+        }
+
+        for (b = tile ; b < tileEnd ; ++b) {
+          TYPE acc [VL_KMEANS_GEMM_NUM_ROWS][VL_KMEANS_GEMM_NUM_COLS] ;
+          TYPE const * hn = halfCenterNorms + b * VL_KMEANS_GEMM_NUM_COLS ;
+
+          VL_XCAT(_vl_inner_products_4x8_sse2_, SFX)(dimension, &acc[0][0], xpt,
+                                                     packedCenters + b * blockSize) ;
+
+          /* (|x - c|^2 - |x|^2) / 2 = |c|^2 / 2 - <x,c> */
+          for (r = 0 ; r < n ; ++r) {
+            for (c = 0 ; c < VL_KMEANS_GEMM_NUM_COLS ; ++c) {
+              TYPE score = hn[c] - acc[r][c] ;
+              if (score < bestScore[row + r]) {
+                bestScore[row + r] = score ;
+                bestCenter[row + r] = (vl_uint32)(b * VL_KMEANS_GEMM_NUM_COLS + c) ;
+              }
+            }
+          }
+        }
+      }
+    }
+
+    for (r = 0 ; r < numRows ; ++r) {
+      assignments[begin + r] = bestCenter[r] ;
+      if (distances) {
+        distances[begin + r] = distFn(dimension, data + (begin + r) * dimension,
+                                      centers + bestCenter[r] * dimension) ;
+      }
+    }
+  }
+}
+/* VL_DISABLE_SSE2 */
+#endif
+
 static void
 VL_XCAT(_vl_kmeans_quantize_, SFX)
 (VlKMeans * self,
@@ -668,9 +1173,15 @@ VL_XCAT(_vl_kmeans_quantize_, SFX)
   VlDoubleVectorComparisonFunction distFn = vl_get_vector_comparison_function_d(self->distance) ;
 #endif
 
+#ifndef VL_DISABLE_SSE2
+  if (self->packedCenters && vl_get_simd_enabled() && vl_cpu_has_sse2()) {
+    VL_XCAT(_vl_kmeans_quantize_l2_, SFX)(self, assignments, distances, data, numData) ;
+    return ;
+  }
+#endif
+
 #ifdef _OPENMP
-#pragma omp parallel default(none) \
-            shared(self, distances, assignments, numData, distFn, data) \
+#pragma omp parallel default(shared) \
             num_threads(vl_get_max_threads())
 #endif
   {
@@ -958,6 +1469,10 @@ VL_XCAT(_vl_kmeans_refine_centers_lloyd_, SFX)
         abort();
     } /* done compute centers */
 
+#ifndef VL_DISABLE_SSE2
+    if (self->packedCenters) VL_XCAT(_vl_kmeans_pack_centers_, SFX)(self) ;
+#endif
+
     totNumRestartedCenters += numRestartedCenters ;
     if (self->verbosity && numRestartedCenters) {
       VL_PRINTF("kmeans: Lloyd iter %d: restarted %d centers\n", iteration,
@@ -1747,53 +2262,616 @@ VL_XCAT(_vl_kmeans_refine_centers_elkan_, SFX)
 }
 
 /* ---------------------------------------------------------------- */
-static double
-VL_XCAT(_vl_kmeans_refine_centers_, SFX)
-(VlKMeans * self,
- TYPE const * data,
- vl_size numData)
+/*                                               Hamerly refinement */
+/* ---------------------------------------------------------------- */
+
+/* Convert the value returned by the comparison function to a metric
+ * distance (the l2 comparison function returns the squared
+ * distance, which does not satisfy the triangular inequality). */
+
+VL_INLINE TYPE
+VL_XCAT(_vl_kmeans_metric_, SFX)
+(VlKMeans const * self, TYPE distance)
 {
-  switch (self->algorithm) {
-    case VlKMeansLloyd:
-      return
-        VL_XCAT(_vl_kmeans_refine_centers_lloyd_, SFX)(self, data, numData) ;
-      break ;
-    case VlKMeansElkan:
-      return
-        VL_XCAT(_vl_kmeans_refine_centers_elkan_, SFX)(self, data, numData) ;
-      break ;
-    case VlKMeansANN:
-      return
-        VL_XCAT(_vl_kmeans_refine_centers_ann_, SFX)(self, data, numData) ;
+  if (self->distance == VlDistanceL2) {
+#if (FLT == VL_TYPE_FLOAT)
+    return sqrtf (distance) ;
+#else
+    return sqrt (distance) ;
+#endif
+  }
+  return distance ;
+}
+
+/* Find the k-th smallest element of an array by quickselect. The
+ * array is permuted in the process. */
+
+static TYPE
+VL_XCAT(_vl_kmeans_select_, SFX)
+(TYPE * values, vl_size numValues, vl_uindex k)
+{
+  vl_index begin = 0 ;
+  vl_index end = (signed)numValues - 1 ;
+
+  while (begin < end) {
+    TYPE pivot = values[begin + (end - begin) / 2] ;
+    vl_index i = begin ;
+    vl_index j = end ;
+    while (i <= j) {
+      while (values[i] < pivot) ++ i ;
+      while (values[j] > pivot) -- j ;
+      if (i <= j) {
+        TYPE tmp = values[i] ;
+        values[i] = values[j] ;
+        values[j] = tmp ;
+        ++ i ;
+        -- j ;
+      }
+    }
+    if ((signed)k <= j) {
+      end = j ;
+    } else if ((signed)k >= i) {
+      begin = i ;
+    } else {
       break ;
-    default:
-      abort() ;
+    }
   }
+  return values[k] ;
 }
 
-/* VL_KMEANS_INSTANTIATING */
-#else
+/* Recompute the centers from the assignments. The data points are
+ * first bucketed by center (counting sort) so that each center can
+ * be updated independently, in parallel, and without per-thread
+ * copies of the centers. The function returns the number of empty
+ * centers that were restarted from a random data point. */
 
-#ifndef __DOXYGEN__
-#define FLT VL_TYPE_FLOAT
-#define TYPE float
-#define SFX f
-#define VL_KMEANS_INSTANTIATING
-#include "kmeans.c"
+static vl_size
+VL_XCAT(_vl_kmeans_update_centers_, SFX)
+(VlKMeans * self,
+ TYPE * centers,
+ TYPE const * data,
+ vl_size numData,
+ vl_uint32 const * assignments,
+ vl_uindex * clusterOffsets,
+ vl_uint32 * clusterMembers)
+{
+  vl_index c ;
+  vl_uindex x, d ;
+  vl_size numRestartedCenters = 0 ;
+  VlRand * rand = vl_get_rand () ;
+  vl_size maxMass = _vl_kmeans_bucket_assignments
+  (assignments, numData, self->numCenters, clusterOffsets, clusterMembers) ;
 
-#define FLT VL_TYPE_DOUBLE
-#define TYPE double
-#define SFX d
-#define VL_KMEANS_INSTANTIATING
-#include "kmeans.c"
-#endif
+  if (self->distance != VlDistanceL1 && self->distance != VlDistanceL2) {
+    abort() ;
+  }
 
-/* VL_KMEANS_INSTANTIATING */
+#if defined(_OPENMP)
+#pragma omp parallel default(shared) private(c, x, d) num_threads(vl_get_max_threads())
 #endif
+  {
+    /* vl_malloc cannot be used here if mapped to MATLAB malloc */
+    TYPE * values = NULL ;
+    if (self->distance == VlDistanceL1) {
+      values = malloc(sizeof(TYPE) * VL_MAX(maxMass, 1)) ;
+    }
+
+#if defined(_OPENMP)
+#pragma omp for schedule(dynamic, 16)
+#endif
+    for (c = 0 ; c < (signed)self->numCenters ; ++c) {
+      vl_uint32 const * members = clusterMembers + clusterOffsets[c] ;
+      vl_size mass = clusterOffsets[c + 1] - clusterOffsets[c] ;
+      TYPE * cpt = centers + c * self->dimension ;
+      if (mass == 0) continue ;
+
+      if (self->distance == VlDistanceL2) {
+        memset(cpt, 0, sizeof(TYPE) * self->dimension) ;
+        for (x = 0 ; x < mass ; ++x) {
+          TYPE const * xpt = data + members[x] * self->dimension ;
+          for (d = 0 ; d < self->dimension ; ++d) {
+            cpt[d] += xpt[d] ;
+          }
+        }
+        for (d = 0 ; d < self->dimension ; ++d) {
+          cpt[d] /= (TYPE)mass ;
+        }
+      } else {
+        /* the median is the (mass-1)/2 order statistic, as in Lloyd */
+        for (d = 0 ; d < self->dimension ; ++d) {
+          for (x = 0 ; x < mass ; ++x) {
+            values[x] = data[members[x] * self->dimension + d] ;
+          }
+          cpt[d] = VL_XCAT(_vl_kmeans_select_, SFX)(values, mass, (mass - 1) / 2) ;
+        }
+      }
+    }
+
+    if (values) free(values) ;
+  }
+
+  /* restart empty centers (sequentially, as the generator is shared) */
+  for (c = 0 ; c < (signed)self->numCenters ; ++c) {
+    if (clusterOffsets[c + 1] == clusterOffsets[c]) {
+      TYPE * cpt = centers + c * self->dimension ;
+      x = vl_rand_uindex(rand, numData) ;
+      numRestartedCenters ++ ;
+      memcpy(cpt, data + x * self->dimension, sizeof(TYPE) * self->dimension) ;
+    }
+  }
+  return numRestartedCenters ;
+}
+
+/* Find the closest and the second closest center to a data point. */
+
+static void
+VL_XCAT(_vl_kmeans_hamerly_scan_point_, SFX)
+(VlKMeans * self,
+#if (FLT == VL_TYPE_FLOAT)
+ VlFloatVectorComparisonFunction distFn,
+#else
+ VlDoubleVectorComparisonFunction distFn,
+#endif
+ TYPE const * xpt,
+ vl_uint32 * closestCenter,
+ TYPE * closestDistance,
+ TYPE * secondClosestDistance)
+{
+  vl_uindex c ;
+  TYPE best = (TYPE) VL_INFINITY_D ;
+  TYPE second = (TYPE) VL_INFINITY_D ;
+  vl_uint32 bestCenter = 0 ;
+  for (c = 0 ; c < self->numCenters ; ++c) {
+    TYPE distance = VL_XCAT(_vl_kmeans_metric_, SFX)
+    (self, distFn(self->dimension, xpt, (TYPE*)self->centers + c * self->dimension)) ;
+    if (distance < best) {
+      second = best ;
+      best = distance ;
+      bestCenter = (vl_uint32)c ;
+    } else if (distance < second) {
+      second = distance ;
+    }
+  }
+  *closestCenter = bestCenter ;
+  *closestDistance = best ;
+  *secondClosestDistance = second ;
+}
+
+static double
+VL_XCAT(_vl_kmeans_refine_centers_hamerly_, SFX)
+(VlKMeans * self,
+ TYPE const * data,
+ vl_size numData)
+{
+  vl_size iteration ;
+  vl_index x, c ;
+  vl_uindex j ;
+  double energy ;
+
+#if (FLT == VL_TYPE_FLOAT)
+  VlFloatVectorComparisonFunction distFn = vl_get_vector_comparison_function_f(self->distance) ;
+#else
+  VlDoubleVectorComparisonFunction distFn = vl_get_vector_comparison_function_d(self->distance) ;
+#endif
+
+  vl_uint32 * assignments = vl_malloc (sizeof(vl_uint32) * numData) ;
+  TYPE * pointToClosestCenterUB = vl_malloc (sizeof(TYPE) * numData) ;
+  TYPE * pointToSecondClosestCenterLB = vl_malloc (sizeof(TYPE) * numData) ;
+  TYPE * newCenters = vl_malloc (sizeof(TYPE) * self->dimension * self->numCenters) ;
+  TYPE * centerToNewCenterDistances = vl_malloc (sizeof(TYPE) * self->numCenters) ;
+  TYPE * halfNextCenterDistances = vl_malloc (sizeof(TYPE) * self->numCenters) ;
+  vl_uindex * clusterOffsets = vl_malloc (sizeof(vl_uindex) * (self->numCenters + 1)) ;
+  vl_uint32 * clusterMembers = vl_malloc (sizeof(vl_uint32) * numData) ;
+
+  vl_size totDistanceComputations = 0 ;
+  vl_size totNumRestartedCenters = 0 ;
+
+  /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+  /*                          Initialization                        */
+  /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+  /* Unlike Elkan, only two bounds per point are stored: an upper
+   bound to the distance to the assigned center and a lower bound to
+   the distance to any other center. All distances are metric. */
+
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(x) num_threads(vl_get_max_threads())
+#endif
+  for (x = 0 ; x < (signed)numData ; ++x) {
+    VL_XCAT(_vl_kmeans_hamerly_scan_point_, SFX)
+    (self, distFn, data + x * self->dimension,
+     assignments + x,
+     pointToClosestCenterUB + x,
+     pointToSecondClosestCenterLB + x) ;
+  }
+  totDistanceComputations += numData * self->numCenters ;
+
+  energy = 0 ;
+  for (x = 0 ; x < (signed)numData ; ++x) {
+    energy += (self->distance == VlDistanceL2) ?
+      pointToClosestCenterUB[x] * pointToClosestCenterUB[x] :
+      pointToClosestCenterUB[x] ;
+  }
+
+  if (self->verbosity) {
+    VL_PRINTF("kmeans: Hamerly iter 0: energy = %g, dist. calc. = %d\n",
+              energy, totDistanceComputations) ;
+  }
+
+  /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+  /*                          Iterations                            */
+  /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+  for (iteration = 1 ; 1 ; ++iteration) {
+
+    vl_size numDistanceComputations = 0 ;
+    vl_size numReassignedPoints = 0 ;
+    vl_size numRestartedCenters ;
+    vl_uindex maxMoveCenter = 0 ;
+    TYPE maxMove = 0 ;
+    TYPE secondMaxMove = 0 ;
+
+    /* compute new centers */
+    numRestartedCenters = VL_XCAT(_vl_kmeans_update_centers_, SFX)
+    (self, newCenters, data, numData, assignments,
+     clusterOffsets, clusterMembers) ;
+
+    /* compute the distance from the old centers to the new centers */
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(c) num_threads(vl_get_max_threads())
+#endif
+    for (c = 0 ; c < (signed)self->numCenters ; ++c) {
+      centerToNewCenterDistances[c] = VL_XCAT(_vl_kmeans_metric_, SFX)
+      (self, distFn(self->dimension,
+                    newCenters + c * self->dimension,
+                    (TYPE*)self->centers + c * self->dimension)) ;
+    }
+    numDistanceComputations += self->numCenters ;
+
+    for (c = 0 ; c < (signed)self->numCenters ; ++c) {
+      TYPE move = centerToNewCenterDistances[c] ;
+      if (move > maxMove) {
+        secondMaxMove = maxMove ;
+        maxMove = move ;
+        maxMoveCenter = c ;
+      } else if (move > secondMaxMove) {
+        secondMaxMove = move ;
+      }
+    }
+
+    /* make the new centers current */
+    {
+      TYPE * tmp = self->centers ;
+      self->centers = newCenters ;
+      newCenters = tmp ;
+    }
+
+    /* Half the distance from each center to the closest other
+     center. This is computed without storing the inter-center
+     distance matrix, which would use O(K^2) memory. */
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(c, j) num_threads(vl_get_max_threads())
+#endif
+    for (c = 0 ; c < (signed)self->numCenters ; ++c) {
+      TYPE best = (TYPE) VL_INFINITY_D ;
+      for (j = 0 ; j < self->numCenters ; ++j) {
+        TYPE distance ;
+        if ((signed)j == c) continue ;
+        distance = distFn(self->dimension,
+                          (TYPE*)self->centers + c * self->dimension,
+                          (TYPE*)self->centers + j * self->dimension) ;
+        best = VL_MIN(best, distance) ;
+      }
+      halfNextCenterDistances[c] = VL_XCAT(_vl_kmeans_metric_, SFX)(self, best) / 2 ;
+    }
+    numDistanceComputations += self->numCenters * (self->numCenters - 1) ;
+
+    /*
+     Update the bounds based on the center variation and do the
+     reassignments. A point needs to be rescanned only if its
+     upper bound exceeds both its lower bound and half the
+     distance of its center to the closest other center.
+     */
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(x) \
+            reduction(+:numDistanceComputations,numReassignedPoints) \
+            num_threads(vl_get_max_threads())
+#endif
+    for (x = 0 ; x < (signed)numData ; ++x) {
+      vl_uint32 cx = assignments[x] ;
+      TYPE const * xpt = data + x * self->dimension ;
+      TYPE bound ;
+
+      pointToClosestCenterUB[x] += centerToNewCenterDistances[cx] ;
+      pointToSecondClosestCenterLB[x] -= (cx == maxMoveCenter) ? secondMaxMove : maxMove ;
+
+      bound = VL_MAX(halfNextCenterDistances[cx], pointToSecondClosestCenterLB[x]) ;
+      if (pointToClosestCenterUB[x] <= bound) continue ;
+
+      /* tighten the upper bound and test again */
+      pointToClosestCenterUB[x] = VL_XCAT(_vl_kmeans_metric_, SFX)
+      (self, distFn(self->dimension, xpt, (TYPE*)self->centers + cx * self->dimension)) ;
+      numDistanceComputations += 1 ;
+      if (pointToClosestCenterUB[x] <= bound) continue ;
+
+      /* rescan all the centers */
+      VL_XCAT(_vl_kmeans_hamerly_scan_point_, SFX)
+      (self, distFn, xpt,
+       assignments + x,
+       pointToClosestCenterUB + x,
+       pointToSecondClosestCenterLB + x) ;
+      numDistanceComputations += self->numCenters ;
+      if (assignments[x] != cx) numReassignedPoints ++ ;
+    }
+
+    totDistanceComputations += numDistanceComputations ;
+    totNumRestartedCenters += numRestartedCenters ;
+
+    /* compute UB on energy */
+    energy = 0 ;
+    for (x = 0 ; x < (signed)numData ; ++x) {
+      energy += (self->distance == VlDistanceL2) ?
+        pointToClosestCenterUB[x] * pointToClosestCenterUB[x] :
+        pointToClosestCenterUB[x] ;
+    }
+
+    if (self->verbosity) {
+      VL_PRINTF("kmeans: Hamerly iter %d: energy <= %g, dist. calc. = %d, reassigned = %d\n",
+                iteration,
+                energy,
+                numDistanceComputations,
+                numReassignedPoints) ;
+      if (numRestartedCenters) {
+        VL_PRINTF("kmeans: Hamerly iter %d: restarted %d centers\n",
+                  iteration,
+                  numRestartedCenters) ;
+      }
+    }
+
+    /* check termination conditions */
+    if (iteration >= self->maxNumIterations) {
+      if (self->verbosity) {
+        VL_PRINTF("kmeans: Hamerly terminating because maximum number of iterations reached\n") ;
+      }
+      break ;
+    }
+    if (numReassignedPoints == 0) {
+      if (self->verbosity) {
+        VL_PRINTF("kmeans: Hamerly terminating because the algorithm fully converged\n") ;
+      }
+      break ;
+    }
+  } /* next Hamerly iteration */
+
+  /* compute true energy */
+  energy = 0 ;
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(x) reduction(+:energy) num_threads(vl_get_max_threads())
+#endif
+  for (x = 0 ; x < (signed)numData ; ++ x) {
+    energy += distFn(self->dimension,
+                     data + self->dimension * x,
+                     (TYPE*)self->centers + self->dimension * assignments[x]) ;
+  }
+  totDistanceComputations += numData ;
+
+  if (self->verbosity) {
+    VL_PRINTF("kmeans: Hamerly: total dist. calc.: %d (%.2f %% of Lloyd)\n",
+              totDistanceComputations,
+              100.0 * totDistanceComputations / ((iteration + 1) * self->numCenters * numData)) ;
+    if (totNumRestartedCenters) {
+      VL_PRINTF("kmeans: Hamerly: there have been %d restarts\n",
+                totNumRestartedCenters) ;
+    }
+  }
+
+  vl_free(assignments) ;
+  vl_free(pointToClosestCenterUB) ;
+  vl_free(pointToSecondClosestCenterLB) ;
+  vl_free(newCenters) ;
+  vl_free(centerToNewCenterDistances) ;
+  vl_free(halfNextCenterDistances) ;
+  vl_free(clusterOffsets) ;
+  vl_free(clusterMembers) ;
+
+  return energy ;
+}
+
+/* ---------------------------------------------------------------- */
+/*                                           Mini-batch refinement */
+/* ---------------------------------------------------------------- */
+
+static double
+VL_XCAT(_vl_kmeans_push_batch_, SFX)
+(VlKMeans * self,
+ TYPE const * data,
+ vl_size numData)
+{
+  vl_index c ;
+  vl_uindex x ;
+  double energy = 0 ;
+  vl_uint32 * assignments = vl_malloc (sizeof(vl_uint32) * numData) ;
+  TYPE * distances = vl_malloc (sizeof(TYPE) * numData) ;
+  vl_uindex * clusterOffsets = vl_malloc (sizeof(vl_uindex) * (self->numCenters + 1)) ;
+  vl_uint32 * clusterMembers = vl_malloc (sizeof(vl_uint32) * numData) ;
+
+  if (! self->centerMasses) {
+    self->centerMasses = vl_calloc (self->numCenters, sizeof(vl_size)) ;
+  }
+
+  /* assign the batch to the current centers */
+  VL_XCAT(_vl_kmeans_quantize_, SFX)(self, assignments, distances, data, numData) ;
+  for (x = 0 ; x < numData ; ++x) energy += distances[x] ;
+
+  /*
+   Move each center towards the points assigned to it, using the
+   per-center learning rate 1/n, where n is the number of points
+   assigned to that center so far. With this choice each center is
+   the running mean of its points. The points of different centers
+   are processed in parallel.
+   */
+  _vl_kmeans_bucket_assignments
+  (assignments, numData, self->numCenters, clusterOffsets, clusterMembers) ;
+
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(c, x) schedule(dynamic, 16) \
+            num_threads(vl_get_max_threads())
+#endif
+  for (c = 0 ; c < (signed)self->numCenters ; ++c) {
+    TYPE * cpt = (TYPE*)self->centers + c * self->dimension ;
+    for (x = clusterOffsets[c] ; x < clusterOffsets[c + 1] ; ++x) {
+      TYPE const * xpt = data + clusterMembers[x] * self->dimension ;
+      TYPE eta = (TYPE) 1 / (TYPE) (++ self->centerMasses[c]) ;
+      vl_uindex d ;
+      for (d = 0 ; d < self->dimension ; ++d) {
+        cpt[d] += eta * (xpt[d] - cpt[d]) ;
+      }
+    }
+  }
+
+#ifndef VL_DISABLE_SSE2
+  if (self->packedCenters) VL_XCAT(_vl_kmeans_pack_centers_, SFX)(self) ;
+#endif
+
+  vl_free(assignments) ;
+  vl_free(distances) ;
+  vl_free(clusterOffsets) ;
+  vl_free(clusterMembers) ;
+  return energy ;
+}
+
+static double
+VL_XCAT(_vl_kmeans_refine_centers_mini_batch_, SFX)
+(VlKMeans * self,
+ TYPE const * data,
+ vl_size numData)
+{
+  vl_uindex i, x, iteration ;
+  double energy ;
+  VlRand * rand = vl_get_rand () ;
+  vl_size batchSize = VL_MIN(self->miniBatchSize, numData) ;
+  TYPE * batch = vl_malloc (sizeof(TYPE) * self->dimension * batchSize) ;
+  TYPE * distances = vl_malloc (sizeof(TYPE) * batchSize) ;
+  vl_uint32 * assignments = vl_malloc (sizeof(vl_uint32) * batchSize) ;
+
+  /* restart the learning rates */
+  if (self->centerMasses) {
+    memset(self->centerMasses, 0, sizeof(vl_size) * self->numCenters) ;
+  }
+
+  for (iteration = 0 ; iteration < self->maxNumIterations ; ++iteration) {
+    double batchEnergy ;
+    for (i = 0 ; i < batchSize ; ++i) {
+      x = vl_rand_uindex(rand, numData) ;
+      memcpy(batch + i * self->dimension,
+             data + x * self->dimension,
+             sizeof(TYPE) * self->dimension) ;
+    }
+    batchEnergy = VL_XCAT(_vl_kmeans_push_batch_, SFX)(self, batch, batchSize) ;
+    if (self->verbosity) {
+      VL_PRINTF("kmeans: MiniBatch iter %d: batch energy = %g\n", iteration,
+                batchEnergy) ;
+    }
+  }
+
+  /* compute the energy of the whole data, one batch at a time */
+  energy = 0 ;
+  for (x = 0 ; x < numData ; x += batchSize) {
+    vl_size n = VL_MIN(batchSize, numData - x) ;
+    VL_XCAT(_vl_kmeans_quantize_, SFX)
+    (self, assignments, distances, data + x * self->dimension, n) ;
+    for (i = 0 ; i < n ; ++i) energy += distances[i] ;
+  }
+
+  if (self->verbosity) {
+    VL_PRINTF("kmeans: MiniBatch terminating after %d batches of %d points\n",
+              iteration, batchSize) ;
+  }
+
+  vl_free(batch) ;
+  vl_free(distances) ;
+  vl_free(assignments) ;
+  return energy ;
+}
+
+/* ---------------------------------------------------------------- */
+static double
+VL_XCAT(_vl_kmeans_refine_centers_, SFX)
+(VlKMeans * self,
+ TYPE const * data,
+ vl_size numData)
+{
+  switch (self->algorithm) {
+    case VlKMeansLloyd:
+      return
+        VL_XCAT(_vl_kmeans_refine_centers_lloyd_, SFX)(self, data, numData) ;
+      break ;
+    case VlKMeansElkan:
+      return
+        VL_XCAT(_vl_kmeans_refine_centers_elkan_, SFX)(self, data, numData) ;
+      break ;
+    case VlKMeansANN:
+      return
+        VL_XCAT(_vl_kmeans_refine_centers_ann_, SFX)(self, data, numData) ;
+      break ;
+    case VlKMeansHamerly:
+      return
+        VL_XCAT(_vl_kmeans_refine_centers_hamerly_, SFX)(self, data, numData) ;
+      break ;
+    case VlKMeansMiniBatch:
+      return
+        VL_XCAT(_vl_kmeans_refine_centers_mini_batch_, SFX)(self, data, numData) ;
+      break ;
+    default:
+      abort() ;
+  }
+}
+
+/* VL_KMEANS_INSTANTIATING */
+#else
+
+#ifndef __DOXYGEN__
+#define FLT VL_TYPE_FLOAT
+#define TYPE float
+#define SFX f
+#define VL_KMEANS_INSTANTIATING
+#include "kmeans.c"
+
+#define FLT VL_TYPE_DOUBLE
+#define TYPE double
+#define SFX d
+#define VL_KMEANS_INSTANTIATING
+#include "kmeans.c"
+#endif
+
+/* VL_KMEANS_INSTANTIATING */
+#endif
+
+/* ================================================================ */
+#ifndef VL_KMEANS_INSTANTIATING
+
+/* Pack the centers for the l2 quantizer. This is done once every time
+   the centers change rather than at every quantization, so that
+   quantizing does not modify the object. */
+
+static void
+_vl_kmeans_update_packed_centers (VlKMeans * self)
+{
+  if (self->packedCenters) {
+    vl_free(self->packedCenters) ;
+    self->packedCenters = NULL ;
+  }
+#ifndef VL_DISABLE_SSE2
+  if (self->centers && self->distance == VlDistanceL2) {
+    switch (self->dataType) {
+      case VL_TYPE_FLOAT : _vl_kmeans_pack_centers_f (self) ; break ;
+      case VL_TYPE_DOUBLE : _vl_kmeans_pack_centers_d (self) ; break ;
+      default: abort() ;
+    }
+  }
+#endif
+}
 
-/* ================================================================ */
-#ifndef VL_KMEANS_INSTANTIATING
-
 /** ------------------------------------------------------------------
  ** @brief Set centers
  ** @param self KMeans object.
@@ -1823,6 +2901,7 @@ vl_kmeans_set_centers
     default:
       abort() ;
   }
+  _vl_kmeans_update_packed_centers (self) ;
 }
 
 /** ------------------------------------------------------------------
@@ -1859,6 +2938,7 @@ vl_kmeans_init_centers_with_rand_data
     default:
       abort() ;
   }
+  _vl_kmeans_update_packed_centers (self) ;
 }
 
 /** ------------------------------------------------------------------
@@ -1892,6 +2972,45 @@ vl_kmeans_init_centers_plus_plus
     default:
       abort() ;
   }
+  _vl_kmeans_update_packed_centers (self) ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Seed centers by the scalable KMeans++ algorithm
+ ** @param self KMeans object.
+ ** @param data data to sample from.
+ ** @param dimension data dimension.
+ ** @param numData nmber of data points.
+ ** @param numCenters number of centers.
+ **
+ ** See @ref kmeans-init. The number of rounds and the oversampling
+ ** are set by ::vl_kmeans_set_num_seeding_rounds and
+ ** ::vl_kmeans_set_oversampling_factor.
+ **/
+
+VL_EXPORT void
+vl_kmeans_init_centers_scalable_plus_plus
+(VlKMeans * self,
+ void const * data,
+ vl_size dimension,
+ vl_size numData,
+ vl_size numCenters)
+{
+  vl_kmeans_reset (self) ;
+
+  switch (self->dataType) {
+    case VL_TYPE_FLOAT :
+      _vl_kmeans_init_centers_scalable_plus_plus_f
+      (self, (float const *)data, dimension, numData, numCenters) ;
+      break ;
+    case VL_TYPE_DOUBLE :
+      _vl_kmeans_init_centers_scalable_plus_plus_d
+      (self, (double const *)data, dimension, numData, numCenters) ;
+      break ;
+    default:
+      abort() ;
+  }
+  _vl_kmeans_update_packed_centers (self) ;
 }
 
 /** ------------------------------------------------------------------
@@ -1966,6 +3085,64 @@ vl_kmeans_quantize_ann
   }
 }
 
+/* The mini-batch updates move the centers towards the mean of the
+   points, which minimizes only the l2 energy. */
+static vl_bool
+_vl_kmeans_check_mini_batch_distance (VlKMeans const * self)
+{
+  if (self->distance != VlDistanceL2) {
+    vl_set_last_error(VL_ERR_BAD_ARG,
+                      "The mini-batch K-means algorithm supports only the L2 distance") ;
+    return VL_FALSE ;
+  }
+  return VL_TRUE ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Update the centers with a batch of data (streaming K-means).
+ ** @param self KMeans object.
+ ** @param data batch of data points.
+ ** @param numData number of data points in the batch.
+ ** @return energy of the batch before the update.
+ **
+ ** The function assigns each point of the batch to the closest
+ ** center and then moves the center towards the point by using a
+ ** per-center learning rate (@ref kmeans-mini-batch). The centers
+ ** must have been seeded before, for example by calling one of the
+ ** seeding functions on the first batch. The function can then be
+ ** called repeatedly as new data becomes available; the data does
+ ** not need to be retained after the call returns.
+ **
+ ** Only the $l^2$ distance is supported: with another distance the
+ ** function sets the last error to ::VL_ERR_BAD_ARG, leaves the
+ ** centers unchanged, and returns NaN.
+ **/
+
+VL_EXPORT double
+vl_kmeans_push_batch
+(VlKMeans * self,
+ void const * data,
+ vl_size numData)
+{
+  assert (self->centers) ;
+  if (! _vl_kmeans_check_mini_batch_distance (self)) {
+    return VL_NAN_D ;
+  }
+
+  switch (self->dataType) {
+    case VL_TYPE_FLOAT :
+      return
+        _vl_kmeans_push_batch_f
+        (self, (float const *)data, numData) ;
+    case VL_TYPE_DOUBLE :
+      return
+        _vl_kmeans_push_batch_d
+        (self, (double const *)data, numData) ;
+    default:
+      abort() ;
+  }
+}
+
 /** ------------------------------------------------------------------
  ** @brief Refine center locations.
  ** @param self KMeans object.
@@ -1978,6 +3155,10 @@ vl_kmeans_quantize_ann
  ** The function assumes that the cluster centers have already
  ** been assigned by using one of the seeding functions, or by
  ** setting them.
+ **
+ ** The ::VlKMeansMiniBatch algorithm supports only the $l^2$
+ ** distance: with another distance the function sets the last error
+ ** to ::VL_ERR_BAD_ARG, leaves the centers unchanged, and returns NaN.
  **/
 
 VL_EXPORT double
@@ -1986,20 +3167,27 @@ vl_kmeans_refine_centers
  void const * data,
  vl_size numData)
 {
+  double energy ;
   assert (self->centers) ;
+  if (self->algorithm == VlKMeansMiniBatch &&
+      ! _vl_kmeans_check_mini_batch_distance (self)) {
+    return VL_NAN_D ;
+  }
 
   switch (self->dataType) {
     case VL_TYPE_FLOAT :
-      return
-        _vl_kmeans_refine_centers_f
+      energy = _vl_kmeans_refine_centers_f
         (self, (float const *)data, numData) ;
+      break ;
     case VL_TYPE_DOUBLE :
-      return
-        _vl_kmeans_refine_centers_d
+      energy = _vl_kmeans_refine_centers_d
         (self, (double const *)data, numData) ;
+      break ;
     default:
       abort() ;
   }
+  _vl_kmeans_update_packed_centers (self) ;
+  return energy ;
 }
 
 
@@ -2051,6 +3239,11 @@ vl_kmeans_cluster (VlKMeans * self,
                                           data, dimension, numData,
                                           numCenters) ;
         break ;
+      case VlKMeansScalablePlusPlus :
+        vl_kmeans_init_centers_scalable_plus_plus (self,
+                                                   data, dimension, numData,
+                                                   numCenters) ;
+        break ;
       default:
         abort() ;
     }
@@ -2089,6 +3282,7 @@ vl_kmeans_cluster (VlKMeans * self,
 
   vl_free (self->centers) ;
   self->centers = bestCenters ;
+  _vl_kmeans_update_packed_centers (self) ;
   return bestEnergy ;
 }
 
@@ -28,14 +28,17 @@ the terms of the BSD license (see the COPYING file).
 typedef enum _VlKMeansAlgorithm {
   VlKMeansLloyd,       /**< Lloyd algorithm */
   VlKMeansElkan,       /**< Elkan algorithm */
-  VlKMeansANN          /**< Approximate nearest neighbors */
+  VlKMeansANN,         /**< Approximate nearest neighbors */
+  VlKMeansHamerly,     /**< Hamerly algorithm */
+  VlKMeansMiniBatch    /**< Mini-batch algorithm */
 } VlKMeansAlgorithm ;
 
 /** @brief K-means initialization algorithms */
 
 typedef enum _VlKMeansInitialization {
   VlKMeansRandomSelection,  /**< Randomized selection */
-  VlKMeansPlusPlus          /**< Plus plus raondomized selection */
+  VlKMeansPlusPlus,         /**< Plus plus raondomized selection */
+  VlKMeansScalablePlusPlus  /**< Scalable plus plus (k-means||) selection */
 } VlKMeansInitialization ;
 
 /** ------------------------------------------------------------------
@@ -50,6 +53,9 @@ typedef struct _VlKMeans
   vl_size numCenters ;                    /**< Number of centers. */
   vl_size numTrees ;                      /**< Number of trees in forest when using ANN-kmeans. */
   vl_size maxNumComparisons ;             /**< Maximum number of comparisons when using ANN-kmeans. */
+  vl_size miniBatchSize ;                 /**< Batch size when using mini-batch-kmeans. */
+  double oversamplingFactor ;             /**< Oversampling (times numCenters) in scalable kmeans++. */
+  vl_size numSeedingRounds ;              /**< Number of sampling rounds in scalable kmeans++. */
 
   VlKMeansInitialization initialization ; /**< Initalization algorithm. */
   VlKMeansAlgorithm algorithm ;           /**< Clustring algorithm. */
@@ -61,6 +67,8 @@ typedef struct _VlKMeans
 
   void * centers ;                        /**< Centers */
   void * centerDistances ;                /**< Centers inter-distances. */
+  vl_size * centerMasses ;                /**< Number of points seen by each center (mini-batch). */
+  void * packedCenters ;                  /**< Centers packed for the l2 quantizer. */
 
   double energy ;                         /**< Current solution energy. */
   VlFloatVectorComparisonFunction floatVectorComparisonFn ;
@@ -122,10 +130,21 @@ VL_EXPORT void vl_kmeans_init_centers_plus_plus
                    vl_size numData,
                    vl_size numCenters) ;
 
+VL_EXPORT void vl_kmeans_init_centers_scalable_plus_plus
+                  (VlKMeans * self,
+                   void const * data,
+                   vl_size dimensions,
+                   vl_size numData,
+                   vl_size numCenters) ;
+
 VL_EXPORT double vl_kmeans_refine_centers (VlKMeans * self,
                                            void const * data,
                                            vl_size numData) ;
 
+VL_EXPORT double vl_kmeans_push_batch (VlKMeans * self,
+                                       void const * data,
+                                       vl_size numData) ;
+
 /** @} */
 
 /** @name Retrieve data and parameters
@@ -146,6 +165,9 @@ VL_INLINE vl_size vl_kmeans_get_max_num_iterations (VlKMeans const * self) ;
 VL_INLINE double vl_kmeans_get_min_energy_variation (VlKMeans const * self) ;
 VL_INLINE vl_size vl_kmeans_get_max_num_comparisons (VlKMeans const * self) ;
 VL_INLINE vl_size vl_kmeans_get_num_trees (VlKMeans const * self) ;
+VL_INLINE vl_size vl_kmeans_get_mini_batch_size (VlKMeans const * self) ;
+VL_INLINE double vl_kmeans_get_oversampling_factor (VlKMeans const * self) ;
+VL_INLINE vl_size vl_kmeans_get_num_seeding_rounds (VlKMeans const * self) ;
 VL_INLINE double vl_kmeans_get_energy (VlKMeans const * self) ;
 VL_INLINE void const * vl_kmeans_get_centers (VlKMeans const * self) ;
 /** @} */
@@ -161,6 +183,9 @@ VL_INLINE void vl_kmeans_set_min_energy_variation (VlKMeans * self, double minEn
 VL_INLINE void vl_kmeans_set_verbosity (VlKMeans * self, int verbosity) ;
 VL_INLINE void vl_kmeans_set_max_num_comparisons (VlKMeans * self, vl_size maxNumComparisons) ;
 VL_INLINE void vl_kmeans_set_num_trees (VlKMeans * self, vl_size numTrees) ;
+VL_INLINE void vl_kmeans_set_mini_batch_size (VlKMeans * self, vl_size miniBatchSize) ;
+VL_INLINE void vl_kmeans_set_oversampling_factor (VlKMeans * self, double oversamplingFactor) ;
+VL_INLINE void vl_kmeans_set_num_seeding_rounds (VlKMeans * self, vl_size numSeedingRounds) ;
 /** @} */
 
 /** ------------------------------------------------------------------
@@ -430,6 +455,81 @@ vl_kmeans_get_num_trees (VlKMeans const * self)
     return self->numTrees;
 }
 
+/** ------------------------------------------------------------------
+ ** @brief Get the batch size of the mini-batch algorithm
+ ** @param self KMeans object instance.
+ ** @return number of data points per batch.
+ **/
+
+VL_INLINE vl_size
+vl_kmeans_get_mini_batch_size (VlKMeans const * self)
+{
+  return self->miniBatchSize ;
+}
+
+/** @brief Set the batch size of the mini-batch algorithm
+ ** @param self KMeans object instance.
+ ** @param miniBatchSize number of data points per batch.
+ ** The batch size cannot be smaller than 1.
+ **/
+
+VL_INLINE void
+vl_kmeans_set_mini_batch_size (VlKMeans * self, vl_size miniBatchSize)
+{
+  assert (miniBatchSize >= 1) ;
+  self->miniBatchSize = miniBatchSize ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get the oversampling factor of scalable KMeans++
+ ** @param self KMeans object instance.
+ ** @return oversampling factor.
+ **/
+
+VL_INLINE double
+vl_kmeans_get_oversampling_factor (VlKMeans const * self)
+{
+  return self->oversamplingFactor ;
+}
+
+/** @brief Set the oversampling factor of scalable KMeans++
+ ** @param self KMeans object instance.
+ ** @param oversamplingFactor oversampling factor.
+ **
+ ** In each round, about @a oversamplingFactor times the number of
+ ** centers candidates are sampled. The factor must be positive.
+ **/
+
+VL_INLINE void
+vl_kmeans_set_oversampling_factor (VlKMeans * self, double oversamplingFactor)
+{
+  assert (oversamplingFactor > 0) ;
+  self->oversamplingFactor = oversamplingFactor ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get the number of sampling rounds of scalable KMeans++
+ ** @param self KMeans object instance.
+ ** @return number of rounds.
+ **/
+
+VL_INLINE vl_size
+vl_kmeans_get_num_seeding_rounds (VlKMeans const * self)
+{
+  return self->numSeedingRounds ;
+}
+
+/** @brief Set the number of sampling rounds of scalable KMeans++
+ ** @param self KMeans object instance.
+ ** @param numSeedingRounds number of rounds.
+ **/
+
+VL_INLINE void
+vl_kmeans_set_num_seeding_rounds (VlKMeans * self, vl_size numSeedingRounds)
+{
+  self->numSeedingRounds = numSeedingRounds ;
+}
+
 
 /* VL_IKMEANS_H */
 #endif
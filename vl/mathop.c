@@ -40,7 +40,10 @@ use the SSE vector extension) and are several times faster than a
 naive implementation.  ::vl_eval_vector_comparison_on_all_pairs_f and
 ::vl_eval_vector_comparison_on_all_pairs_d can be used to evaluate
 the comparison function on all pairs of one or two sequences of
-vectors.
+vectors. For the l2 distance, ::vl_get_vector_block_comparison_function_f
+and ::vl_get_vector_block_comparison_function_d return functions that
+compare ::VL_VECTOR_COMPARISON_BLOCK_SIZE vectors at once to a
+sequence of vectors, loading each of the latter only once.
 
 Let @f$ \mathbf{x} = (x_1,\dots,x_d) @f$ and @f$ \mathbf{y} =
 (y_1,\dots,y_d) @f$ be two vectors.  The following comparison
@@ -165,6 +168,32 @@ includes and implementations of:
  ** @sa vl_get_vector_comparison_function_f
  **/
 
+/** @fn vl_get_vector_block_comparison_function_f(VlVectorComparisonType)
+ **
+ ** @brief Get block vector comparison function from comparison type
+ ** @param type vector comparison type.
+ ** @return block comparison function, or @c NULL.
+ **
+ ** A block comparison function
+ ** <code>function(dimension, result, X, Y, numDataY)</code> compares
+ ** each of the ::VL_VECTOR_COMPARISON_BLOCK_SIZE vectors
+ ** <code>X[0]</code>, <code>X[1]</code>, ... to each of the @c
+ ** numDataY vectors stored one after the other in @c Y. The
+ ** comparison of <code>X[i]</code> and vector @c j of @c Y is stored
+ ** in <code>result[i * numDataY + j]</code>. Each vector of @c Y is
+ ** loaded once for all the vectors of the block.
+ **
+ ** The results are identical to those of the function returned by
+ ** ::vl_get_vector_comparison_function_f for the same type and the
+ ** same SIMD settings. The function returns @c NULL if @a type has
+ ** no block implementation (currently only ::VlDistanceL2 has one).
+ **/
+
+/** @fn vl_get_vector_block_comparison_function_d(VlVectorComparisonType)
+ ** @brief Get block vector comparison function from comparison type
+ ** @sa vl_get_vector_block_comparison_function_f
+ **/
+
 /** @fn vl_eval_vector_comparison_on_all_pairs_f(float*,vl_size,
  **     float const*,vl_size,float const*,vl_size,VlFloatVectorComparisonFunction)
  **
@@ -283,12 +312,15 @@ optimal because $2^k > r$. This yields the algorithm:
 
 #undef COMPARISONFUNCTION_TYPE
 #undef COMPARISONFUNCTION3_TYPE
+#undef BLOCKCOMPARISONFUNCTION_TYPE
 #if (FLT == VL_TYPE_FLOAT)
 #  define COMPARISONFUNCTION_TYPE VlFloatVectorComparisonFunction
 #  define COMPARISONFUNCTION3_TYPE VlFloatVector3ComparisonFunction
+#  define BLOCKCOMPARISONFUNCTION_TYPE VlFloatVectorBlockComparisonFunction
 #else
 #  define COMPARISONFUNCTION_TYPE VlDoubleVectorComparisonFunction
 #  define COMPARISONFUNCTION3_TYPE VlDoubleVector3ComparisonFunction
+#  define BLOCKCOMPARISONFUNCTION_TYPE VlDoubleVectorBlockComparisonFunction
 #endif
 
 /* ---------------------------------------------------------------- */
@@ -306,6 +338,19 @@ VL_XCAT(_vl_distance_l2_, SFX)
   return acc ;
 }
 
+VL_EXPORT void
+VL_XCAT(_vl_distance_l2_block_, SFX)
+(vl_size dimension, T * result, T const * const * X, T const * Y, vl_size numDataY)
+{
+  vl_uindex i, j ;
+  for (j = 0 ; j < numDataY ; ++ j) {
+    T const * Yj = Y + j * dimension ;
+    for (i = 0 ; i < VL_VECTOR_COMPARISON_BLOCK_SIZE ; ++ i) {
+      result [i * numDataY + j] = VL_XCAT(_vl_distance_l2_, SFX)(dimension, X[i], Yj) ;
+    }
+  }
+}
+
 VL_EXPORT T
 VL_XCAT(_vl_distance_l1_, SFX)
 (vl_size dimension, T const * X, T const * Y)
@@ -517,6 +562,39 @@ VL_XCAT(vl_get_vector_comparison_function_, SFX)(VlVectorComparisonType type)
 
 /* ---------------------------------------------------------------- */
 
+/* the selection follows vl_get_vector_comparison_function */
+VL_EXPORT BLOCKCOMPARISONFUNCTION_TYPE
+VL_XCAT(vl_get_vector_block_comparison_function_, SFX)(VlVectorComparisonType type)
+{
+  BLOCKCOMPARISONFUNCTION_TYPE function = 0 ;
+  switch (type) {
+    case VlDistanceL2        : function = VL_XCAT(_vl_distance_l2_block_,        SFX) ; break ;
+    default: return NULL ;
+  }
+
+#ifndef VL_DISABLE_SSE2
+  if (vl_cpu_has_sse2() && vl_get_simd_enabled()) {
+    switch (type) {
+      case VlDistanceL2    : function = VL_XCAT(_vl_distance_l2_block_sse2_,   SFX) ; break ;
+      default: break ;
+    }
+  }
+#endif
+
+#ifndef VL_DISABLE_AVX
+  if (vl_cpu_has_avx() && vl_get_simd_enabled()) {
+    switch (type) {
+      case VlDistanceL2    : function = VL_XCAT(_vl_distance_l2_block_avx_,    SFX) ; break ;
+      default: break ;
+    }
+  }
+#endif
+
+  return function ;
+}
+
+/* ---------------------------------------------------------------- */
+
 VL_EXPORT COMPARISONFUNCTION3_TYPE
 VL_XCAT(vl_get_vector_3_comparison_function_, SFX)(VlVectorComparisonType type)
 {
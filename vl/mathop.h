@@ -624,6 +624,19 @@ typedef float (*VlFloatVector3ComparisonFunction)(vl_size dimension, float const
  **/
 typedef double (*VlDoubleVector3ComparisonFunction)(vl_size dimension, double const * X, double const * Y, double const * Z) ;
 
+/** @brief Number of vectors compared at once by a block comparison function */
+#define VL_VECTOR_COMPARISON_BLOCK_SIZE 4
+
+/** @typedef VlFloatVectorBlockComparisonFunction
+ ** @brief Pointer to a function to compare a block of vectors of floats to a sequence of vectors
+ **/
+typedef void (*VlFloatVectorBlockComparisonFunction)(vl_size dimension, float * result, float const * const * X, float const * Y, vl_size numDataY) ;
+
+/** @typedef VlDoubleVectorBlockComparisonFunction
+ ** @brief Pointer to a function to compare a block of vectors of doubles to a sequence of vectors
+ **/
+typedef void (*VlDoubleVectorBlockComparisonFunction)(vl_size dimension, double * result, double const * const * X, double const * Y, vl_size numDataY) ;
+
 /** @brief Vector comparison types */
 enum _VlVectorComparisonType {
   VlDistanceL1,        /**< l1 distance (squared intersection metric) */
@@ -668,6 +681,12 @@ vl_get_vector_comparison_function_f (VlVectorComparisonType type) ;
 VL_EXPORT VlDoubleVectorComparisonFunction
 vl_get_vector_comparison_function_d (VlVectorComparisonType type) ;
 
+VL_EXPORT VlFloatVectorBlockComparisonFunction
+vl_get_vector_block_comparison_function_f (VlVectorComparisonType type) ;
+
+VL_EXPORT VlDoubleVectorBlockComparisonFunction
+vl_get_vector_block_comparison_function_d (VlVectorComparisonType type) ;
+
 VL_EXPORT VlFloatVector3ComparisonFunction
 vl_get_vector_3_comparison_function_f (VlVectorComparisonType type) ;
 
@@ -110,6 +110,68 @@ VL_XCAT(_vl_distance_l2_avx_, SFX)
   return acc ;
 }
 
+VL_EXPORT void
+VL_XCAT(_vl_distance_l2_block_avx_, SFX)
+(vl_size dimension, T * result, T const * const * X, T const * Y, vl_size numDataY)
+{
+  vl_uindex j ;
+  for (j = 0 ; j < numDataY ; ++ j) {
+    /* each accumulator sees the same operations as in
+       _vl_distance_l2_avx, so that the results are identical */
+    T const * X0 = X[0] ;
+    T const * X1 = X[1] ;
+    T const * X2 = X[2] ;
+    T const * X3 = X[3] ;
+    T const * Yj = Y + j * dimension ;
+    T const * Y_end = Yj + dimension ;
+    T const * Y_vec_end = Y_end - VSIZEavx + 1 ;
+    VTYPEavx vacc0 = VSTZavx() ;
+    VTYPEavx vacc1 = VSTZavx() ;
+    VTYPEavx vacc2 = VSTZavx() ;
+    VTYPEavx vacc3 = VSTZavx() ;
+    T acc0, acc1, acc2, acc3 ;
+
+    while (Yj < Y_vec_end) {
+      VTYPEavx b = VLDUavx(Yj) ;
+      VTYPEavx delta0 = VSUBavx(VLDUavx(X0), b) ;
+      VTYPEavx delta1 = VSUBavx(VLDUavx(X1), b) ;
+      VTYPEavx delta2 = VSUBavx(VLDUavx(X2), b) ;
+      VTYPEavx delta3 = VSUBavx(VLDUavx(X3), b) ;
+      vacc0 = VADDavx(vacc0, VMULavx(delta0, delta0)) ;
+      vacc1 = VADDavx(vacc1, VMULavx(delta1, delta1)) ;
+      vacc2 = VADDavx(vacc2, VMULavx(delta2, delta2)) ;
+      vacc3 = VADDavx(vacc3, VMULavx(delta3, delta3)) ;
+      X0 += VSIZEavx ;
+      X1 += VSIZEavx ;
+      X2 += VSIZEavx ;
+      X3 += VSIZEavx ;
+      Yj += VSIZEavx ;
+    }
+
+    acc0 = VL_XCAT(_vl_vhsum_avx_, SFX)(vacc0) ;
+    acc1 = VL_XCAT(_vl_vhsum_avx_, SFX)(vacc1) ;
+    acc2 = VL_XCAT(_vl_vhsum_avx_, SFX)(vacc2) ;
+    acc3 = VL_XCAT(_vl_vhsum_avx_, SFX)(vacc3) ;
+
+    while (Yj < Y_end) {
+      T b = *Yj++ ;
+      T delta0 = *X0++ - b ;
+      T delta1 = *X1++ - b ;
+      T delta2 = *X2++ - b ;
+      T delta3 = *X3++ - b ;
+      acc0 += delta0 * delta0 ;
+      acc1 += delta1 * delta1 ;
+      acc2 += delta2 * delta2 ;
+      acc3 += delta3 * delta3 ;
+    }
+
+    result [0 * numDataY + j] = acc0 ;
+    result [1 * numDataY + j] = acc1 ;
+    result [2 * numDataY + j] = acc2 ;
+    result [3 * numDataY + j] = acc3 ;
+  }
+}
+
 VL_EXPORT T
 VL_XCAT(_vl_distance_mahalanobis_sq_avx_, SFX)
 (vl_size dimension, T const * X, T const * MU, T const * S)
@@ -26,6 +26,7 @@ the terms of the BSD license (see the COPYING file).
 #define FLT VL_TYPE_FLOAT
 #define VL_MATHOP_AVX_H_INSTANTIATING
 #include "mathop_avx.h"
+#undef FLT
 
 /* VL_MATHOP_AVX_H */
 #endif
@@ -46,6 +47,10 @@ VL_EXPORT T
 VL_XCAT(_vl_distance_l2_avx_, SFX)
 (vl_size dimension, T const * X, T const * Y);
 
+VL_EXPORT void
+VL_XCAT(_vl_distance_l2_block_avx_, SFX)
+(vl_size dimension, T * result, T const * const * X, T const * Y, vl_size numDataY);
+
 VL_EXPORT void
 VL_XCAT(_vl_weighted_sigma_avx_, SFX)
 (vl_size dimension, T * S, T const * X, T const * Y, T const W);
@@ -26,6 +26,173 @@ the terms of the BSD license (see the COPYING file).
 #define VL_MATHOP_SSE2_INSTANTIATING
 #include "mathop_sse2.c"
 
+#ifndef VL_DISABLE_SSE2
+#include <emmintrin.h>
+#include <math.h>
+#include <string.h>
+#include "mathop.h"
+
+/** @internal @brief Squared L2 distance of two byte vectors
+ ** @param dimension number of components.
+ ** @param X first vector.
+ ** @param Y second vector.
+ ** @return distance (exact).
+ **
+ ** The absolute differences are computed with saturated
+ ** subtractions, widened to 16 bits, and squared and summed in
+ ** pairs by @c pmaddwd. The 32-bit accumulators cannot overflow for
+ ** vectors with less than 33025 components.
+ **
+ ** The byte multiply-add @c pmaddubsw cannot be used instead: it
+ ** treats one operand as signed and saturates the sums of products
+ ** to 16 bits, while a squared difference can reach 65025.
+ **/
+
+vl_uint32
+_vl_distance_l2_sse2_u8 (vl_size dimension, vl_uint8 const * X, vl_uint8 const * Y)
+{
+  vl_uint8 const * X_end = X + dimension ;
+  vl_uint8 const * X_vec_end = X + (dimension & ~ (vl_size) 15) ;
+  __m128i zero = _mm_setzero_si128 () ;
+  __m128i acc = zero ;
+  vl_uint32 dist ;
+
+  while (X < X_vec_end) {
+    __m128i a = _mm_loadu_si128 ((__m128i const *) X) ;
+    __m128i b = _mm_loadu_si128 ((__m128i const *) Y) ;
+    __m128i delta = _mm_or_si128 (_mm_subs_epu8 (a, b), _mm_subs_epu8 (b, a)) ;
+    __m128i lo = _mm_unpacklo_epi8 (delta, zero) ;
+    __m128i hi = _mm_unpackhi_epi8 (delta, zero) ;
+    acc = _mm_add_epi32 (acc, _mm_madd_epi16 (lo, lo)) ;
+    acc = _mm_add_epi32 (acc, _mm_madd_epi16 (hi, hi)) ;
+    X += 16 ;
+    Y += 16 ;
+  }
+  acc = _mm_add_epi32 (acc, _mm_shuffle_epi32 (acc, _MM_SHUFFLE(1, 0, 3, 2))) ;
+  acc = _mm_add_epi32 (acc, _mm_shuffle_epi32 (acc, _MM_SHUFFLE(2, 3, 0, 1))) ;
+  dist = (vl_uint32) _mm_cvtsi128_si32 (acc) ;
+
+  while (X < X_end) {
+    vl_int32 delta = (vl_int32) *X++ - (vl_int32) *Y++ ;
+    dist += (vl_uint32) (delta * delta) ;
+  }
+  return dist ;
+}
+
+/* Polynomial approximation of exp (Cephes expf). The argument is
+   split as x = n log(2) + r with |r| <= log(2)/2, exp(r) is
+   approximated by a degree 7 polynomial and 2^n is assembled in the
+   exponent bits. The relative error is below 2e-7 for arguments in
+   the range [-87.3, 88.3]. Smaller arguments, including -inf and NaN,
+   return zero. */
+
+static __m128
+_vl_exp_sse2_ps (__m128 x)
+{
+  __m128 minX = _mm_set1_ps (-87.3365448f) ;
+  __m128 valid = _mm_cmpge_ps (x, minX) ;
+  __m128 fn, r, r2, p, y ;
+  __m128i n ;
+
+  x = _mm_min_ps (_mm_max_ps (x, minX), _mm_set1_ps (88.3762626f)) ;
+  n = _mm_cvtps_epi32 (_mm_mul_ps (x, _mm_set1_ps (1.44269504088896341f))) ;
+  fn = _mm_cvtepi32_ps (n) ;
+  r = _mm_sub_ps (x, _mm_mul_ps (fn, _mm_set1_ps (0.693359375f))) ;
+  r = _mm_sub_ps (r, _mm_mul_ps (fn, _mm_set1_ps (-2.12194440e-4f))) ;
+  r2 = _mm_mul_ps (r, r) ;
+
+  p = _mm_set1_ps (1.9875691500e-4f) ;
+  p = _mm_add_ps (_mm_mul_ps (p, r), _mm_set1_ps (1.3981999507e-3f)) ;
+  p = _mm_add_ps (_mm_mul_ps (p, r), _mm_set1_ps (8.3334519073e-3f)) ;
+  p = _mm_add_ps (_mm_mul_ps (p, r), _mm_set1_ps (4.1665795894e-2f)) ;
+  p = _mm_add_ps (_mm_mul_ps (p, r), _mm_set1_ps (1.6666665459e-1f)) ;
+  p = _mm_add_ps (_mm_mul_ps (p, r), _mm_set1_ps (5.0000001201e-1f)) ;
+  y = _mm_add_ps (_mm_add_ps (_mm_mul_ps (p, r2), r), _mm_set1_ps (1.0f)) ;
+
+  y = _mm_mul_ps (y, _mm_castsi128_ps
+                  (_mm_slli_epi32 (_mm_add_epi32 (n, _mm_set1_epi32 (127)), 23))) ;
+  return _mm_and_ps (y, valid) ;
+}
+
+/** @internal @brief Normalize log-probabilities
+ ** @param numElements number of elements.
+ ** @param Y normalized probabilities (output, may be @c NULL).
+ ** @param X log-probabilities (up to a constant).
+ ** @return logarithm of the sum of the exponentials of @a X.
+ **
+ ** The function computes @f$ z = \log \sum_i \exp x_i @f$ as
+ ** @f$ m + \log \sum_i \exp (x_i - m) @f$, where @f$ m @f$ is the
+ ** maximum of @a X, and, if @a Y is not @c NULL, sets @f$ y_i = \exp
+ ** (x_i - z) @f$. The exponentials are evaluated four at a time by a
+ ** polynomial approximation with relative error below 2e-7. @a Y may
+ ** coincide with @a X. If all the elements of @a X are @c -inf, @a Y
+ ** is set to zero and the function returns @c -inf.
+ **/
+
+double
+_vl_log_sum_exp_sse2_f (vl_size numElements, float * Y, float const * X)
+{
+  vl_size numBlocks = numElements / 4 ;
+  vl_size numRemaining = numElements - 4 * numBlocks ;
+  __m128 vmax = _mm_set1_ps ((float) - VL_INFINITY_D) ;
+  __m128 vsum = _mm_setzero_ps () ;
+  __m128 m ;
+  float tail [4] ;
+  float maximum, sum ;
+  vl_uindex i ;
+
+  for (i = 0 ; i < numBlocks ; ++i) {
+    vmax = _mm_max_ps (vmax, _mm_loadu_ps (X + 4 * i)) ;
+  }
+  vmax = _mm_max_ps (vmax, _mm_shuffle_ps (vmax, vmax, _MM_SHUFFLE(1, 0, 3, 2))) ;
+  vmax = _mm_max_ps (vmax, _mm_shuffle_ps (vmax, vmax, _MM_SHUFFLE(2, 3, 0, 1))) ;
+  maximum = _mm_cvtss_f32 (vmax) ;
+  for (i = 4 * numBlocks ; i < numElements ; ++i) {
+    maximum = VL_MAX(maximum, X[i]) ;
+  }
+
+  if (maximum == (float) - VL_INFINITY_D) {
+    if (Y) memset (Y, 0, sizeof(float) * numElements) ;
+    return - VL_INFINITY_D ;
+  }
+
+  /* the remainder is padded with -inf, whose exponential is zero */
+  m = _mm_set1_ps (maximum) ;
+  for (i = 0 ; i < 4 ; ++i) {
+    tail[i] = (i < numRemaining) ? X[4 * numBlocks + i] : (float) - VL_INFINITY_D ;
+  }
+  for (i = 0 ; i <= numBlocks ; ++i) {
+    __m128 x = (i < numBlocks) ? _mm_loadu_ps (X + 4 * i) : _mm_loadu_ps (tail) ;
+    __m128 e = _vl_exp_sse2_ps (_mm_sub_ps (x, m)) ;
+    vsum = _mm_add_ps (vsum, e) ;
+    if (Y) {
+      if (i < numBlocks) {
+        _mm_storeu_ps (Y + 4 * i, e) ;
+      } else {
+        _mm_storeu_ps (tail, e) ;
+        memcpy (Y + 4 * i, tail, sizeof(float) * numRemaining) ;
+      }
+    }
+  }
+  vsum = _mm_add_ps (vsum, _mm_shuffle_ps (vsum, vsum, _MM_SHUFFLE(1, 0, 3, 2))) ;
+  vsum = _mm_add_ps (vsum, _mm_shuffle_ps (vsum, vsum, _MM_SHUFFLE(2, 3, 0, 1))) ;
+  sum = _mm_cvtss_f32 (vsum) ;
+
+  if (Y) {
+    __m128 scale = _mm_set1_ps (1.0f / sum) ;
+    for (i = 0 ; i < numBlocks ; ++i) {
+      _mm_storeu_ps (Y + 4 * i, _mm_mul_ps (_mm_loadu_ps (Y + 4 * i), scale)) ;
+    }
+    for (i = 4 * numBlocks ; i < numElements ; ++i) {
+      Y[i] *= 1.0f / sum ;
+    }
+  }
+  return maximum + log (sum) ;
+}
+
+/* VL_DISABLE_SSE2 */
+#endif
+
 /* ---------------------------------------------------------------- */
 /* VL_MATHOP_SSE2_INSTANTIATING */
 #else
@@ -158,6 +325,68 @@ VL_XCAT(_vl_distance_l2_sse2_, SFX)
   return acc ;
 }
 
+VL_EXPORT void
+VL_XCAT(_vl_distance_l2_block_sse2_, SFX)
+(vl_size dimension, T * result, T const * const * X, T const * Y, vl_size numDataY)
+{
+  vl_uindex j ;
+  for (j = 0 ; j < numDataY ; ++ j) {
+    /* each accumulator sees the same operations as in
+       _vl_distance_l2_sse2, so that the results are identical */
+    T const * X0 = X[0] ;
+    T const * X1 = X[1] ;
+    T const * X2 = X[2] ;
+    T const * X3 = X[3] ;
+    T const * Yj = Y + j * dimension ;
+    T const * Y_end = Yj + dimension ;
+    T const * Y_vec_end = Y_end - VSIZE + 1 ;
+    VTYPE vacc0 = VSTZ() ;
+    VTYPE vacc1 = VSTZ() ;
+    VTYPE vacc2 = VSTZ() ;
+    VTYPE vacc3 = VSTZ() ;
+    T acc0, acc1, acc2, acc3 ;
+
+    while (Yj < Y_vec_end) {
+      VTYPE b = VLDU(Yj) ;
+      VTYPE delta0 = VSUB(VLDU(X0), b) ;
+      VTYPE delta1 = VSUB(VLDU(X1), b) ;
+      VTYPE delta2 = VSUB(VLDU(X2), b) ;
+      VTYPE delta3 = VSUB(VLDU(X3), b) ;
+      vacc0 = VADD(vacc0, VMUL(delta0, delta0)) ;
+      vacc1 = VADD(vacc1, VMUL(delta1, delta1)) ;
+      vacc2 = VADD(vacc2, VMUL(delta2, delta2)) ;
+      vacc3 = VADD(vacc3, VMUL(delta3, delta3)) ;
+      X0 += VSIZE ;
+      X1 += VSIZE ;
+      X2 += VSIZE ;
+      X3 += VSIZE ;
+      Yj += VSIZE ;
+    }
+
+    acc0 = VL_XCAT(_vl_vhsum_sse2_, SFX)(vacc0) ;
+    acc1 = VL_XCAT(_vl_vhsum_sse2_, SFX)(vacc1) ;
+    acc2 = VL_XCAT(_vl_vhsum_sse2_, SFX)(vacc2) ;
+    acc3 = VL_XCAT(_vl_vhsum_sse2_, SFX)(vacc3) ;
+
+    while (Yj < Y_end) {
+      T b = *Yj++ ;
+      T delta0 = *X0++ - b ;
+      T delta1 = *X1++ - b ;
+      T delta2 = *X2++ - b ;
+      T delta3 = *X3++ - b ;
+      acc0 += delta0 * delta0 ;
+      acc1 += delta1 * delta1 ;
+      acc2 += delta2 * delta2 ;
+      acc3 += delta3 * delta3 ;
+    }
+
+    result [0 * numDataY + j] = acc0 ;
+    result [1 * numDataY + j] = acc1 ;
+    result [2 * numDataY + j] = acc2 ;
+    result [3 * numDataY + j] = acc3 ;
+  }
+}
+
 VL_EXPORT T
 VL_XCAT(_vl_distance_mahalanobis_sq_sse2_, SFX)
 (vl_size dimension, T const * X, T const * MU, T const * S)
@@ -558,6 +787,86 @@ VL_XCAT(_vl_weighted_mean_sse2_, SFX)
   }
 }
 
+VL_EXPORT void
+VL_XCAT(_vl_weighted_whitened_moments_sse2_, SFX)
+(vl_size dimension, T * U, T * V, T const * X, T const * MU, T const * S, T const W)
+{
+  T const * X_end = X + dimension ;
+  T const * X_vec_end = X_end - VSIZE + 1 ;
+
+  vl_bool dataAligned = VALIGNED(X) & VALIGNED(MU) & VALIGNED(S) & VALIGNED(U) & VALIGNED(V) ;
+  VTYPE w = VLD1 (&W) ;
+
+  if (dataAligned) {
+    while (X < X_vec_end) {
+      VTYPE delta = VMUL(VSUB(*(VTYPE*)X, *(VTYPE*)MU), *(VTYPE*)S) ;
+      VTYPE deltaw = VMUL(delta, w) ;
+
+      *(VTYPE *)U = VADD(*(VTYPE*)U, deltaw) ;
+      *(VTYPE *)V = VADD(*(VTYPE*)V, VMUL(deltaw, delta)) ;
+
+      X += VSIZE ;
+      MU += VSIZE ;
+      S += VSIZE ;
+      U += VSIZE ;
+      V += VSIZE ;
+    }
+  } else {
+    while (X < X_vec_end) {
+      VTYPE delta = VMUL(VSUB(VLDU(X), VLDU(MU)), VLDU(S)) ;
+      VTYPE deltaw = VMUL(delta, w) ;
+
+      VST2U(U, VADD(VLDU(U), deltaw)) ;
+      VST2U(V, VADD(VLDU(V), VMUL(deltaw, delta))) ;
+
+      X += VSIZE ;
+      MU += VSIZE ;
+      S += VSIZE ;
+      U += VSIZE ;
+      V += VSIZE ;
+    }
+  }
+
+  while (X < X_end) {
+    T delta = (*X++ - *MU++) * (*S++) ;
+    T deltaw = delta * W ;
+    *U++ += deltaw ;
+    *V++ += deltaw * delta ;
+  }
+}
+
+VL_EXPORT void
+VL_XCAT(_vl_inner_products_4x8_sse2_, SFX)
+(vl_size dimension, T * acc, T const * const * X, T const * C)
+{
+  /* C stores 8 vectors interleaved (C[d*8 + c] is the d-th component
+     of the c-th vector); acc receives the 4 x 8 inner products
+     row-major. The accumulators are kept in registers, processing
+     2*VSIZE columns at a time. */
+  vl_uindex c, d ;
+  for (c = 0 ; c < 8 ; c += 2 * VSIZE) {
+    VTYPE a00 = VSTZ(), a01 = VSTZ() ;
+    VTYPE a10 = VSTZ(), a11 = VSTZ() ;
+    VTYPE a20 = VSTZ(), a21 = VSTZ() ;
+    VTYPE a30 = VSTZ(), a31 = VSTZ() ;
+    T const * pc = C + c ;
+    for (d = 0 ; d < dimension ; ++d) {
+      VTYPE c0 = VLDU(pc) ;
+      VTYPE c1 = VLDU(pc + VSIZE) ;
+      VTYPE x ;
+      x = VLD1(X[0] + d) ; a00 = VADD(a00, VMUL(x, c0)) ; a01 = VADD(a01, VMUL(x, c1)) ;
+      x = VLD1(X[1] + d) ; a10 = VADD(a10, VMUL(x, c0)) ; a11 = VADD(a11, VMUL(x, c1)) ;
+      x = VLD1(X[2] + d) ; a20 = VADD(a20, VMUL(x, c0)) ; a21 = VADD(a21, VMUL(x, c1)) ;
+      x = VLD1(X[3] + d) ; a30 = VADD(a30, VMUL(x, c0)) ; a31 = VADD(a31, VMUL(x, c1)) ;
+      pc += 8 ;
+    }
+    VST2U(acc +  0 + c, a00) ; VST2U(acc +  0 + c + VSIZE, a01) ;
+    VST2U(acc +  8 + c, a10) ; VST2U(acc +  8 + c + VSIZE, a11) ;
+    VST2U(acc + 16 + c, a20) ; VST2U(acc + 16 + c + VSIZE, a21) ;
+    VST2U(acc + 24 + c, a30) ; VST2U(acc + 24 + c + VSIZE, a31) ;
+  }
+}
+
 /* VL_DISABLE_SSE2 */
 #endif
 #undef VL_MATHOP_SSE2_INSTANTIATING
@@ -26,6 +26,15 @@ the terms of the BSD license (see the COPYING file).
 #define FLT VL_TYPE_FLOAT
 #define VL_MATHOP_SSE2_H_INSTANTIATING
 #include "mathop_sse2.h"
+#undef FLT
+
+#ifndef VL_DISABLE_SSE2
+VL_EXPORT vl_uint32
+_vl_distance_l2_sse2_u8 (vl_size dimension, vl_uint8 const * X, vl_uint8 const * Y) ;
+
+VL_EXPORT double
+_vl_log_sum_exp_sse2_f (vl_size numElements, float * Y, float const * X) ;
+#endif
 
 /* VL_MATHOP_SSE2_H */
 #endif
@@ -47,6 +56,10 @@ VL_EXPORT T
 VL_XCAT(_vl_distance_l2_sse2_, SFX)
 (vl_size dimension, T const * X, T const * Y) ;
 
+VL_EXPORT void
+VL_XCAT(_vl_distance_l2_block_sse2_, SFX)
+(vl_size dimension, T * result, T const * const * X, T const * Y, vl_size numDataY) ;
+
 VL_EXPORT T
 VL_XCAT(_vl_distance_l1_sse2_, SFX)
 (vl_size dimension, T const * X, T const * Y) ;
@@ -79,6 +92,14 @@ VL_EXPORT void
 VL_XCAT(_vl_weighted_mean_sse2_, SFX)
 (vl_size dimension, T * MU, T const * X, T const W);
 
+VL_EXPORT void
+VL_XCAT(_vl_weighted_whitened_moments_sse2_, SFX)
+(vl_size dimension, T * U, T * V, T const * X, T const * MU, T const * S, T const W);
+
+VL_EXPORT void
+VL_XCAT(_vl_inner_products_4x8_sse2_, SFX)
+(vl_size dimension, T * acc, T const * const * X, T const * C);
+
 /* ! VL_DISABLE_SSE2 */
 #endif
 #undef VL_MATHOP_SSE2_INSTANTIATING
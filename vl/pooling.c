@@ -0,0 +1,217 @@
+/** @file pooling.c
+ ** @brief Region pooling - Definition
+ ** @author agent
+ **/
+
+/*
+Copyright (C) 2026 agent.
+All rights reserved.
+
+This file is part of the VLFeat library and is made available under
+the terms of the BSD license (see the COPYING file).
+*/
+
+/**
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+@page pooling Region pooling
+@author agent
+@tableofcontents
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+
+@ref pooling.h supports pooling local descriptors into several image
+regions at once, as done by spatial pyramids or when scoring object
+proposals. It is used by the @ref fisher and @ref vlad encoders
+(::vl_fisher_encoder_encode_regions, ::vl_vlad_encoder_encode_regions)
+to compute the assignments of each descriptor only once, however
+many regions contain it.
+
+A region is an axis-aligned box $[x_0, x_1) \times [y_0, y_1)$,
+stored as the four numbers $(x_0, y_0, x_1, y_1)$; a descriptor
+belongs to it if its position is inside the box. Regions may overlap
+arbitrarily.
+
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+@section pooling-grid Pooling grid
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+
+The distinct horizontal and vertical coordinates of the region
+boundaries partition the plane into a grid of cells. Each region is
+then exactly the union of a rectangular block of cells, and all the
+descriptors in a cell belong to the same regions. ::vl_pooling_grid_new
+computes this grid and sorts the descriptors by cell, so that the
+descriptors of a region are enumerated by visiting its cells.
+
+Two consecutive boundaries with no descriptor coordinate between them
+would delimit empty cells, so they are merged. Hence the grid has at
+most one more column (row) than the distinct horizontal (vertical)
+coordinates of the descriptors, even for thousands of arbitrary boxes,
+and a region may be described by a smaller block of cells than its
+box. For instance, descriptors extracted on a lattice result in at
+most one cell per lattice node.
+
+When the cells are few compared to the regions, as for object
+proposals snapped to a coarse lattice, the encoders sum the
+statistics of each cell once and compute the statistics of every
+region from an integral image of the cells, in time independent of
+the region size.
+**/
+
+#include "pooling.h"
+#include <string.h>
+
+#define VL_QSORT_type    double
+#define VL_QSORT_prefix  _vl_pooling_qsort
+#include "qsort-def.h"
+
+/* Sort the values and remove duplicates; return their number. */
+static vl_size
+_vl_pooling_unique (double * values, vl_size numValues)
+{
+  vl_uindex i, n = 0 ;
+  if (numValues == 0) return 0 ;
+  _vl_pooling_qsort_sort (values, numValues) ;
+  for (i = 1 ; i < numValues ; ++i) {
+    if (values[i] != values[n]) values[++n] = values[i] ;
+  }
+  return n + 1 ;
+}
+
+/* Merge the consecutive boundaries with no coordinate between them,
+   i.e. the ones with the same number of smaller coordinates; return
+   the number of remaining boundaries. Both arrays are sorted. */
+static vl_size
+_vl_pooling_merge (double * boundaries, vl_size numBoundaries,
+                   double const * coords, vl_size numCoords)
+{
+  vl_uindex i, n = 0, rank = 0, lastRank = 0 ;
+  for (i = 0 ; i < numBoundaries ; ++i) {
+    while (rank < numCoords && coords[rank] < boundaries[i]) ++ rank ;
+    if (i == 0 || rank != lastRank) boundaries[n++] = boundaries[i] ;
+    lastRank = rank ;
+  }
+  return n ;
+}
+
+/* Index of the first boundary larger than v. */
+static vl_uindex
+_vl_pooling_upper_bound (double const * boundaries, vl_size numBoundaries, double v)
+{
+  vl_uindex lo = 0, hi = numBoundaries ;
+  while (lo < hi) {
+    vl_uindex mid = (lo + hi) / 2 ;
+    if (boundaries[mid] > v) { hi = mid ; } else { lo = mid + 1 ; }
+  }
+  return lo ;
+}
+
+/* Index of the cell [b[j], b[j+1]) containing v, or -1. */
+static vl_index
+_vl_pooling_find (double const * boundaries, vl_size numBoundaries, double v)
+{
+  vl_index j = (vl_index) _vl_pooling_upper_bound (boundaries, numBoundaries, v) - 1 ;
+  return (j >= 0 && j + 1 < (signed)numBoundaries) ? j : -1 ;
+}
+
+/** @brief Create a new pooling grid
+ ** @param positions vector positions.
+ ** @param numData number of vectors.
+ ** @param regions pooling regions.
+ ** @param numRegions number of regions.
+ ** @return new grid.
+ **
+ ** @a positions is a 2 x @a numData matrix of (x,y) coordinates and
+ ** @a regions a 4 x @a numRegions matrix of boxes
+ ** $(x_0,y_0,x_1,y_1)$, both in column-major order (@ref
+ ** pooling-grid). Vectors outside all the regions are not listed in
+ ** the grid. Boundaries with no vector coordinate between them are
+ ** merged, so that there are at most as many cells as positions
+ ** on the lattice spanned by the vector coordinates, plus one per
+ ** row and column.
+ **/
+
+VlPoolingGrid *
+vl_pooling_grid_new (double const * positions,
+                     vl_size numData,
+                     double const * regions,
+                     vl_size numRegions)
+{
+  VlPoolingGrid * self = vl_calloc(1, sizeof(VlPoolingGrid)) ;
+  vl_size numBoundariesX, numBoundariesY, numCells ;
+  vl_index * cells = vl_malloc(sizeof(vl_index) * VL_MAX(numData, 1)) ;
+  double * coords = vl_malloc(sizeof(double) * VL_MAX(numData, 1)) ;
+  vl_uindex i, r ;
+
+  self->numData = numData ;
+  self->numRegions = numRegions ;
+  self->boundariesX = vl_malloc(sizeof(double) * VL_MAX(2 * numRegions, 1)) ;
+  self->boundariesY = vl_malloc(sizeof(double) * VL_MAX(2 * numRegions, 1)) ;
+  for (r = 0 ; r < numRegions ; ++r) {
+    self->boundariesX[2*r] = regions[4*r] ;
+    self->boundariesX[2*r+1] = regions[4*r+2] ;
+    self->boundariesY[2*r] = regions[4*r+1] ;
+    self->boundariesY[2*r+1] = regions[4*r+3] ;
+  }
+  numBoundariesX = _vl_pooling_unique (self->boundariesX, 2 * numRegions) ;
+  numBoundariesY = _vl_pooling_unique (self->boundariesY, 2 * numRegions) ;
+  for (i = 0 ; i < numData ; ++i) coords[i] = positions[2*i] ;
+  if (numData > 0) _vl_pooling_qsort_sort (coords, numData) ;
+  numBoundariesX = _vl_pooling_merge (self->boundariesX, numBoundariesX, coords, numData) ;
+  for (i = 0 ; i < numData ; ++i) coords[i] = positions[2*i+1] ;
+  if (numData > 0) _vl_pooling_qsort_sort (coords, numData) ;
+  numBoundariesY = _vl_pooling_merge (self->boundariesY, numBoundariesY, coords, numData) ;
+  vl_free(coords) ;
+  self->numCellsX = (numBoundariesX > 1) ? numBoundariesX - 1 : 0 ;
+  self->numCellsY = (numBoundariesY > 1) ? numBoundariesY - 1 : 0 ;
+  numCells = self->numCellsX * self->numCellsY ;
+
+  /* the block of cells of each region */
+  self->regionCells = vl_malloc(sizeof(vl_uindex) * 4 * VL_MAX(numRegions, 1)) ;
+  for (r = 0 ; r < numRegions ; ++r) {
+    vl_uindex * block = self->regionCells + 4 * r ;
+    double const * box = regions + 4 * r ;
+    /* a box coordinate is a boundary, or was merged into the
+       previous remaining one */
+    block[0] = _vl_pooling_upper_bound (self->boundariesX, numBoundariesX, box[0]) - 1 ;
+    block[1] = _vl_pooling_upper_bound (self->boundariesY, numBoundariesY, box[1]) - 1 ;
+    block[2] = _vl_pooling_upper_bound (self->boundariesX, numBoundariesX, box[2]) - 1 ;
+    block[3] = _vl_pooling_upper_bound (self->boundariesY, numBoundariesY, box[3]) - 1 ;
+    if (box[2] <= box[0] || box[3] <= box[1]) {
+      block[2] = block[0] ;
+      block[3] = block[1] ;
+    }
+  }
+
+  /* sort the vectors by cell with a counting sort */
+  self->cellOffsets = vl_calloc(numCells + 2, sizeof(vl_uindex)) ;
+  for (i = 0 ; i < numData ; ++i) {
+    vl_index cx = _vl_pooling_find (self->boundariesX, numBoundariesX, positions[2*i]) ;
+    vl_index cy = _vl_pooling_find (self->boundariesY, numBoundariesY, positions[2*i+1]) ;
+    cells[i] = (cx < 0 || cy < 0) ? -1 : cy * (vl_index)self->numCellsX + cx ;
+    if (cells[i] >= 0) self->cellOffsets[cells[i] + 2] ++ ;
+  }
+  for (i = 2 ; i < numCells + 2 ; ++i) {
+    self->cellOffsets[i] += self->cellOffsets[i - 1] ;
+  }
+  self->order = vl_malloc(sizeof(vl_uindex) * VL_MAX(self->cellOffsets[numCells + 1], 1)) ;
+  for (i = 0 ; i < numData ; ++i) {
+    if (cells[i] >= 0) self->order[self->cellOffsets[cells[i] + 1] ++] = i ;
+  }
+
+  vl_free(cells) ;
+  return self ;
+}
+
+/** @brief Delete a pooling grid
+ ** @param self grid.
+ **/
+
+void
+vl_pooling_grid_delete (VlPoolingGrid * self)
+{
+  vl_free(self->boundariesX) ;
+  vl_free(self->boundariesY) ;
+  vl_free(self->cellOffsets) ;
+  vl_free(self->order) ;
+  vl_free(self->regionCells) ;
+  vl_free(self) ;
+}
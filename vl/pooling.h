@@ -0,0 +1,101 @@
+/** @file pooling.h
+ ** @brief Region pooling (@ref pooling)
+ ** @author agent
+ **/
+
+/*
+Copyright (C) 2026 agent.
+All rights reserved.
+
+This file is part of the VLFeat library and is made available under
+the terms of the BSD license (see the COPYING file).
+*/
+
+#ifndef VL_POOLING_H
+#define VL_POOLING_H
+
+#include "generic.h"
+
+/** ------------------------------------------------------------------
+ ** @brief Grid of cells induced by a set of pooling regions
+ **/
+
+typedef struct _VlPoolingGrid
+{
+  vl_size numData ;                  /**< Number of pooled vectors. */
+  vl_size numRegions ;               /**< Number of pooling regions. */
+  vl_size numCellsX ;                /**< Number of cell columns. */
+  vl_size numCellsY ;                /**< Number of cell rows. */
+  double * boundariesX ;             /**< Column boundaries (@c numCellsX + 1). */
+  double * boundariesY ;             /**< Row boundaries (@c numCellsY + 1). */
+  vl_uindex * cellOffsets ;          /**< Offset of the first vector of each cell in @c order. */
+  vl_uindex * order ;                /**< Indexes of the vectors inside the grid, sorted by cell. */
+  vl_uindex * regionCells ;          /**< Cell range of each region (4 x @c numRegions). */
+} VlPoolingGrid ;
+
+/** @name Create and destroy
+ ** @{
+ **/
+VL_EXPORT VlPoolingGrid * vl_pooling_grid_new (double const * positions,
+                                               vl_size numData,
+                                               double const * regions,
+                                               vl_size numRegions) ;
+VL_EXPORT void vl_pooling_grid_delete (VlPoolingGrid * self) ;
+/** @} */
+
+/** @name Retrieve data
+ ** @{
+ **/
+VL_INLINE vl_size vl_pooling_grid_get_num_cells (VlPoolingGrid const * self) ;
+VL_INLINE vl_uindex vl_pooling_grid_get_cell_begin (VlPoolingGrid const * self,
+                                                    vl_uindex cx, vl_uindex cy) ;
+VL_INLINE vl_uindex vl_pooling_grid_get_cell_end (VlPoolingGrid const * self,
+                                                  vl_uindex cx, vl_uindex cy) ;
+/** @} */
+
+/* ---------------------------------------------------------------- */
+/*                                              Inline functions    */
+/* ---------------------------------------------------------------- */
+
+/** ------------------------------------------------------------------
+ ** @brief Get the number of cells
+ ** @param self grid.
+ ** @return number of cells.
+ **/
+
+VL_INLINE vl_size
+vl_pooling_grid_get_num_cells (VlPoolingGrid const * self)
+{
+  return self->numCellsX * self->numCellsY ;
+}
+
+/** @brief Get the first vector of a cell
+ ** @param self grid.
+ ** @param cx cell column.
+ ** @param cy cell row.
+ ** @return offset in @c self->order of the first vector of the cell.
+ **/
+
+VL_INLINE vl_uindex
+vl_pooling_grid_get_cell_begin (VlPoolingGrid const * self,
+                                vl_uindex cx, vl_uindex cy)
+{
+  return self->cellOffsets[cy * self->numCellsX + cx] ;
+}
+
+/** @brief Get the end of the vectors of a cell
+ ** @param self grid.
+ ** @param cx cell column.
+ ** @param cy cell row.
+ ** @return offset in @c self->order one past the last vector of the cell.
+ **/
+
+VL_INLINE vl_uindex
+vl_pooling_grid_get_cell_end (VlPoolingGrid const * self,
+                              vl_uindex cx, vl_uindex cy)
+{
+  return self->cellOffsets[cy * self->numCellsX + cx + 1] ;
+}
+
+/* VL_POOLING_H */
+#endif
@@ -0,0 +1,1232 @@
+/** @file pq.c
+ ** @brief Product quantization - Declaration
+ ** @author agent
+ **/
+
+/*
+Copyright (C) 2026 agent.
+All rights reserved.
+
+This file is part of the VLFeat library and is made available under
+the terms of the BSD license (see the COPYING file).
+*/
+
+/**
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+@page pq Product quantization
+@author agent
+@tableofcontents
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+
+@ref pq.h implements *product quantization* (PQ)
+@cite{jegou11product}, a vector compression scheme that supports
+approximate nearest neighbor search directly on the compressed
+vectors. Compared to @ref kdtree, which requires storing the data in
+full, PQ encodes each vector in a few bytes and therefore scales to
+very large collections of descriptors.
+
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+@section pq-starting Getting started
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+
+A ::VlProductQuantizer is created by ::vl_pq_new, specifying the data
+type, the dimension of the data, the number $M$ of sub-quantizers
+(which must divide the dimension), and the number of centers of each
+sub-quantizer (at most 256). The quantizer is then learned from
+training data by ::vl_pq_train:
+
+@code
+VlProductQuantizer * pq = vl_pq_new (VL_TYPE_FLOAT, dimension, 8, 256) ;
+vl_pq_train (pq, data, numData) ;
+@endcode
+
+Vectors are encoded into $M$ bytes each by ::vl_pq_encode and
+approximately reconstructed by ::vl_pq_decode. ::vl_pq_search returns
+the approximate nearest neighbors of a set of queries among a set of
+codes:
+
+@code
+vl_uint8 * codes = vl_malloc (numData * 8) ;
+vl_pq_encode (pq, codes, data, numData) ;
+vl_pq_search (pq, indexes, numNeighbors, numQueries, distances, queries,
+              codes, numData) ;
+@endcode
+
+For large collections, exhaustive scanning of the codes can be
+avoided by using the inverted file ::VlIVFPQ (@ref pq-ivf).
+
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+@section pq-fundamentals Product quantization
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+
+A vector $\bx \in \real^d$ is split into $M$ sub-vectors
+$\bx^{(1)},\dots,\bx^{(M)}$ of dimension $d/M$. Each sub-vector is
+quantized independently by a sub-quantizer $q_m$ learned by @ref
+kmeans on the corresponding sub-vectors of the training data. The
+code of $\bx$ is the tuple of the $M$ center indexes and, for 256
+centers, takes $M$ bytes.
+
+The squared Euclidean distance between a query $\by$ and an encoded
+vector $\bx$ is approximated by the *asymmetric distance*
+\[
+ \|\by - q(\bx)\|^2 = \sum_{m=1}^M \|\by^{(m)} - q_m(\bx^{(m)})\|^2
+\]
+where the query is not quantized. Before scanning the codes, the
+$M \times 256$ squared distances between the query sub-vectors and
+the sub-quantizer centers are stored in a lookup table
+(::vl_pq_compute_distance_table), so that the distance to each code
+requires only $M$ table lookups and additions.
+
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+@section pq-ivf Inverted file
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+
+::VlIVFPQ combines a coarse @ref kmeans quantizer with a product
+quantizer (IVFADC in @cite{jegou11product}). Each vector is assigned
+to the closest coarse center and the *residual* from this center is
+encoded with the product quantizer and stored in the inverted list of
+the center. A query visits only the ::vl_ivfpq_get_num_probes lists
+whose centers are closest to it, computing a lookup table for its
+residual with respect to each of them.
+
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+@section pq-fast-scan Fast scan
+<!-- ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~  -->
+
+Scanning the codes is limited by the table lookups, which are
+scattered loads from memory. If the sub-quantizers have at most 16
+centers, the table of each sub-quantizer fits in a SIMD register and
+the lookups of 16 codes can be done at once by a byte shuffle
+@cite{andre15cache}. To do so, the table is quantized to 8 bits, with
+each entry rounded down, and the codes are stored in blocks of 16,
+the @c m-th bytes of the 16 codes of a block being contiguous. The
+sums of the quantized entries are lower bounds of the distances, and
+only the codes whose bound is below the distance of the current
+farthest neighbor are scored exactly. Hence the results are the same
+as for the generic scan.
+
+The fast scan is used by ::vl_pq_search_blocked, which searches
+codes copied once to the blocked layout by ::vl_pq_block_codes, and
+by ::vl_ivfpq_search, whose inverted lists are stored in the blocked
+layout. It requires AVX support (see @ref host-arch); otherwise
+the generic scan is used.
+**/
+
+#include "pq.h"
+#include "mathop.h"
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+#ifndef VL_DISABLE_AVX
+#include "pq_avx.h"
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* ================================================================ */
+#ifndef VL_PQ_INSTANTIATING
+
+/* Number of vectors processed together by the coarse quantizer */
+#define VL_PQ_BLOCK_SIZE 4096
+
+/* Blocks scanned together and maximum number of sub-quantizers of
+   the fast scan */
+#define VL_PQ_FAST_SCAN_NUM_BLOCKS 64
+#define VL_PQ_FAST_SCAN_MAX_NUM_SUBQUANTIZERS 256
+
+typedef struct _VlPQNeighbor
+{
+  double distance ;
+  vl_uint32 index ;
+} VlPQNeighbor ;
+
+#define VL_HEAP_prefix     vl_pq_neighbor_heap
+#define VL_HEAP_type       VlPQNeighbor
+#define VL_HEAP_cmp(v,x,y) (v[y].distance - v[x].distance)
+#include "heap-def.h"
+
+/* add a candidate to a heap holding the numNeighbors best ones */
+VL_INLINE void
+_vl_pq_push_neighbor (VlPQNeighbor * heap,
+                      vl_size * heapSize,
+                      vl_size numNeighbors,
+                      double distance,
+                      vl_uint32 index)
+{
+  if (*heapSize < numNeighbors) {
+    heap[*heapSize].distance = distance ;
+    heap[*heapSize].index = index ;
+    vl_pq_neighbor_heap_push (heap, heapSize) ;
+  } else if (distance < heap[0].distance) {
+    heap[0].distance = distance ;
+    heap[0].index = index ;
+    vl_pq_neighbor_heap_update (heap, *heapSize, 0) ;
+  }
+}
+
+/* sort the heap by increasing distance */
+static void
+_vl_pq_sort_neighbors (VlPQNeighbor * heap, vl_size heapSize)
+{
+  while (heapSize > 0) {
+    vl_pq_neighbor_heap_pop (heap, &heapSize) ;
+  }
+}
+
+/* Whether the codes of the quantizer can be stored in blocks for the
+   fast scan (@ref pq-fast-scan). */
+static vl_bool
+_vl_pq_has_fast_scan (VlProductQuantizer const * self)
+{
+#ifndef VL_DISABLE_AVX
+  return
+  self->numCenters <= VL_PQ_FAST_SCAN_BLOCK_SIZE &&
+  self->numSubquantizers <= VL_PQ_FAST_SCAN_MAX_NUM_SUBQUANTIZERS ;
+#else
+  (void) self ;
+  return VL_FALSE ;
+#endif
+}
+
+/* Whether the fast scan can be used now. */
+static vl_bool
+_vl_pq_use_fast_scan (VlProductQuantizer const * self)
+{
+  return _vl_pq_has_fast_scan(self) && vl_get_simd_enabled() && vl_cpu_has_avx() ;
+}
+
+/* Byte m of the code i in the blocked layout. */
+VL_INLINE vl_uint8
+_vl_pq_get_blocked_code (vl_uint8 const * blockedCodes, vl_size numSubquantizers,
+                         vl_uindex i, vl_uindex m)
+{
+  return blockedCodes[((i / VL_PQ_FAST_SCAN_BLOCK_SIZE) * numSubquantizers + m)
+                      * VL_PQ_FAST_SCAN_BLOCK_SIZE + i % VL_PQ_FAST_SCAN_BLOCK_SIZE] ;
+}
+
+/* Copy the codes to the blocked layout, padding the last block with
+   zeros. */
+static void
+_vl_pq_block_codes (vl_uint8 * blockedCodes, vl_uint8 const * codes,
+                    vl_size numSubquantizers, vl_size numCodes)
+{
+  vl_uindex i, m ;
+  vl_size numBlocks = (numCodes + VL_PQ_FAST_SCAN_BLOCK_SIZE - 1) / VL_PQ_FAST_SCAN_BLOCK_SIZE ;
+  memset(blockedCodes, 0, numBlocks * VL_PQ_FAST_SCAN_BLOCK_SIZE * numSubquantizers) ;
+  for (i = 0 ; i < numCodes ; ++i) {
+    vl_uint8 * block = blockedCodes + (i / VL_PQ_FAST_SCAN_BLOCK_SIZE)
+                       * numSubquantizers * VL_PQ_FAST_SCAN_BLOCK_SIZE
+                       + i % VL_PQ_FAST_SCAN_BLOCK_SIZE ;
+    for (m = 0 ; m < numSubquantizers ; ++m) {
+      block[m * VL_PQ_FAST_SCAN_BLOCK_SIZE] = codes[i * numSubquantizers + m] ;
+    }
+  }
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Create a new product quantizer
+ ** @param dataType type of data (::VL_TYPE_FLOAT or ::VL_TYPE_DOUBLE)
+ ** @param dimension data dimension.
+ ** @param numSubquantizers number of sub-quantizers (bytes per code).
+ ** @param numCenters number of centers of each sub-quantizer.
+ ** @return new product quantizer.
+ **
+ ** @a numSubquantizers must divide @a dimension and @a numCenters
+ ** must be in the range 1 to 256.
+ **/
+
+VlProductQuantizer *
+vl_pq_new (vl_type dataType,
+           vl_size dimension,
+           vl_size numSubquantizers,
+           vl_size numCenters)
+{
+  VlProductQuantizer * self = vl_calloc(1, sizeof(VlProductQuantizer)) ;
+
+  assert (dataType == VL_TYPE_FLOAT || dataType == VL_TYPE_DOUBLE) ;
+  assert (numSubquantizers >= 1) ;
+  assert (dimension % numSubquantizers == 0) ;
+  assert (numCenters >= 1 && numCenters <= 256) ;
+
+  self->dataType = dataType ;
+  self->dimension = dimension ;
+  self->numSubquantizers = numSubquantizers ;
+  self->subdimension = dimension / numSubquantizers ;
+  self->numCenters = numCenters ;
+  self->maxNumIterations = 25 ;
+  self->verbosity = 0 ;
+  self->centers = vl_calloc(dimension * numCenters,
+                            vl_get_type_size(dataType)) ;
+  return self ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Delete a product quantizer
+ ** @param self product quantizer.
+ **/
+
+void
+vl_pq_delete (VlProductQuantizer * self)
+{
+  if (self->centers) vl_free(self->centers) ;
+  vl_free(self) ;
+}
+
+/* VL_PQ_INSTANTIATING */
+#endif
+
+/* ================================================================ */
+#ifdef VL_PQ_INSTANTIATING
+
+/* ---------------------------------------------------------------- */
+/*                                                Product quantizer */
+/* ---------------------------------------------------------------- */
+
+static double
+VL_XCAT(_vl_pq_train_, SFX)
+(VlProductQuantizer * self,
+ TYPE const * data,
+ vl_size numData)
+{
+  vl_uindex m, i ;
+  vl_size sd = self->subdimension ;
+  vl_size K = self->numCenters ;
+  TYPE * subdata = vl_malloc(sizeof(TYPE) * sd * numData) ;
+  TYPE * centers = (TYPE*) self->centers ;
+  double energy = 0 ;
+
+  for (m = 0 ; m < self->numSubquantizers ; ++m) {
+    VlKMeans * kmeans = vl_kmeans_new (self->dataType, VlDistanceL2) ;
+    vl_kmeans_set_algorithm (kmeans, VlKMeansLloyd) ;
+    vl_kmeans_set_initialization (kmeans, VlKMeansPlusPlus) ;
+    vl_kmeans_set_max_num_iterations (kmeans, self->maxNumIterations) ;
+    vl_kmeans_set_verbosity (kmeans, self->verbosity > 1 ? self->verbosity - 1 : 0) ;
+
+    for (i = 0 ; i < numData ; ++i) {
+      memcpy(subdata + i * sd, data + i * self->dimension + m * sd, sizeof(TYPE) * sd) ;
+    }
+    energy += vl_kmeans_cluster (kmeans, subdata, sd, numData, K) ;
+    memcpy(centers + m * K * sd, vl_kmeans_get_centers(kmeans), sizeof(TYPE) * K * sd) ;
+    vl_kmeans_delete (kmeans) ;
+
+    if (self->verbosity) {
+      VL_PRINTF("pq: sub-quantizer %d of %d trained (energy %g)\n",
+                (int)m + 1, (int)self->numSubquantizers, energy) ;
+    }
+  }
+
+  vl_free(subdata) ;
+  return energy ;
+}
+
+static void
+VL_XCAT(_vl_pq_compute_distance_table_, SFX)
+(VlProductQuantizer const * self,
+ TYPE * table,
+ TYPE const * query)
+{
+  vl_uindex m, k, j ;
+  vl_size sd = self->subdimension ;
+  vl_size K = self->numCenters ;
+  TYPE const * center = (TYPE const *) self->centers ;
+
+  for (m = 0 ; m < self->numSubquantizers ; ++m) {
+    TYPE const * y = query + m * sd ;
+    for (k = 0 ; k < K ; ++k) {
+      TYPE acc = 0 ;
+      for (j = 0 ; j < sd ; ++j) {
+        TYPE delta = y[j] - center[j] ;
+        acc += delta * delta ;
+      }
+      *table++ = acc ;
+      center += sd ;
+    }
+  }
+}
+
+static void
+VL_XCAT(_vl_pq_encode_, SFX)
+(VlProductQuantizer const * self,
+ vl_uint8 * codes,
+ TYPE const * data,
+ vl_size numData)
+{
+  vl_index i ;
+  vl_size M = self->numSubquantizers ;
+  vl_size K = self->numCenters ;
+
+#ifdef _OPENMP
+#pragma omp parallel default(shared) num_threads(vl_get_max_threads())
+#endif
+  {
+    /* vl_malloc cannot be used here if mapped to MATLAB malloc */
+    TYPE * table = malloc(sizeof(TYPE) * M * K) ;
+
+#ifdef _OPENMP
+#pragma omp for
+#endif
+    for (i = 0 ; i < (signed)numData ; ++i) {
+      vl_uindex m, k ;
+      TYPE const * t = table ;
+      VL_XCAT(_vl_pq_compute_distance_table_, SFX)(self, table, data + i * self->dimension) ;
+      for (m = 0 ; m < M ; ++m) {
+        vl_uindex best = 0 ;
+        for (k = 1 ; k < K ; ++k) {
+          if (t[k] < t[best]) best = k ;
+        }
+        codes[i * M + m] = (vl_uint8) best ;
+        t += K ;
+      }
+    }
+
+    free(table) ;
+  }
+}
+
+static void
+VL_XCAT(_vl_pq_decode_, SFX)
+(VlProductQuantizer const * self,
+ TYPE * data,
+ vl_uint8 const * codes,
+ vl_size numData)
+{
+  vl_uindex i, m ;
+  vl_size M = self->numSubquantizers ;
+  vl_size sd = self->subdimension ;
+  vl_size K = self->numCenters ;
+  TYPE const * centers = (TYPE const *) self->centers ;
+
+  for (i = 0 ; i < numData ; ++i) {
+    for (m = 0 ; m < M ; ++m) {
+      memcpy(data, centers + (m * K + codes[m]) * sd, sizeof(TYPE) * sd) ;
+      data += sd ;
+    }
+    codes += M ;
+  }
+}
+
+/*
+ Fast scan (@ref pq-fast-scan). The table is quantized to 8 bits so
+ that the sums of the quantized entries, computed 16 codes at a time,
+ are lower bounds of the distances. Only the codes whose bound does
+ not exceed the distance of the current farthest neighbor are scored
+ exactly, in the same way as by the generic scan. The bounds are
+ slightly relaxed to account for the rounding of the floating point
+ sums, so that the result is the same as for the generic scan.
+ */
+
+#ifndef VL_DISABLE_AVX
+static void
+VL_XCAT(_vl_pq_fast_scan_, SFX)
+(VlProductQuantizer const * self,
+ VlPQNeighbor * heap,
+ vl_size * heapSize,
+ vl_size numNeighbors,
+ TYPE const * table,
+ vl_uint8 const * blockedCodes,
+ vl_uint32 const * codeIndexes,
+ vl_uindex offset,
+ vl_size numCodes)
+{
+  vl_uint8 quantizedTable [VL_PQ_FAST_SCAN_MAX_NUM_SUBQUANTIZERS * VL_PQ_FAST_SCAN_BLOCK_SIZE] ;
+  vl_uint16 sums [VL_PQ_FAST_SCAN_NUM_BLOCKS * VL_PQ_FAST_SCAN_BLOCK_SIZE] ;
+  vl_size M = self->numSubquantizers ;
+  vl_size K = self->numCenters ;
+  vl_size numBlocks = (numCodes + VL_PQ_FAST_SCAN_BLOCK_SIZE - 1) / VL_PQ_FAST_SCAN_BLOCK_SIZE ;
+  vl_size blockSize = M * VL_PQ_FAST_SCAN_BLOCK_SIZE ;
+  double base = 0 ;
+  double step = 0 ;
+#if (FLT == VL_TYPE_FLOAT)
+  double slack = 1 - 4 * (M + 4) * FLT_EPSILON ;
+#else
+  double slack = 1 - 4 * (M + 4) * DBL_EPSILON ;
+#endif
+  vl_uindex i, m, k, block ;
+
+  /* the step is chosen so that the entries of each sub-quantizer span
+     at most 255 steps above their minimum */
+  for (m = 0 ; m < M ; ++m) {
+    TYPE const * t = table + m * K ;
+    TYPE minValue = t[0], maxValue = t[0] ;
+    for (k = 1 ; k < K ; ++k) {
+      minValue = VL_MIN(minValue, t[k]) ;
+      maxValue = VL_MAX(maxValue, t[k]) ;
+    }
+    base += minValue ;
+    step = VL_MAX(step, ((double)maxValue - minValue) / 255) ;
+  }
+  if (step == 0) step = 1 ;
+  for (m = 0 ; m < M ; ++m) {
+    TYPE const * t = table + m * K ;
+    TYPE minValue = t[0] ;
+    for (k = 1 ; k < K ; ++k) minValue = VL_MIN(minValue, t[k]) ;
+    for (k = 0 ; k < VL_PQ_FAST_SCAN_BLOCK_SIZE ; ++k) {
+      quantizedTable[m * VL_PQ_FAST_SCAN_BLOCK_SIZE + k] = (k < K) ?
+        (vl_uint8) VL_MIN(floor(((double)t[k] - minValue) / step), 255) : 0 ;
+    }
+  }
+
+  for (block = 0 ; block < numBlocks ; block += VL_PQ_FAST_SCAN_NUM_BLOCKS) {
+    vl_size n = VL_MIN(VL_PQ_FAST_SCAN_NUM_BLOCKS, numBlocks - block) ;
+    vl_uindex begin = block * VL_PQ_FAST_SCAN_BLOCK_SIZE ;
+    vl_size numBlockCodes = VL_MIN(n * VL_PQ_FAST_SCAN_BLOCK_SIZE, numCodes - begin) ;
+    _vl_pq_fast_scan_avx (sums, blockedCodes + block * blockSize, quantizedTable, M, n) ;
+    for (i = 0 ; i < numBlockCodes ; ++i) {
+      TYPE const * t = table ;
+      TYPE d0 = 0 ;
+      if (*heapSize == numNeighbors &&
+          (base + step * sums[i]) * slack >= heap[0].distance) continue ;
+      for (m = 0 ; m < M ; ++m) {
+        d0 += t[_vl_pq_get_blocked_code(blockedCodes, M, begin + i, m)] ;
+        t += K ;
+      }
+      _vl_pq_push_neighbor (heap, heapSize, numNeighbors, d0,
+                            codeIndexes ? codeIndexes[begin + i] : (vl_uint32)(offset + begin + i)) ;
+    }
+  }
+}
+/* VL_DISABLE_AVX */
+#endif
+
+/*
+ Scan a list of codes accumulating the distances from the lookup
+ table. Four codes are processed at a time, so that the independent
+ table lookups of different codes can overlap. Codes are numbered
+ from offset unless their indexes are given explicitly. The codes are
+ given either one after the other (codes) or in the blocked layout
+ of the fast scan (blockedCodes), or both.
+ */
+
+static void
+VL_XCAT(_vl_pq_scan_, SFX)
+(VlProductQuantizer const * self,
+ VlPQNeighbor * heap,
+ vl_size * heapSize,
+ vl_size numNeighbors,
+ TYPE const * table,
+ vl_uint8 const * codes,
+ vl_uint8 const * blockedCodes,
+ vl_uint32 const * codeIndexes,
+ vl_uindex offset,
+ vl_size numCodes)
+{
+  vl_uindex i, m ;
+  vl_size M = self->numSubquantizers ;
+  vl_size K = self->numCenters ;
+
+#ifndef VL_DISABLE_AVX
+  if (blockedCodes && _vl_pq_use_fast_scan(self)) {
+    VL_XCAT(_vl_pq_fast_scan_, SFX)(self, heap, heapSize, numNeighbors, table,
+                                    blockedCodes, codeIndexes, offset, numCodes) ;
+    return ;
+  }
+#endif
+
+  if (! codes) {
+    for (i = 0 ; i < numCodes ; ++i) {
+      TYPE const * t = table ;
+      TYPE d0 = 0 ;
+      for (m = 0 ; m < M ; ++m) {
+        d0 += t[_vl_pq_get_blocked_code(blockedCodes, M, i, m)] ;
+        t += K ;
+      }
+      _vl_pq_push_neighbor (heap, heapSize, numNeighbors, d0,
+                            codeIndexes ? codeIndexes[i] : (vl_uint32)(offset + i)) ;
+    }
+    return ;
+  }
+
+  for (i = 0 ; i + 4 <= numCodes ; i += 4) {
+    vl_uint8 const * c0 = codes + i * M ;
+    vl_uint8 const * c1 = c0 + M ;
+    vl_uint8 const * c2 = c1 + M ;
+    vl_uint8 const * c3 = c2 + M ;
+    TYPE const * t = table ;
+    TYPE d0 = 0, d1 = 0, d2 = 0, d3 = 0 ;
+    for (m = 0 ; m < M ; ++m) {
+      d0 += t[c0[m]] ;
+      d1 += t[c1[m]] ;
+      d2 += t[c2[m]] ;
+      d3 += t[c3[m]] ;
+      t += K ;
+    }
+    _vl_pq_push_neighbor (heap, heapSize, numNeighbors, d0,
+                          codeIndexes ? codeIndexes[i + 0] : (vl_uint32)(offset + i + 0)) ;
+    _vl_pq_push_neighbor (heap, heapSize, numNeighbors, d1,
+                          codeIndexes ? codeIndexes[i + 1] : (vl_uint32)(offset + i + 1)) ;
+    _vl_pq_push_neighbor (heap, heapSize, numNeighbors, d2,
+                          codeIndexes ? codeIndexes[i + 2] : (vl_uint32)(offset + i + 2)) ;
+    _vl_pq_push_neighbor (heap, heapSize, numNeighbors, d3,
+                          codeIndexes ? codeIndexes[i + 3] : (vl_uint32)(offset + i + 3)) ;
+  }
+
+  for ( ; i < numCodes ; ++i) {
+    vl_uint8 const * c0 = codes + i * M ;
+    TYPE const * t = table ;
+    TYPE d0 = 0 ;
+    for (m = 0 ; m < M ; ++m) {
+      d0 += t[c0[m]] ;
+      t += K ;
+    }
+    _vl_pq_push_neighbor (heap, heapSize, numNeighbors, d0,
+                          codeIndexes ? codeIndexes[i] : (vl_uint32)(offset + i)) ;
+  }
+}
+
+/* copy the sorted neighbors to the output, padding missing ones */
+static void
+VL_XCAT(_vl_pq_store_neighbors_, SFX)
+(vl_uint32 * indexes,
+ TYPE * distances,
+ vl_size numNeighbors,
+ VlPQNeighbor const * heap,
+ vl_size heapSize)
+{
+  vl_uindex ni ;
+  for (ni = 0 ; ni < numNeighbors ; ++ni) {
+    if (ni < heapSize) {
+      indexes[ni] = heap[ni].index ;
+      if (distances) distances[ni] = (TYPE) heap[ni].distance ;
+    } else {
+      indexes[ni] = (vl_uint32) -1 ;
+      if (distances) distances[ni] = (TYPE) VL_INFINITY_D ;
+    }
+  }
+}
+
+/* search either the codes or the same codes in the blocked layout */
+static void
+VL_XCAT(_vl_pq_search_, SFX)
+(VlProductQuantizer const * self,
+ vl_uint32 * indexes,
+ vl_size numNeighbors,
+ vl_size numQueries,
+ TYPE * distances,
+ TYPE const * queries,
+ vl_uint8 const * codes,
+ vl_uint8 const * blockedCodes,
+ vl_size numCodes)
+{
+  vl_index qi ;
+  vl_size M = self->numSubquantizers ;
+  vl_size K = self->numCenters ;
+
+#ifdef _OPENMP
+#pragma omp parallel default(shared) num_threads(vl_get_max_threads())
+#endif
+  {
+    /* vl_malloc cannot be used here if mapped to MATLAB malloc */
+    TYPE * table = malloc(sizeof(TYPE) * M * K) ;
+    VlPQNeighbor * heap = malloc(sizeof(VlPQNeighbor) * numNeighbors) ;
+
+#ifdef _OPENMP
+#pragma omp for
+#endif
+    for (qi = 0 ; qi < (signed)numQueries ; ++qi) {
+      vl_size heapSize = 0 ;
+      VL_XCAT(_vl_pq_compute_distance_table_, SFX)(self, table, queries + qi * self->dimension) ;
+      VL_XCAT(_vl_pq_scan_, SFX)(self, heap, &heapSize, numNeighbors,
+                                 table, codes, blockedCodes, NULL, 0, numCodes) ;
+      _vl_pq_sort_neighbors (heap, heapSize) ;
+      VL_XCAT(_vl_pq_store_neighbors_, SFX)(indexes + qi * numNeighbors,
+                                            distances ? distances + qi * numNeighbors : NULL,
+                                            numNeighbors, heap, heapSize) ;
+    }
+
+    free(table) ;
+    free(heap) ;
+  }
+}
+
+/* ---------------------------------------------------------------- */
+/*                                                    Inverted file */
+/* ---------------------------------------------------------------- */
+
+static double
+VL_XCAT(_vl_ivfpq_train_, SFX)
+(VlIVFPQ * self,
+ TYPE const * data,
+ vl_size numData)
+{
+  vl_uindex i, d ;
+  vl_size dimension = self->dimension ;
+  vl_uint32 * assignments = vl_malloc(sizeof(vl_uint32) * numData) ;
+  TYPE * residuals = vl_malloc(sizeof(TYPE) * dimension * numData) ;
+  TYPE const * centers ;
+  double energy ;
+
+  vl_kmeans_cluster (self->coarseQuantizer, data, dimension, numData, self->numLists) ;
+  vl_kmeans_quantize (self->coarseQuantizer, assignments, NULL, data, numData) ;
+  centers = vl_kmeans_get_centers (self->coarseQuantizer) ;
+
+  for (i = 0 ; i < numData ; ++i) {
+    TYPE const * c = centers + assignments[i] * dimension ;
+    for (d = 0 ; d < dimension ; ++d) {
+      residuals[i * dimension + d] = data[i * dimension + d] - c[d] ;
+    }
+  }
+  energy = VL_XCAT(_vl_pq_train_, SFX)(self->pq, residuals, numData) ;
+
+  vl_free(assignments) ;
+  vl_free(residuals) ;
+  return energy ;
+}
+
+static void
+VL_XCAT(_vl_ivfpq_add_, SFX)
+(VlIVFPQ * self,
+ TYPE const * data,
+ vl_size numData)
+{
+  vl_uindex begin, i, d ;
+  vl_size dimension = self->dimension ;
+  vl_size M = self->pq->numSubquantizers ;
+  vl_size blockSize = VL_MIN(numData, VL_PQ_BLOCK_SIZE) ;
+  vl_uint32 * assignments = vl_malloc(sizeof(vl_uint32) * blockSize) ;
+  TYPE * residuals = vl_malloc(sizeof(TYPE) * dimension * blockSize) ;
+  vl_uint8 * codes = vl_malloc(sizeof(vl_uint8) * M * blockSize) ;
+  TYPE const * centers = vl_kmeans_get_centers (self->coarseQuantizer) ;
+
+  for (begin = 0 ; begin < numData ; begin += blockSize) {
+    vl_size n = VL_MIN(blockSize, numData - begin) ;
+    TYPE const * x = data + begin * dimension ;
+
+    vl_kmeans_quantize (self->coarseQuantizer, assignments, NULL, x, n) ;
+    for (i = 0 ; i < n ; ++i) {
+      TYPE const * c = centers + assignments[i] * dimension ;
+      for (d = 0 ; d < dimension ; ++d) {
+        residuals[i * dimension + d] = x[i * dimension + d] - c[d] ;
+      }
+    }
+    VL_XCAT(_vl_pq_encode_, SFX)(self->pq, codes, residuals, n) ;
+
+    for (i = 0 ; i < n ; ++i) {
+      vl_uindex list = assignments[i] ;
+      vl_size size = self->listSizes[list] ;
+      if (size == self->listCapacities[list]) {
+        /* a multiple of the fast scan block size */
+        vl_size capacity = VL_MAX(2 * size, VL_PQ_FAST_SCAN_BLOCK_SIZE) ;
+        self->listCodes[list] = vl_realloc(self->listCodes[list], sizeof(vl_uint8) * M * capacity) ;
+        self->listIndexes[list] = vl_realloc(self->listIndexes[list], sizeof(vl_uint32) * capacity) ;
+        memset(self->listCodes[list] + M * size, 0, M * (capacity - size)) ;
+        self->listCapacities[list] = capacity ;
+      }
+      if (_vl_pq_has_fast_scan(self->pq)) {
+        vl_uint8 * block = self->listCodes[list]
+          + (size / VL_PQ_FAST_SCAN_BLOCK_SIZE) * M * VL_PQ_FAST_SCAN_BLOCK_SIZE
+          + size % VL_PQ_FAST_SCAN_BLOCK_SIZE ;
+        for (d = 0 ; d < M ; ++d) {
+          block[d * VL_PQ_FAST_SCAN_BLOCK_SIZE] = codes[i * M + d] ;
+        }
+      } else {
+        memcpy(self->listCodes[list] + size * M, codes + i * M, M) ;
+      }
+      self->listIndexes[list][size] = (vl_uint32) (self->numEntries + begin + i) ;
+      self->listSizes[list] = size + 1 ;
+    }
+  }
+  self->numEntries += numData ;
+
+  vl_free(assignments) ;
+  vl_free(residuals) ;
+  vl_free(codes) ;
+}
+
+static void
+VL_XCAT(_vl_ivfpq_search_, SFX)
+(VlIVFPQ const * self,
+ vl_uint32 * indexes,
+ vl_size numNeighbors,
+ vl_size numQueries,
+ TYPE * distances,
+ TYPE const * queries)
+{
+  vl_index qi ;
+  vl_size dimension = self->dimension ;
+  vl_size numProbes = self->numProbes ;
+  vl_size M = self->pq->numSubquantizers ;
+  vl_size K = self->pq->numCenters ;
+  TYPE const * centers = vl_kmeans_get_centers (self->coarseQuantizer) ;
+  vl_bool blocked = _vl_pq_has_fast_scan(self->pq) ;
+
+#if (FLT == VL_TYPE_FLOAT)
+  VlFloatVectorComparisonFunction distFn = vl_get_vector_comparison_function_f(VlDistanceL2) ;
+#else
+  VlDoubleVectorComparisonFunction distFn = vl_get_vector_comparison_function_d(VlDistanceL2) ;
+#endif
+
+#ifdef _OPENMP
+#pragma omp parallel default(shared) num_threads(vl_get_max_threads())
+#endif
+  {
+    /* vl_malloc cannot be used here if mapped to MATLAB malloc */
+    TYPE * table = malloc(sizeof(TYPE) * M * K) ;
+    TYPE * residual = malloc(sizeof(TYPE) * dimension) ;
+    VlPQNeighbor * probes = malloc(sizeof(VlPQNeighbor) * numProbes) ;
+    VlPQNeighbor * heap = malloc(sizeof(VlPQNeighbor) * numNeighbors) ;
+
+#ifdef _OPENMP
+#pragma omp for
+#endif
+    for (qi = 0 ; qi < (signed)numQueries ; ++qi) {
+      TYPE const * query = queries + qi * dimension ;
+      vl_size numAddedProbes = 0 ;
+      vl_size heapSize = 0 ;
+      vl_uindex p, list, d ;
+
+      /* select the lists to visit */
+      for (list = 0 ; list < self->numLists ; ++list) {
+        _vl_pq_push_neighbor (probes, &numAddedProbes, numProbes,
+                              distFn(dimension, query, centers + list * dimension),
+                              (vl_uint32) list) ;
+      }
+
+      for (p = 0 ; p < numAddedProbes ; ++p) {
+        TYPE const * c ;
+        list = probes[p].index ;
+        if (self->listSizes[list] == 0) continue ;
+        c = centers + list * dimension ;
+        for (d = 0 ; d < dimension ; ++d) {
+          residual[d] = query[d] - c[d] ;
+        }
+        VL_XCAT(_vl_pq_compute_distance_table_, SFX)(self->pq, table, residual) ;
+        VL_XCAT(_vl_pq_scan_, SFX)(self->pq, heap, &heapSize, numNeighbors, table,
+                                   blocked ? NULL : self->listCodes[list],
+                                   blocked ? self->listCodes[list] : NULL,
+                                   self->listIndexes[list], 0, self->listSizes[list]) ;
+      }
+
+      _vl_pq_sort_neighbors (heap, heapSize) ;
+      VL_XCAT(_vl_pq_store_neighbors_, SFX)(indexes + qi * numNeighbors,
+                                            distances ? distances + qi * numNeighbors : NULL,
+                                            numNeighbors, heap, heapSize) ;
+    }
+
+    free(table) ;
+    free(residual) ;
+    free(probes) ;
+    free(heap) ;
+  }
+}
+
+/* VL_PQ_INSTANTIATING */
+#else
+
+#ifndef __DOXYGEN__
+#define FLT VL_TYPE_FLOAT
+#define TYPE float
+#define SFX f
+#define VL_PQ_INSTANTIATING
+#include "pq.c"
+
+#define FLT VL_TYPE_DOUBLE
+#define TYPE double
+#define SFX d
+#define VL_PQ_INSTANTIATING
+#include "pq.c"
+#endif
+
+/* VL_PQ_INSTANTIATING */
+#endif
+
+/* ================================================================ */
+#ifndef VL_PQ_INSTANTIATING
+
+/** ------------------------------------------------------------------
+ ** @brief Train a product quantizer
+ ** @param self product quantizer.
+ ** @param data training data.
+ ** @param numData number of training vectors.
+ ** @return total quantization energy of the sub-quantizers.
+ **
+ ** Each sub-quantizer is learned by running @ref kmeans (Lloyd
+ ** algorithm with k-means++ initialization) on the corresponding
+ ** sub-vectors of @a data. @a numData must not be smaller than the
+ ** number of centers.
+ **/
+
+double
+vl_pq_train (VlProductQuantizer * self,
+             void const * data,
+             vl_size numData)
+{
+  assert (numData >= self->numCenters) ;
+  switch (self->dataType) {
+    case VL_TYPE_FLOAT :
+      return _vl_pq_train_f (self, (float const *)data, numData) ;
+    case VL_TYPE_DOUBLE :
+      return _vl_pq_train_d (self, (double const *)data, numData) ;
+    default:
+      abort() ;
+  }
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Encode vectors
+ ** @param self product quantizer.
+ ** @param codes codes (output).
+ ** @param data data to encode.
+ ** @param numData number of vectors to encode.
+ **
+ ** @a codes must have room for <code>numData *
+ ** numSubquantizers</code> bytes. The code of each vector is stored
+ ** contiguously.
+ **/
+
+void
+vl_pq_encode (VlProductQuantizer const * self,
+              vl_uint8 * codes,
+              void const * data,
+              vl_size numData)
+{
+  switch (self->dataType) {
+    case VL_TYPE_FLOAT :
+      _vl_pq_encode_f (self, codes, (float const *)data, numData) ;
+      break ;
+    case VL_TYPE_DOUBLE :
+      _vl_pq_encode_d (self, codes, (double const *)data, numData) ;
+      break ;
+    default:
+      abort() ;
+  }
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Decode vectors
+ ** @param self product quantizer.
+ ** @param data reconstructed vectors (output).
+ ** @param codes codes to decode.
+ ** @param numData number of codes.
+ **/
+
+void
+vl_pq_decode (VlProductQuantizer const * self,
+              void * data,
+              vl_uint8 const * codes,
+              vl_size numData)
+{
+  switch (self->dataType) {
+    case VL_TYPE_FLOAT :
+      _vl_pq_decode_f (self, (float *)data, codes, numData) ;
+      break ;
+    case VL_TYPE_DOUBLE :
+      _vl_pq_decode_d (self, (double *)data, codes, numData) ;
+      break ;
+    default:
+      abort() ;
+  }
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Compute the asymmetric distance lookup table of a query
+ ** @param self product quantizer.
+ ** @param table lookup table (output).
+ ** @param query query vector.
+ **
+ ** The table has <code>numSubquantizers * numCenters</code>
+ ** elements. Element <code>m * numCenters + k</code> is the squared
+ ** Euclidean distance between the @c m-th sub-vector of @a query and
+ ** the @c k-th center of the @c m-th sub-quantizer.
+ **/
+
+void
+vl_pq_compute_distance_table (VlProductQuantizer const * self,
+                              void * table,
+                              void const * query)
+{
+  switch (self->dataType) {
+    case VL_TYPE_FLOAT :
+      _vl_pq_compute_distance_table_f (self, (float *)table, (float const *)query) ;
+      break ;
+    case VL_TYPE_DOUBLE :
+      _vl_pq_compute_distance_table_d (self, (double *)table, (double const *)query) ;
+      break ;
+    default:
+      abort() ;
+  }
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Copy codes to the blocked layout
+ ** @param self product quantizer.
+ ** @param blockedCodes codes in the blocked layout (output).
+ ** @param codes codes, as returned by ::vl_pq_encode.
+ ** @param numCodes number of codes.
+ **
+ ** @a blockedCodes must have room for
+ ** ::vl_pq_get_blocked_codes_size bytes. The codes are stored in
+ ** blocks of ::VL_PQ_FAST_SCAN_BLOCK_SIZE, the @c m-th bytes of the
+ ** codes of a block being contiguous, and the last block is padded
+ ** with zeros. This is the layout searched by ::vl_pq_search_blocked
+ ** (@ref pq-fast-scan).
+ **/
+
+void
+vl_pq_block_codes (VlProductQuantizer const * self,
+                   vl_uint8 * blockedCodes,
+                   vl_uint8 const * codes,
+                   vl_size numCodes)
+{
+  _vl_pq_block_codes (blockedCodes, codes, self->numSubquantizers, numCodes) ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Search encoded vectors
+ ** @param self product quantizer.
+ ** @param indexes nearest neighbor indexes (output).
+ ** @param numNeighbors number of neighbors per query.
+ ** @param numQueries number of queries.
+ ** @param distances squared asymmetric distances (output, may be @c NULL).
+ ** @param queries query vectors.
+ ** @param codes codes of the vectors to search.
+ ** @param numCodes number of codes.
+ **
+ ** For each query, the function returns the @a numNeighbors codes
+ ** with the smallest asymmetric distance, sorted by increasing
+ ** distance. @a indexes and @a distances are <code>numNeighbors x
+ ** numQueries</code> arrays. If fewer than @a numNeighbors codes are
+ ** available, the remaining entries are set to <code>(vl_uint32)
+ ** -1</code> and infinity. Queries are processed in parallel.
+ **
+ ** The fast scan is not used by this function. To use it, copy the
+ ** codes to the blocked layout once by ::vl_pq_block_codes and search
+ ** them by ::vl_pq_search_blocked.
+ **/
+
+void
+vl_pq_search (VlProductQuantizer const * self,
+              vl_uint32 * indexes,
+              vl_size numNeighbors,
+              vl_size numQueries,
+              void * distances,
+              void const * queries,
+              vl_uint8 const * codes,
+              vl_size numCodes)
+{
+  if (numNeighbors == 0) return ;
+  switch (self->dataType) {
+    case VL_TYPE_FLOAT :
+      _vl_pq_search_f (self, indexes, numNeighbors, numQueries,
+                       (float *)distances, (float const *)queries,
+                       codes, NULL, numCodes) ;
+      break ;
+    case VL_TYPE_DOUBLE :
+      _vl_pq_search_d (self, indexes, numNeighbors, numQueries,
+                       (double *)distances, (double const *)queries,
+                       codes, NULL, numCodes) ;
+      break ;
+    default:
+      abort() ;
+  }
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Search encoded vectors in the blocked layout
+ ** @param self product quantizer.
+ ** @param indexes nearest neighbor indexes (output).
+ ** @param numNeighbors number of neighbors per query.
+ ** @param numQueries number of queries.
+ ** @param distances squared asymmetric distances (output, may be @c NULL).
+ ** @param queries query vectors.
+ ** @param blockedCodes codes of the vectors to search, as returned by ::vl_pq_block_codes.
+ ** @param numCodes number of codes.
+ **
+ ** The function is the same as ::vl_pq_search, but uses the fast
+ ** scan when possible (@ref pq-fast-scan). The results are the same.
+ **/
+
+void
+vl_pq_search_blocked (VlProductQuantizer const * self,
+                      vl_uint32 * indexes,
+                      vl_size numNeighbors,
+                      vl_size numQueries,
+                      void * distances,
+                      void const * queries,
+                      vl_uint8 const * blockedCodes,
+                      vl_size numCodes)
+{
+  if (numNeighbors == 0) return ;
+  switch (self->dataType) {
+    case VL_TYPE_FLOAT :
+      _vl_pq_search_f (self, indexes, numNeighbors, numQueries,
+                       (float *)distances, (float const *)queries,
+                       NULL, blockedCodes, numCodes) ;
+      break ;
+    case VL_TYPE_DOUBLE :
+      _vl_pq_search_d (self, indexes, numNeighbors, numQueries,
+                       (double *)distances, (double const *)queries,
+                       NULL, blockedCodes, numCodes) ;
+      break ;
+    default:
+      abort() ;
+  }
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Create a new inverted file
+ ** @param dataType type of data (::VL_TYPE_FLOAT or ::VL_TYPE_DOUBLE)
+ ** @param dimension data dimension.
+ ** @param numLists number of inverted lists (coarse centers).
+ ** @param numSubquantizers number of sub-quantizers (bytes per code).
+ ** @param numCenters number of centers of each sub-quantizer.
+ ** @return new inverted file.
+ **
+ ** The coarse quantizer is a ::VlKMeans object that can be
+ ** configured by using ::vl_ivfpq_get_coarse_quantizer before
+ ** training. By default, a query visits a single list.
+ **/
+
+VlIVFPQ *
+vl_ivfpq_new (vl_type dataType,
+              vl_size dimension,
+              vl_size numLists,
+              vl_size numSubquantizers,
+              vl_size numCenters)
+{
+  VlIVFPQ * self = vl_calloc(1, sizeof(VlIVFPQ)) ;
+
+  assert (numLists >= 1) ;
+
+  self->dataType = dataType ;
+  self->dimension = dimension ;
+  self->numLists = numLists ;
+  self->numProbes = 1 ;
+  self->numEntries = 0 ;
+  self->coarseQuantizer = vl_kmeans_new (dataType, VlDistanceL2) ;
+  vl_kmeans_set_initialization (self->coarseQuantizer, VlKMeansPlusPlus) ;
+  self->pq = vl_pq_new (dataType, dimension, numSubquantizers, numCenters) ;
+  self->listSizes = vl_calloc(numLists, sizeof(vl_size)) ;
+  self->listCapacities = vl_calloc(numLists, sizeof(vl_size)) ;
+  self->listCodes = vl_calloc(numLists, sizeof(vl_uint8*)) ;
+  self->listIndexes = vl_calloc(numLists, sizeof(vl_uint32*)) ;
+  return self ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Delete an inverted file
+ ** @param self inverted file.
+ **/
+
+void
+vl_ivfpq_delete (VlIVFPQ * self)
+{
+  vl_uindex list ;
+  for (list = 0 ; list < self->numLists ; ++list) {
+    if (self->listCodes[list]) vl_free(self->listCodes[list]) ;
+    if (self->listIndexes[list]) vl_free(self->listIndexes[list]) ;
+  }
+  vl_free(self->listSizes) ;
+  vl_free(self->listCapacities) ;
+  vl_free(self->listCodes) ;
+  vl_free(self->listIndexes) ;
+  vl_kmeans_delete(self->coarseQuantizer) ;
+  vl_pq_delete(self->pq) ;
+  vl_free(self) ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Train an inverted file
+ ** @param self inverted file.
+ ** @param data training data.
+ ** @param numData number of training vectors.
+ ** @return total quantization energy of the residuals.
+ **
+ ** The function learns the coarse quantizer by @ref kmeans and then
+ ** the product quantizer on the residuals of @a data from their
+ ** closest coarse centers. Training does not add @a data to the
+ ** index (see ::vl_ivfpq_add).
+ **/
+
+double
+vl_ivfpq_train (VlIVFPQ * self,
+                void const * data,
+                vl_size numData)
+{
+  assert (numData >= self->numLists) ;
+  assert (numData >= self->pq->numCenters) ;
+  switch (self->dataType) {
+    case VL_TYPE_FLOAT :
+      return _vl_ivfpq_train_f (self, (float const *)data, numData) ;
+    case VL_TYPE_DOUBLE :
+      return _vl_ivfpq_train_d (self, (double const *)data, numData) ;
+    default:
+      abort() ;
+  }
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Add vectors to an inverted file
+ ** @param self inverted file.
+ ** @param data vectors to add.
+ ** @param numData number of vectors.
+ **
+ ** The vectors are numbered in order of addition, starting from
+ ** zero for the first vector ever added. These are the indexes
+ ** returned by ::vl_ivfpq_search.
+ **/
+
+void
+vl_ivfpq_add (VlIVFPQ * self,
+              void const * data,
+              vl_size numData)
+{
+  if (numData == 0) return ;
+  switch (self->dataType) {
+    case VL_TYPE_FLOAT :
+      _vl_ivfpq_add_f (self, (float const *)data, numData) ;
+      break ;
+    case VL_TYPE_DOUBLE :
+      _vl_ivfpq_add_d (self, (double const *)data, numData) ;
+      break ;
+    default:
+      abort() ;
+  }
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Search an inverted file
+ ** @param self inverted file.
+ ** @param indexes nearest neighbor indexes (output).
+ ** @param numNeighbors number of neighbors per query.
+ ** @param numQueries number of queries.
+ ** @param distances squared asymmetric distances (output, may be @c NULL).
+ ** @param queries query vectors.
+ **
+ ** The function is analogous to ::vl_pq_search, but scans only the
+ ** vectors in the ::vl_ivfpq_get_num_probes lists closest to each
+ ** query.
+ **/
+
+void
+vl_ivfpq_search (VlIVFPQ const * self,
+                 vl_uint32 * indexes,
+                 vl_size numNeighbors,
+                 vl_size numQueries,
+                 void * distances,
+                 void const * queries)
+{
+  if (numNeighbors == 0) return ;
+  switch (self->dataType) {
+    case VL_TYPE_FLOAT :
+      _vl_ivfpq_search_f (self, indexes, numNeighbors, numQueries,
+                          (float *)distances, (float const *)queries) ;
+      break ;
+    case VL_TYPE_DOUBLE :
+      _vl_ivfpq_search_d (self, indexes, numNeighbors, numQueries,
+                          (double *)distances, (double const *)queries) ;
+      break ;
+    default:
+      abort() ;
+  }
+}
+
+/* VL_PQ_INSTANTIATING */
+#endif
+
+#undef SFX
+#undef TYPE
+#undef FLT
+#undef VL_PQ_INSTANTIATING
@@ -0,0 +1,358 @@
+/** @file pq.h
+ ** @brief Product quantization (@ref pq)
+ ** @author agent
+ **/
+
+/*
+Copyright (C) 2026 agent.
+All rights reserved.
+
+This file is part of the VLFeat library and is made available under
+the terms of the BSD license (see the COPYING file).
+*/
+
+#ifndef VL_PQ_H
+#define VL_PQ_H
+
+#include "generic.h"
+#include "kmeans.h"
+
+/** @brief Number of codes in a block of the blocked layout (@ref pq-fast-scan) */
+#define VL_PQ_FAST_SCAN_BLOCK_SIZE 16
+
+/** ------------------------------------------------------------------
+ ** @brief Product quantizer
+ **/
+
+typedef struct _VlProductQuantizer
+{
+  vl_type dataType ;                 /**< Data type. */
+  vl_size dimension ;                /**< Data dimensionality. */
+  vl_size numSubquantizers ;         /**< Number of sub-quantizers (M). */
+  vl_size subdimension ;             /**< Dimension of each sub-vector. */
+  vl_size numCenters ;               /**< Number of centers per sub-quantizer (at most 256). */
+  vl_size maxNumIterations ;         /**< Maximum number of k-means iterations. */
+  int verbosity ;                    /**< Verbosity level. */
+  void * centers ;                   /**< Sub-quantizer centers. */
+} VlProductQuantizer ;
+
+/** ------------------------------------------------------------------
+ ** @brief Inverted file with product quantized residuals
+ **/
+
+typedef struct _VlIVFPQ
+{
+  vl_type dataType ;                 /**< Data type. */
+  vl_size dimension ;                /**< Data dimensionality. */
+  vl_size numLists ;                 /**< Number of inverted lists (coarse centers). */
+  vl_size numProbes ;                /**< Number of lists visited by a query. */
+  vl_size numEntries ;               /**< Number of indexed vectors. */
+  VlKMeans * coarseQuantizer ;       /**< Coarse quantizer. */
+  VlProductQuantizer * pq ;          /**< Residual product quantizer. */
+  vl_size * listSizes ;              /**< Number of entries of each list. */
+  vl_size * listCapacities ;         /**< Allocated entries of each list. */
+  vl_uint8 ** listCodes ;            /**< Codes of each list (in blocks for the fast scan, see @ref pq-fast-scan). */
+  vl_uint32 ** listIndexes ;         /**< Vector indexes of each list. */
+} VlIVFPQ ;
+
+/** @name Product quantizer
+ ** @{
+ **/
+VL_EXPORT VlProductQuantizer * vl_pq_new (vl_type dataType,
+                                          vl_size dimension,
+                                          vl_size numSubquantizers,
+                                          vl_size numCenters) ;
+VL_EXPORT void vl_pq_delete (VlProductQuantizer * self) ;
+
+VL_EXPORT double vl_pq_train (VlProductQuantizer * self,
+                              void const * data,
+                              vl_size numData) ;
+
+VL_EXPORT void vl_pq_encode (VlProductQuantizer const * self,
+                             vl_uint8 * codes,
+                             void const * data,
+                             vl_size numData) ;
+
+VL_EXPORT void vl_pq_decode (VlProductQuantizer const * self,
+                             void * data,
+                             vl_uint8 const * codes,
+                             vl_size numData) ;
+
+VL_EXPORT void vl_pq_compute_distance_table (VlProductQuantizer const * self,
+                                             void * table,
+                                             void const * query) ;
+
+VL_EXPORT void vl_pq_search (VlProductQuantizer const * self,
+                             vl_uint32 * indexes,
+                             vl_size numNeighbors,
+                             vl_size numQueries,
+                             void * distances,
+                             void const * queries,
+                             vl_uint8 const * codes,
+                             vl_size numCodes) ;
+
+VL_EXPORT void vl_pq_block_codes (VlProductQuantizer const * self,
+                                  vl_uint8 * blockedCodes,
+                                  vl_uint8 const * codes,
+                                  vl_size numCodes) ;
+
+VL_EXPORT void vl_pq_search_blocked (VlProductQuantizer const * self,
+                                     vl_uint32 * indexes,
+                                     vl_size numNeighbors,
+                                     vl_size numQueries,
+                                     void * distances,
+                                     void const * queries,
+                                     vl_uint8 const * blockedCodes,
+                                     vl_size numCodes) ;
+/** @} */
+
+/** @name Inverted file
+ ** @{
+ **/
+VL_EXPORT VlIVFPQ * vl_ivfpq_new (vl_type dataType,
+                                  vl_size dimension,
+                                  vl_size numLists,
+                                  vl_size numSubquantizers,
+                                  vl_size numCenters) ;
+VL_EXPORT void vl_ivfpq_delete (VlIVFPQ * self) ;
+
+VL_EXPORT double vl_ivfpq_train (VlIVFPQ * self,
+                                 void const * data,
+                                 vl_size numData) ;
+
+VL_EXPORT void vl_ivfpq_add (VlIVFPQ * self,
+                             void const * data,
+                             vl_size numData) ;
+
+VL_EXPORT void vl_ivfpq_search (VlIVFPQ const * self,
+                                vl_uint32 * indexes,
+                                vl_size numNeighbors,
+                                vl_size numQueries,
+                                void * distances,
+                                void const * queries) ;
+/** @} */
+
+/** @name Retrieve data and parameters
+ ** @{
+ **/
+VL_INLINE vl_type vl_pq_get_data_type (VlProductQuantizer const * self) ;
+VL_INLINE vl_size vl_pq_get_dimension (VlProductQuantizer const * self) ;
+VL_INLINE vl_size vl_pq_get_num_subquantizers (VlProductQuantizer const * self) ;
+VL_INLINE vl_size vl_pq_get_num_centers (VlProductQuantizer const * self) ;
+VL_INLINE void const * vl_pq_get_centers (VlProductQuantizer const * self) ;
+VL_INLINE vl_size vl_pq_get_blocked_codes_size (VlProductQuantizer const * self, vl_size numCodes) ;
+VL_INLINE vl_size vl_pq_get_max_num_iterations (VlProductQuantizer const * self) ;
+VL_INLINE int vl_pq_get_verbosity (VlProductQuantizer const * self) ;
+
+VL_INLINE VlProductQuantizer * vl_ivfpq_get_pq (VlIVFPQ const * self) ;
+VL_INLINE VlKMeans * vl_ivfpq_get_coarse_quantizer (VlIVFPQ const * self) ;
+VL_INLINE vl_size vl_ivfpq_get_num_lists (VlIVFPQ const * self) ;
+VL_INLINE vl_size vl_ivfpq_get_num_probes (VlIVFPQ const * self) ;
+VL_INLINE vl_size vl_ivfpq_get_num_entries (VlIVFPQ const * self) ;
+/** @} */
+
+/** @name Set parameters
+ ** @{
+ **/
+VL_INLINE void vl_pq_set_max_num_iterations (VlProductQuantizer * self, vl_size maxNumIterations) ;
+VL_INLINE void vl_pq_set_verbosity (VlProductQuantizer * self, int verbosity) ;
+VL_INLINE void vl_ivfpq_set_num_probes (VlIVFPQ * self, vl_size numProbes) ;
+/** @} */
+
+/* ---------------------------------------------------------------- */
+/*                                              Inline functions    */
+/* ---------------------------------------------------------------- */
+
+/** ------------------------------------------------------------------
+ ** @brief Get data type
+ ** @param self product quantizer.
+ ** @return data type.
+ **/
+
+VL_INLINE vl_type
+vl_pq_get_data_type (VlProductQuantizer const * self)
+{
+  return self->dataType ;
+}
+
+/** @brief Get data dimension
+ ** @param self product quantizer.
+ ** @return data dimension.
+ **/
+
+VL_INLINE vl_size
+vl_pq_get_dimension (VlProductQuantizer const * self)
+{
+  return self->dimension ;
+}
+
+/** @brief Get the number of sub-quantizers (M)
+ ** @param self product quantizer.
+ ** @return number of sub-quantizers, i.e. bytes per code.
+ **/
+
+VL_INLINE vl_size
+vl_pq_get_num_subquantizers (VlProductQuantizer const * self)
+{
+  return self->numSubquantizers ;
+}
+
+/** @brief Get the number of centers of each sub-quantizer
+ ** @param self product quantizer.
+ ** @return number of centers.
+ **/
+
+VL_INLINE vl_size
+vl_pq_get_num_centers (VlProductQuantizer const * self)
+{
+  return self->numCenters ;
+}
+
+/** @brief Get the sub-quantizer centers
+ ** @param self product quantizer.
+ ** @return centers.
+ **
+ ** The centers of sub-quantizer @c m are stored contiguously
+ ** starting at offset <code>m * numCenters * dimension /
+ ** numSubquantizers</code>.
+ **/
+
+VL_INLINE void const *
+vl_pq_get_centers (VlProductQuantizer const * self)
+{
+  return self->centers ;
+}
+
+/** @brief Get the size of codes in the blocked layout
+ ** @param self product quantizer.
+ ** @param numCodes number of codes.
+ ** @return size in bytes (see ::vl_pq_block_codes).
+ **/
+
+VL_INLINE vl_size
+vl_pq_get_blocked_codes_size (VlProductQuantizer const * self, vl_size numCodes)
+{
+  vl_size numBlocks = (numCodes + VL_PQ_FAST_SCAN_BLOCK_SIZE - 1) / VL_PQ_FAST_SCAN_BLOCK_SIZE ;
+  return numBlocks * VL_PQ_FAST_SCAN_BLOCK_SIZE * self->numSubquantizers ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get maximum number of k-means iterations
+ ** @param self product quantizer.
+ ** @return maximum number of iterations.
+ **/
+
+VL_INLINE vl_size
+vl_pq_get_max_num_iterations (VlProductQuantizer const * self)
+{
+  return self->maxNumIterations ;
+}
+
+/** @brief Set maximum number of k-means iterations
+ ** @param self product quantizer.
+ ** @param maxNumIterations maximum number of iterations.
+ **/
+
+VL_INLINE void
+vl_pq_set_max_num_iterations (VlProductQuantizer * self, vl_size maxNumIterations)
+{
+  self->maxNumIterations = maxNumIterations ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get verbosity level
+ ** @param self product quantizer.
+ ** @return verbosity level.
+ **/
+
+VL_INLINE int
+vl_pq_get_verbosity (VlProductQuantizer const * self)
+{
+  return self->verbosity ;
+}
+
+/** @brief Set verbosity level
+ ** @param self product quantizer.
+ ** @param verbosity verbosity level.
+ **/
+
+VL_INLINE void
+vl_pq_set_verbosity (VlProductQuantizer * self, int verbosity)
+{
+  self->verbosity = verbosity ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get the residual product quantizer
+ ** @param self inverted file.
+ ** @return product quantizer.
+ **/
+
+VL_INLINE VlProductQuantizer *
+vl_ivfpq_get_pq (VlIVFPQ const * self)
+{
+  return self->pq ;
+}
+
+/** @brief Get the coarse quantizer
+ ** @param self inverted file.
+ ** @return coarse quantizer.
+ **/
+
+VL_INLINE VlKMeans *
+vl_ivfpq_get_coarse_quantizer (VlIVFPQ const * self)
+{
+  return self->coarseQuantizer ;
+}
+
+/** @brief Get the number of inverted lists
+ ** @param self inverted file.
+ ** @return number of lists.
+ **/
+
+VL_INLINE vl_size
+vl_ivfpq_get_num_lists (VlIVFPQ const * self)
+{
+  return self->numLists ;
+}
+
+/** @brief Get the number of indexed vectors
+ ** @param self inverted file.
+ ** @return number of vectors.
+ **/
+
+VL_INLINE vl_size
+vl_ivfpq_get_num_entries (VlIVFPQ const * self)
+{
+  return self->numEntries ;
+}
+
+/** ------------------------------------------------------------------
+ ** @brief Get the number of lists visited by a query
+ ** @param self inverted file.
+ ** @return number of probes.
+ **/
+
+VL_INLINE vl_size
+vl_ivfpq_get_num_probes (VlIVFPQ const * self)
+{
+  return self->numProbes ;
+}
+
+/** @brief Set the number of lists visited by a query
+ ** @param self inverted file.
+ ** @param numProbes number of probes.
+ **
+ ** @a numProbes must be in the range 1 to the number of lists.
+ **/
+
+VL_INLINE void
+vl_ivfpq_set_num_probes (VlIVFPQ * self, vl_size numProbes)
+{
+  assert (numProbes >= 1) ;
+  assert (numProbes <= self->numLists) ;
+  self->numProbes = numProbes ;
+}
+
+/* VL_PQ_H */
+#endif
@@ -0,0 +1,68 @@
+/** @file pq_avx.c
+ ** @brief Product quantization for AVX - Definition
+ ** @author agent
+ **/
+
+/*
+Copyright (C) 2026 agent.
+All rights reserved.
+
+This file is part of the VLFeat library and is made available under
+the terms of the BSD license (see the COPYING file).
+*/
+
+#include "pq_avx.h"
+
+#ifndef VL_DISABLE_AVX
+
+#ifndef __AVX__
+#error Compiling AVX functions but AVX does not seem to be supported by the compiler.
+#endif
+
+#include <immintrin.h>
+
+/** @internal
+ ** @brief Sum 8-bit lookup tables over blocks of 16 codes
+ ** @param sums sums of each code (output).
+ ** @param blockedCodes codes in blocks of 16.
+ ** @param table 16-entry 8-bit table of each sub-quantizer.
+ ** @param numSubquantizers number of sub-quantizers.
+ ** @param numBlocks number of blocks.
+ **
+ ** A block stores the @c m-th byte of its 16 codes contiguously, for
+ ** each @c m in turn (@ref pq-fast-scan). The table of a sub-quantizer
+ ** fits in a register, so that the entries of 16 codes are looked up
+ ** by a single byte shuffle. The sums are accumulated in 16 bits,
+ ** which cannot overflow for up to 257 sub-quantizers.
+ **/
+
+void
+_vl_pq_fast_scan_avx (vl_uint16 * sums,
+                      vl_uint8 const * blockedCodes,
+                      vl_uint8 const * table,
+                      vl_size numSubquantizers,
+                      vl_size numBlocks)
+{
+  vl_uindex b, m ;
+  __m128i zero = _mm_setzero_si128() ;
+
+  for (b = 0 ; b < numBlocks ; ++b) {
+    __m128i lo = zero ;
+    __m128i hi = zero ;
+    vl_uint8 const * t = table ;
+    for (m = 0 ; m < numSubquantizers ; ++m) {
+      __m128i codes = _mm_loadu_si128((__m128i const *)blockedCodes) ;
+      __m128i entries = _mm_shuffle_epi8(_mm_loadu_si128((__m128i const *)t), codes) ;
+      lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(entries, zero)) ;
+      hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(entries, zero)) ;
+      blockedCodes += 16 ;
+      t += 16 ;
+    }
+    _mm_storeu_si128((__m128i *)sums, lo) ;
+    _mm_storeu_si128((__m128i *)(sums + 8), hi) ;
+    sums += 16 ;
+  }
+}
+
+/* ! VL_DISABLE_AVX */
+#endif
@@ -0,0 +1,32 @@
+/** @file pq_avx.h
+ ** @brief Product quantization for AVX
+ ** @author agent
+ **/
+
+/*
+Copyright (C) 2026 agent.
+All rights reserved.
+
+This file is part of the VLFeat library and is made available under
+the terms of the BSD license (see the COPYING file).
+*/
+
+#ifndef VL_PQ_AVX_H
+#define VL_PQ_AVX_H
+
+#include "generic.h"
+
+#ifndef VL_DISABLE_AVX
+
+VL_EXPORT void
+_vl_pq_fast_scan_avx (vl_uint16 * sums,
+                      vl_uint8 const * blockedCodes,
+                      vl_uint8 const * table,
+                      vl_size numSubquantizers,
+                      vl_size numBlocks) ;
+
+/* ! VL_DISABLE_AVX */
+#endif
+
+/* VL_PQ_AVX_H */
+#endif
@@ -45,6 +45,8 @@ implemented by VLFeat are given in:
 - @subpage svm-advanced - Loss functions, dual objective, and other details.
 - @subpage svm-sgd - The SGD algorithm.
 - @subpage svm-sdca - The SDCA algorithm.
+- @subpage svm-parallel - Multi-threaded SGD and SDCA.
+- @subpage svm-multiclass - Learning many one-vs-rest SVMs together.
 
 <!-- ------------------------------------------------------------- -->
 @section svm-starting Getting started
@@ -95,7 +97,9 @@ This code learns a binary linear SVM using the SGD algorithm on
 four two-dimensional points using 0.01 as regularization parameter.
 
 ::VlSvmSolverSdca can be specified in place of ::VlSvmSolverSdca
-in orer to use the SDCA algorithm instead.
+in orer to use the SDCA algorithm instead. ::VlSvmSolverSgdParallel
+and ::VlSvmSolverSdcaParallel run the same algorithms on several
+threads (@ref svm-parallel).
 
 Convergence and other diagnostic information can be obtained after
 training by using the ::vl_svm_get_statistics function. Algorithms
@@ -803,6 +807,67 @@ but it is otherwise identical.
 
 **/
 
+/**
+<!-- ------------------------------------------------------------- -->
+@page svm-parallel Multi-threaded solvers
+@tableofcontents
+<!-- ------------------------------------------------------------- -->
+
+::VlSvmSolverSgdParallel and ::VlSvmSolverSdcaParallel are
+multi-threaded versions of the @ref svm-sgd and @ref svm-sdca
+solvers, using up to ::vl_get_max_threads threads to learn a single
+model. They visit the data in the same order, take the same
+parameters, and report the same statistics to the diagnostic function
+(::vl_svm_set_diagnostic_function). ::VlSvmSolverSgd and
+::VlSvmSolverSdca are left unchanged and serve as a reference.
+
+Each epoch, the random permutation of the data is split among the
+threads, which update the shared model $\bw$ concurrently and
+*without locks*. Two threads conflict only when they write the same
+component of the model at the same time and, when they do, part of
+one update is lost; with many dimensions or sparse data this barely
+affects convergence [1,2]. Only the bias, a single shared number, is updated
+atomically. Note that, as a consequence, the inner product and
+accumulate functions are called concurrently, and must be
+reentrant. This is the case for ::VlSvmDataset.
+
+Diagnostic is run by a single thread after the threads have been
+synchronized, with the same frequency as the reference solvers
+(::vl_svm_set_diagnostic_frequency); the statistics are computed in
+parallel too.
+
+<!-- ------------------------------------------------------------ --->
+@section svm-parallel-sgd Parallel SGD
+<!-- ------------------------------------------------------------ --->
+
+The parallel SGD solver follows the *Hogwild!* scheme [1]. The
+factored representation of the model (@ref svm-sgd-details) is kept:
+the factor $f_t$ is shared and updated atomically by each iteration,
+and the learning rate $\eta_t$ of an iteration is determined by its
+position $t$ in the sequence of visits, as in the sequential
+algorithm.
+
+<!-- ------------------------------------------------------------ --->
+@section svm-parallel-sdca Parallel SDCA
+<!-- ------------------------------------------------------------ --->
+
+The parallel SDCA solver follows the *PASSCoDe-Wild* scheme [2]. Each
+dual variable $\alpha_i$ is updated by a single thread in each epoch,
+but the primal model is updated without locks and may therefore
+drift from its expression $\bw(\balpha)$ in terms of the dual
+variables. To make the duality gap a valid certificate of
+convergence, the model is recomputed from the dual variables (in
+parallel) before running diagnostic.
+
+[1] F. Niu, B. Recht, C. Re, and S. J. Wright. Hogwild!: A lock-free
+approach to parallelizing stochastic gradient descent. In
+<em>Proc. NIPS</em>, 2011.
+
+[2] C.-J. Hsieh, H.-F. Yu, and I. S. Dhillon. PASSCoDe: Parallel
+ASynchronous Stochastic dual Co-ordinate Descent. In <em>Proc.
+ICML</em>, 2015.
+**/
+
 /*
 
 <!-- ------------------------------------------------------------ --->
@@ -892,6 +957,10 @@ or the memory is limited.
 #include "mathop.h"
 #include <string.h>
 
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
 struct VlSvm_ {
   VlSvmSolverType solver ;      /**< SVM solver type. */
 
@@ -907,6 +976,7 @@ struct VlSvm_ {
   double const * labels ;       /**< Data labels. */
   double const * weights ;      /**< Data weights. */
 
+  VlSvmDataset * dataset ;      /**< Optional dataset. */
   VlSvmDataset * ownDataset ;   /**< Optional owned dataset. */
 
   VlSvmDiagnosticFunction diagnosticFn ;
@@ -991,6 +1061,7 @@ vl_svm_new_with_dataset (VlSvmSolverType solver,
   vl_svm_set_data_functions (self,
                              vl_svmdataset_get_inner_product_function(dataset),
                              vl_svmdataset_get_accumulate_function(dataset)) ;
+  self->dataset = dataset ;
   return self ;
 }
 
@@ -1062,7 +1133,7 @@ vl_svm_new_with_abstract_data (VlSvmSolverType solver,
   self->model = vl_calloc(dimension, sizeof(double)) ;
   if (self->model == NULL) goto err_alloc ;
 
-  if (self->solver == VlSvmSolverSdca) {
+  if (self->solver == VlSvmSolverSdca || self->solver == VlSvmSolverSdcaParallel) {
     self->alpha = vl_calloc(self->numData, sizeof(double)) ;
     if (self->alpha == NULL) goto err_alloc ;
   }
@@ -1104,6 +1175,10 @@ vl_svm_delete (VlSvm * self)
     vl_free (self->alpha) ;
     self->alpha = 0 ;
   }
+  if (self->scores) {
+    vl_free (self->scores) ;
+    self->scores = 0 ;
+  }
   if (self->ownDataset) {
     vl_svmdataset_delete(self->ownDataset) ;
     self->ownDataset = 0 ;
@@ -1870,8 +1945,18 @@ vl_svm_logistic_dca_update (double alpha, double inner, double norm2, double lab
 
 void _vl_svm_update_statistics (VlSvm *self)
 {
-  vl_size i, k ;
-  double inner, p ;
+  vl_size i, t ;
+  vl_bool isDual = (self->solver == VlSvmSolverSdca ||
+                    self->solver == VlSvmSolverSdcaParallel) ;
+  vl_size numThreads = 1 ;
+  double * partial ;
+
+  /* only the multi-threaded solvers require reentrant data functions */
+  if (self->solver == VlSvmSolverSgdParallel ||
+      self->solver == VlSvmSolverSdcaParallel) {
+    numThreads = vl_get_max_threads() ;
+  }
+  partial = vl_calloc(2 * numThreads, sizeof(double)) ;
 
   memset(&self->statistics, 0, sizeof(VlSvmStatistics)) ;
 
@@ -1881,23 +1966,40 @@ void _vl_svm_update_statistics (VlSvm *self)
   }
   self->statistics.regularizer *= self->lambda * 0.5 ;
 
-  for (k = 0; k < self->numData ; k++) {
-    p = (self->weights) ? self->weights[k] : 1.0 ;
-    if (p <= 0) continue ;
-    inner = self->innerProductFn(self->data, k, self->model) ;
-    inner += self->bias * self->biasMultiplier ;
-    self->scores[k] = inner ;
-    self->statistics.loss += p * self->lossFn(inner, self->labels[k]) ;
-    if (self->solver == VlSvmSolverSdca) {
-
-      self->statistics.dualLoss -= p * self->conjugateLossFn(- self->alpha[k] / p, self->labels[k]) ;
+  /* each thread sums its own losses, added in thread order below */
+#if defined(_OPENMP)
+#pragma omp parallel default(shared) num_threads(numThreads)
+#endif
+  {
+    vl_index k ;
+    double inner, p ;
+    double * sums = partial ;
+#if defined(_OPENMP)
+    sums += 2 * omp_get_thread_num() ;
+#pragma omp for schedule(static)
+#endif
+    for (k = 0; k < (signed)self->numData ; k++) {
+      p = (self->weights) ? self->weights[k] : 1.0 ;
+      if (p <= 0) continue ;
+      inner = self->innerProductFn(self->data, k, self->model) ;
+      inner += self->bias * self->biasMultiplier ;
+      self->scores[k] = inner ;
+      sums[0] += p * self->lossFn(inner, self->labels[k]) ;
+      if (isDual) {
+        sums[1] -= p * self->conjugateLossFn(- self->alpha[k] / p, self->labels[k]) ;
+      }
     }
   }
+  for (t = 0 ; t < numThreads ; ++t) {
+    self->statistics.loss += partial[2*t] ;
+    self->statistics.dualLoss += partial[2*t+1] ;
+  }
+  vl_free(partial) ;
 
   self->statistics.loss /= self->numData ;
   self->statistics.objective = self->statistics.regularizer + self->statistics.loss ;
 
-  if (self->solver == VlSvmSolverSdca) {
+  if (isDual) {
     self->statistics.dualLoss /= self->numData ;
     self->statistics.dualObjective = - self->statistics.regularizer + self->statistics.dualLoss ;
     self->statistics.dualityGap = self->statistics.objective - self->statistics.dualObjective ;
@@ -2141,6 +2243,325 @@ void _vl_svm_sgd_train (VlSvm *self)
   vl_free (permutation) ;
 }
 
+/* ---------------------------------------------------------------- */
+/*                                           Multi-threaded solvers */
+/* ---------------------------------------------------------------- */
+
+/** @internal @brief Get the end of a block of iterations
+ ** @param self object.
+ ** @param t first iteration of the block.
+ ** @return one past the last iteration of the block.
+ **
+ ** The multi-threaded solvers run the iterations in blocks, which end
+ ** with the epoch, when diagnostic is due, or when the maximum
+ ** number of iterations is reached. Hence a block visits each data
+ ** point at most once.
+ **/
+
+static vl_uindex
+_vl_svm_get_block_end (VlSvm const *self, vl_uindex t)
+{
+  vl_uindex end = t - t % self->numData + self->numData ;
+  end = VL_MIN(end, t - t % self->diagnosticFrequency + self->diagnosticFrequency) ;
+  end = VL_MIN(end, self->maxNumIterations) ;
+  return end ;
+}
+
+/** @internal @brief Recompute the SVM model from the dual variables
+ ** @param self object.
+ ** @param buffers a buffer of dimension @c self->dimension per thread.
+ ** @param numThreads number of threads.
+ **/
+
+static void
+_vl_svm_sdca_update_model (VlSvm *self, double * buffers, vl_size numThreads)
+{
+  vl_uindex i ;
+  double bias = 0 ;
+  double scale = 1.0 / (self->lambda * self->numData) ;
+
+  memset(buffers, 0, sizeof(double) * self->dimension * numThreads) ;
+  for (i = 0 ; i < self->numData ; ++i) {
+    bias += self->alpha[i] ;
+  }
+  self->bias = self->biasMultiplier * bias * scale ;
+
+#if defined(_OPENMP)
+#pragma omp parallel default(shared) num_threads(numThreads)
+#endif
+  {
+    vl_index j, k ;
+    vl_uindex t ;
+    double * buffer = buffers ;
+#if defined(_OPENMP)
+    buffer += self->dimension * omp_get_thread_num() ;
+#pragma omp for schedule(static)
+#endif
+    for (j = 0 ; j < (signed)self->numData ; ++j) {
+      if (self->alpha[j] != 0) {
+        self->accumulateFn(self->data, j, buffer, self->alpha[j]) ;
+      }
+    }
+    /* add the thread contributions in thread order */
+#if defined(_OPENMP)
+#pragma omp for schedule(static)
+#endif
+    for (k = 0 ; k < (signed)self->dimension ; ++k) {
+      double w = 0 ;
+      for (t = 0 ; t < numThreads ; ++t) {
+        w += buffers[t * self->dimension + k] ;
+      }
+      self->model[k] = w * scale ;
+    }
+  }
+}
+
+void _vl_svm_sdca_parallel_train (VlSvm *self)
+{
+  double * norm2 ;
+  double * buffers ;
+  vl_index * permutation ;
+  vl_uindex i, t ;
+  vl_size numThreads = vl_get_max_threads() ;
+
+  double startTime = vl_get_cpu_time () ;
+  VlRand * rand = vl_get_rand() ;
+
+  norm2 = (double*) vl_calloc(self->numData, sizeof(double));
+  permutation = vl_calloc(self->numData, sizeof(vl_index)) ;
+  buffers = vl_calloc(self->dimension * numThreads, sizeof(double)) ;
+
+  for (i = 0 ; i < self->numData ; ++i) {
+    permutation [i] = i ;
+  }
+
+#if defined(_OPENMP)
+#pragma omp parallel default(shared) num_threads(numThreads)
+#endif
+  {
+    vl_index j ;
+    double * buffer = buffers ;
+#if defined(_OPENMP)
+    buffer += self->dimension * omp_get_thread_num() ;
+#pragma omp for schedule(static)
+#endif
+    for (j = 0 ; j < (signed)self->numData ; ++j) {
+      double n2 ;
+      memset(buffer, 0, self->dimension * sizeof(double)) ;
+      self->accumulateFn (self->data, j, buffer, 1) ;
+      n2 = self->innerProductFn (self->data, j, buffer) ;
+      n2 += self->biasMultiplier * self->biasMultiplier ;
+      norm2[j] = n2 / (self->lambda * self->numData) ;
+    }
+  }
+
+  for (t = 0 ; 1 ; ) {
+    vl_uindex end = _vl_svm_get_block_end (self, t) ;
+    vl_index s ;
+
+    if (t % self->numData == 0) {
+      /* once a new epoch is reached (all data have been visited),
+       change permutation */
+      vl_rand_permute_indexes(rand, permutation, self->numData) ;
+    }
+
+    /* each dual variable is updated by a single thread, the model
+       is updated without locks */
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) schedule(static,1) num_threads(numThreads)
+#endif
+    for (s = t ; s < (signed)end ; ++s) {
+      vl_uindex j = permutation[s % self->numData] ;
+      double p = (self->weights) ? self->weights[j] : 1.0 ;
+      double inner, delta, multiplier, bias ;
+      if (p <= 0) continue ;
+#if defined(_OPENMP)
+#pragma omp atomic read
+#endif
+      bias = self->bias ;
+      inner = self->innerProductFn(self->data, j, self->model) ;
+      inner += bias * self->biasMultiplier ;
+      delta = p * self->dcaUpdateFn(self->alpha[j] / p, inner, p * norm2[j], self->labels[j]) ;
+      if (delta != 0) {
+        self->alpha[j] += delta ;
+        multiplier = delta / (self->numData * self->lambda) ;
+        self->accumulateFn(self->data, j, self->model, multiplier) ;
+#if defined(_OPENMP)
+#pragma omp atomic
+#endif
+        self->bias += self->biasMultiplier * multiplier ;
+      }
+    }
+    t = end ;
+
+    /* call diagnostic occasionally */
+    if (t % self->diagnosticFrequency == 0 || t == self->maxNumIterations) {
+      /* undo the effect of conflicting model updates */
+      _vl_svm_sdca_update_model (self, buffers, numThreads) ;
+      _vl_svm_update_statistics (self) ;
+      self->statistics.elapsedTime = vl_get_cpu_time() - startTime ;
+      self->statistics.iteration = t - 1 ;
+      self->statistics.epoch = (t - 1) / self->numData ;
+
+      self->statistics.status = VlSvmStatusTraining ;
+      if (self->statistics.dualityGap < self->epsilon) {
+        self->statistics.status = VlSvmStatusConverged ;
+      }
+      else if (t == self->maxNumIterations) {
+        self->statistics.status = VlSvmStatusMaxNumIterationsReached ;
+      }
+
+      if (self->diagnosticFn) {
+        self->diagnosticFn(self, self->diagnosticFnData) ;
+      }
+
+      if (self->statistics.status != VlSvmStatusTraining) {
+        break ;
+      }
+    }
+  } /* next block */
+
+  vl_free (norm2) ;
+  vl_free (buffers) ;
+  vl_free (permutation) ;
+}
+
+void _vl_svm_sgd_parallel_train (VlSvm *self)
+{
+  vl_index * permutation ;
+  double * scores ;
+  double * previousScores ;
+  vl_uindex i, t, k ;
+  double factor = 1.0 ;
+  double biasFactor = 1.0 ;
+  vl_index t0 = VL_MAX(2, vl_ceil_d(1.0 / self->lambda)) ;
+  vl_size numThreads = vl_get_max_threads() ;
+
+  double startTime = vl_get_cpu_time () ;
+  VlRand * rand = vl_get_rand() ;
+
+  permutation = vl_calloc(self->numData, sizeof(vl_index)) ;
+  scores = vl_calloc(self->numData * 2, sizeof(double)) ;
+  previousScores = scores + self->numData ;
+
+  for (i = 0 ; i < (unsigned)self->numData; i++) {
+    permutation [i] = i ;
+    previousScores [i] = - VL_INFINITY_D ;
+  }
+
+  /*
+   The model is stored as in the sequential solver as the product
+   factor * model. The factors are shared: each iteration shrinks
+   them atomically, and uses them to scale its update as they were
+   when the update was computed.
+   */
+
+  for (t = 0 ; 1 ; ) {
+    vl_uindex end = _vl_svm_get_block_end (self, t) ;
+    vl_index s ;
+
+    if (t % self->numData == 0) {
+      /* once a new epoch is reached (all data have been visited),
+       change permutation */
+      vl_rand_permute_indexes(rand, permutation, self->numData) ;
+    }
+
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) schedule(static,1) num_threads(numThreads)
+#endif
+    for (s = t ; s < (signed)end ; ++s) {
+      vl_uindex j = permutation[s % self->numData] ;
+      double p = (self->weights) ? self->weights[j] : 1.0 ;
+      double inner, gradient, rate, biasRate, shrink, biasShrink ;
+      double f, bf, bias ;
+      p = VL_MAX(0.0, p) ;
+
+#if defined(_OPENMP)
+#pragma omp atomic read
+#endif
+      f = factor ;
+#if defined(_OPENMP)
+#pragma omp atomic read
+#endif
+      bf = biasFactor ;
+#if defined(_OPENMP)
+#pragma omp atomic read
+#endif
+      bias = self->bias ;
+
+      inner = f * self->innerProductFn(self->data, j, self->model) ;
+      inner += bf * (self->biasMultiplier * bias) ;
+      gradient = p * self->lossDerivativeFn(inner, self->labels[j]) ;
+      previousScores[j] = scores[j] ;
+      scores[j] = inner ;
+
+      /* the learning rate depends on the position of the iteration */
+      rate = 1.0 / (self->lambda * (s + t0)) ;
+      biasRate = rate * self->biasLearningRate ;
+      shrink = 1.0 - self->lambda * rate ;
+      biasShrink = 1.0 - self->lambda * biasRate ;
+#if defined(_OPENMP)
+#pragma omp atomic
+#endif
+      factor *= shrink ;
+#if defined(_OPENMP)
+#pragma omp atomic
+#endif
+      biasFactor *= biasShrink ;
+
+      if (gradient != 0) {
+        self->accumulateFn(self->data, j, self->model, - gradient * rate / (f * shrink)) ;
+#if defined(_OPENMP)
+#pragma omp atomic
+#endif
+        self->bias += self->biasMultiplier * (- gradient * biasRate / (bf * biasShrink)) ;
+      }
+    }
+    t = end ;
+
+    /* call diagnostic occasionally */
+    if (t % self->diagnosticFrequency == 0 || t == self->maxNumIterations) {
+
+      /* realize factor before computing statistics or completing training */
+      for (k = 0 ; k < self->dimension ; ++k) self->model[k] *= factor ;
+      self->bias *= biasFactor;
+      factor = 1.0 ;
+      biasFactor = 1.0 ;
+
+      _vl_svm_update_statistics (self) ;
+
+      for (k = 0 ; k < self->numData ; ++k) {
+        double delta = scores[k] - previousScores[k] ;
+        self->statistics.scoresVariation += delta * delta ;
+      }
+      self->statistics.scoresVariation = sqrt(self->statistics.scoresVariation) / self->numData ;
+
+      self->statistics.elapsedTime = vl_get_cpu_time() - startTime ;
+      self->statistics.iteration = t - 1 ;
+      self->statistics.epoch = (t - 1) / self->numData ;
+
+      self->statistics.status = VlSvmStatusTraining ;
+      if (self->statistics.scoresVariation < self->epsilon) {
+        self->statistics.status = VlSvmStatusConverged ;
+      }
+      else if (t == self->maxNumIterations) {
+        self->statistics.status = VlSvmStatusMaxNumIterationsReached ;
+      }
+
+      if (self->diagnosticFn) {
+        self->diagnosticFn(self, self->diagnosticFnData) ;
+      }
+
+      if (self->statistics.status != VlSvmStatusTraining) {
+        break ;
+      }
+    }
+  } /* next block */
+
+  vl_free (scores) ;
+  vl_free (permutation) ;
+}
+
 /* ---------------------------------------------------------------- */
 /*                                                       Dispatcher */
 /* ---------------------------------------------------------------- */
@@ -2156,6 +2577,10 @@ void _vl_svm_sgd_train (VlSvm *self)
 void vl_svm_train (VlSvm * self)
 {
   assert (self) ;
+  /* the number of threads may have grown since the dataset was set up */
+  if (self->dataset) {
+    _vl_svmdataset_reserve_hom_buffers (self->dataset, vl_get_max_threads()) ;
+  }
   switch (self->solver) {
     case VlSvmSolverSdca:
       _vl_svm_sdca_train(self) ;
@@ -2163,6 +2588,12 @@ void vl_svm_train (VlSvm * self)
     case VlSvmSolverSgd:
       _vl_svm_sgd_train(self) ;
       break ;
+    case VlSvmSolverSdcaParallel:
+      _vl_svm_sdca_parallel_train(self) ;
+      break ;
+    case VlSvmSolverSgdParallel:
+      _vl_svm_sgd_parallel_train(self) ;
+      break ;
     case VlSvmSolverNone:
       _vl_svm_evaluate(self) ;
       break ;
@@ -39,7 +39,9 @@ typedef enum
 {
   VlSvmSolverNone = 0, /**< No solver (used to evaluate an SVM). */
   VlSvmSolverSgd = 1,  /**< SGD algorithm (@ref svm-sgd). */
-  VlSvmSolverSdca      /**< SDCA algorithm (@ref svm-sdca). */
+  VlSvmSolverSdca,     /**< SDCA algorithm (@ref svm-sdca). */
+  VlSvmSolverSgdParallel, /**< Multi-threaded SGD algorithm (@ref svm-parallel). */
+  VlSvmSolverSdcaParallel /**< Multi-threaded SDCA algorithm (@ref svm-parallel). */
 } VlSvmSolverType ;
 
 /** @brief Type of SVM loss
@@ -52,6 +52,8 @@ that its use with the SVM solver ::VlSvm is entirely optional).
 Presently, ::VlSvmDataset supports:
 
 - @c float and @c double dense arrays.
+- @c float and @c double sparse arrays, 8-bit integer arrays, and
+  product quantized data (see @ref svmdataset-storage).
 - The on-the-fly application of the homogeneous kernel map to implement
   additive non-linear kernels (see @ref homkermap).
 
@@ -91,6 +93,29 @@ int main()
 }
 @endcode
 
+<!-- ------------------------------------------------------------- -->
+@section svmdataset-storage Sparse and compressed data
+<!-- ------------------------------------------------------------- -->
+
+Large datasets may not fit in memory as dense arrays. Since the SVM
+solvers access the data only by inner products and accumulations,
+these can be computed from a more compact representation directly,
+without expanding the data points:
+
+- ::vl_svmdataset_new_sparse wraps data in compressed sparse row
+  format. The cost of the two operations is proportional to the
+  number of non-zero values. The homogeneous kernel map can be used
+  with sparse data, since it maps zeros to zeros.
+- ::vl_svmdataset_new_int8 wraps data quantized to 8-bit integers
+  with a scale per data point, as computed by
+  ::vl_svmdataset_quantize_int8, using a quarter of the memory of
+  @c float data.
+- ::vl_svmdataset_new_pq wraps the codes of a product quantizer (see
+  @ref pq), using one byte per sub-vector. The data points are
+  the concatenation of the corresponding sub-quantizer centers.
+
+The model is learned in the space of the decoded data points, and can
+be applied to data in any of these formats.
 **/
 
 /* ---------------------------------------------------------------- */
@@ -98,19 +123,52 @@ int main()
 /* ---------------------------------------------------------------- */
 
 #include "svmdataset.h"
+#include "mathop.h"
 #include <string.h>
 #include <math.h>
 
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+/* how the data is stored */
+typedef enum _VlSvmDatasetStorage
+{
+  VlSvmDatasetDense,                /* dense matrix */
+  VlSvmDatasetSparse,               /* compressed sparse rows */
+  VlSvmDatasetPQ,                   /* product quantization codes */
+  VlSvmDatasetInt8                  /* 8-bit integers with a scale per data point */
+} VlSvmDatasetStorage ;
+
 struct VlSvmDataset_ {
   vl_type dataType ;                /**< Data type. */
-  void * data ;                     /**< Pointer to data. */
+  VlSvmDatasetStorage storage ;     /**< Data storage. */
+  void * data ;                     /**< Pointer to data (values or codes). */
+  vl_uindex const * offsets ;       /**< Sparse data: offset of each data point. */
+  vl_uint32 const * indexes ;       /**< Sparse data: dimension of each value. */
+  VlProductQuantizer const * pq ;   /**< PQ data: product quantizer. */
+  float const * scales ;            /**< 8-bit data: scale of each data point. */
   vl_size numData ;                 /**< Number of wrapped data. */
   vl_size dimension ;               /**< Data point dimension. */
   VlHomogeneousKernelMap * hom ;    /**< Homogeneous kernel map (optional). */
-  void * homBuffer ;                /**< Homogeneous kernel map buffer. */
+  void * homBuffer ;                /**< Homogeneous kernel map buffers. */
+  vl_size homNumBuffers ;           /**< Number of buffers (one per thread). */
   vl_size homDimension ;            /**< Homogeneous kernel map dimension. */
 } ;
 
+/* Get the feature map buffer of the calling thread. */
+static void *
+_vl_svmdataset_get_hom_buffer (VlSvmDataset const * self)
+{
+  vl_uindex thread = 0 ;
+#if defined(_OPENMP)
+  thread = omp_get_thread_num() ;
+#endif
+  assert (thread < self->homNumBuffers) ;
+  return (char*)self->homBuffer
+    + thread * self->homDimension * vl_get_type_size(self->dataType) ;
+}
+
 /* templetized parts of the implementation */
 #define FLT VL_TYPE_FLOAT
 #define VL_SVMDATASET_INSTANTIATING
@@ -120,6 +178,37 @@ struct VlSvmDataset_ {
 #define VL_SVMDATASET_INSTANTIATING
 #include "svmdataset.c"
 
+/* 8-bit data: the integers are scaled once per data point */
+
+double
+_vl_svmdataset_inner_product_int8 (VlSvmDataset const *self,
+                                   vl_uindex element,
+                                   double const *model)
+{
+  double product = 0 ;
+  signed char const * data = (signed char const *)self->data + self->dimension * element ;
+  signed char const * end = data + self->dimension ;
+  while (data != end) {
+    product += (*data++) * (*model++) ;
+  }
+  return product * self->scales[element] ;
+}
+
+void
+vl_svmdataset_accumulate_int8 (VlSvmDataset const *self,
+                               vl_uindex element,
+                               double *model,
+                               const double multiplier)
+{
+  signed char const * data = (signed char const *)self->data + self->dimension * element ;
+  signed char const * end = data + self->dimension ;
+  double scaledMultiplier = multiplier * self->scales[element] ;
+  while (data != end) {
+    *model += (*data++) * scaledMultiplier ;
+    model++ ;
+  }
+}
+
 /** @brief Create a new object wrapping a dataset.
  ** @param dataType of data (@c float and @c double supported).
  ** @param data pointer to the data.
@@ -145,6 +234,7 @@ vl_svmdataset_new (vl_type dataType, void *data, vl_size dimension, vl_size numD
   if (self == NULL) return NULL ;
 
   self->dataType = dataType ;
+  self->storage = VlSvmDatasetDense ;
   self->data = data ;
   self->dimension = dimension ;
   self->numData = numData ;
@@ -153,6 +243,133 @@ vl_svmdataset_new (vl_type dataType, void *data, vl_size dimension, vl_size numD
   return self ;
 }
 
+/** @brief Create a new object wrapping a sparse dataset.
+ ** @param dataType of the values (@c float and @c double supported).
+ ** @param values non-zero values of the data.
+ ** @param indexes dimension of each value.
+ ** @param offsets offset of the first value of each data vector.
+ ** @param dimension the dimension of a data vector.
+ ** @param numData number of wrapped data vectors.
+ ** @return new object.
+ **
+ ** The data is in compressed sparse row format: the non-zero values
+ ** of the data vector @c i are <code>values[offsets[i]]</code> to
+ ** <code>values[offsets[i+1]-1]</code>, and @a indexes contains
+ ** their dimensions. Hence @a offsets has @a numData + 1 elements.
+ ** As for ::vl_svmdataset_new, no copy of the data is made.
+ **
+ ** @sa @ref svmdataset-storage
+ **/
+
+VlSvmDataset*
+vl_svmdataset_new_sparse (vl_type dataType,
+                          void const *values,
+                          vl_uint32 const *indexes,
+                          vl_uindex const *offsets,
+                          vl_size dimension, vl_size numData)
+{
+  VlSvmDataset * self ;
+  assert(indexes) ;
+  assert(offsets) ;
+  self = vl_svmdataset_new (dataType, (void*)values, dimension, numData) ;
+  if (self == NULL) return NULL ;
+  self->storage = VlSvmDatasetSparse ;
+  self->indexes = indexes ;
+  self->offsets = offsets ;
+  return self ;
+}
+
+/** @brief Create a new object wrapping a product quantized dataset.
+ ** @param pq product quantizer.
+ ** @param codes PQ codes of the data.
+ ** @param numData number of wrapped data vectors.
+ ** @return new object.
+ **
+ ** @a codes are computed by ::vl_pq_encode. The SVM operates on the
+ ** decoded data vectors, whose dimension is the one of @a pq, but
+ ** these are never expanded in memory. Neither @a pq nor @a codes
+ ** are copied.
+ **
+ ** @sa @ref svmdataset-storage
+ **/
+
+VlSvmDataset*
+vl_svmdataset_new_pq (VlProductQuantizer const * pq,
+                      vl_uint8 const * codes,
+                      vl_size numData)
+{
+  VlSvmDataset * self ;
+  assert(pq) ;
+  self = vl_svmdataset_new (pq->dataType, (void*)codes, pq->dimension, numData) ;
+  if (self == NULL) return NULL ;
+  self->storage = VlSvmDatasetPQ ;
+  self->pq = pq ;
+  return self ;
+}
+
+/** @brief Create a new object wrapping an 8-bit dataset.
+ ** @param codes 8-bit integer data.
+ ** @param scales scale of each data vector.
+ ** @param dimension the dimension of a data vector.
+ ** @param numData number of wrapped data vectors.
+ ** @return new object.
+ **
+ ** The data vector @c i is the column @c i of the @a dimension x
+ ** @a numData matrix @a codes times <code>scales[i]</code>. The
+ ** codes can be computed by ::vl_svmdataset_quantize_int8. Neither
+ ** @a codes nor @a scales are copied.
+ **
+ ** @sa @ref svmdataset-storage
+ **/
+
+VlSvmDataset*
+vl_svmdataset_new_int8 (vl_int8 const * codes,
+                        float const * scales,
+                        vl_size dimension, vl_size numData)
+{
+  VlSvmDataset * self ;
+  assert(scales) ;
+  self = vl_svmdataset_new (VL_TYPE_FLOAT, (void*)codes, dimension, numData) ;
+  if (self == NULL) return NULL ;
+  self->storage = VlSvmDatasetInt8 ;
+  self->scales = scales ;
+  return self ;
+}
+
+/** @brief Quantize data to 8-bit integers.
+ ** @param codes 8-bit integer data (output).
+ ** @param scales scale of each data vector (output).
+ ** @param dataType of data (@c float and @c double supported).
+ ** @param data data to quantize.
+ ** @param dimension the dimension of a data vector.
+ ** @param numData number of data vectors.
+ **
+ ** Each data vector is divided by its largest absolute value over
+ ** 127 and rounded, so that the quantization error of a component is
+ ** at most half this scale.
+ **
+ ** @sa ::vl_svmdataset_new_int8
+ **/
+
+void
+vl_svmdataset_quantize_int8 (vl_int8 * codes,
+                             float * scales,
+                             vl_type dataType,
+                             void const * data,
+                             vl_size dimension, vl_size numData)
+{
+  switch (dataType) {
+    case VL_TYPE_FLOAT:
+      _vl_svmdataset_quantize_int8_f ((signed char*)codes, scales, data, dimension, numData) ;
+      break ;
+    case VL_TYPE_DOUBLE:
+      _vl_svmdataset_quantize_int8_d ((signed char*)codes, scales, data, dimension, numData) ;
+      break ;
+    default:
+      abort() ;
+  }
+}
+
 /** @brief Delete the object.
  ** @param self object to delete.
  **
@@ -228,6 +445,13 @@ vl_svmdataset_get_homogeneous_kernel_map (VlSvmDataset const *self)
  **
  ** Set this to @c NULL to avoid using a kernel map.
  **
+ ** The feature map is evaluated in a separate buffer for each thread,
+ ** so that the data functions can be used by the multi-threaded
+ ** solvers (@ref svm-parallel) with up to ::vl_get_max_threads
+ ** threads, as set when this function is called. ::VlSvm and
+ ** ::VlSvmMulticlass add buffers when training starts if the number
+ ** of threads has grown since.
+ **
  ** Note that this does *not* transfer the ownership of the object
  ** to the function. Furthermore, ::VlSvmDataset holds to the
  ** object until it is destroyed or the object is replaced or removed
@@ -239,15 +463,85 @@ vl_svmdataset_set_homogeneous_kernel_map (VlSvmDataset * self,
                                           VlHomogeneousKernelMap * hom)
 {
   assert(self) ;
+  assert(hom == NULL ||
+         self->storage == VlSvmDatasetDense ||
+         self->storage == VlSvmDatasetSparse) ;
   self->hom = hom ;
   self->homDimension = 0 ;
   if (self->homBuffer) {
     vl_free (self->homBuffer) ;
     self->homBuffer = 0 ;
   }
+  self->homNumBuffers = 0 ;
   if (self->hom) {
     self->homDimension = vl_homogeneouskernelmap_get_dimension(self->hom) ;
-    self->homBuffer = vl_calloc(self->homDimension, vl_get_type_size(self->dataType)) ;
+    _vl_svmdataset_reserve_hom_buffers (self, vl_get_max_threads()) ;
+  }
+}
+
+/** @internal @brief Make room for the feature maps of several threads
+ ** @param self object.
+ ** @param numThreads number of threads calling the data functions.
+ **
+ ** The buffers are reallocated only if there are fewer than @a
+ ** numThreads of them. This must not happen while the data
+ ** functions are in use, hence the solvers call this function
+ ** before training.
+ **/
+
+void
+_vl_svmdataset_reserve_hom_buffers (VlSvmDataset * self, vl_size numThreads)
+{
+  assert(self) ;
+  if (self->hom == NULL || numThreads <= self->homNumBuffers) return ;
+  if (self->homBuffer) {
+    vl_free (self->homBuffer) ;
+  }
+  self->homNumBuffers = numThreads ;
+  self->homBuffer = vl_calloc(self->homDimension * self->homNumBuffers,
+                              vl_get_type_size(self->dataType)) ;
+}
+
+/** @internal @brief Check whether the data points can be read directly
+ ** @param self object.
+ ** @return @c true if the data is a dense matrix without a feature map.
+ **
+ ** In this case the inner products and accumulations are plain linear
+ ** algebra on the points returned by ::_vl_svmdataset_get_point_d.
+ **/
+
+vl_bool
+_vl_svmdataset_is_dense (VlSvmDataset const * self)
+{
+  assert(self) ;
+  return self->storage == VlSvmDatasetDense && self->hom == NULL ;
+}
+
+/** @internal @brief Copy a data point of a dense dataset
+ ** @param self object.
+ ** @param i index of the data point.
+ ** @param x data point (output, @c dimension elements).
+ ** @sa ::_vl_svmdataset_is_dense
+ **/
+
+void
+_vl_svmdataset_get_point_d (VlSvmDataset const * self, vl_uindex i, double * x)
+{
+  vl_uindex d ;
+  assert(_vl_svmdataset_is_dense(self)) ;
+  assert(i < self->numData) ;
+  switch (self->dataType) {
+    case VL_TYPE_FLOAT : {
+      float const * y = (float const*)self->data + i * self->dimension ;
+      for (d = 0 ; d < self->dimension ; ++d) x[d] = y[d] ;
+      break ;
+    }
+    case VL_TYPE_DOUBLE :
+      memcpy(x, (double const*)self->data + i * self->dimension,
+             sizeof(double) * self->dimension) ;
+      break ;
+    default :
+      abort() ;
   }
 }
 
@@ -259,6 +553,30 @@ vl_svmdataset_set_homogeneous_kernel_map (VlSvmDataset * self,
 VlSvmAccumulateFunction
 vl_svmdataset_get_accumulate_function(VlSvmDataset const *self)
 {
+  switch (self->storage) {
+    case VlSvmDatasetPQ:
+      switch (self->dataType) {
+        case VL_TYPE_FLOAT:
+          return (VlSvmAccumulateFunction) vl_svmdataset_accumulate_pq_f ;
+        case VL_TYPE_DOUBLE:
+          return (VlSvmAccumulateFunction) vl_svmdataset_accumulate_pq_d ;
+      }
+      break ;
+    case VlSvmDatasetInt8:
+      return (VlSvmAccumulateFunction) vl_svmdataset_accumulate_int8 ;
+    case VlSvmDatasetSparse:
+      switch (self->dataType) {
+        case VL_TYPE_FLOAT:
+          return (VlSvmAccumulateFunction)
+          ((self->hom) ? vl_svmdataset_accumulate_sparse_hom_f : vl_svmdataset_accumulate_sparse_f) ;
+        case VL_TYPE_DOUBLE:
+          return (VlSvmAccumulateFunction)
+          ((self->hom) ? vl_svmdataset_accumulate_sparse_hom_d : vl_svmdataset_accumulate_sparse_d) ;
+      }
+      break ;
+    case VlSvmDatasetDense:
+      break ;
+  }
   if (self->hom == NULL) {
     switch (self->dataType) {
       case VL_TYPE_FLOAT:
@@ -290,6 +608,30 @@ vl_svmdataset_get_accumulate_function(VlSvmDataset const *self)
 VlSvmInnerProductFunction
 vl_svmdataset_get_inner_product_function (VlSvmDataset const *self)
 {
+  switch (self->storage) {
+    case VlSvmDatasetPQ:
+      switch (self->dataType) {
+        case VL_TYPE_FLOAT:
+          return (VlSvmInnerProductFunction) _vl_svmdataset_inner_product_pq_f ;
+        case VL_TYPE_DOUBLE:
+          return (VlSvmInnerProductFunction) _vl_svmdataset_inner_product_pq_d ;
+      }
+      break ;
+    case VlSvmDatasetInt8:
+      return (VlSvmInnerProductFunction) _vl_svmdataset_inner_product_int8 ;
+    case VlSvmDatasetSparse:
+      switch (self->dataType) {
+        case VL_TYPE_FLOAT:
+          return (VlSvmInnerProductFunction)
+          ((self->hom) ? _vl_svmdataset_inner_product_sparse_hom_f : _vl_svmdataset_inner_product_sparse_f) ;
+        case VL_TYPE_DOUBLE:
+          return (VlSvmInnerProductFunction)
+          ((self->hom) ? _vl_svmdataset_inner_product_sparse_hom_d : _vl_svmdataset_inner_product_sparse_d) ;
+      }
+      break ;
+    case VlSvmDatasetDense:
+      break ;
+  }
   if (self->hom == NULL) {
     switch (self->dataType) {
       case VL_TYPE_FLOAT:
@@ -362,12 +704,13 @@ VL_XCAT(_vl_svmdataset_inner_product_hom_,SFX) (VlSvmDataset const *self,
   double product = 0 ;
   T* data = ((T*)self->data) + self->dimension * element ;
   T* end = data + self->dimension ;
-  T* bufEnd = ((T*)self->homBuffer)+ self->homDimension ;
+  T* homBuffer = _vl_svmdataset_get_hom_buffer(self) ;
+  T* bufEnd = homBuffer + self->homDimension ;
   while (data != end) {
     /* TODO: zeros in data could be optimized by skipping over them */
-    T* buf = self->homBuffer ;
+    T* buf = homBuffer ;
     VL_XCAT(vl_homogeneouskernelmap_evaluate_,SFX)(self->hom,
-                                                   self->homBuffer,
+                                                   homBuffer,
                                                    1,
                                                    (*data++)) ;
     while (buf != bufEnd) {
@@ -385,12 +728,13 @@ VL_XCAT(vl_svmdataset_accumulate_hom_,SFX)(VlSvmDataset const *self,
 {
   T* data = ((T*)self->data) + self->dimension * element ;
   T* end = data + self->dimension ;
-  T* bufEnd = ((T*)self->homBuffer)+ self->homDimension ;
+  T* homBuffer = _vl_svmdataset_get_hom_buffer(self) ;
+  T* bufEnd = homBuffer + self->homDimension ;
   while (data != end) {
     /* TODO: zeros in data could be optimized by skipping over them */
-    T* buf = self->homBuffer ;
+    T* buf = homBuffer ;
     VL_XCAT(vl_homogeneouskernelmap_evaluate_,SFX)(self->hom,
-                                                   self->homBuffer,
+                                                   homBuffer,
                                                    1,
                                                    (*data++)) ;
     while (buf != bufEnd) {
@@ -400,6 +744,140 @@ VL_XCAT(vl_svmdataset_accumulate_hom_,SFX)(VlSvmDataset const *self,
   }
 }
 
+double
+VL_XCAT(_vl_svmdataset_inner_product_sparse_,SFX) (VlSvmDataset const *self,
+                                                   vl_uindex element,
+                                                   double const *model)
+{
+  double product = 0 ;
+  vl_uindex k ;
+  T const * values = self->data ;
+  for (k = self->offsets[element] ; k < self->offsets[element + 1] ; ++k) {
+    product += values[k] * model[self->indexes[k]] ;
+  }
+  return product ;
+}
+
+void
+VL_XCAT(vl_svmdataset_accumulate_sparse_,SFX)(VlSvmDataset const *self,
+                                              vl_uindex element,
+                                              double *model,
+                                              const double multiplier)
+{
+  vl_uindex k ;
+  T const * values = self->data ;
+  for (k = self->offsets[element] ; k < self->offsets[element + 1] ; ++k) {
+    model[self->indexes[k]] += values[k] * multiplier ;
+  }
+}
+
+/* the homogeneous kernel maps vanish at zero, so that the zeros of
+   sparse data can be skipped */
+
+double
+VL_XCAT(_vl_svmdataset_inner_product_sparse_hom_,SFX) (VlSvmDataset const *self,
+                                                       vl_uindex element,
+                                                       double const *model)
+{
+  double product = 0 ;
+  vl_uindex k, h ;
+  T const * values = self->data ;
+  T* homBuffer = _vl_svmdataset_get_hom_buffer(self) ;
+  for (k = self->offsets[element] ; k < self->offsets[element + 1] ; ++k) {
+    double const * w = model + self->indexes[k] * self->homDimension ;
+    VL_XCAT(vl_homogeneouskernelmap_evaluate_,SFX)(self->hom, homBuffer, 1, values[k]) ;
+    for (h = 0 ; h < self->homDimension ; ++h) {
+      product += homBuffer[h] * w[h] ;
+    }
+  }
+  return product ;
+}
+
+void
+VL_XCAT(vl_svmdataset_accumulate_sparse_hom_,SFX)(VlSvmDataset const *self,
+                                                  vl_uindex element,
+                                                  double *model,
+                                                  const double multiplier)
+{
+  vl_uindex k, h ;
+  T const * values = self->data ;
+  T* homBuffer = _vl_svmdataset_get_hom_buffer(self) ;
+  for (k = self->offsets[element] ; k < self->offsets[element + 1] ; ++k) {
+    double * w = model + self->indexes[k] * self->homDimension ;
+    VL_XCAT(vl_homogeneouskernelmap_evaluate_,SFX)(self->hom, homBuffer, 1, values[k]) ;
+    for (h = 0 ; h < self->homDimension ; ++h) {
+      w[h] += homBuffer[h] * multiplier ;
+    }
+  }
+}
+
+/* product quantized data: the data points are sums of sub-quantizer
+   centers, the sub-vectors of model are dotted with them */
+
+double
+VL_XCAT(_vl_svmdataset_inner_product_pq_,SFX) (VlSvmDataset const *self,
+                                               vl_uindex element,
+                                               double const *model)
+{
+  double product = 0 ;
+  vl_uindex m, d ;
+  vl_size sd = self->pq->subdimension ;
+  vl_size K = self->pq->numCenters ;
+  vl_uint8 const * code = (vl_uint8 const *)self->data + element * self->pq->numSubquantizers ;
+  T const * centers = self->pq->centers ;
+  for (m = 0 ; m < self->pq->numSubquantizers ; ++m) {
+    T const * c = centers + (m * K + code[m]) * sd ;
+    for (d = 0 ; d < sd ; ++d) {
+      product += c[d] * model[d] ;
+    }
+    model += sd ;
+  }
+  return product ;
+}
+
+void
+VL_XCAT(vl_svmdataset_accumulate_pq_,SFX)(VlSvmDataset const *self,
+                                          vl_uindex element,
+                                          double *model,
+                                          const double multiplier)
+{
+  vl_uindex m, d ;
+  vl_size sd = self->pq->subdimension ;
+  vl_size K = self->pq->numCenters ;
+  vl_uint8 const * code = (vl_uint8 const *)self->data + element * self->pq->numSubquantizers ;
+  T const * centers = self->pq->centers ;
+  for (m = 0 ; m < self->pq->numSubquantizers ; ++m) {
+    T const * c = centers + (m * K + code[m]) * sd ;
+    for (d = 0 ; d < sd ; ++d) {
+      model[d] += c[d] * multiplier ;
+    }
+    model += sd ;
+  }
+}
+
+static void
+VL_XCAT(_vl_svmdataset_quantize_int8_,SFX)(signed char * codes,
+                                           float * scales,
+                                           T const * data,
+                                           vl_size dimension,
+                                           vl_size numData)
+{
+  vl_uindex i, d ;
+  for (i = 0 ; i < numData ; ++i) {
+    T const * x = data + i * dimension ;
+    double maxValue = 0 ;
+    double scale ;
+    for (d = 0 ; d < dimension ; ++d) {
+      maxValue = VL_MAX(maxValue, VL_XCAT(vl_abs_,SFX)(x[d])) ;
+    }
+    scale = (maxValue > 0) ? maxValue / 127 : 1 ;
+    scales[i] = (float) scale ;
+    for (d = 0 ; d < dimension ; ++d) {
+      codes[i * dimension + d] = (signed char) vl_round_d(x[d] / scale) ;
+    }
+  }
+}
+
 #undef FLT
 #undef VL_SVMDATASET_INSTANTIATING
 
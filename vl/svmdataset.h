@@ -18,6 +18,7 @@ the terms of the BSD license (see the COPYING file).
 
 #include "generic.h"
 #include "homkermap.h"
+#include "pq.h"
 
 struct VlSvm_ ;
 
@@ -53,6 +54,17 @@ typedef void (*VlSvmAccumulateFunction) (const void *data, vl_uindex element, do
  ** @{
  **/
 VL_EXPORT VlSvmDataset* vl_svmdataset_new (vl_type dataType, void *data, vl_size dimension, vl_size numData) ;
+VL_EXPORT VlSvmDataset* vl_svmdataset_new_sparse (vl_type dataType,
+                                                  void const *values,
+                                                  vl_uint32 const *indexes,
+                                                  vl_uindex const *offsets,
+                                                  vl_size dimension, vl_size numData) ;
+VL_EXPORT VlSvmDataset* vl_svmdataset_new_pq (VlProductQuantizer const *pq,
+                                              vl_uint8 const *codes,
+                                              vl_size numData) ;
+VL_EXPORT VlSvmDataset* vl_svmdataset_new_int8 (vl_int8 const *codes,
+                                                float const *scales,
+                                                vl_size dimension, vl_size numData) ;
 VL_EXPORT void vl_svmdataset_delete (VlSvmDataset * dataset) ;
 /** @} */
 
@@ -61,6 +73,21 @@ VL_EXPORT void vl_svmdataset_delete (VlSvmDataset * dataset) ;
  **/
 VL_EXPORT void vl_svmdataset_set_homogeneous_kernel_map (VlSvmDataset * self,
                                                          VlHomogeneousKernelMap * hom) ;
+VL_EXPORT void _vl_svmdataset_reserve_hom_buffers (VlSvmDataset * self,
+                                                   vl_size numThreads) ;
+VL_EXPORT vl_bool _vl_svmdataset_is_dense (VlSvmDataset const * self) ;
+VL_EXPORT void _vl_svmdataset_get_point_d (VlSvmDataset const * self,
+                                           vl_uindex i, double * x) ;
+/** @} */
+
+/** @name Compress data
+ ** @{
+ **/
+VL_EXPORT void vl_svmdataset_quantize_int8 (vl_int8 * codes,
+                                            float * scales,
+                                            vl_type dataType,
+                                            void const * data,
+                                            vl_size dimension, vl_size numData) ;
 /** @} */
 
 /** @name Get data and parameters
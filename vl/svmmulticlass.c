@@ -0,0 +1,1276 @@
+/** @file svmmulticlass.c
+ ** @brief Multi-class SVM - Definition
+ ** @author agent
+ **/
+
+/*
+Copyright (C) 2026 agent.
+All rights reserved.
+
+This file is part of the VLFeat library and is made available under
+the terms of the BSD license (see the COPYING file).
+*/
+
+/**
+<!-- ------------------------------------------------------------- -->
+@page svm-multiclass Multi-class SVMs
+@tableofcontents
+<!-- ------------------------------------------------------------- -->
+
+::VlSvmMulticlass learns the one-vs-rest linear SVMs of several
+classes at once. Training the classes one by one with ::VlSvm reads
+the whole training set once per class, and with many classes and
+large data this is limited by the memory bandwidth. Instead,
+::VlSvmMulticlass reads the data in *mini-batches*
+(::vl_svmmulticlass_set_batch_size) and, while a batch is in the
+cache, scores it against all the models and updates all the models
+together. Thus the data is read from memory about once per epoch
+rather than once per class.
+
+@code
+VlSvmDataset * dataset = vl_svmdataset_new (VL_TYPE_FLOAT, x, dimension, numData) ;
+VlSvmMulticlass * svm = vl_svmmulticlass_new (VlSvmSolverSdca, dataset,
+                                              labels, numClasses, lambda) ;
+vl_svmmulticlass_train (svm) ;
+models = vl_svmmulticlass_get_models (svm) ;
+biases = vl_svmmulticlass_get_biases (svm) ;
+@endcode
+
+Here @c labels are the class indexes, between 0 and @c numClasses-1,
+of the training data. The model of the class $c$ is learned by
+labelling as positive the data of class $c$ and as negative all the
+other data. The models are stored in a @c dimension x @c numClasses
+matrix, in column-major order.
+
+Both the @ref svm-sgd and the @ref svm-sdca solvers are supported,
+with the same loss functions (::vl_svmmulticlass_set_loss) and
+parameters of ::VlSvm. The SDCA solver keeps a dual variable for each
+class and data point, and the SGD solver a score, so that their memory
+footprint grows with the number of classes times the number of data
+points. The data is visited in the same random order for all classes,
+and each class model is updated exactly as by ::VlSvm with the same
+order: the result does not depend on the number of threads or on the
+batch size, up to rounding.
+
+With dense data, no feature map and at least eight classes, the
+batches are scored against tiles of eight class models at a time by
+matrix products rather than by calling the inner product function
+for each class and point, and the models are updated after each
+block of four points. The updates made by the earlier points of a
+block are accounted for by the inner products of the points. This
+only changes the rounding of the scores; otherwise, and in particular
+with a ::VlHomogeneousKernelMap, the dataset functions are used.
+
+The classes are split among up to ::vl_get_max_threads threads. Hence
+the inner product and accumulate functions of the dataset
+(@ref svm-data-abstraction) are called concurrently, albeit never on
+the same model. The statistics of each class (::VlSvmStatistics) are
+available from ::vl_svmmulticlass_get_statistics, for example in a
+diagnostic function (::vl_svmmulticlass_set_diagnostic_function).
+Training terminates when all the classes have converged, or after
+the maximum number of iterations.
+**/
+
+#include "svmmulticlass.h"
+#include "mathop.h"
+#include "mathop_sse2.h"
+#include <string.h>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+/* the default batch size holds about this many data components */
+#define VL_SVMMULTICLASS_BATCH_SIZE (1 << 18)
+
+/* Classes (columns) and data points (rows) in a block of the batched
+   inner products of dense data (must match _vl_inner_products_4x8_sse2) */
+#define VL_SVMMULTICLASS_TILE_NUM_CLASSES 8
+#define VL_SVMMULTICLASS_TILE_NUM_POINTS 4
+
+struct VlSvmMulticlass_ {
+  VlSvmSolverType solver ;      /**< SVM solver type. */
+
+  vl_size numClasses ;          /**< Number of classes. */
+  vl_size dimension ;           /**< Model dimension. */
+  double * models ;             /**< Models (@c dimension x @c numClasses). */
+  double * biases ;             /**< Biases. */
+  double biasMultiplier ;       /**< Bias feature multiplier. */
+
+  double lambda ;               /**< Regularizer multiplier. */
+  void const * data ;           /**< Data. */
+  VlSvmDataset * dataset ;      /**< Dataset wrapping the data. */
+  vl_size numData ;             /**< Number of data points. */
+  vl_uint32 const * labels ;    /**< Data class labels. */
+  double const * weights ;      /**< Data weights. */
+
+  VlSvmMulticlassDiagnosticFunction diagnosticFn ;
+  void * diagnosticFnData ;
+  vl_size diagnosticFrequency ; /**< Frequency of diagnostic. */
+
+  VlSvmLossFunction lossFn ;
+  VlSvmLossFunction conjugateLossFn ;
+  VlSvmLossFunction lossDerivativeFn ;
+  VlSvmDcaUpdateFunction dcaUpdateFn ;
+  VlSvmInnerProductFunction innerProductFn ;
+  VlSvmAccumulateFunction accumulateFn ;
+
+  vl_size maxNumIterations ;    /**< Maximum number of iterations. */
+  double epsilon ;              /**< Stopping threshold. */
+  vl_size batchSize ;           /**< Number of data points in a batch. */
+
+  /* Book keeping */
+  VlSvmStatistics * statistics ; /**< Statistics of each class. */
+  VlSvmSolverStatus status ;    /**< Overall status. */
+
+  /* SGD specific */
+  double biasLearningRate ;     /**< Bias learning rate. */
+
+  /* SDCA specific */
+  double * alpha ;              /**< Dual variables (@c numData x @c numClasses). */
+} ;
+
+/* ---------------------------------------------------------------- */
+
+/** @brief Create a new object.
+ ** @param solver type of SVM solver.
+ ** @param dataset SVM dataset object.
+ ** @param labels class of each training sample.
+ ** @param numClasses number of classes.
+ ** @param lambda regularizer parameter.
+ ** @return the new object.
+ **
+ ** @a labels has one entry per sample in @a dataset with a value in
+ ** the range 0 to @a numClasses - 1. @a solver can be
+ ** ::VlSvmSolverSgd or ::VlSvmSolverSdca; their parallel variants are
+ ** equivalent, as the classes are always learned in parallel.
+ **
+ ** @sa ::vl_svmmulticlass_delete, @ref svm-multiclass
+ **/
+
+VlSvmMulticlass *
+vl_svmmulticlass_new (VlSvmSolverType solver,
+                      VlSvmDataset * dataset,
+                      vl_uint32 const * labels,
+                      vl_size numClasses,
+                      double lambda)
+{
+  VlSvmMulticlass * self ;
+  vl_size dimension = vl_svmdataset_get_dimension(dataset) ;
+  vl_size numData = vl_svmdataset_get_num_data(dataset) ;
+
+  assert(numClasses >= 1) ;
+  assert(numData >= 1) ;
+  assert(labels) ;
+  assert(solver != VlSvmSolverNone) ;
+
+  self = vl_calloc(1, sizeof(VlSvmMulticlass)) ;
+  if (self == NULL) return NULL ;
+
+  if (solver == VlSvmSolverSgdParallel) solver = VlSvmSolverSgd ;
+  if (solver == VlSvmSolverSdcaParallel) solver = VlSvmSolverSdca ;
+  self->solver = solver ;
+
+  self->numClasses = numClasses ;
+  self->dimension = dimension ;
+  self->biasMultiplier = 1.0 ;
+
+  self->lambda = lambda ;
+  self->data = dataset ;
+  self->dataset = dataset ;
+  self->numData = numData ;
+  self->labels = labels ;
+
+  self->diagnosticFrequency = numData ;
+
+  self->innerProductFn = vl_svmdataset_get_inner_product_function(dataset) ;
+  self->accumulateFn = vl_svmdataset_get_accumulate_function(dataset) ;
+  vl_svmmulticlass_set_loss (self, VlSvmLossHinge) ;
+
+  self->maxNumIterations = VL_MAX((double)numData, vl_ceil_f(10.0 / lambda)) ;
+  self->epsilon = 1e-2 ;
+  self->batchSize = VL_MAX(1, VL_MIN(numData, VL_SVMMULTICLASS_BATCH_SIZE / VL_MAX(dimension, 1))) ;
+  self->biasLearningRate = 0.01 ;
+
+  /* allocations */
+  self->models = vl_calloc(dimension * numClasses, sizeof(double)) ;
+  self->biases = vl_calloc(numClasses, sizeof(double)) ;
+  self->statistics = vl_calloc(numClasses, sizeof(VlSvmStatistics)) ;
+  if (self->models == NULL || self->biases == NULL || self->statistics == NULL) goto err_alloc ;
+
+  if (self->solver == VlSvmSolverSdca) {
+    self->alpha = vl_calloc(numData * numClasses, sizeof(double)) ;
+    if (self->alpha == NULL) goto err_alloc ;
+  }
+  return self ;
+
+err_alloc:
+  vl_svmmulticlass_delete (self) ;
+  return NULL ;
+}
+
+/** @brief Delete object.
+ ** @param self object.
+ ** @sa ::vl_svmmulticlass_new
+ **/
+
+void
+vl_svmmulticlass_delete (VlSvmMulticlass * self)
+{
+  if (self->models) vl_free (self->models) ;
+  if (self->biases) vl_free (self->biases) ;
+  if (self->statistics) vl_free (self->statistics) ;
+  if (self->alpha) vl_free (self->alpha) ;
+  vl_free (self) ;
+}
+
+/* ---------------------------------------------------------------- */
+/*                                          Retrieve data and state */
+/* ---------------------------------------------------------------- */
+
+/** @brief Get the statistics of each class.
+ ** @param self object.
+ ** @return array of @c numClasses statistics.
+ **/
+
+VlSvmStatistics const *
+vl_svmmulticlass_get_statistics (VlSvmMulticlass const *self)
+{
+  return self->statistics ;
+}
+
+/** @brief Get the overall solver status.
+ ** @param self object.
+ ** @return status.
+ **
+ ** The solver is converged when all the classes are.
+ **/
+
+VlSvmSolverStatus
+vl_svmmulticlass_get_status (VlSvmMulticlass const *self)
+{
+  return self->status ;
+}
+
+/** @brief Get the models.
+ ** @param self object.
+ ** @return models (@c dimension x @c numClasses matrix).
+ **/
+
+double const *
+vl_svmmulticlass_get_models (VlSvmMulticlass const *self)
+{
+  return self->models ;
+}
+
+/** @brief Get the biases.
+ ** @param self object.
+ ** @return biases (@c numClasses vector).
+ **/
+
+double const *
+vl_svmmulticlass_get_biases (VlSvmMulticlass const *self)
+{
+  return self->biases ;
+}
+
+/** @brief Get the number of classes.
+ ** @param self object.
+ ** @return number of classes.
+ **/
+
+vl_size
+vl_svmmulticlass_get_num_classes (VlSvmMulticlass const *self)
+{
+  return self->numClasses ;
+}
+
+/** @brief Get the model dimension.
+ ** @param self object.
+ ** @return model dimension.
+ **/
+
+vl_size
+vl_svmmulticlass_get_dimension (VlSvmMulticlass const *self)
+{
+  return self->dimension ;
+}
+
+/** @brief Get the number of data samples.
+ ** @param self object.
+ ** @return number of data samples.
+ **/
+
+vl_size
+vl_svmmulticlass_get_num_data (VlSvmMulticlass const *self)
+{
+  return self->numData ;
+}
+
+/** @brief Get the solver type.
+ ** @param self object.
+ ** @return solver type.
+ **/
+
+VlSvmSolverType
+vl_svmmulticlass_get_solver (VlSvmMulticlass const *self)
+{
+  return self->solver ;
+}
+
+/** @brief Get the regularizer parameter.
+ ** @param self object.
+ ** @return regularizer parameter $\lambda$.
+ **/
+
+double
+vl_svmmulticlass_get_lambda (VlSvmMulticlass const *self)
+{
+  return self->lambda ;
+}
+
+/* ---------------------------------------------------------------- */
+/*                                                       Parameters */
+/* ---------------------------------------------------------------- */
+
+/** @brief Set the convergence threshold
+ ** @param self object
+ ** @param epsilon threshold (non-negative).
+ ** @sa ::vl_svm_set_epsilon
+ **/
+
+void
+vl_svmmulticlass_set_epsilon (VlSvmMulticlass *self, double epsilon)
+{
+  assert(epsilon >= 0) ;
+  self->epsilon = epsilon ;
+}
+
+/** @brief Get the convergence threshold
+ ** @param self object
+ ** @return threshold.
+ **/
+
+double
+vl_svmmulticlass_get_epsilon (VlSvmMulticlass const *self)
+{
+  return self->epsilon ;
+}
+
+/** @brief Set the bias multiplier.
+ ** @param self object.
+ ** @param b bias multiplier (non-negative).
+ ** @sa ::vl_svm_set_bias_multiplier
+ **/
+
+void
+vl_svmmulticlass_set_bias_multiplier (VlSvmMulticlass *self, double b)
+{
+  assert(b >= 0) ;
+  self->biasMultiplier = b ;
+}
+
+/** @brief Get the bias multiplier.
+ ** @param self object.
+ ** @return bias multiplier.
+ **/
+
+double
+vl_svmmulticlass_get_bias_multiplier (VlSvmMulticlass const *self)
+{
+  return self->biasMultiplier ;
+}
+
+/** @brief Set the bias learning rate (SGD)
+ ** @param self object
+ ** @param rate bias learning rate (positive).
+ ** @sa ::vl_svm_set_bias_learning_rate
+ **/
+
+void
+vl_svmmulticlass_set_bias_learning_rate (VlSvmMulticlass *self, double rate)
+{
+  assert(rate > 0) ;
+  self->biasLearningRate = rate ;
+}
+
+/** @brief Get the bias learning rate (SGD)
+ ** @param self object
+ ** @return bias learning rate.
+ **/
+
+double
+vl_svmmulticlass_get_bias_learning_rate (VlSvmMulticlass const *self)
+{
+  return self->biasLearningRate ;
+}
+
+/** @brief Set the maximum number of iterations.
+ ** @param self object.
+ ** @param n maximum number of iterations.
+ **/
+
+void
+vl_svmmulticlass_set_max_num_iterations (VlSvmMulticlass *self, vl_size n)
+{
+  self->maxNumIterations = n ;
+}
+
+/** @brief Get the maximum number of iterations.
+ ** @param self object.
+ ** @return maximum number of iterations.
+ **/
+
+vl_size
+vl_svmmulticlass_get_max_num_iterations (VlSvmMulticlass const *self)
+{
+  return self->maxNumIterations ;
+}
+
+/** @brief Set the diagnostic frequency
+ ** @param self object.
+ ** @param f diagnostic frequency (@c >= 1).
+ **
+ ** Diagnostic is run every @a f iterations, i.e. after visiting @a f
+ ** data points for all the classes.
+ **/
+
+void
+vl_svmmulticlass_set_diagnostic_frequency (VlSvmMulticlass *self, vl_size f)
+{
+  assert(f > 0) ;
+  self->diagnosticFrequency = f ;
+}
+
+/** @brief Get the diagnostic frequency.
+ ** @param self object.
+ ** @return diagnostic frequency.
+ **/
+
+vl_size
+vl_svmmulticlass_get_diagnostic_frequency (VlSvmMulticlass const *self)
+{
+  return self->diagnosticFrequency ;
+}
+
+/** @brief Set the batch size.
+ ** @param self object.
+ ** @param n number of data points in a batch (@c >= 1).
+ **
+ ** The batch should be small enough for its data to stay in the
+ ** cache while it is used by all the classes. The default holds
+ ** about 256K data components. The batch size does not change the
+ ** result of training except for rounding, as small batches of dense
+ ** data are scored by matrix products (@ref svm-multiclass).
+ **/
+
+void
+vl_svmmulticlass_set_batch_size (VlSvmMulticlass *self, vl_size n)
+{
+  assert(n > 0) ;
+  self->batchSize = n ;
+}
+
+/** @brief Get the batch size.
+ ** @param self object.
+ ** @return batch size.
+ **/
+
+vl_size
+vl_svmmulticlass_get_batch_size (VlSvmMulticlass const *self)
+{
+  return self->batchSize ;
+}
+
+/** @brief Set the data weights.
+ ** @param self object.
+ ** @param weights data weights (or @c NULL).
+ ** @sa ::vl_svm_set_weights
+ **/
+
+void
+vl_svmmulticlass_set_weights (VlSvmMulticlass *self, double const *weights)
+{
+  self->weights = weights ;
+}
+
+/** @brief Get the data weights.
+ ** @param self object.
+ ** @return data weights.
+ **/
+
+double const *
+vl_svmmulticlass_get_weights (VlSvmMulticlass const *self)
+{
+  return self->weights ;
+}
+
+/** @brief Set the loss function to one of the default types.
+ ** @param self object.
+ ** @param loss type of loss function.
+ ** @sa ::vl_svm_set_loss, @ref svm-loss-functions.
+ **/
+
+void
+vl_svmmulticlass_set_loss (VlSvmMulticlass *self, VlSvmLossType loss)
+{
+#define SETLOSS(x,y) \
+case VlSvmLoss ## x: \
+  self->lossFn = vl_svm_ ## y ## _loss ; \
+  self->lossDerivativeFn = vl_svm_ ## y ## _loss_derivative ; \
+  self->conjugateLossFn = vl_svm_ ## y ## _conjugate_loss ; \
+  self->dcaUpdateFn = vl_svm_ ## y ## _dca_update ; \
+  break;
+
+  switch (loss) {
+      SETLOSS(Hinge, hinge) ;
+      SETLOSS(Hinge2, hinge2) ;
+      SETLOSS(L1, l1) ;
+      SETLOSS(L2, l2) ;
+      SETLOSS(Logistic, logistic) ;
+    default:
+      assert(0) ;
+  }
+#undef SETLOSS
+}
+
+/** @brief Set the diagnostic function callback
+ ** @param self object.
+ ** @param f diagnostic function pointer.
+ ** @param data pointer to data used by the diagnostic function.
+ **/
+
+void
+vl_svmmulticlass_set_diagnostic_function (VlSvmMulticlass *self,
+                                          VlSvmMulticlassDiagnosticFunction f,
+                                          void *data)
+{
+  self->diagnosticFn = f ;
+  self->diagnosticFnData = data ;
+}
+
+/* ---------------------------------------------------------------- */
+/*                                                          Helpers */
+/* ---------------------------------------------------------------- */
+
+VL_INLINE double
+_vl_svmmulticlass_get_label (VlSvmMulticlass const *self, vl_uindex c, vl_uindex i)
+{
+  return (self->labels[i] == c) ? 1.0 : -1.0 ;
+}
+
+/* One past the last iteration of the block starting at t; a block
+   visits each data point at most once. */
+static vl_uindex
+_vl_svmmulticlass_get_block_end (VlSvmMulticlass const *self, vl_uindex t)
+{
+  vl_uindex end = t - t % self->numData + self->numData ;
+  end = VL_MIN(end, t - t % self->diagnosticFrequency + self->diagnosticFrequency) ;
+  end = VL_MIN(end, self->maxNumIterations) ;
+  return end ;
+}
+
+/** @internal @brief Update the statistics of all classes
+ ** @param self object.
+ ** @param t number of iterations done.
+ ** @param startTime training start time.
+ **
+ ** The function scores each batch of data against all the models.
+ ** It sets the objective values but not the convergence criterion.
+ **/
+
+static void
+_vl_svmmulticlass_update_statistics (VlSvmMulticlass *self, vl_uindex t, double startTime)
+{
+  vl_uindex c ;
+  vl_bool isDual = (self->solver == VlSvmSolverSdca) ;
+
+  memset(self->statistics, 0, sizeof(VlSvmStatistics) * self->numClasses) ;
+
+#if defined(_OPENMP)
+#pragma omp parallel default(shared) num_threads(vl_get_max_threads())
+#endif
+  {
+    vl_uindex b ;
+    for (b = 0 ; b < self->numData ; b += self->batchSize) {
+      vl_uindex bend = VL_MIN(b + self->batchSize, self->numData) ;
+      vl_index ci ;
+#if defined(_OPENMP)
+#pragma omp for schedule(static)
+#endif
+      for (ci = 0 ; ci < (signed)self->numClasses ; ++ci) {
+        VlSvmStatistics * stats = self->statistics + ci ;
+        double * model = self->models + ci * self->dimension ;
+        double bias = self->biases[ci] * self->biasMultiplier ;
+        vl_uindex i ;
+        for (i = b ; i < bend ; ++i) {
+          double p = (self->weights) ? self->weights[i] : 1.0 ;
+          double label, inner ;
+          if (p <= 0) continue ;
+          label = _vl_svmmulticlass_get_label(self, ci, i) ;
+          inner = self->innerProductFn(self->data, i, model) + bias ;
+          stats->loss += p * self->lossFn(inner, label) ;
+          if (isDual) {
+            double alpha = self->alpha[ci * self->numData + i] ;
+            stats->dualLoss -= p * self->conjugateLossFn(- alpha / p, label) ;
+          }
+        }
+      }
+    }
+  }
+
+  for (c = 0 ; c < self->numClasses ; ++c) {
+    VlSvmStatistics * stats = self->statistics + c ;
+    double const * model = self->models + c * self->dimension ;
+    vl_uindex k ;
+    stats->regularizer = self->biases[c] * self->biases[c] ;
+    for (k = 0 ; k < self->dimension ; ++k) {
+      stats->regularizer += model[k] * model[k] ;
+    }
+    stats->regularizer *= self->lambda * 0.5 ;
+    stats->loss /= self->numData ;
+    stats->objective = stats->regularizer + stats->loss ;
+    if (isDual) {
+      stats->dualLoss /= self->numData ;
+      stats->dualObjective = - stats->regularizer + stats->dualLoss ;
+      stats->dualityGap = stats->objective - stats->dualObjective ;
+    }
+    stats->iteration = t - 1 ;
+    stats->epoch = (t - 1) / self->numData ;
+    stats->elapsedTime = vl_get_cpu_time() - startTime ;
+  }
+}
+
+/** @internal @brief Check convergence and run diagnostic
+ ** @param self object.
+ ** @param t number of iterations done.
+ ** @return @c true if training should stop.
+ **/
+
+static vl_bool
+_vl_svmmulticlass_check_convergence (VlSvmMulticlass *self, vl_uindex t)
+{
+  vl_uindex c ;
+  vl_bool converged = VL_TRUE ;
+  for (c = 0 ; c < self->numClasses ; ++c) {
+    VlSvmStatistics * stats = self->statistics + c ;
+    double criterion = (self->solver == VlSvmSolverSdca) ?
+      stats->dualityGap : stats->scoresVariation ;
+    if (criterion < self->epsilon) {
+      stats->status = VlSvmStatusConverged ;
+    } else {
+      converged = VL_FALSE ;
+      stats->status = (t == self->maxNumIterations) ?
+        VlSvmStatusMaxNumIterationsReached : VlSvmStatusTraining ;
+    }
+  }
+  if (converged) {
+    self->status = VlSvmStatusConverged ;
+  } else if (t == self->maxNumIterations) {
+    self->status = VlSvmStatusMaxNumIterationsReached ;
+  } else {
+    self->status = VlSvmStatusTraining ;
+  }
+  if (self->diagnosticFn) {
+    self->diagnosticFn(self, self->diagnosticFnData) ;
+  }
+  return self->status != VlSvmStatusTraining ;
+}
+
+/* ---------------------------------------------------------------- */
+/*                                           Batched dense products */
+/* ---------------------------------------------------------------- */
+
+/*
+ With dense data the solvers score a batch against a tile of classes
+ by matrix products rather than by calling the inner product function
+ for each class and point. The models of the tile are interleaved, so
+ that the products of a block of points and the tile are computed by
+ a single pass over the data, and stay in the cache while the batch
+ is processed.
+
+ The models are updated after each block of points. Within a block,
+ the updates are accounted for by the Gram matrix of the block: if
+ the model w of a class is incremented by m x_s after visiting the
+ point x_s, then the inner product with a later point x_r of the
+ block is incremented by m <x_s,x_r>.
+
+ A tile is padded with null models, so that this is used only if
+ there are enough classes to fill one.
+ */
+
+static vl_bool
+_vl_svmmulticlass_use_tiles (VlSvmMulticlass const *self)
+{
+  return
+  _vl_svmdataset_is_dense(self->dataset) &&
+  self->numClasses >= VL_SVMMULTICLASS_TILE_NUM_CLASSES ;
+}
+
+/* Copy the points of a batch and compute the inner products of the
+   points of each block, gram[s * TILE_NUM_POINTS + r % TILE_NUM_POINTS]
+   = <x_s,x_r> for s < r; called by all the threads of a parallel
+   region. */
+static void
+_vl_svmmulticlass_prepare_batch (VlSvmMulticlass const *self,
+                                 double * points, double * gram,
+                                 vl_index const * permutation,
+                                 vl_uindex begin, vl_size numPoints)
+{
+  vl_size dimension = self->dimension ;
+  vl_index s ;
+#if defined(_OPENMP)
+#pragma omp for schedule(static)
+#endif
+  for (s = 0 ; s < (signed)numPoints ; ++s) {
+    _vl_svmdataset_get_point_d (self->dataset,
+                                permutation[(begin + s) % self->numData],
+                                points + s * dimension) ;
+  }
+#if defined(_OPENMP)
+#pragma omp for schedule(static)
+#endif
+  for (s = 0 ; s < (signed)numPoints ; ++s) {
+    double const * x = points + s * dimension ;
+    vl_uindex blockEnd = s - s % VL_SVMMULTICLASS_TILE_NUM_POINTS + VL_SVMMULTICLASS_TILE_NUM_POINTS ;
+    vl_uindex r, d ;
+    for (r = s + 1 ; r < VL_MIN(blockEnd, numPoints) ; ++r) {
+      double const * y = points + r * dimension ;
+      double acc = 0 ;
+      for (d = 0 ; d < dimension ; ++d) acc += x[d] * y[d] ;
+      gram[s * VL_SVMMULTICLASS_TILE_NUM_POINTS + r % VL_SVMMULTICLASS_TILE_NUM_POINTS] = acc ;
+    }
+  }
+}
+
+/* Interleave the models of a tile of classes (padding with zeros). */
+static void
+_vl_svmmulticlass_pack_models (double * packed, double const * models,
+                               vl_size numModels, vl_size dimension)
+{
+  vl_uindex d, k ;
+  for (d = 0 ; d < dimension ; ++d) {
+    double * row = packed + d * VL_SVMMULTICLASS_TILE_NUM_CLASSES ;
+    for (k = 0 ; k < VL_SVMMULTICLASS_TILE_NUM_CLASSES ; ++k) {
+      row[k] = (k < numModels) ? models[k * dimension + d] : 0.0 ;
+    }
+  }
+}
+
+static void
+_vl_svmmulticlass_unpack_models (double * models, double const * packed,
+                                 vl_size numModels, vl_size dimension)
+{
+  vl_uindex d, k ;
+  for (d = 0 ; d < dimension ; ++d) {
+    double const * row = packed + d * VL_SVMMULTICLASS_TILE_NUM_CLASSES ;
+    for (k = 0 ; k < numModels ; ++k) {
+      models[k * dimension + d] = row[k] ;
+    }
+  }
+}
+
+/* acc[r * TILE_NUM_CLASSES + k] = <packed model k, points[r]> for a
+   block of numPoints <= TILE_NUM_POINTS points. */
+static void
+_vl_svmmulticlass_tile_inner_products (double * acc, double const * packed,
+                                       double const * points, vl_size numPoints,
+                                       vl_size dimension)
+{
+  double const * x [VL_SVMMULTICLASS_TILE_NUM_POINTS] ;
+  vl_uindex r, k, d ;
+
+  /* an incomplete block repeats its last point */
+  for (r = 0 ; r < VL_SVMMULTICLASS_TILE_NUM_POINTS ; ++r) {
+    x[r] = points + VL_MIN(r, numPoints - 1) * dimension ;
+  }
+#ifndef VL_DISABLE_SSE2
+  if (vl_get_simd_enabled() && vl_cpu_has_sse2()) {
+    _vl_inner_products_4x8_sse2_d (dimension, acc, x, packed) ;
+    return ;
+  }
+#endif
+  memset(acc, 0, sizeof(double) * VL_SVMMULTICLASS_TILE_NUM_POINTS * VL_SVMMULTICLASS_TILE_NUM_CLASSES) ;
+  for (d = 0 ; d < dimension ; ++d) {
+    double const * row = packed + d * VL_SVMMULTICLASS_TILE_NUM_CLASSES ;
+    for (r = 0 ; r < VL_SVMMULTICLASS_TILE_NUM_POINTS ; ++r) {
+      for (k = 0 ; k < VL_SVMMULTICLASS_TILE_NUM_CLASSES ; ++k) {
+        acc[r * VL_SVMMULTICLASS_TILE_NUM_CLASSES + k] += x[r][d] * row[k] ;
+      }
+    }
+  }
+}
+
+/* Add the points of a block weighted by
+   multipliers[r * TILE_NUM_CLASSES + k] to the packed models; the
+   multipliers of the missing points of an incomplete block are zero. */
+static void
+_vl_svmmulticlass_tile_accumulate (double * packed, double const * multipliers,
+                                   double const * points, vl_size numPoints,
+                                   vl_size dimension)
+{
+  double const * m = multipliers ;
+  double const * x0 = points ;
+  double const * x1 = points + VL_MIN(1, numPoints - 1) * dimension ;
+  double const * x2 = points + VL_MIN(2, numPoints - 1) * dimension ;
+  double const * x3 = points + VL_MIN(3, numPoints - 1) * dimension ;
+  vl_uindex k, d ;
+  for (d = 0 ; d < dimension ; ++d) {
+    double * row = packed + d * VL_SVMMULTICLASS_TILE_NUM_CLASSES ;
+    for (k = 0 ; k < VL_SVMMULTICLASS_TILE_NUM_CLASSES ; ++k) {
+      row[k] +=
+      m[k] * x0[d] +
+      m[k + VL_SVMMULTICLASS_TILE_NUM_CLASSES] * x1[d] +
+      m[k + 2 * VL_SVMMULTICLASS_TILE_NUM_CLASSES] * x2[d] +
+      m[k + 3 * VL_SVMMULTICLASS_TILE_NUM_CLASSES] * x3[d] ;
+    }
+  }
+}
+
+/* Propagate the update m x_s of the model k to its inner products
+   with the later points of the block. */
+VL_INLINE void
+_vl_svmmulticlass_propagate (double * acc, double const * gram, vl_uindex k,
+                             vl_uindex s, vl_size numPoints, double m)
+{
+  vl_uindex r ;
+  for (r = s + 1 ; r < numPoints ; ++r) {
+    acc[r * VL_SVMMULTICLASS_TILE_NUM_CLASSES + k] +=
+    m * gram[s * VL_SVMMULTICLASS_TILE_NUM_POINTS + r] ;
+  }
+}
+
+/* ---------------------------------------------------------------- */
+/*                         Stochastic Dual Coordinate Ascent Solver */
+/* ---------------------------------------------------------------- */
+
+/* SDCA steps of a tile of classes on a batch of dense data. */
+static void
+_vl_svmmulticlass_sdca_tile (VlSvmMulticlass *self, vl_uindex c0,
+                             vl_index const * permutation, double const * norm2,
+                             vl_uindex begin, vl_size numPoints,
+                             double const * points, double const * gram,
+                             double * packed)
+{
+  vl_size dimension = self->dimension ;
+  vl_size numModels = VL_MIN(self->numClasses - c0, VL_SVMMULTICLASS_TILE_NUM_CLASSES) ;
+  double acc [VL_SVMMULTICLASS_TILE_NUM_POINTS * VL_SVMMULTICLASS_TILE_NUM_CLASSES] ;
+  double multipliers [VL_SVMMULTICLASS_TILE_NUM_POINTS * VL_SVMMULTICLASS_TILE_NUM_CLASSES] ;
+  vl_uindex k, s, r ;
+
+  _vl_svmmulticlass_pack_models (packed, self->models + c0 * dimension, numModels, dimension) ;
+
+  for (s = 0 ; s < numPoints ; s += VL_SVMMULTICLASS_TILE_NUM_POINTS) {
+    vl_size n = VL_MIN(numPoints - s, VL_SVMMULTICLASS_TILE_NUM_POINTS) ;
+    vl_bool updated = VL_FALSE ;
+    _vl_svmmulticlass_tile_inner_products (acc, packed, points + s * dimension, n, dimension) ;
+    memset(multipliers, 0, sizeof(multipliers)) ;
+    for (k = 0 ; k < numModels ; ++k) {
+      vl_uindex ci = c0 + k ;
+      double * alpha = self->alpha + ci * self->numData ;
+      for (r = 0 ; r < n ; ++r) {
+        vl_uindex j = permutation[(begin + s + r) % self->numData] ;
+        double p = (self->weights) ? self->weights[j] : 1.0 ;
+        double delta, multiplier ;
+        if (p <= 0) continue ;
+        delta = p * self->dcaUpdateFn(alpha[j] / p,
+                                      acc[r * VL_SVMMULTICLASS_TILE_NUM_CLASSES + k] +
+                                      self->biases[ci] * self->biasMultiplier,
+                                      p * norm2[j],
+                                      _vl_svmmulticlass_get_label(self, ci, j)) ;
+        if (delta != 0) {
+          alpha[j] += delta ;
+          multiplier = delta / (self->numData * self->lambda) ;
+          multipliers[r * VL_SVMMULTICLASS_TILE_NUM_CLASSES + k] = multiplier ;
+          self->biases[ci] += self->biasMultiplier * multiplier ;
+          _vl_svmmulticlass_propagate (acc, gram + s * VL_SVMMULTICLASS_TILE_NUM_POINTS,
+                                       k, r, n, multiplier) ;
+          updated = VL_TRUE ;
+        }
+      }
+    }
+    if (updated) {
+      _vl_svmmulticlass_tile_accumulate (packed, multipliers, points + s * dimension, n, dimension) ;
+    }
+  }
+
+  _vl_svmmulticlass_unpack_models (self->models + c0 * dimension, packed, numModels, dimension) ;
+}
+
+static void
+_vl_svmmulticlass_sdca_train (VlSvmMulticlass *self)
+{
+  double * norm2 ;
+  double * buffers ;
+  double * points = NULL ;
+  double * gram = NULL ;
+  double * scratch = NULL ;
+  vl_index * permutation ;
+  vl_uindex i, t ;
+  vl_size numThreads = vl_get_max_threads() ;
+  vl_size maxNumPoints = VL_MIN(self->batchSize, self->numData) ;
+  vl_size scratchSize = self->dimension * VL_SVMMULTICLASS_TILE_NUM_CLASSES ;
+  vl_size numTiles = (self->numClasses + VL_SVMMULTICLASS_TILE_NUM_CLASSES - 1) / VL_SVMMULTICLASS_TILE_NUM_CLASSES ;
+  vl_bool useTiles = _vl_svmmulticlass_use_tiles (self) ;
+
+  double startTime = vl_get_cpu_time () ;
+  VlRand * rand = vl_get_rand() ;
+
+  norm2 = vl_calloc(self->numData, sizeof(double)) ;
+  permutation = vl_calloc(self->numData, sizeof(vl_index)) ;
+  buffers = vl_calloc(self->dimension * numThreads, sizeof(double)) ;
+
+  for (i = 0 ; i < self->numData ; ++i) {
+    permutation[i] = i ;
+  }
+
+#if defined(_OPENMP)
+#pragma omp parallel default(shared) num_threads(numThreads)
+#endif
+  {
+    vl_index j ;
+    double * buffer = buffers ;
+#if defined(_OPENMP)
+    buffer += self->dimension * omp_get_thread_num() ;
+#pragma omp for schedule(static)
+#endif
+    for (j = 0 ; j < (signed)self->numData ; ++j) {
+      double n2 ;
+      memset(buffer, 0, self->dimension * sizeof(double)) ;
+      self->accumulateFn (self->data, j, buffer, 1) ;
+      n2 = self->innerProductFn (self->data, j, buffer) ;
+      n2 += self->biasMultiplier * self->biasMultiplier ;
+      norm2[j] = n2 / (self->lambda * self->numData) ;
+    }
+  }
+  vl_free(buffers) ;
+
+  if (useTiles) {
+    points = vl_malloc(sizeof(double) * maxNumPoints * self->dimension) ;
+    gram = vl_malloc(sizeof(double) * maxNumPoints * VL_SVMMULTICLASS_TILE_NUM_POINTS) ;
+    scratch = vl_malloc(sizeof(double) * scratchSize * numThreads) ;
+  }
+
+  for (t = 0 ; 1 ; ) {
+    vl_uindex end = _vl_svmmulticlass_get_block_end (self, t) ;
+
+    if (t % self->numData == 0) {
+      vl_rand_permute_indexes(rand, permutation, self->numData) ;
+    }
+
+#if defined(_OPENMP)
+#pragma omp parallel default(shared) num_threads(numThreads)
+#endif
+    {
+      vl_uindex b ;
+      vl_uindex thread = 0 ;
+#if defined(_OPENMP)
+      thread = omp_get_thread_num() ;
+#endif
+      for (b = t ; b < end ; b += self->batchSize) {
+        vl_uindex bend = VL_MIN(b + self->batchSize, end) ;
+        vl_index ci ;
+        if (useTiles) {
+          vl_index tile ;
+          _vl_svmmulticlass_prepare_batch (self, points, gram, permutation, b, bend - b) ;
+#if defined(_OPENMP)
+#pragma omp for schedule(static)
+#endif
+          for (tile = 0 ; tile < (signed)numTiles ; ++tile) {
+            _vl_svmmulticlass_sdca_tile (self, tile * VL_SVMMULTICLASS_TILE_NUM_CLASSES,
+                                         permutation, norm2, b, bend - b, points, gram,
+                                         scratch + thread * scratchSize) ;
+          }
+          continue ;
+        }
+#if defined(_OPENMP)
+#pragma omp for schedule(static)
+#endif
+        for (ci = 0 ; ci < (signed)self->numClasses ; ++ci) {
+          double * model = self->models + ci * self->dimension ;
+          double * alpha = self->alpha + ci * self->numData ;
+          vl_uindex s ;
+          for (s = b ; s < bend ; ++s) {
+            vl_uindex j = permutation[s % self->numData] ;
+            double p = (self->weights) ? self->weights[j] : 1.0 ;
+            double inner, delta, multiplier ;
+            if (p <= 0) continue ;
+            inner = self->innerProductFn(self->data, j, model) ;
+            inner += self->biases[ci] * self->biasMultiplier ;
+            delta = p * self->dcaUpdateFn(alpha[j] / p, inner, p * norm2[j],
+                                          _vl_svmmulticlass_get_label(self, ci, j)) ;
+            if (delta != 0) {
+              alpha[j] += delta ;
+              multiplier = delta / (self->numData * self->lambda) ;
+              self->accumulateFn(self->data, j, model, multiplier) ;
+              self->biases[ci] += self->biasMultiplier * multiplier ;
+            }
+          }
+        }
+      }
+    }
+    t = end ;
+
+    if (t % self->diagnosticFrequency == 0 || t == self->maxNumIterations) {
+      _vl_svmmulticlass_update_statistics (self, t, startTime) ;
+      if (_vl_svmmulticlass_check_convergence (self, t)) break ;
+    }
+  }
+
+  if (useTiles) {
+    vl_free (points) ;
+    vl_free (gram) ;
+    vl_free (scratch) ;
+  }
+  vl_free (norm2) ;
+  vl_free (permutation) ;
+}
+
+/* ---------------------------------------------------------------- */
+/*                               Stochastic Gradient Descent Solver */
+/* ---------------------------------------------------------------- */
+
+/* SGD steps of a tile of classes on a batch of dense data; t is the
+   first iteration of the block, to which the factors refer. */
+static void
+_vl_svmmulticlass_sgd_tile (VlSvmMulticlass *self, vl_uindex c0,
+                            vl_index const * permutation,
+                            double * scores, double * previousScores,
+                            double const * factors, double const * biasFactors,
+                            vl_index t0, vl_uindex t,
+                            vl_uindex begin, vl_size numPoints,
+                            double const * points, double const * gram,
+                            double * packed)
+{
+  vl_size dimension = self->dimension ;
+  vl_size numModels = VL_MIN(self->numClasses - c0, VL_SVMMULTICLASS_TILE_NUM_CLASSES) ;
+  double acc [VL_SVMMULTICLASS_TILE_NUM_POINTS * VL_SVMMULTICLASS_TILE_NUM_CLASSES] ;
+  double multipliers [VL_SVMMULTICLASS_TILE_NUM_POINTS * VL_SVMMULTICLASS_TILE_NUM_CLASSES] ;
+  vl_uindex k, s, r ;
+
+  _vl_svmmulticlass_pack_models (packed, self->models + c0 * dimension, numModels, dimension) ;
+
+  for (s = 0 ; s < numPoints ; s += VL_SVMMULTICLASS_TILE_NUM_POINTS) {
+    vl_size n = VL_MIN(numPoints - s, VL_SVMMULTICLASS_TILE_NUM_POINTS) ;
+    vl_bool updated = VL_FALSE ;
+    _vl_svmmulticlass_tile_inner_products (acc, packed, points + s * dimension, n, dimension) ;
+    memset(multipliers, 0, sizeof(multipliers)) ;
+    for (k = 0 ; k < numModels ; ++k) {
+      vl_uindex ci = c0 + k ;
+      double * classScores = scores + ci * self->numData ;
+      double * classPreviousScores = previousScores + ci * self->numData ;
+      for (r = 0 ; r < n ; ++r) {
+        vl_uindex j = permutation[(begin + s + r) % self->numData] ;
+        vl_uindex q = begin + s + r - t ;
+        double p = (self->weights) ? self->weights[j] : 1.0 ;
+        double score, gradient, rate, biasRate, multiplier ;
+        p = VL_MAX(0.0, p) ;
+        score = factors[q] * acc[r * VL_SVMMULTICLASS_TILE_NUM_CLASSES + k] ;
+        score += biasFactors[q] * (self->biasMultiplier * self->biases[ci]) ;
+        gradient = p * self->lossDerivativeFn(score, _vl_svmmulticlass_get_label(self, ci, j)) ;
+        classPreviousScores[j] = classScores[j] ;
+        classScores[j] = score ;
+        if (gradient != 0) {
+          rate = 1.0 / (self->lambda * (begin + s + r + t0)) ;
+          biasRate = rate * self->biasLearningRate ;
+          multiplier = - gradient * rate / factors[q+1] ;
+          multipliers[r * VL_SVMMULTICLASS_TILE_NUM_CLASSES + k] = multiplier ;
+          self->biases[ci] += self->biasMultiplier * (- gradient * biasRate / biasFactors[q+1]) ;
+          _vl_svmmulticlass_propagate (acc, gram + s * VL_SVMMULTICLASS_TILE_NUM_POINTS,
+                                       k, r, n, multiplier) ;
+          updated = VL_TRUE ;
+        }
+      }
+    }
+    if (updated) {
+      _vl_svmmulticlass_tile_accumulate (packed, multipliers, points + s * dimension, n, dimension) ;
+    }
+  }
+
+  _vl_svmmulticlass_unpack_models (self->models + c0 * dimension, packed, numModels, dimension) ;
+}
+
+static void
+_vl_svmmulticlass_sgd_train (VlSvmMulticlass *self)
+{
+  vl_index * permutation ;
+  double * scores ;
+  double * previousScores ;
+  double * factors ;
+  double * biasFactors ;
+  double * points = NULL ;
+  double * gram = NULL ;
+  double * scratch = NULL ;
+  vl_uindex i, t, c, k ;
+  vl_index t0 = VL_MAX(2, vl_ceil_d(1.0 / self->lambda)) ;
+  vl_size numThreads = vl_get_max_threads() ;
+  vl_size maxNumPoints = VL_MIN(self->batchSize, self->numData) ;
+  vl_size scratchSize = self->dimension * VL_SVMMULTICLASS_TILE_NUM_CLASSES ;
+  vl_size numTiles = (self->numClasses + VL_SVMMULTICLASS_TILE_NUM_CLASSES - 1) / VL_SVMMULTICLASS_TILE_NUM_CLASSES ;
+  vl_bool useTiles = _vl_svmmulticlass_use_tiles (self) ;
+
+  double startTime = vl_get_cpu_time () ;
+  VlRand * rand = vl_get_rand() ;
+
+  permutation = vl_calloc(self->numData, sizeof(vl_index)) ;
+  scores = vl_calloc(self->numData * self->numClasses * 2, sizeof(double)) ;
+  previousScores = scores + self->numData * self->numClasses ;
+  factors = vl_calloc(2 * (self->numData + 1), sizeof(double)) ;
+  biasFactors = factors + self->numData + 1 ;
+
+  for (i = 0 ; i < self->numData ; ++i) {
+    permutation[i] = i ;
+  }
+  for (i = 0 ; i < self->numData * self->numClasses ; ++i) {
+    previousScores[i] = - VL_INFINITY_D ;
+  }
+  factors[0] = 1.0 ;
+  biasFactors[0] = 1.0 ;
+
+  if (useTiles) {
+    points = vl_malloc(sizeof(double) * maxNumPoints * self->dimension) ;
+    gram = vl_malloc(sizeof(double) * maxNumPoints * VL_SVMMULTICLASS_TILE_NUM_POINTS) ;
+    scratch = vl_malloc(sizeof(double) * scratchSize * numThreads) ;
+  }
+
+  /*
+   The models are stored in the factored representation of the
+   binary SGD solver. Since the learning rate
+   is the same for all classes, so are the factors, which are computed
+   in advance for each block of iterations.
+   */
+
+  for (t = 0 ; 1 ; ) {
+    vl_uindex end = _vl_svmmulticlass_get_block_end (self, t) ;
+
+    if (t % self->numData == 0) {
+      vl_rand_permute_indexes(rand, permutation, self->numData) ;
+    }
+
+    for (k = 0 ; k < end - t ; ++k) {
+      double rate = 1.0 / (self->lambda * (t + k + t0)) ;
+      double biasRate = rate * self->biasLearningRate ;
+      factors[k+1] = factors[k] * (1.0 - self->lambda * rate) ;
+      biasFactors[k+1] = biasFactors[k] * (1.0 - self->lambda * biasRate) ;
+    }
+
+#if defined(_OPENMP)
+#pragma omp parallel default(shared) num_threads(numThreads)
+#endif
+    {
+      vl_uindex b ;
+      vl_uindex thread = 0 ;
+#if defined(_OPENMP)
+      thread = omp_get_thread_num() ;
+#endif
+      for (b = t ; b < end ; b += self->batchSize) {
+        vl_uindex bend = VL_MIN(b + self->batchSize, end) ;
+        vl_index ci ;
+        if (useTiles) {
+          vl_index tile ;
+          _vl_svmmulticlass_prepare_batch (self, points, gram, permutation, b, bend - b) ;
+#if defined(_OPENMP)
+#pragma omp for schedule(static)
+#endif
+          for (tile = 0 ; tile < (signed)numTiles ; ++tile) {
+            _vl_svmmulticlass_sgd_tile (self, tile * VL_SVMMULTICLASS_TILE_NUM_CLASSES,
+                                        permutation, scores, previousScores,
+                                        factors, biasFactors, t0, t, b, bend - b,
+                                        points, gram, scratch + thread * scratchSize) ;
+          }
+          continue ;
+        }
+#if defined(_OPENMP)
+#pragma omp for schedule(static)
+#endif
+        for (ci = 0 ; ci < (signed)self->numClasses ; ++ci) {
+          double * model = self->models + ci * self->dimension ;
+          double * classScores = scores + ci * self->numData ;
+          double * classPreviousScores = previousScores + ci * self->numData ;
+          vl_uindex s ;
+          for (s = b ; s < bend ; ++s) {
+            vl_uindex j = permutation[s % self->numData] ;
+            vl_uindex q = s - t ;
+            double p = (self->weights) ? self->weights[j] : 1.0 ;
+            double inner, gradient, rate, biasRate ;
+            p = VL_MAX(0.0, p) ;
+            inner = factors[q] * self->innerProductFn(self->data, j, model) ;
+            inner += biasFactors[q] * (self->biasMultiplier * self->biases[ci]) ;
+            gradient = p * self->lossDerivativeFn(inner, _vl_svmmulticlass_get_label(self, ci, j)) ;
+            classPreviousScores[j] = classScores[j] ;
+            classScores[j] = inner ;
+            if (gradient != 0) {
+              rate = 1.0 / (self->lambda * (s + t0)) ;
+              biasRate = rate * self->biasLearningRate ;
+              self->accumulateFn(self->data, j, model, - gradient * rate / factors[q+1]) ;
+              self->biases[ci] += self->biasMultiplier * (- gradient * biasRate / biasFactors[q+1]) ;
+            }
+          }
+        }
+      }
+    }
+    factors[0] = factors[end - t] ;
+    biasFactors[0] = biasFactors[end - t] ;
+    t = end ;
+
+    if (t % self->diagnosticFrequency == 0 || t == self->maxNumIterations) {
+      /* realize the factors */
+      for (k = 0 ; k < self->dimension * self->numClasses ; ++k) {
+        self->models[k] *= factors[0] ;
+      }
+      for (c = 0 ; c < self->numClasses ; ++c) {
+        self->biases[c] *= biasFactors[0] ;
+      }
+      factors[0] = 1.0 ;
+      biasFactors[0] = 1.0 ;
+
+      _vl_svmmulticlass_update_statistics (self, t, startTime) ;
+      for (c = 0 ; c < self->numClasses ; ++c) {
+        double variation = 0 ;
+        for (i = 0 ; i < self->numData ; ++i) {
+          double delta = scores[c * self->numData + i] - previousScores[c * self->numData + i] ;
+          variation += delta * delta ;
+        }
+        self->statistics[c].scoresVariation = sqrt(variation) / self->numData ;
+      }
+      if (_vl_svmmulticlass_check_convergence (self, t)) break ;
+    }
+  }
+
+  if (useTiles) {
+    vl_free (points) ;
+    vl_free (gram) ;
+    vl_free (scratch) ;
+  }
+  vl_free (factors) ;
+  vl_free (scores) ;
+  vl_free (permutation) ;
+}
+
+/* ---------------------------------------------------------------- */
+/*                                                       Dispatcher */
+/* ---------------------------------------------------------------- */
+
+/** @brief Train the SVMs of all classes
+ ** @param self object.
+ **
+ ** @sa @ref svm-multiclass
+ **/
+
+void
+vl_svmmulticlass_train (VlSvmMulticlass * self)
+{
+  assert (self) ;
+  /* the number of threads may have grown since the dataset was set up */
+  _vl_svmdataset_reserve_hom_buffers (self->dataset, vl_get_max_threads()) ;
+  switch (self->solver) {
+    case VlSvmSolverSdca:
+      _vl_svmmulticlass_sdca_train(self) ;
+      break ;
+    case VlSvmSolverSgd:
+      _vl_svmmulticlass_sgd_train(self) ;
+      break ;
+    default:
+      assert(0) ;
+  }
+}
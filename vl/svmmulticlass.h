@@ -0,0 +1,87 @@
+/** @file svmmulticlass.h
+ ** @brief Multi-class SVM (@ref svm-multiclass)
+ ** @author agent
+ **/
+
+/*
+Copyright (C) 2026 agent.
+All rights reserved.
+
+This file is part of the VLFeat library and is made available under
+the terms of the BSD license (see the COPYING file).
+*/
+
+#ifndef VL_SVMMULTICLASS_H
+#define VL_SVMMULTICLASS_H
+
+#include "generic.h"
+#include "svm.h"
+
+/** @typedef VlSvmMulticlass
+ ** @brief Multi-class SVM solver.
+ ** This object learns one-vs-rest SVMs for several classes at once
+ ** (see @ref svm-multiclass).
+ **/
+
+#ifndef __DOXYGEN__
+struct VlSvmMulticlass_ ;
+typedef struct VlSvmMulticlass_ VlSvmMulticlass ;
+#else
+typedef OPAQUE VlSvmMulticlass ;
+#endif
+
+/** @brief Multi-class SVM diagnostic function */
+typedef void (*VlSvmMulticlassDiagnosticFunction) (VlSvmMulticlass *svm, void *data) ;
+
+/** @name Create and destroy
+ ** @{ */
+VL_EXPORT VlSvmMulticlass * vl_svmmulticlass_new (VlSvmSolverType solver,
+                                                  VlSvmDataset * dataset,
+                                                  vl_uint32 const * labels,
+                                                  vl_size numClasses,
+                                                  double lambda) ;
+VL_EXPORT void vl_svmmulticlass_delete (VlSvmMulticlass * self) ;
+/** @} */
+
+/** @name Retrieve parameters and data
+ ** @{ */
+VL_EXPORT VlSvmStatistics const * vl_svmmulticlass_get_statistics (VlSvmMulticlass const *self) ;
+VL_EXPORT VlSvmSolverStatus vl_svmmulticlass_get_status (VlSvmMulticlass const *self) ;
+VL_EXPORT double const * vl_svmmulticlass_get_models (VlSvmMulticlass const *self) ;
+VL_EXPORT double const * vl_svmmulticlass_get_biases (VlSvmMulticlass const *self) ;
+VL_EXPORT vl_size vl_svmmulticlass_get_num_classes (VlSvmMulticlass const *self) ;
+VL_EXPORT vl_size vl_svmmulticlass_get_dimension (VlSvmMulticlass const *self) ;
+VL_EXPORT vl_size vl_svmmulticlass_get_num_data (VlSvmMulticlass const *self) ;
+VL_EXPORT VlSvmSolverType vl_svmmulticlass_get_solver (VlSvmMulticlass const *self) ;
+VL_EXPORT double vl_svmmulticlass_get_lambda (VlSvmMulticlass const *self) ;
+VL_EXPORT double vl_svmmulticlass_get_epsilon (VlSvmMulticlass const *self) ;
+VL_EXPORT double vl_svmmulticlass_get_bias_multiplier (VlSvmMulticlass const *self) ;
+VL_EXPORT double vl_svmmulticlass_get_bias_learning_rate (VlSvmMulticlass const *self) ;
+VL_EXPORT vl_size vl_svmmulticlass_get_max_num_iterations (VlSvmMulticlass const *self) ;
+VL_EXPORT vl_size vl_svmmulticlass_get_diagnostic_frequency (VlSvmMulticlass const *self) ;
+VL_EXPORT vl_size vl_svmmulticlass_get_batch_size (VlSvmMulticlass const *self) ;
+VL_EXPORT double const * vl_svmmulticlass_get_weights (VlSvmMulticlass const *self) ;
+/** @} */
+
+/** @name Set parameters
+ ** @{ */
+VL_EXPORT void vl_svmmulticlass_set_epsilon (VlSvmMulticlass *self, double epsilon) ;
+VL_EXPORT void vl_svmmulticlass_set_bias_multiplier (VlSvmMulticlass *self, double b) ;
+VL_EXPORT void vl_svmmulticlass_set_bias_learning_rate (VlSvmMulticlass *self, double rate) ;
+VL_EXPORT void vl_svmmulticlass_set_max_num_iterations (VlSvmMulticlass *self, vl_size n) ;
+VL_EXPORT void vl_svmmulticlass_set_diagnostic_frequency (VlSvmMulticlass *self, vl_size f) ;
+VL_EXPORT void vl_svmmulticlass_set_batch_size (VlSvmMulticlass *self, vl_size n) ;
+VL_EXPORT void vl_svmmulticlass_set_weights (VlSvmMulticlass *self, double const *weights) ;
+VL_EXPORT void vl_svmmulticlass_set_loss (VlSvmMulticlass *self, VlSvmLossType loss) ;
+VL_EXPORT void vl_svmmulticlass_set_diagnostic_function (VlSvmMulticlass *self,
+                                                         VlSvmMulticlassDiagnosticFunction f,
+                                                         void *data) ;
+/** @} */
+
+/** @name Process data
+ ** @{ */
+VL_EXPORT void vl_svmmulticlass_train (VlSvmMulticlass * self) ;
+/** @} */
+
+/* VL_SVMMULTICLASS_H */
+#endif
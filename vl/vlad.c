@@ -40,7 +40,8 @@ float or @c double data types.
 ::vl_vlad_encode requires a visual dictionary, for example obtained by
 using @ref kmeans. Furthermore, the assignments of features to
 dictionary elements must be pre-computed, for example by using @ref
-kdtree.
+kdtree. ::vl_vlad_encode_sparse is a variant that takes the
+assignments as lists of cluster indexes.
 
 In the following example code, the vocabulary is first created using
 the KMeans clustering, then the points, that are to be encoded are
@@ -50,9 +51,7 @@ At the end of the process the encoding is stored in the @c enc variable.
 
 @code
 vl_uint32 * indexes;
-float * assignments;
 float * enc
-int i;
 
 // create a KMeans object and run clustering to get vocabulary words (centers)
 kmeans = vl_kmeans_new (VLDistanceL2, VL_TYPE_FLOAT) ;
@@ -66,25 +65,23 @@ vl_kmeans_cluster (kmeans,
 indexes = vl_malloc(sizeof(vl_uint32) * numDataToEncode);
 vl_kmeans_quantize(kmeans,indexes,dataToEncode,numDataToEncode);
 
-// convert indexes array to assignments array,
-// which can be processed by vl_vlad_encode
-assignments = vl_malloc(sizeof(float) * numDataToEncode * numCenters);
-memset(assignments, 0, sizeof(float) * numDataToEncode * numCenters);
-for(i = 0; i < numDataToEncode; i++) {
-  assignments[i * numCenters + indexes[i]] = 1.;
-}
-
 // allocate space for vlad encoding
 enc = vl_malloc(sizeof(TYPE) * dimension * numCenters);
 
 // do the encoding job
-vl_vlad_encode (enc, VL_F_TYPE,
-                vl_kmeans_get_centers(kmeans), dimension, numCenters,
-                data, numData,
-                assignments,
-                0) ;
+vl_vlad_encode_sparse (enc, VL_F_TYPE,
+                       vl_kmeans_get_centers(kmeans), dimension, numCenters,
+                       dataToEncode, numDataToEncode,
+                       indexes, NULL, 1,
+                       0) ;
 @endcode
 
+Hard (or top-k) assignments are passed to ::vl_vlad_encode_sparse as
+lists of cluster indexes, optionally with weights. Soft assignments
+are passed to ::vl_vlad_encode as a dense matrix with one column of
+@c numCenters weights per vector, for example the posteriors of a @ref
+gmm "GMM".
+
 Various @ref vlad-normalization normalizations can be applied to the
 VLAD vectors. These are controlled by the parameter @a flag of
 ::vl_vlad_encode.
@@ -149,6 +146,7 @@ normalization strategies. These are optionally applied in this order:
 
 #include "vlad.h"
 #include "mathop.h"
+#include "pooling.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -157,9 +155,109 @@ normalization strategies. These are optionally applied in this order:
 #include <omp.h>
 #endif
 
+#ifndef VL_VLAD_INSTANTIATING
+/* maximum number of elements of the integral image used for region
+   pooling (128 MB) */
+#define VL_VLAD_MAX_INTEGRAL_SIZE (1 << 24)
+
+struct _VlVladEncoder
+{
+  vl_type dataType ;                 /**< Data type. */
+  vl_size dimension ;                /**< Data dimensionality. */
+  vl_size numClusters ;              /**< Number of clusters. */
+  void * means ;                     /**< Cluster means. */
+  vl_size numScratches ;             /**< Number of per-thread scratch buffers. */
+  vl_size maxNumPairs ;              /**< Capacity of each pair buffer. */
+  vl_uindex * clusterEnds ;          /**< Per-thread cluster buckets. */
+  vl_uindex * pairs ;                /**< Per-thread bucketed assignments. */
+} ;
+
+/* Grow the per-thread scratch buffers to hold the given number of
+   assignments. */
+static void
+_vl_vlad_encoder_reserve (VlVladEncoder * self, vl_size numThreads, vl_size numPairs)
+{
+  numPairs = VL_MAX(numPairs, 1) ;
+  if (self->numScratches < numThreads || self->maxNumPairs < numPairs) {
+    vl_free(self->clusterEnds) ;
+    vl_free(self->pairs) ;
+    self->numScratches = VL_MAX(self->numScratches, numThreads) ;
+    self->maxNumPairs = VL_MAX(self->maxNumPairs, numPairs) ;
+    self->clusterEnds = vl_malloc(sizeof(vl_uindex) * (self->numClusters + 1) * self->numScratches) ;
+    self->pairs = vl_malloc(sizeof(vl_uindex) * self->maxNumPairs * self->numScratches) ;
+  }
+}
+#endif
+
 /* ================================================================ */
 #ifdef VL_VLAD_INSTANTIATING
 
+/* Subtract the mean from the accumulated residuals of one cluster and
+   apply the per-cluster normalizations. */
+static void
+VL_XCAT(_vl_vlad_finalize_cluster_, SFX)
+(TYPE * enc, TYPE const * mean, vl_size dimension,
+ double clusterMass, int flags)
+{
+  vl_uindex dim ;
+
+  if (clusterMass > 0) {
+    if (flags & VL_VLAD_FLAG_NORMALIZE_MASS) {
+      for(dim = 0; dim < dimension; dim++) {
+        enc[dim] /= clusterMass ;
+        enc[dim] -= mean[dim];
+      }
+    } else {
+      for(dim = 0; dim < dimension; dim++) {
+        enc[dim] -= clusterMass * mean[dim];
+      }
+    }
+  }
+
+  if (flags & VL_VLAD_FLAG_SQUARE_ROOT) {
+    for(dim = 0; dim < dimension; dim++) {
+      TYPE z = enc[dim] ;
+      if (z >= 0) {
+        enc[dim] = VL_XCAT(vl_sqrt_, SFX)(z) ;
+      } else {
+        enc[dim] = - VL_XCAT(vl_sqrt_, SFX)(- z) ;
+      }
+    }
+  }
+
+  if (flags & VL_VLAD_FLAG_NORMALIZE_COMPONENTS) {
+    TYPE n = 0 ;
+    for(dim = 0; dim < dimension; dim++) {
+      TYPE z = enc[dim] ;
+      n += z * z ;
+    }
+    n = VL_XCAT(vl_sqrt_, SFX)(n) ;
+    n = VL_MAX(n, 1e-12) ;
+    for(dim = 0; dim < dimension; dim++) {
+      enc[dim] /= n ;
+    }
+  }
+}
+
+static void
+VL_XCAT(_vl_vlad_normalize_, SFX)
+(TYPE * enc, vl_size size, int flags)
+{
+  vl_uindex dim ;
+  if (! (flags & VL_VLAD_FLAG_UNNORMALIZED)) {
+    TYPE n = 0 ;
+    for(dim = 0 ; dim < size ; dim++) {
+      TYPE z = enc [dim] ;
+      n += z * z ;
+    }
+    n = VL_XCAT(vl_sqrt_, SFX)(n) ;
+    n = VL_MAX(n, 1e-12) ;
+    for(dim = 0 ; dim < size ; dim++) {
+      enc[dim] /= n ;
+    }
+  }
+}
+
 static void
 VL_XCAT(_vl_vlad_encode_, SFX)
 (TYPE * enc,
@@ -187,61 +285,282 @@ VL_XCAT(_vl_vlad_encode_, SFX)
         }
       }
     }
+    VL_XCAT(_vl_vlad_finalize_cluster_, SFX)
+    (enc + i_cl * dimension, means + i_cl * dimension, dimension,
+     clusterMass, flags) ;
+  }
 
-    if (clusterMass > 0) {
-      if (flags & VL_VLAD_FLAG_NORMALIZE_MASS) {
-        for(dim = 0; dim < dimension; dim++) {
-          enc[i_cl*dimension + dim] /= clusterMass ;
-          enc[i_cl*dimension + dim] -= means[i_cl*dimension+dim];
-        }
-      } else {
+  VL_XCAT(_vl_vlad_normalize_, SFX)(enc, dimension * numClusters, flags) ;
+}
+
+/* clusterEnds and pairs are scratch buffers of size numClusters + 1
+   and numData * numAssignments respectively. */
+static void
+VL_XCAT(_vl_vlad_encode_sparse_, SFX)
+(TYPE * enc,
+ TYPE const * means, vl_size dimension, vl_size numClusters,
+ TYPE const * data, vl_size numData,
+ vl_uint32 const * indexes,
+ TYPE const * weights,
+ vl_size numAssignments,
+ int flags,
+ vl_uindex * clusterEnds,
+ vl_uindex * pairs)
+{
+  vl_size numPairs = numData * numAssignments ;
+  vl_uindex dim, p ;
+  vl_index i_cl ;
+
+  memset(clusterEnds, 0, sizeof(vl_uindex) * (numClusters + 1)) ;
+
+  /* Bucket the (datum, cluster) pairs by cluster with a counting sort.
+     After the pairs are placed, clusterEnds[k] points one past the
+     last pair of cluster k, which is also the first pair of cluster
+     k + 1. Pairs keep the data order within each bucket, so the
+     accumulation order matches the one of the dense encoder. */
+  for (p = 0 ; p < numPairs ; ++p) {
+    assert (indexes[p] < numClusters) ;
+    clusterEnds[indexes[p] + 1] ++ ;
+  }
+  for (p = 1 ; p <= numClusters ; ++p) {
+    clusterEnds[p] += clusterEnds[p - 1] ;
+  }
+  for (p = 0 ; p < numPairs ; ++p) {
+    pairs[clusterEnds[indexes[p]] ++] = p ;
+  }
+
+  memset(enc, 0, sizeof(TYPE) * dimension * numClusters) ;
+
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(i_cl,p,dim) num_threads(vl_get_max_threads())
+#endif
+  for (i_cl = 0; i_cl < (signed)numClusters; i_cl++) {
+    TYPE * clusterEnc = enc + i_cl * dimension ;
+    double clusterMass = 0 ;
+    vl_uindex begin = (i_cl > 0) ? clusterEnds[i_cl - 1] : 0 ;
+    for (p = begin ; p < clusterEnds[i_cl] ; ++p) {
+      TYPE const * x = data + (pairs[p] / numAssignments) * dimension ;
+      double q = weights ? weights[pairs[p]] : 1.0 ;
+      if (q > 0) {
+        clusterMass += q ;
         for(dim = 0; dim < dimension; dim++) {
-          enc[i_cl*dimension + dim] -= clusterMass * means[i_cl*dimension+dim];
+          clusterEnc[dim] += q * x[dim] ;
         }
       }
     }
+    VL_XCAT(_vl_vlad_finalize_cluster_, SFX)
+    (clusterEnc, means + i_cl * dimension, dimension,
+     clusterMass, flags) ;
+  }
 
-    if (flags & VL_VLAD_FLAG_SQUARE_ROOT) {
-      for(dim = 0; dim < dimension; dim++) {
-        TYPE z = enc[i_cl*dimension + dim] ;
-        if (z >= 0) {
-          enc[i_cl*dimension + dim] = VL_XCAT(vl_sqrt_, SFX)(z) ;
-        } else {
-          enc[i_cl*dimension + dim] = - VL_XCAT(vl_sqrt_, SFX)(- z) ;
-        }
+  VL_XCAT(_vl_vlad_normalize_, SFX)(enc, dimension * numClusters, flags) ;
+}
+
+static void
+VL_XCAT(_vl_vlad_encoder_encode_batch_, SFX)
+(VlVladEncoder * self,
+ TYPE * enc,
+ TYPE const * data, vl_size const * numData, vl_size numImages,
+ vl_uint32 const * indexes,
+ TYPE const * weights,
+ vl_size numAssignments,
+ int flags)
+{
+  vl_size dimension = self->dimension ;
+  vl_size numClusters = self->numClusters ;
+  vl_size numThreads = 1 ;
+  vl_size maxNumData = 0 ;
+  vl_uindex * offsets = vl_malloc(sizeof(vl_uindex) * (numImages + 1)) ;
+  vl_index i ;
+
+#if defined(_OPENMP)
+  numThreads = vl_get_max_threads() ;
+#endif
+
+  offsets[0] = 0 ;
+  for (i = 0 ; i < (signed)numImages ; ++i) {
+    offsets[i + 1] = offsets[i] + numData[i] ;
+    maxNumData = VL_MAX(maxNumData, numData[i]) ;
+  }
+  _vl_vlad_encoder_reserve (self, numThreads, maxNumData * numAssignments) ;
+
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(i) num_threads(numThreads) schedule(dynamic)
+#endif
+  for (i = 0 ; i < (signed)numImages ; ++i) {
+    vl_uindex thread = 0 ;
+#if defined(_OPENMP)
+    thread = omp_get_thread_num() ;
+#endif
+    VL_XCAT(_vl_vlad_encode_sparse_, SFX)
+    (enc + i * dimension * numClusters,
+     (TYPE const *) self->means, dimension, numClusters,
+     data + offsets[i] * dimension, numData[i],
+     indexes + offsets[i] * numAssignments,
+     weights ? weights + offsets[i] * numAssignments : NULL,
+     numAssignments, flags,
+     self->clusterEnds + thread * (numClusters + 1),
+     self->pairs + thread * self->maxNumPairs) ;
+  }
+
+  vl_free(offsets) ;
+}
+
+/* Add the weighted vector x to the accumulators of its clusters. */
+VL_INLINE void
+VL_XCAT(_vl_vlad_add_, SFX)
+(TYPE * acc, TYPE const * x, vl_size dimension, vl_size numClusters,
+ vl_uint32 const * indexes, TYPE const * weights, vl_size numAssignments)
+{
+  vl_uindex a, dim ;
+  for (a = 0 ; a < numAssignments ; ++a) {
+    double q = weights ? weights[a] : 1.0 ;
+    TYPE * clusterAcc = acc + indexes[a] * dimension ;
+    if (q > 0) {
+      acc[dimension * numClusters + indexes[a]] += q ;
+      for (dim = 0 ; dim < dimension ; ++dim) {
+        clusterAcc[dim] += q * x[dim] ;
       }
     }
+  }
+}
 
-    if (flags & VL_VLAD_FLAG_NORMALIZE_COMPONENTS) {
-      TYPE n = 0 ;
-      dim = 0 ;
-      for(dim = 0; dim < dimension; dim++) {
-        TYPE z = enc[i_cl*dimension + dim] ;
-        n += z * z ;
+static void
+VL_XCAT(_vl_vlad_encoder_encode_regions_, SFX)
+(VlVladEncoder * self,
+ TYPE * enc,
+ TYPE const * data,
+ VlPoolingGrid const * grid,
+ vl_uint32 const * indexes,
+ TYPE const * weights,
+ vl_size numAssignments,
+ int flags)
+{
+  vl_size dimension = self->dimension ;
+  vl_size numClusters = self->numClusters ;
+  vl_size numRegions = grid->numRegions ;
+  vl_size encSize = dimension * numClusters ;
+  vl_size accSize = (dimension + 1) * numClusters ;
+  vl_size tableWidth = grid->numCellsX + 1 ;
+  vl_size tableSize = tableWidth * (grid->numCellsY + 1) ;
+  vl_size numThreads = 1 ;
+  TYPE const * means = self->means ;
+  TYPE * scratch ;
+  double * table = NULL ;
+  vl_index c, r ;
+  vl_uindex e ;
+
+#if defined(_OPENMP)
+  numThreads = vl_get_max_threads() ;
+#endif
+  scratch = vl_malloc(sizeof(TYPE) * accSize * numThreads) ;
+
+  if (tableSize <= numRegions && tableSize * accSize <= VL_VLAD_MAX_INTEGRAL_SIZE) {
+    /* integral image of the cell statistics */
+    table = vl_calloc(tableSize * accSize, sizeof(double)) ;
+
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(c,e) num_threads(numThreads) schedule(dynamic)
+#endif
+    for (c = 0 ; c < (signed)vl_pooling_grid_get_num_cells(grid) ; ++c) {
+      vl_uindex thread = 0 ;
+      vl_uindex cx = c % grid->numCellsX ;
+      vl_uindex cy = c / grid->numCellsX ;
+      double * entry = table + ((cy + 1) * tableWidth + cx + 1) * accSize ;
+      vl_uindex o ;
+      TYPE * acc ;
+#if defined(_OPENMP)
+      thread = omp_get_thread_num() ;
+#endif
+      acc = scratch + thread * accSize ;
+      memset(acc, 0, sizeof(TYPE) * accSize) ;
+      for (o = vl_pooling_grid_get_cell_begin(grid, cx, cy) ;
+           o < vl_pooling_grid_get_cell_end(grid, cx, cy) ; ++o) {
+        vl_uindex i = grid->order[o] ;
+        VL_XCAT(_vl_vlad_add_, SFX)
+        (acc, data + i * dimension, dimension, numClusters,
+         indexes + i * numAssignments,
+         weights ? weights + i * numAssignments : NULL,
+         numAssignments) ;
       }
-      n = VL_XCAT(vl_sqrt_, SFX)(n) ;
-      n = VL_MAX(n, 1e-12) ;
-      for(dim = 0; dim < dimension; dim++) {
-        enc[i_cl*dimension + dim] /= n ;
+      for (e = 0 ; e < accSize ; ++e) entry[e] = acc[e] ;
+    }
+
+    /* cumulate along the rows and then along the columns */
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(c,e) num_threads(numThreads)
+#endif
+    for (c = 1 ; c < (signed)(grid->numCellsY + 1) ; ++c) {
+      vl_uindex cx ;
+      for (cx = 1 ; cx < tableWidth ; ++cx) {
+        double * entry = table + (c * tableWidth + cx) * accSize ;
+        for (e = 0 ; e < accSize ; ++e) entry[e] += entry[e - accSize] ;
+      }
+    }
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(c,e) num_threads(numThreads)
+#endif
+    for (c = 1 ; c < (signed)tableWidth ; ++c) {
+      vl_uindex cy ;
+      for (cy = 1 ; cy < grid->numCellsY + 1 ; ++cy) {
+        double * entry = table + (cy * tableWidth + c) * accSize ;
+        for (e = 0 ; e < accSize ; ++e) entry[e] += entry[e - tableWidth * accSize] ;
       }
     }
   }
 
-  if (! (flags & VL_VLAD_FLAG_UNNORMALIZED)) {
-    TYPE n = 0 ;
-    for(dim = 0 ; dim < dimension * numClusters ; dim++) {
-      TYPE z = enc [dim] ;
-      n += z * z ;
+#if defined(_OPENMP)
+#pragma omp parallel for default(shared) private(r,c,e) num_threads(numThreads) schedule(dynamic)
+#endif
+  for (r = 0 ; r < (signed)numRegions ; ++r) {
+    vl_uindex thread = 0 ;
+    vl_uindex const * block = grid->regionCells + 4 * r ;
+    TYPE * regionEnc = enc + r * encSize ;
+    TYPE * acc ;
+#if defined(_OPENMP)
+    thread = omp_get_thread_num() ;
+#endif
+    acc = scratch + thread * accSize ;
+
+    if (table) {
+      double const * a = table + (block[1] * tableWidth + block[0]) * accSize ;
+      double const * b = table + (block[1] * tableWidth + block[2]) * accSize ;
+      double const * d = table + (block[3] * tableWidth + block[0]) * accSize ;
+      double const * f = table + (block[3] * tableWidth + block[2]) * accSize ;
+      for (e = 0 ; e < accSize ; ++e) acc[e] = (TYPE) ((f[e] - b[e]) - (d[e] - a[e])) ;
+    } else {
+      /* pool the vectors of the region directly */
+      vl_uindex cx, cy, o ;
+      memset(acc, 0, sizeof(TYPE) * accSize) ;
+      for (cy = block[1] ; cy < block[3] ; ++cy) {
+        for (cx = block[0] ; cx < block[2] ; ++cx) {
+          for (o = vl_pooling_grid_get_cell_begin(grid, cx, cy) ;
+               o < vl_pooling_grid_get_cell_end(grid, cx, cy) ; ++o) {
+            vl_uindex i = grid->order[o] ;
+            VL_XCAT(_vl_vlad_add_, SFX)
+            (acc, data + i * dimension, dimension, numClusters,
+             indexes + i * numAssignments,
+             weights ? weights + i * numAssignments : NULL,
+             numAssignments) ;
+          }
+        }
+      }
     }
-    n = VL_XCAT(vl_sqrt_, SFX)(n) ;
-    n = VL_MAX(n, 1e-12) ;
-    for(dim = 0 ; dim < dimension * numClusters ; dim++) {
-      enc[dim] /= n ;
+
+    memcpy(regionEnc, acc, sizeof(TYPE) * encSize) ;
+    for (c = 0 ; c < (signed)numClusters ; ++c) {
+      VL_XCAT(_vl_vlad_finalize_cluster_, SFX)
+      (regionEnc + c * dimension, means + c * dimension, dimension,
+       acc[encSize + c], flags) ;
     }
+    VL_XCAT(_vl_vlad_normalize_, SFX)(regionEnc, encSize, flags) ;
   }
+
+  if (table) vl_free(table) ;
+  vl_free(scratch) ;
 }
 
-/* VL_FISHER_INSTANTIATING */
+/* VL_VLAD_INSTANTIATING */
 #else
 
 #ifndef __DOXYGEN__
@@ -314,6 +633,222 @@ vl_vlad_encode (void * enc, vl_type dataType,
   }
 }
 
+/** @brief VLAD encoding of a set of vectors with sparse assignments.
+ ** @param enc output VLAD encoding (out).
+ ** @param dataType the type of the input data (::VL_TYPE_DOUBLE or ::VL_TYPE_FLOAT).
+ ** @param means cluster means.
+ ** @param dimension dimensionality of the data.
+ ** @param numClusters number of clusters.
+ ** @param data the data vectors to encode.
+ ** @param numData number of data vectors to encode.
+ ** @param indexes indexes of the clusters assigned to each vector.
+ ** @param weights assignment weights (may be @c NULL).
+ ** @param numAssignments number of clusters assigned to each vector.
+ ** @param flags options.
+ **
+ ** The function is equivalent to ::vl_vlad_encode, but the
+ ** assignments are given as a list of @a numAssignments cluster
+ ** indexes for each data vector rather than as a dense @a numClusters
+ ** by @a numData matrix. @a indexes is a matrix with @a numAssignments
+ ** rows and @a numData columns and @a weights, if not @c NULL, has
+ ** the same size and the same type as @a data. If @a weights is @c
+ ** NULL, all the assignments have unit weight; hence setting @a
+ ** numAssignments to one and passing the output of
+ ** ::vl_kmeans_quantize as @a indexes computes the VLAD encoding of a
+ ** hard k-means assignment.
+ **
+ ** The cost of the encoding is proportional to @a numData times @a
+ ** numAssignments rather than to @a numData times @a numClusters.
+ ** The result is identical to the one of ::vl_vlad_encode applied to
+ ** the equivalent dense assignments. @a flags are the same as for
+ ** ::vl_vlad_encode.
+ **
+ ** @sa @ref vlad
+ **/
+
+void
+vl_vlad_encode_sparse (void * enc, vl_type dataType,
+                       void const * means, vl_size dimension, vl_size numClusters,
+                       void const * data, vl_size numData,
+                       vl_uint32 const * indexes,
+                       void const * weights,
+                       vl_size numAssignments,
+                       int flags)
+{
+  vl_uindex * clusterEnds = vl_malloc(sizeof(vl_uindex) * (numClusters + 1)) ;
+  vl_uindex * pairs = vl_malloc(sizeof(vl_uindex) * VL_MAX(numData * numAssignments, 1)) ;
+  switch(dataType) {
+    case VL_TYPE_FLOAT:
+      _vl_vlad_encode_sparse_f ((float *) enc,
+                                (float const *) means, dimension, numClusters,
+                                (float const *) data, numData,
+                                indexes, (float const *) weights,
+                                numAssignments, flags,
+                                clusterEnds, pairs) ;
+      break;
+    case VL_TYPE_DOUBLE:
+      _vl_vlad_encode_sparse_d ((double *) enc,
+                                (double const *) means, dimension, numClusters,
+                                (double const *) data, numData,
+                                indexes, (double const *) weights,
+                                numAssignments, flags,
+                                clusterEnds, pairs) ;
+      break;
+    default:
+      abort();
+  }
+  vl_free(pairs) ;
+  vl_free(clusterEnds) ;
+}
+
+/** @brief Create a new VLAD encoder
+ ** @param dataType the type of the data (::VL_TYPE_DOUBLE or ::VL_TYPE_FLOAT).
+ ** @param means cluster means.
+ ** @param dimension dimensionality of the data.
+ ** @param numClusters number of clusters.
+ ** @return new encoder.
+ **
+ ** The encoder copies the cluster means and keeps its scratch
+ ** buffers across calls to ::vl_vlad_encoder_encode_batch. Hence it
+ ** must not be used by concurrent callers: encode the images of
+ ** several threads by one batch, or use one encoder per thread.
+ **/
+
+VlVladEncoder *
+vl_vlad_encoder_new (vl_type dataType,
+                     void const * means, vl_size dimension, vl_size numClusters)
+{
+  vl_size size = vl_get_type_size(dataType) * dimension * numClusters ;
+  VlVladEncoder * self = vl_calloc(1, sizeof(VlVladEncoder)) ;
+  self->dataType = dataType ;
+  self->dimension = dimension ;
+  self->numClusters = numClusters ;
+  self->means = vl_malloc(size) ;
+  memcpy(self->means, means, size) ;
+  return self ;
+}
+
+/** @brief Delete a VLAD encoder
+ ** @param self encoder.
+ **/
+
+void
+vl_vlad_encoder_delete (VlVladEncoder * self)
+{
+  vl_free(self->means) ;
+  if (self->clusterEnds) vl_free(self->clusterEnds) ;
+  if (self->pairs) vl_free(self->pairs) ;
+  vl_free(self) ;
+}
+
+/** @brief VLAD encoding of several sets of vectors with sparse assignments
+ ** @param self encoder.
+ ** @param enc output VLAD encodings (out).
+ ** @param data the data vectors to encode.
+ ** @param numData number of data vectors in each set.
+ ** @param numImages number of sets.
+ ** @param indexes indexes of the clusters assigned to each vector.
+ ** @param weights assignment weights (may be @c NULL).
+ ** @param numAssignments number of clusters assigned to each vector.
+ ** @param flags options.
+ **
+ ** @a data contains the vectors of the @a numImages sets one after
+ ** the other, and @a numData[i] is the number of vectors of the
+ ** @a i-th set. @a indexes and @a weights are laid out in the same
+ ** way, with @a numAssignments entries per vector. @a enc is a matrix
+ ** with @a numImages columns, each receiving the VLAD encoding of one
+ ** set as computed by ::vl_vlad_encode_sparse. The sets are encoded
+ ** in parallel.
+ **/
+
+void
+vl_vlad_encoder_encode_batch (VlVladEncoder * self,
+                              void * enc,
+                              void const * data,
+                              vl_size const * numData,
+                              vl_size numImages,
+                              vl_uint32 const * indexes,
+                              void const * weights,
+                              vl_size numAssignments,
+                              int flags)
+{
+  switch(self->dataType) {
+    case VL_TYPE_FLOAT:
+      _vl_vlad_encoder_encode_batch_f (self, (float *) enc,
+                                       (float const *) data, numData, numImages,
+                                       indexes, (float const *) weights,
+                                       numAssignments, flags) ;
+      break;
+    case VL_TYPE_DOUBLE:
+      _vl_vlad_encoder_encode_batch_d (self, (double *) enc,
+                                       (double const *) data, numData, numImages,
+                                       indexes, (double const *) weights,
+                                       numAssignments, flags) ;
+      break;
+    default:
+      abort();
+  }
+}
+
+/** @brief VLAD encoding of the vectors of several image regions
+ ** @param self encoder.
+ ** @param enc output VLAD encodings (out).
+ ** @param data the data vectors to encode.
+ ** @param numData number of data vectors.
+ ** @param positions vector positions.
+ ** @param regions pooling regions.
+ ** @param numRegions number of regions.
+ ** @param indexes indexes of the clusters assigned to each vector.
+ ** @param weights assignment weights (may be @c NULL).
+ ** @param numAssignments number of clusters assigned to each vector.
+ ** @param flags options.
+ **
+ ** The function computes the VLAD encoding of the vectors of each of
+ ** @a numRegions regions, for example the cells of a spatial pyramid
+ ** or a set of object proposals. @a positions is a 2 x @a numData
+ ** matrix with the (x,y) coordinates of the vectors and @a regions a
+ ** 4 x @a numRegions matrix of boxes $(x_0,y_0,x_1,y_1)$ (@ref
+ ** pooling). The assignments are given as for
+ ** ::vl_vlad_encode_sparse. @a enc is a matrix with @a numRegions
+ ** columns, each receiving the encoding of the vectors inside one
+ ** region.
+ **
+ ** If the regions are more than the cells of their @ref
+ ** pooling-grid "pooling grid", the statistics of the regions are
+ ** obtained from an integral image of the cells.
+ **/
+
+void
+vl_vlad_encoder_encode_regions (VlVladEncoder * self,
+                                void * enc,
+                                void const * data,
+                                vl_size numData,
+                                double const * positions,
+                                double const * regions,
+                                vl_size numRegions,
+                                vl_uint32 const * indexes,
+                                void const * weights,
+                                vl_size numAssignments,
+                                int flags)
+{
+  VlPoolingGrid * grid = vl_pooling_grid_new (positions, numData, regions, numRegions) ;
+  switch(self->dataType) {
+    case VL_TYPE_FLOAT:
+      _vl_vlad_encoder_encode_regions_f (self, (float *) enc, (float const *) data, grid,
+                                         indexes, (float const *) weights,
+                                         numAssignments, flags) ;
+      break;
+    case VL_TYPE_DOUBLE:
+      _vl_vlad_encoder_encode_regions_d (self, (double *) enc, (double const *) data, grid,
+                                         indexes, (double const *) weights,
+                                         numAssignments, flags) ;
+      break;
+    default:
+      abort();
+  }
+  vl_pooling_grid_delete (grid) ;
+}
+
 /* ! VL_VLAD_INSTANTIATING */
 #endif
 
@@ -42,6 +42,18 @@ the terms of the BSD license (see the COPYING file).
  **/
 /** @} */
 
+#ifndef __DOXYGEN__
+struct _VlVladEncoder ;
+typedef struct _VlVladEncoder VlVladEncoder ;
+#else
+/** @brief VLAD encoder
+ **
+ ** An encoder reuses its scratch buffers across calls and must not
+ ** be used by concurrent callers (see ::vl_vlad_encoder_new).
+ **/
+typedef OPAQUE VlVladEncoder ;
+#endif
+
 VL_EXPORT void vl_vlad_encode
   (void * enc, vl_type dataType,
    void const * means, vl_size dimension, vl_size numClusters,
@@ -49,5 +61,47 @@ VL_EXPORT void vl_vlad_encode
    void const * assignments,
    int flags) ;
 
+VL_EXPORT void vl_vlad_encode_sparse
+  (void * enc, vl_type dataType,
+   void const * means, vl_size dimension, vl_size numClusters,
+   void const * data, vl_size numData,
+   vl_uint32 const * indexes,
+   void const * weights,
+   vl_size numAssignments,
+   int flags) ;
+
+/** @name Encoder object
+ ** @{ */
+VL_EXPORT VlVladEncoder * vl_vlad_encoder_new
+  (vl_type dataType,
+   void const * means, vl_size dimension, vl_size numClusters) ;
+
+VL_EXPORT void vl_vlad_encoder_delete (VlVladEncoder * self) ;
+
+VL_EXPORT void vl_vlad_encoder_encode_batch
+  (VlVladEncoder * self,
+   void * enc,
+   void const * data,
+   vl_size const * numData,
+   vl_size numImages,
+   vl_uint32 const * indexes,
+   void const * weights,
+   vl_size numAssignments,
+   int flags) ;
+
+VL_EXPORT void vl_vlad_encoder_encode_regions
+  (VlVladEncoder * self,
+   void * enc,
+   void const * data,
+   vl_size numData,
+   double const * positions,
+   double const * regions,
+   vl_size numRegions,
+   vl_uint32 const * indexes,
+   void const * weights,
+   vl_size numAssignments,
+   int flags) ;
+/** @} */
+
 /* VL_VLAD_H */
 #endif